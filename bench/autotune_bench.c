@@ -0,0 +1,139 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ray/autotune.h"
+#include "ray/render.h"
+#include "ray/scene_gen.h"
+
+// renders generated scenes with the default settings, the ones picked from
+// the scene stats alone and the calibrated ones, and times the tuning itself
+// (the second time round it comes from the cache), e.g.
+//
+//   build/bench/autotune_bench 2000
+//
+// usage: autotune_bench [max_spheres] [repetitions]
+
+#define CACHE_PATH "autotune_bench.cache"
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double best_render(const RayScene *scene,
+                          const RayRenderSettings *settings,
+                          int repetitions) {
+  RayRenderer *renderer = ray_create_renderer(settings);
+  double best = 0.0;
+  for (int r = 0; r < repetitions && renderer != NULL; ++r) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    RayFramebuffer *fb = ray_renderer_render_hdr(renderer, scene);
+    double elapsed = seconds_since(&start);
+    if (fb == NULL) {
+      break;
+    }
+    ray_free_framebuffer(fb);
+    best = r == 0 || elapsed < best ? elapsed : best;
+  }
+  if (renderer == NULL || best == 0.0) {
+    fprintf(stderr, "render failed\n");
+    exit(1);
+  }
+  ray_free_renderer(renderer);
+  return best;
+}
+
+static double tune(const RayScene *scene, bool calibrate,
+                   RayAutotuneResult *result) {
+  RayAutotuneSettings settings = ray_default_autotune_settings();
+  settings.calibrate = calibrate;
+  settings.cache_path = CACHE_PATH;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (!ray_autotune(scene, &settings, result)) {
+    fprintf(stderr, "tuning failed\n");
+    exit(1);
+  }
+  return seconds_since(&start);
+}
+
+static void print_row(const char *name, const RayRenderSettings *settings,
+                      double seconds, double tuning) {
+  printf("  %-11s %7d %5d %6s %10.2f ms %10.2f ms\n", name,
+         settings->num_threads, settings->tile_size,
+         settings->batch_shadows ? "yes" : "no", seconds * 1000.0,
+         tuning * 1000.0);
+}
+
+int main(int argc, char **argv) {
+  const int max_spheres = argc > 1 ? atoi(argv[1]) : 1000;
+  const int repetitions = argc > 2 ? atoi(argv[2]) : 2;
+  remove(CACHE_PATH);
+
+  for (int num_spheres = 10; num_spheres <= max_spheres; num_spheres *= 10) {
+    for (int mirrors = 0; mirrors < 2; ++mirrors) {
+      RaySceneGenSettings gen = ray_default_scene_gen_settings();
+      gen.num_spheres = num_spheres;
+      gen.reflective_fraction = mirrors ? 0.6 : 0.0;
+      gen.refractive_fraction = mirrors ? 0.2 : 0.0;
+      RayScene scene;
+      if (!ray_generate_scene(&gen, &scene)) {
+        fprintf(stderr, "failed to generate a scene\n");
+        return 1;
+      }
+
+      RayAutotuneResult picked;
+      RayAutotuneResult calibrated;
+      RayAutotuneResult cached;
+      const double pick_time = tune(&scene, false, &picked);
+      const double calibrate_time = tune(&scene, true, &calibrated);
+      const double cached_time = tune(&scene, true, &cached);
+
+      printf("%d spheres%s, coverage %.2f, secondary share %.2f\n",
+             num_spheres, mirrors ? " (mirrors and glass)" : "",
+             picked.stats.coverage, picked.stats.secondary_share);
+      printf("  %-11s %7s %5s %6s %13s %13s\n", "", "threads", "tile",
+             "batch", "render", "tuning");
+      RayRenderSettings defaults = ray_default_render_settings();
+      RayRenderSettings shown = defaults;
+      shown.num_threads = picked.settings.num_threads;
+      print_row("default", &shown, best_render(&scene, &defaults, repetitions),
+                0.0);
+      print_row("picked", &picked.settings,
+                best_render(&scene, &picked.settings, repetitions),
+                pick_time);
+      print_row("calibrated", &calibrated.settings,
+                best_render(&scene, &calibrated.settings, repetitions),
+                calibrate_time);
+      printf("  %-11s %s in %.3f ms\n", "cached",
+             cached.from_cache ? "found" : "missing", cached_time * 1000.0);
+      fflush(stdout);
+      ray_free_scene(&scene);
+    }
+  }
+  remove(CACHE_PATH);
+}
@@ -0,0 +1,96 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ray/render.h"
+#include "ray/scene_gen.h"
+
+// what journaling finished tiles costs a render: none, every interval
+// seconds, and after every single tile (each append waits for the disk), e.g.
+//
+//   build/bench/checkpoint_bench [num_spheres] [interval]
+
+#define PATH "checkpoint_bench.journal"
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// the best of a few renders, so noise doesn't swamp the difference
+static double time_render(RayRenderer *renderer, const RayScene *scene,
+                          const RayCheckpointSettings *checkpoint) {
+  double best = 0.0;
+  for (int r = 0; r < 3; ++r) {
+    // from scratch every time
+    remove(PATH);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    RayFramebuffer *fb =
+        checkpoint != NULL
+            ? ray_renderer_render_checkpointed(renderer, scene, checkpoint)
+            : ray_renderer_render_hdr(renderer, scene);
+    double elapsed = seconds_since(&start);
+    if (fb == NULL) {
+      fprintf(stderr, "failed to render\n");
+      exit(1);
+    }
+    ray_free_framebuffer(fb);
+    best = r == 0 || elapsed < best ? elapsed : best;
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  RaySceneGenSettings gen = ray_default_scene_gen_settings();
+  gen.num_spheres = argc > 1 ? atoi(argv[1]) : 300;
+  const double interval = argc > 2 ? atof(argv[2]) : 1.0;
+  RayScene scene;
+  RayRenderer *renderer = ray_create_renderer(NULL);
+  if (!ray_generate_scene(&gen, &scene) || renderer == NULL) {
+    fprintf(stderr, "failed to set up\n");
+    return 1;
+  }
+
+  double plain = time_render(renderer, &scene, NULL);
+  printf("%-12s %10.2f ms\n", "plain", plain * 1000.0);
+  const double intervals[] = {interval, 0.0};
+  for (int i = 0; i < 2; ++i) {
+    RayCheckpointSettings checkpoint = {
+        .path = PATH,
+        .interval = intervals[i],
+    };
+    double elapsed = time_render(renderer, &scene, &checkpoint);
+    char name[32];
+    snprintf(name, sizeof name, "every %gs", intervals[i]);
+    printf("%-12s %10.2f ms %+6.2f%%\n", i == 0 ? name : "every tile",
+           elapsed * 1000.0, (elapsed / plain - 1.0) * 100.0);
+  }
+
+  remove(PATH);
+  ray_free_renderer(renderer);
+  ray_free_scene(&scene);
+  return 0;
+}
@@ -0,0 +1,127 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ray/cost_map.h"
+#include "ray/img_utils.h"
+#include "ray/loader.h"
+#include "ray/render.h"
+
+// renders a scene with and without a cost map to show what keeping one
+// costs, then writes the image and its cost maps next to it (as false colour
+// pngs, or pfms with raw set), e.g.
+//
+//   build/bench/cost_map_bench scene.json render.png
+//
+// leaves render.png, render.rays.png, render.tests.png, render.depth.png and
+// render.time.png behind
+//
+// usage: cost_map_bench [scene.json] [out.png] [raw] [repetitions]
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// fastest of repetitions renders, the renderer is left with the last one's
+// image and cost map
+static double best_render(RayRenderer *renderer, const RayScene *scene,
+                          int repetitions, RayImg **img) {
+  double best = 0.0;
+  for (int r = 0; r < repetitions; ++r) {
+    if (*img != NULL) {
+      ray_free_img(*img);
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    *img = ray_renderer_render(renderer, scene);
+    const double elapsed = seconds_since(&start);
+    if (*img == NULL) {
+      return -1.0;
+    }
+    if (r == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  return best;
+}
+
+int main(int argc, char **argv) {
+  const char *scene_path = argc > 1 ? argv[1] : "scene.json";
+  const char *out_path = argc > 2 ? argv[2] : "cost_map_bench.png";
+  const bool raw = argc > 3 && atoi(argv[3]) != 0;
+  int repetitions = argc > 4 ? atoi(argv[4]) : 3;
+  repetitions = repetitions > 0 ? repetitions : 1;
+
+  RayScene scene;
+  if (!ray_scene_from_file(scene_path, &scene)) {
+    fprintf(stderr, "failed to load %s\n", scene_path);
+    return 1;
+  }
+
+  RayRenderSettings settings = ray_default_render_settings();
+  RayRenderer *plain = ray_create_renderer(&settings);
+  settings.cost_map = true;
+  RayRenderer *costed = ray_create_renderer(&settings);
+  if (plain == NULL || costed == NULL) {
+    fprintf(stderr, "failed to create renderers\n");
+    return 1;
+  }
+
+  RayImg *img = NULL;
+  const double plain_time = best_render(plain, &scene, repetitions, &img);
+  const double costed_time = best_render(costed, &scene, repetitions, &img);
+  if (plain_time < 0.0 || costed_time < 0.0) {
+    fprintf(stderr, "render failed\n");
+    return 1;
+  }
+  printf("render %.2f ms, %.2f ms with a cost map (%+.1f%%)\n",
+         plain_time * 1000.0, costed_time * 1000.0,
+         (costed_time / plain_time - 1.0) * 100.0);
+
+  const RayCostMap *map = ray_renderer_cost_map(costed);
+  printf("%-8s %14s %10s %10s\n", "cost", "total", "max", "scale");
+  for (int cost = 0; cost < RAY_PIXEL_COST_count; ++cost) {
+    const float *plane = ray_cost_map_plane(map, cost);
+    double total = 0.0;
+    float max = 0.0f;
+    for (int i = 0; i < map->width * map->height; ++i) {
+      total += plane[i];
+      max = plane[i] > max ? plane[i] : max;
+    }
+    printf("%-8s %14.0f %10.0f %10.0f\n", ray_pixel_cost_name(cost), total,
+           max, ray_cost_map_scale(map, cost));
+  }
+
+  bool success = ray_png_write(out_path, img) &&
+                 ray_write_cost_maps(map, out_path, raw);
+
+  ray_free_img(img);
+  ray_free_renderer(plain);
+  ray_free_renderer(costed);
+  ray_free_scene(&scene);
+  return success ? 0 : 1;
+}
@@ -0,0 +1,96 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ray/scene_gen.h"
+
+// writes a generated scene (and its textures) out as json, e.g.
+//
+//   build/bench/gen_scene big.json --spheres 1000000 --clustering 0.5
+//
+// usage: gen_scene out.json [--option value]..., see below for the options
+
+typedef struct GenOption {
+  const char *name;
+  // exactly one of these is set
+  int *integer;
+  double *real;
+} GenOption;
+
+static void usage(const GenOption *options, int num_options) {
+  fprintf(stderr, "usage: gen_scene out.json [--option value]...\n"
+                  "options:");
+  for (int i = 0; i < num_options; ++i) {
+    fprintf(stderr, " --%s", options[i].name);
+  }
+  fprintf(stderr, " --seed\n");
+}
+
+int main(int argc, char **argv) {
+  RaySceneGenSettings settings = ray_default_scene_gen_settings();
+  const GenOption options[] = {
+      {"width", .integer = &settings.width},
+      {"height", .integer = &settings.height},
+      {"spheres", .integer = &settings.num_spheres},
+      {"clustering", .real = &settings.clustering},
+      {"clusters", .integer = &settings.num_clusters},
+      {"planes", .integer = &settings.num_planes},
+      {"lights", .integer = &settings.num_lights},
+      {"reflective", .real = &settings.reflective_fraction},
+      {"refractive", .real = &settings.refractive_fraction},
+      {"textured", .real = &settings.textured_fraction},
+      {"textures", .integer = &settings.num_textures},
+      {"texture-size", .integer = &settings.texture_size},
+  };
+  const int num_options = sizeof options / sizeof options[0];
+
+  if (argc < 2 || argc % 2 != 0) {
+    usage(options, num_options);
+    return 1;
+  }
+  for (int a = 2; a < argc; a += 2) {
+    const char *name = argv[a] + 2;
+    const char *value = argv[a + 1];
+    if (strncmp(argv[a], "--", 2) != 0) {
+      usage(options, num_options);
+      return 1;
+    }
+    if (strcmp(name, "seed") == 0) {
+      settings.seed = strtoull(value, NULL, 10);
+      continue;
+    }
+    int o = 0;
+    while (o < num_options && strcmp(options[o].name, name) != 0) {
+      ++o;
+    }
+    if (o == num_options) {
+      fprintf(stderr, "unknown option %s\n", argv[a]);
+      usage(options, num_options);
+      return 1;
+    }
+    if (options[o].integer != NULL) {
+      *options[o].integer = atoi(value);
+    } else {
+      *options[o].real = atof(value);
+    }
+  }
+
+  return ray_write_generated_scene(&settings, argv[1]) ? 0 : 1;
+}
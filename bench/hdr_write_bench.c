@@ -0,0 +1,107 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ray/hdr_io.h"
+#include "ray/tone_map.h"
+
+// writes a synthetic 4k frame out in every format, e.g.
+//
+//   build/bench/hdr_write_bench [width] [height]
+//
+// pfm and raw should run at about the speed of the disk (or page cache),
+// png (with each preset, fast spreads over every cpu) is there for
+// comparison
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void report(const char *name, double seconds, size_t bytes) {
+  printf("%-6s %8.2f ms %8.1f MB/s\n", name, seconds * 1000.0,
+         bytes / seconds / 1e6);
+}
+
+int main(int argc, char **argv) {
+  const int width = argc > 1 ? atoi(argv[1]) : 3840;
+  const int height = argc > 2 ? atoi(argv[2]) : 2160;
+
+  RayFramebuffer *fb = ray_create_framebuffer(width, height);
+  if (fb == NULL) {
+    fprintf(stderr, "failed to make a %dx%d framebuffer\n", width, height);
+    return 1;
+  }
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      float *pixel = ray_framebuffer_pixel(fb, x, y);
+      pixel[0] = (float)x / width * 4.0f;
+      pixel[1] = (float)y / height;
+      pixel[2] = (float)((x ^ y) & 255) / 64.0f;
+    }
+  }
+  const size_t bytes = (size_t)width * height * 3 * sizeof(float);
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  bool success = ray_raw_framebuffer_write("hdr_write_bench.rayfb", fb);
+  report("raw", seconds_since(&start), bytes);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  success = ray_pfm_write("hdr_write_bench.pfm", fb) && success;
+  report("pfm", seconds_since(&start), bytes);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  RayFramebuffer *mapped = ray_map_raw_framebuffer("hdr_write_bench.rayfb");
+  // nothing is read until it's touched, so there's no meaningful rate
+  printf("%-6s %8.2f ms\n", "map", seconds_since(&start) * 1000.0);
+  success = mapped != NULL && success;
+  ray_free_framebuffer(mapped);
+
+  // png times leave out tone mapping, they're only the encode
+  RayImg *img = ray_tone_map(fb, NULL);
+  const struct {
+    const char *name;
+    RAY_PNG_PRESET preset;
+  } presets[] = {
+      {"png", RAY_PNG_PRESET_default},
+      {"fast", RAY_PNG_PRESET_fast},
+      {"small", RAY_PNG_PRESET_small},
+  };
+  for (size_t p = 0; p < sizeof presets / sizeof presets[0]; ++p) {
+    RayPngOptions options = ray_png_options(presets[p].preset);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    success = ray_png_write_with_options("hdr_write_bench.png", img,
+                                         &options) &&
+              success;
+    report(presets[p].name, seconds_since(&start), bytes);
+  }
+
+  ray_free_img(img);
+  ray_free_framebuffer(fb);
+
+  return success ? 0 : 1;
+}
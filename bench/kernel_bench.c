@@ -0,0 +1,132 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ray/prepare.h"
+#include "ray/render.h"
+#include "ray/scene_gen.h"
+
+// renders generated scenes with the kernel specialised for their features
+// and with the generic one, from the leanest feature set to all of them, e.g.
+//
+//   build/bench/kernel_bench 200
+//
+// fewer spheres leave more of the time to shading, which is all the kernels
+// differ in
+//
+// usage: kernel_bench [num_spheres] [repetitions]
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double time_render(const RayScene *scene, bool generic) {
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.num_threads = 1;
+  settings.generic_kernel = generic;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  RayImg *img = ray_render_scene_with_settings(scene, &settings);
+  double elapsed = seconds_since(&start);
+  if (img == NULL) {
+    fprintf(stderr, "render failed\n");
+    exit(1);
+  }
+  ray_free_img(img);
+  return elapsed;
+}
+
+// the generator only makes point lights
+static void make_lights_directional(RayScene *scene) {
+  for (int i = 0; i < scene->num_lights; ++i) {
+    RayLight *light = &scene->lights[i];
+    light->type = RAY_LIGHT_TYPE_directional;
+    gsl_vector_set(light->direction, 0, 0.3 * (i % 3 - 1));
+    gsl_vector_set(light->direction, 1, -1.0);
+    gsl_vector_set(light->direction, 2, -0.5);
+    light->intensity = 2.0 / scene->num_lights;
+  }
+}
+
+int main(int argc, char **argv) {
+  const int num_spheres = argc > 1 ? atoi(argv[1]) : 50;
+  const int repetitions = argc > 2 ? atoi(argv[2]) : 3;
+
+  struct {
+    const char *name;
+    bool directional;
+    int num_planes;
+    double refractive_fraction;
+    double textured_fraction;
+  } cases[] = {
+      {"spheres, directional lights", true, 0, 0.0, 0.0},
+      {"spheres, point lights", false, 0, 0.0, 0.0},
+      {"+ planes", false, 2, 0.0, 0.0},
+      {"+ refraction", false, 2, 0.2, 0.0},
+      {"+ textures", false, 2, 0.2, 0.3},
+  };
+
+  printf("%-28s %8s %12s %12s %8s\n", "scene", "features", "specialised",
+         "generic", "speedup");
+  for (size_t c = 0; c < sizeof cases / sizeof cases[0]; ++c) {
+    RaySceneGenSettings gen = ray_default_scene_gen_settings();
+    gen.num_spheres = num_spheres;
+    gen.num_planes = cases[c].num_planes;
+    gen.reflective_fraction = 0.3;
+    gen.refractive_fraction = cases[c].refractive_fraction;
+    gen.textured_fraction = cases[c].textured_fraction;
+
+    RayScene scene;
+    RayPreparedScene prepared;
+    if (!ray_generate_scene(&gen, &scene)) {
+      fprintf(stderr, "failed to generate a scene\n");
+      return 1;
+    }
+    if (cases[c].directional) {
+      make_lights_directional(&scene);
+    }
+    if (!ray_prepare_scene(&scene, 0.0, &prepared)) {
+      fprintf(stderr, "failed to prepare the scene\n");
+      return 1;
+    }
+    const unsigned features = prepared.features;
+    ray_free_prepared_scene(&prepared);
+
+    // taking turns so drifting clocks hit both the same
+    double specialised = 0.0;
+    double generic = 0.0;
+    for (int r = 0; r < repetitions; ++r) {
+      double s = time_render(&scene, false);
+      double g = time_render(&scene, true);
+      specialised = r == 0 || s < specialised ? s : specialised;
+      generic = r == 0 || g < generic ? g : generic;
+    }
+    printf("%-28s %8x %9.2f ms %9.2f ms %7.3fx\n", cases[c].name, features,
+           specialised * 1000.0, generic * 1000.0, generic / specialised);
+    fflush(stdout);
+    ray_free_scene(&scene);
+  }
+}
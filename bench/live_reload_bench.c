@@ -0,0 +1,122 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ray/loader.h"
+#include "ray/render.h"
+
+// loads a scene with lots of spheres as a live scene, then edits one of them
+// and reloads it, e.g.
+//
+//   build/bench/live_reload_bench [num_objects]
+//
+// the reload still reads the whole file but only parses and loads the
+// edited sphere, and the renderer patches its prepared scene rather than
+// rebuilding it
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static bool write_scene(const char *path, int num_objects,
+                        double first_radius) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    return false;
+  }
+  fprintf(file, "{\n  \"width\": 64, \"height\": 64, \"fov\": 90.0,\n"
+                "  \"shadow-bias\": 1e-12, \"max-recursion-depth\": 2,\n"
+                "  \"background\": {\"r\": 0.0, \"g\": 0.0, \"b\": 0.0},\n"
+                "  \"objects\": [\n");
+  for (int i = 0; i < num_objects; ++i) {
+    fprintf(file,
+            "    {\"sphere\": {\"center\": {\"x\": %d.0, \"y\": %d.0, "
+            "\"z\": -%d.0}, \"radius\": %g, \"material\": "
+            "{\"coloration\": {\"color\": {\"r\": 0.2, \"g\": 0.6, "
+            "\"b\": 0.3}}, \"albedo\": 0.18, \"surface\": \"diffuse\"}}}%s\n",
+            i % 100, (i / 100) % 100, 5 + i / 10000,
+            i == 0 ? first_radius : 0.4, i + 1 < num_objects ? "," : "");
+  }
+  fprintf(file, "  ],\n  \"lights\": [{\"directional\": {\"direction\": "
+                "{\"x\": 0.0, \"y\": -1.0, \"z\": -1.0}, \"color\": "
+                "{\"r\": 1.0, \"g\": 1.0, \"b\": 1.0}, "
+                "\"intensity\": 1.0}}]\n}\n");
+  return fclose(file) == 0;
+}
+
+int main(int argc, char **argv) {
+  const int num_objects = argc > 1 ? atoi(argv[1]) : 200000;
+  const char *path = "live_reload_bench.json";
+  if (!write_scene(path, num_objects, 0.4)) {
+    fprintf(stderr, "failed to write %s\n", path);
+    return 1;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  RayLiveScene *live = ray_load_live_scene(path);
+  if (live == NULL) {
+    fprintf(stderr, "failed to load %s\n", path);
+    return 1;
+  }
+  printf("load    %8.2f ms\n", seconds_since(&start) * 1000.0);
+  RayRenderer *renderer = ray_create_renderer(NULL);
+  if (renderer == NULL) {
+    fprintf(stderr, "failed to create a renderer\n");
+    return 1;
+  }
+  // a move can't be patched, so this prepares it from scratch
+  const RaySceneChanges everything = {.moved = true};
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (!ray_renderer_apply_changes(renderer, ray_live_scene(live),
+                                  &everything)) {
+    fprintf(stderr, "failed to prepare %s\n", path);
+    return 1;
+  }
+  printf("prepare %8.2f ms\n", seconds_since(&start) * 1000.0);
+
+  bool success = write_scene(path, num_objects, 0.5);
+  RaySceneChanges changes;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  success = success && ray_reload_live_scene(live, &changes);
+  if (success) {
+    printf("reload  %8.2f ms (%d changed)\n", seconds_since(&start) * 1000.0,
+           changes.num_changed_objects);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    success =
+        ray_renderer_apply_changes(renderer, ray_live_scene(live), &changes);
+    printf("update  %8.2f ms\n", seconds_since(&start) * 1000.0);
+    ray_free_scene_changes(&changes);
+  }
+  if (!success) {
+    fprintf(stderr, "failed to reload %s\n", path);
+  }
+
+  ray_free_renderer(renderer);
+  ray_free_live_scene(live);
+  remove(path);
+  return success ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ray/render.h"
+#include "ray/vec_utils.h"
+
+// shading cost as the number of point lights grows: every light (traced
+// one at a time and batched per tile), lights culled by influence radius, and
+// culled plus a fixed number of samples per hit. the scene is a field of
+// spheres on a floor with the lights scattered just above it, like street
+// lights
+//
+// usage: many_lights_bench [max lights] [cutoff] [samples]
+
+#define WIDTH 320
+#define HEIGHT 240
+#define GRID 6
+
+static double random_between(double low, double high) {
+  return low + (high - low) * ((double)rand() / RAND_MAX);
+}
+
+static RayMaterial diffuse(double r, double g, double b) {
+  return (RayMaterial){
+      .coloration =
+          {
+              .type = RAY_COLORATION_TYPE_color,
+              .color = ray_create_vec3(r, g, b),
+          },
+      .albedo = 0.18,
+      .surface = {.type = RAY_SURFACE_TYPE_diffuse},
+  };
+}
+
+static RayScene create_scene(int num_lights) {
+  const int num_objects = GRID * GRID + 1;
+  RayObject *objects = malloc(num_objects * (sizeof *objects));
+  objects[0] = (RayObject){
+      .type = RAY_OBJECT_TYPE_plane,
+      .point = ray_create_vec3(0.0, -1.0, 0.0),
+      .normal = ray_create_vec3(0.0, -1.0, 0.0),
+      .material = diffuse(0.5, 0.5, 0.5),
+  };
+  for (int i = 0; i < GRID * GRID; ++i) {
+    double x = (i % GRID - GRID / 2) * 4.0;
+    double z = -6.0 - (i / GRID) * 4.0;
+    objects[i + 1] = (RayObject){
+        .type = RAY_OBJECT_TYPE_sphere,
+        .center = ray_create_vec3(x, 0.0, z),
+        .radius = 1.0,
+        .material = diffuse(0.2 + 0.1 * (i % 7), 0.6, 0.3),
+    };
+  }
+
+  srand(1);
+  RayLight *lights = malloc(num_lights * (sizeof *lights));
+  for (int l = 0; l < num_lights; ++l) {
+    lights[l] = (RayLight){
+        .type = RAY_LIGHT_TYPE_point,
+        .position =
+            ray_create_vec3(random_between(-14.0, 14.0),
+                            random_between(1.5, 3.0),
+                            random_between(-30.0, -2.0)),
+        .color = ray_create_vec3(1.0, random_between(0.6, 1.0), 0.6),
+        .intensity = random_between(100.0, 400.0),
+    };
+  }
+
+  return (RayScene){
+      .width = WIDTH,
+      .height = HEIGHT,
+      .fov = 90.0,
+      .shadow_bias = 1e-12,
+      .max_recursion_depth = 4,
+      .background = ray_create_vec3(0.05, 0.05, 0.1),
+      .num_objects = num_objects,
+      .objects = objects,
+      .num_lights = num_lights,
+      .lights = lights,
+  };
+}
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void run(const char *name, const RayScene *scene, double cutoff,
+                int samples, bool batch_shadows) {
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.light_cutoff = cutoff;
+  settings.light_samples = samples;
+  settings.batch_shadows = batch_shadows;
+  RayRenderer *renderer = ray_create_renderer(&settings);
+  if (renderer == NULL) {
+    fprintf(stderr, "failed to create renderer\n");
+    exit(1);
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  RayImg *img = ray_renderer_render(renderer, scene);
+  double elapsed = seconds_since(&start);
+  RayRenderStats stats = ray_renderer_stats(renderer);
+
+  uint64_t cache_tests =
+      stats.occluder_cache_hits + stats.occluder_cache_misses;
+  double hit_rate =
+      cache_tests > 0 ? 100.0 * stats.occluder_cache_hits / cache_tests : 0.0;
+  printf("%8d %-10s %10.2f %14llu %14llu %13.1f%%\n", scene->num_lights, name,
+         elapsed * 1000.0, (unsigned long long)stats.shadow_rays,
+         (unsigned long long)stats.culled_lights, hit_rate);
+
+  ray_free_img(img);
+  ray_free_renderer(renderer);
+}
+
+int main(int argc, char **argv) {
+  const int max_lights = argc > 1 ? atoi(argv[1]) : 1024;
+  const double cutoff = argc > 2 ? atof(argv[2]) : 0.05;
+  const int samples = argc > 3 ? atoi(argv[3]) : 4;
+
+  printf("%8s %-10s %10s %14s %14s %14s\n", "lights", "mode", "ms",
+         "shadow rays", "culled", "occluder hits");
+  for (int num_lights = 16; num_lights <= max_lights; num_lights *= 4) {
+    RayScene scene = create_scene(num_lights);
+    run("all", &scene, 0.0, 0, false);
+    run("batched", &scene, 0.0, 0, true);
+    run("culled", &scene, cutoff, 0, false);
+    run("sampled", &scene, cutoff, samples, false);
+    ray_free_scene(&scene);
+  }
+
+  return 0;
+}
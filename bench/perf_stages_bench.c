@@ -0,0 +1,172 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ray/loader.h"
+#include "ray/render.h"
+
+// where a render's time and hardware events go, stage by stage, from the
+// perf counters each render thread keeps (see RayRenderSettings.
+// perf_counters). ipc and misses per thousand instructions tell compute
+// bound stages from memory bound ones. also times the render without
+// counting, to show what reading the counters costs. counters that can't be
+// opened (vms and containers often have none of the hardware ones) show as
+// n/a. sample_every is RayRenderSettings.perf_sample_every, 1 shows what
+// splitting every pixel by stage costs, e.g.
+//
+//   build/bench/perf_stages_bench scene.json
+//   build/bench/perf_stages_bench scene.json 3 0 1
+//
+// usage: perf_stages_bench [scene.json] [repetitions] [batch_shadows]
+//                          [sample_every]
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static double best_render(const RayScene *scene,
+                          const RayRenderSettings *settings, int repetitions,
+                          RayRenderStats *stats) {
+  RayRenderer *renderer = ray_create_renderer(settings);
+  if (renderer == NULL) {
+    fprintf(stderr, "failed to create a renderer\n");
+    exit(1);
+  }
+  double best = 0.0;
+  for (int r = 0; r < repetitions; ++r) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    RayFramebuffer *fb = ray_renderer_render_hdr(renderer, scene);
+    double elapsed = seconds_since(&start);
+    if (fb == NULL) {
+      fprintf(stderr, "render failed\n");
+      exit(1);
+    }
+    ray_free_framebuffer(fb);
+    if (r == 0 || elapsed < best) {
+      best = elapsed;
+      *stats = ray_renderer_stats(renderer);
+    }
+  }
+  ray_free_renderer(renderer);
+  return best;
+}
+
+static bool has(const RayRenderStats *stats, RAY_PERF_COUNTER counter) {
+  return (stats->perf_counters & (1u << counter)) != 0;
+}
+
+static void print_count(const RayRenderStats *stats, const uint64_t *counts,
+                        RAY_PERF_COUNTER counter) {
+  if (has(stats, counter)) {
+    printf(" %14llu", (unsigned long long)counts[counter]);
+  } else {
+    printf(" %14s", "n/a");
+  }
+}
+
+// per thousand instructions
+static void print_per_kilo(const RayRenderStats *stats,
+                           const uint64_t *counts, RAY_PERF_COUNTER counter) {
+  const uint64_t instructions = counts[RAY_PERF_COUNTER_instructions];
+  if (has(stats, counter) && has(stats, RAY_PERF_COUNTER_instructions) &&
+      instructions > 0) {
+    printf(" %8.2f", 1000.0 * counts[counter] / instructions);
+  } else {
+    printf(" %8s", "n/a");
+  }
+}
+
+static void print_row(const char *name, const RayRenderStats *stats,
+                      const uint64_t *counts) {
+  printf("%-10s", name);
+  if (has(stats, RAY_PERF_COUNTER_task_clock)) {
+    printf(" %10.2f", counts[RAY_PERF_COUNTER_task_clock] / 1e6);
+  } else {
+    printf(" %10s", "n/a");
+  }
+  for (int c = 0; c < RAY_PERF_COUNTER_task_clock; ++c) {
+    print_count(stats, counts, c);
+  }
+  if (has(stats, RAY_PERF_COUNTER_cycles) &&
+      has(stats, RAY_PERF_COUNTER_instructions) &&
+      counts[RAY_PERF_COUNTER_cycles] > 0) {
+    printf(" %6.2f", (double)counts[RAY_PERF_COUNTER_instructions] /
+                         counts[RAY_PERF_COUNTER_cycles]);
+  } else {
+    printf(" %6s", "n/a");
+  }
+  print_per_kilo(stats, counts, RAY_PERF_COUNTER_l1d_misses);
+  print_per_kilo(stats, counts, RAY_PERF_COUNTER_llc_misses);
+  printf("\n");
+}
+
+int main(int argc, char **argv) {
+  const char *scene_path = argc > 1 ? argv[1] : "scene.json";
+  const int repetitions = argc > 2 ? atoi(argv[2]) : 3;
+  const bool batch_shadows = argc > 3 && atoi(argv[3]) != 0;
+  const int sample_every =
+      argc > 4 ? atoi(argv[4])
+               : ray_default_render_settings().perf_sample_every;
+
+  RayScene scene;
+  if (!ray_scene_from_file(scene_path, &scene)) {
+    fprintf(stderr, "failed to load %s\n", scene_path);
+    return 1;
+  }
+
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.batch_shadows = batch_shadows;
+  RayRenderStats stats;
+  const double plain = best_render(&scene, &settings, repetitions, &stats);
+  settings.perf_counters = true;
+  settings.perf_sample_every = sample_every;
+  const double counted = best_render(&scene, &settings, repetitions, &stats);
+  printf("render %.2f ms, %.2f ms counting (%+.1f%%)\n", plain * 1000.0,
+         counted * 1000.0, (counted / plain - 1.0) * 100.0);
+  if (stats.perf_counters == 0) {
+    printf("no perf counters could be opened\n");
+    ray_free_scene(&scene);
+    return 0;
+  }
+
+  printf("%-10s %10s", "stage", "cpu ms");
+  for (int c = 0; c < RAY_PERF_COUNTER_task_clock; ++c) {
+    printf(" %14s", ray_perf_counter_name(c));
+  }
+  printf(" %6s %8s %8s\n", "ipc", "l1d/ki", "llc/ki");
+  uint64_t total[RAY_PERF_COUNTER_count] = {0};
+  for (int s = 0; s < RAY_RENDER_STAGE_count; ++s) {
+    print_row(ray_render_stage_name(s), &stats, stats.perf[s]);
+    for (int c = 0; c < RAY_PERF_COUNTER_count; ++c) {
+      total[c] += stats.perf[s][c];
+    }
+  }
+  print_row("total", &stats, total);
+
+  ray_free_scene(&scene);
+  return 0;
+}
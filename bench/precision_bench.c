@@ -0,0 +1,129 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ray/img_utils.h"
+#include "ray/loader.h"
+#include "ray/real.h"
+#include "ray/render.h"
+
+// times a render with whatever precision the library was built with and
+// writes it out as precision_bench_<float|double>.png. given the image from a
+// build with the other precision it also reports how far apart they are, e.g.
+//
+//   build-double/bench/precision_bench scene.json
+//   build-float/bench/precision_bench scene.json precision_bench_double.png
+//
+// usage: precision_bench [scene.json] [reference.png|""] [repetitions]
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static bool compare(const RayImg *img, const char *reference_path) {
+  RayImg *reference = ray_read_img(reference_path);
+  if (reference == NULL) {
+    fprintf(stderr, "failed to read %s\n", reference_path);
+    return false;
+  }
+  if (reference->width != img->width || reference->height != img->height) {
+    fprintf(stderr, "%s is %dx%d, expected %dx%d\n", reference_path,
+            reference->width, reference->height, img->width, img->height);
+    ray_free_img(reference);
+    return false;
+  }
+
+  // in 8 bit steps, converted the same way ray_png_write does
+  double max_diff = 0.0;
+  double sum_squared = 0.0;
+  long differing = 0;
+  for (int y = 0; y < img->height; ++y) {
+    for (int x = 0; x < img->width; ++x) {
+      bool differs = false;
+      for (size_t c = 0; c < 3; ++c) {
+        int a = (unsigned char)(gsl_vector_get(img->pixels[y][x], c) *
+                                UCHAR_MAX);
+        int b = (unsigned char)(gsl_vector_get(reference->pixels[y][x], c) *
+                                UCHAR_MAX);
+        double diff = abs(a - b);
+        max_diff = diff > max_diff ? diff : max_diff;
+        sum_squared += diff * diff;
+        differs = differs || diff > 0.0;
+      }
+      differing += differs;
+    }
+  }
+  double rmse = sqrt(sum_squared / (img->width * img->height * 3.0));
+  printf("vs %s: max %.0f rmse %.4f differing pixels %ld/%d\n",
+         reference_path, max_diff, rmse, differing, img->width * img->height);
+
+  ray_free_img(reference);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const char *scene_path = argc > 1 ? argv[1] : "scene.json";
+  const char *reference_path =
+      argc > 2 && argv[2][0] != '\0' ? argv[2] : NULL;
+  const int repetitions = argc > 3 ? atoi(argv[3]) : 3;
+
+  RayScene scene;
+  if (!ray_scene_from_file(scene_path, &scene)) {
+    fprintf(stderr, "failed to load %s\n", scene_path);
+    return 1;
+  }
+
+  double best = 0.0;
+  RayImg *img = NULL;
+  for (int r = 0; r < repetitions || img == NULL; ++r) {
+    if (img != NULL) {
+      ray_free_img(img);
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    img = ray_render_scene(&scene);
+    double elapsed = seconds_since(&start);
+    if (r == 0 || elapsed < best) {
+      best = elapsed;
+    }
+  }
+  printf("%s: %.2f ms\n", RAY_REAL_NAME, best * 1000.0);
+
+  char out_path[64];
+  snprintf(out_path, sizeof out_path, "precision_bench_%s.png", RAY_REAL_NAME);
+  bool success = ray_png_write(out_path, img);
+  if (success && reference_path != NULL) {
+    success = compare(img, reference_path);
+  }
+
+  ray_free_img(img);
+  ray_free_scene(&scene);
+
+  return success ? 0 : 1;
+}
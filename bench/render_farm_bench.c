@@ -0,0 +1,89 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for clock_gettime and sysconf
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ray/render_farm.h"
+#include "ray/scene_gen.h"
+
+// one generated frame rendered in this process on every cpu, then split
+// between worker processes with the cpus shared out between them, e.g.
+//
+//   build/bench/render_farm_bench [num_spheres] [batch_size]
+//
+// the farm pays for forking, the sockets and putting the image together, but
+// each worker has its own heap and caches to itself
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+  RaySceneGenSettings gen = ray_default_scene_gen_settings();
+  gen.num_spheres = argc > 1 ? atoi(argv[1]) : 1000;
+  const int batch_size = argc > 2 ? atoi(argv[2]) : 0;
+  RayScene scene;
+  if (!ray_generate_scene(&gen, &scene)) {
+    fprintf(stderr, "failed to generate the scene\n");
+    return 1;
+  }
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  const int num_cpus = online > 0 ? (int)online : 1;
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  RayRenderer *renderer = ray_create_renderer(NULL);
+  RayFramebuffer *fb =
+      renderer != NULL ? ray_renderer_render_hdr(renderer, &scene) : NULL;
+  if (fb == NULL) {
+    fprintf(stderr, "failed to render\n");
+    return 1;
+  }
+  printf("%-24s %10.2f ms\n", "threads", seconds_since(&start) * 1000.0);
+  ray_free_framebuffer(fb);
+  ray_free_renderer(renderer);
+
+  bool success = true;
+  for (int threads = 1; threads <= num_cpus && success; threads *= 2) {
+    RayFarmSettings settings = ray_default_farm_settings();
+    settings.num_workers = num_cpus / threads;
+    settings.render.num_threads = threads;
+    settings.batch_size = batch_size;
+    RayFarmStats stats;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    fb = ray_farm_render_hdr(&scene, &settings, &stats);
+    success = fb != NULL;
+    char name[64];
+    snprintf(name, sizeof name, "%d workers x %d threads", stats.num_workers,
+             threads);
+    printf("%-24s %10.2f ms (%d batches)\n", name,
+           seconds_since(&start) * 1000.0, stats.num_batches);
+    ray_free_framebuffer(fb);
+  }
+
+  ray_free_scene(&scene);
+  return success ? 0 : 1;
+}
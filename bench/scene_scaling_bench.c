@@ -0,0 +1,161 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ray/loader.h"
+#include "ray/prepare.h"
+#include "ray/render.h"
+#include "ray/scene_gen.h"
+
+// how loading, preparing and rendering a generated scene scale along one of
+// its dimensions, with everything else left at the generator's defaults, e.g.
+//
+//   build/bench/scene_scaling_bench spheres 1000000
+//
+// dimensions: spheres, lights, planes, clustering, reflective, refractive,
+// texture-size and resolution. the optional max is the largest count or
+// size to go up to. each step writes the scene as json, streams it back in,
+// prepares it and renders it (which prepares it again, so the render column
+// includes the prepare one)
+//
+// usage: scene_scaling_bench [dimension] [max]
+
+#define PATH "scene_scaling_bench.json"
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// sets up the given step along dimension, false once past the last one
+static bool set_step(const char *dimension, int step, int max,
+                     RaySceneGenSettings *settings, double *value) {
+  const double fractions[] = {0.0, 0.25, 0.5, 0.75, 1.0};
+  const double clusterings[] = {0.0, 0.5, 0.8, 0.9, 0.95};
+  const int num_fractions = sizeof fractions / sizeof fractions[0];
+  if (strcmp(dimension, "spheres") == 0) {
+    settings->num_spheres = 1000 << (2 * step);
+    *value = settings->num_spheres;
+    return settings->num_spheres <= (max > 0 ? max : 16000);
+  } else if (strcmp(dimension, "lights") == 0) {
+    settings->num_lights = 1 << (2 * step);
+    *value = settings->num_lights;
+    return settings->num_lights <= (max > 0 ? max : 256);
+  } else if (strcmp(dimension, "planes") == 0) {
+    settings->num_planes = 1 << step;
+    *value = settings->num_planes;
+    return settings->num_planes <= (max > 0 ? max : 64);
+  } else if (strcmp(dimension, "clustering") == 0) {
+    settings->num_clusters = 4;
+    settings->clustering = clusterings[step % num_fractions];
+    *value = settings->clustering;
+    return step < num_fractions;
+  } else if (strcmp(dimension, "reflective") == 0) {
+    settings->refractive_fraction = 0.0;
+    settings->reflective_fraction = fractions[step % num_fractions];
+    *value = settings->reflective_fraction;
+    return step < num_fractions;
+  } else if (strcmp(dimension, "refractive") == 0) {
+    settings->reflective_fraction = 0.0;
+    settings->refractive_fraction = fractions[step % num_fractions];
+    *value = settings->refractive_fraction;
+    return step < num_fractions;
+  } else if (strcmp(dimension, "texture-size") == 0) {
+    settings->textured_fraction = 1.0;
+    settings->texture_size = 64 << (2 * step);
+    *value = settings->texture_size;
+    return settings->texture_size <= (max > 0 ? max : 4096);
+  } else if (strcmp(dimension, "resolution") == 0) {
+    settings->width = 80 << step;
+    settings->height = settings->width * 3 / 4;
+    *value = settings->width;
+    return settings->width <= (max > 0 ? max : 1280);
+  }
+  fprintf(stderr, "unknown dimension %s\n", dimension);
+  exit(1);
+}
+
+static bool run(const RaySceneGenSettings *settings, double value) {
+  if (!ray_write_generated_scene(settings, PATH)) {
+    return false;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  RayScene scene;
+  if (!ray_scene_stream_from_file(PATH, NULL, NULL, &scene)) {
+    fprintf(stderr, "failed to load %s\n", PATH);
+    return false;
+  }
+  double load = seconds_since(&start);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  RayPreparedScene prepared;
+  if (!ray_prepare_scene(&scene, 0.0, &prepared)) {
+    fprintf(stderr, "failed to prepare %s\n", PATH);
+    ray_free_scene(&scene);
+    return false;
+  }
+  double prepare = seconds_since(&start);
+  ray_free_prepared_scene(&prepared);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  RayImg *img = ray_render_scene(&scene);
+  double render = seconds_since(&start);
+
+  printf("%12g %10.2f %10.2f %10.2f\n", value, load * 1000.0,
+         prepare * 1000.0, render * 1000.0);
+  fflush(stdout);
+  ray_free_img(img);
+  ray_free_scene(&scene);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const char *dimension = argc > 1 ? argv[1] : "spheres";
+  const int max = argc > 2 ? atoi(argv[2]) : 0;
+
+  printf("%12s %10s %10s %10s\n", dimension, "load ms", "prepare ms",
+         "render ms");
+  // every object is tested against every ray, so keep the image small
+  RaySceneGenSettings settings = ray_default_scene_gen_settings();
+  settings.width = 160;
+  settings.height = 120;
+  double value;
+  bool success = true;
+  for (int step = 0;
+       success && set_step(dimension, step, max, &settings, &value); ++step) {
+    success = run(&settings, value);
+  }
+
+  remove(PATH);
+  for (int t = 0; t < settings.num_textures; ++t) {
+    char texture[64];
+    snprintf(texture, sizeof texture, "scene_scaling_bench_texture%d.png", t);
+    remove(texture);
+  }
+  return success ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for clock_gettime, fork and wait4
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ray/loader.h"
+#include "ray/scene_gen.h"
+
+// generates a scene with lots of spheres and loads it whole and streamed, each
+// in a process of its own so their peak memory can be told apart, e.g.
+//
+//   build/bench/stream_load_bench [num_objects]
+//
+// the streamed load should peak at not much more than the scene itself
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static bool load(const char *path, bool stream) {
+  RayScene scene;
+  bool success = stream ? ray_scene_stream_from_file(path, NULL, NULL, &scene)
+                        : ray_scene_from_file(path, &scene);
+  if (success) {
+    ray_free_scene(&scene);
+  }
+  return success;
+}
+
+static bool run(const char *name, const char *path, bool stream) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pid_t pid = fork();
+  if (pid < 0) {
+    return false;
+  }
+  if (pid == 0) {
+    _exit(load(path, stream) ? 0 : 1);
+  }
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "%s load of %s failed\n", name, path);
+    return false;
+  }
+  printf("%-8s %8.2f ms  peak %8.1f MB\n", name,
+         seconds_since(&start) * 1000.0, usage.ru_maxrss / 1024.0);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const int num_objects = argc > 1 ? atoi(argv[1]) : 200000;
+  const char *path = "stream_load_bench.json";
+  RaySceneGenSettings settings = ray_default_scene_gen_settings();
+  settings.num_spheres = num_objects;
+  if (!ray_write_generated_scene(&settings, path)) {
+    return 1;
+  }
+
+  bool success = run("whole", path, false) && run("streamed", path, true);
+  remove(path);
+  return success ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+// for clock_gettime
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ray/loader.h"
+#include "ray/render.h"
+
+// compares wall time and cache misses of the different tile orders. there's
+// no generic perf event for l2 so l1d and last level misses are reported,
+// counters that can't be opened (e.g. in containers) just show as n/a
+//
+// usage: tile_order_bench [scene.json] [repetitions]
+
+static const RAY_PERF_COUNTER counters[] = {
+    RAY_PERF_COUNTER_l1d_misses,
+    RAY_PERF_COUNTER_llc_misses,
+};
+
+#define NUM_COUNTERS ((int)(sizeof counters / sizeof counters[0]))
+
+// summed over the stages
+static uint64_t counter_total(const RayRenderStats *stats,
+                              RAY_PERF_COUNTER counter) {
+  uint64_t total = 0;
+  for (int s = 0; s < RAY_RENDER_STAGE_count; ++s) {
+    total += stats->perf[s][counter];
+  }
+  return total;
+}
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+typedef struct OrderCase {
+  const char *name;
+  RAY_TILE_ORDER order;
+} OrderCase;
+
+static const OrderCase cases[] = {
+    {"scanline", RAY_TILE_ORDER_scanline},
+    {"raster", RAY_TILE_ORDER_raster},
+    {"morton", RAY_TILE_ORDER_morton},
+    {"hilbert", RAY_TILE_ORDER_hilbert},
+};
+
+int main(int argc, char **argv) {
+  const char *scene_path = argc > 1 ? argv[1] : "scene.json";
+  const int repetitions = argc > 2 ? atoi(argv[2]) : 3;
+
+  RayScene scene;
+  if (!ray_scene_from_file(scene_path, &scene)) {
+    fprintf(stderr, "failed to load %s\n", scene_path);
+    return 1;
+  }
+
+  printf("%-10s %12s", "order", "ms");
+  for (int i = 0; i < NUM_COUNTERS; ++i) {
+    printf(" %14s", ray_perf_counter_name(counters[i]));
+  }
+  printf("\n");
+
+  for (size_t c = 0; c < sizeof cases / sizeof cases[0]; ++c) {
+    RayRenderSettings settings = ray_default_render_settings();
+    settings.tile_order = cases[c].order;
+    settings.perf_counters = true;
+    RayRenderer *renderer = ray_create_renderer(&settings);
+    if (renderer == NULL) {
+      fprintf(stderr, "failed to create a renderer\n");
+      return 1;
+    }
+
+    double best = 0.0;
+    RayRenderStats best_stats = {0};
+    for (int r = 0; r < repetitions; ++r) {
+      struct timespec start;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      RayImg *img = ray_renderer_render(renderer, &scene);
+      double elapsed = seconds_since(&start);
+      ray_free_img(img);
+      if (r == 0 || elapsed < best) {
+        best = elapsed;
+        best_stats = ray_renderer_stats(renderer);
+      }
+    }
+    ray_free_renderer(renderer);
+
+    printf("%-10s %12.2f", cases[c].name, best * 1000.0);
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+      if (best_stats.perf_counters & (1u << counters[i])) {
+        printf(" %14llu", (unsigned long long)counter_total(&best_stats,
+                                                           counters[i]));
+      } else {
+        printf(" %14s", "n/a");
+      }
+    }
+    printf("\n");
+  }
+
+  ray_free_scene(&scene);
+
+  return 0;
+}
@@ -0,0 +1,79 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_ARENA_H
+#define INCLUDED_RAY_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "gsl/gsl_vector.h"
+
+// bump allocator for data that all dies at the same time. allocations are
+// never freed one at a time, resetting hands all of the memory back at once
+// (in O(1) unless cleanups were registered) but keeps the blocks around for
+// reuse. render threads get one each for per-pixel data and loaded scenes own
+// one holding everything they're made of. not thread safe
+typedef struct RayArenaBlock {
+  struct RayArenaBlock *next;
+  size_t size;
+  size_t used;
+} RayArenaBlock;
+
+typedef void (*RayArenaCleanupFn)(void *data);
+
+typedef struct RayArenaCleanup {
+  struct RayArenaCleanup *next;
+  RayArenaCleanupFn fn;
+  void *data;
+} RayArenaCleanup;
+
+typedef struct RayArena {
+  RayArenaBlock *first;
+  RayArenaBlock *current;
+  size_t block_size;
+  // most recently registered first
+  RayArenaCleanup *cleanups;
+} RayArena;
+
+// block_size of 0 means the default
+RayArena *ray_create_arena(size_t block_size);
+
+// returns memory aligned for any type, never NULL unless out of memory
+void *ray_arena_alloc(RayArena *arena, size_t size);
+
+// a 3 element vector living in the arena, don't gsl_vector_free it. NULL if
+// out of memory
+gsl_vector *ray_arena_vec3(RayArena *arena);
+
+// arena equivalent of ray_create_vec3, NULL if out of memory
+gsl_vector *ray_arena_create_vec3(RayArena *arena, double x, double y,
+                                  double z);
+
+// fn(data) will be run when the arena is next reset or freed, for things the
+// arena can't own directly (e.g. textures). returns false if out of memory
+bool ray_arena_add_cleanup(RayArena *arena, RayArenaCleanupFn fn, void *data);
+
+// bytes handed out since the last reset
+size_t ray_arena_used(const RayArena *arena);
+
+void ray_arena_reset(RayArena *arena);
+
+void ray_free_arena(RayArena *arena);
+
+#endif // ifndef INCLUDED_RAY_ARENA_H
@@ -0,0 +1,92 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#ifndef INCLUDED_RAY_AUTOTUNE_H
+#define INCLUDED_RAY_AUTOTUNE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "render.h"
+#include "scene.h"
+
+// picks render settings for a scene instead of them being tuned by hand.
+// only settings that don't change the pixels are touched (threads, tile
+// size and whether shadows are batched), the rest come from the caller
+
+// what the settings are picked from
+typedef struct RaySceneStats {
+  int num_spheres;
+  int num_planes;
+  int num_lights;
+  int num_directional_lights;
+  int num_area_lights;
+  int num_diffuse;
+  int num_reflective;
+  int num_refractive;
+  int num_textured;
+  // share of primary rays that hit anything, and of those the share that hit
+  // something reflective or refractive. from a coarse grid of rays over the
+  // image
+  double coverage;
+  double secondary_share;
+} RaySceneStats;
+
+// false if it runs out of memory
+bool ray_analyse_scene(const RayScene *scene, RaySceneStats *stats);
+
+// hash of everything in the scene that can change how long it takes to
+// render, so tuning results can be looked up again
+uint64_t ray_scene_hash(const RayScene *scene);
+
+typedef struct RayAutotuneSettings {
+  // everything that isn't tuned is taken from here
+  RayRenderSettings base;
+  // time the likely candidates on a scaled down frame rather than going by
+  // the stats alone. tile sizes are timed as they are, not scaled down too
+  bool calibrate;
+  // the calibration frame keeps the aspect ratio and has at most this many
+  // pixels, <= 0 means the default
+  int calibration_pixels;
+  // text file of earlier results, read and appended to. they're looked up by
+  // the scene hash, the number of cpus online and the base settings' threads
+  // and tile order. NULL to tune from scratch every time
+  const char *cache_path;
+} RayAutotuneSettings;
+
+// calibrating on an 80x60 sized frame, without a cache
+RayAutotuneSettings ray_default_autotune_settings(void);
+
+typedef struct RayAutotuneResult {
+  RayRenderSettings settings;
+  RaySceneStats stats;
+  uint64_t scene_hash;
+  // the settings were found in the cache, stats is left zeroed then
+  bool from_cache;
+  bool calibrated;
+  // how long the chosen settings took on the calibration frame, in seconds
+  double calibration_seconds;
+} RayAutotuneResult;
+
+// settings may be NULL to use the defaults. a cached result is only used
+// if it was calibrated or calibration wasn't asked for. false if the
+// calibration renders fail, a cache that can't be read or written is
+// ignored
+bool ray_autotune(const RayScene *scene, const RayAutotuneSettings *settings,
+                  RayAutotuneResult *result);
+
+#endif // ifndef INCLUDED_RAY_AUTOTUNE_H
@@ -0,0 +1,164 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_CONTEXT_H
+#define INCLUDED_RAY_CONTEXT_H
+
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arena.h"
+#include "cost_map.h"
+#include "perf_counters.h"
+#include "prepare.h"
+#include "ray.h"
+#include "rng.h"
+#include "shadow_batch.h"
+
+#define RAY_CACHE_LINE_SIZE 64
+
+// what a render thread is doing, for splitting up its perf counts
+typedef enum RAY_RENDER_STAGE {
+  // finding what primary rays hit
+  RAY_RENDER_STAGE_primary,
+  // working out the colour at hits, apart from the rays that takes
+  RAY_RENDER_STAGE_shading,
+  RAY_RENDER_STAGE_shadow,
+  // finding what reflection and transmission rays hit
+  RAY_RENDER_STAGE_secondary,
+  // writing pixels out, and everything between them like taking tiles
+  RAY_RENDER_STAGE_output,
+  RAY_RENDER_STAGE_count,
+} RAY_RENDER_STAGE;
+
+// e.g. "primary"
+const char *ray_render_stage_name(RAY_RENDER_STAGE stage);
+
+typedef struct RayRenderStats {
+  uint64_t primary_rays;
+  uint64_t reflection_rays;
+  uint64_t transmission_rays;
+  uint64_t shadow_rays;
+  // ray/object tests performed, not hits
+  uint64_t intersection_tests;
+  // lights left out of shading a hit because they were out of range
+  uint64_t culled_lights;
+  // shadow rays settled by the light's last occluder, without searching
+  uint64_t occluder_cache_hits;
+  uint64_t occluder_cache_misses;
+  // points taken on area lights, and how many hits needed more than the
+  // first pass of them because it was in a penumbra
+  uint64_t area_light_samples;
+  uint64_t area_light_refinements;
+  uint64_t tiles;
+  // only with RayRenderSettings.perf_counters: a RAY_PERF_COUNTER bit for
+  // each counter that counted on some thread, and each one's total per
+  // stage. the totals are exact, how they're split between the stages is
+  // measured on a sample of pixels (see RayRenderSettings.perf_sample_every)
+  unsigned perf_counters;
+  uint64_t perf[RAY_RENDER_STAGE_count][RAY_PERF_COUNTER_count];
+} RayRenderStats;
+
+void ray_render_stats_add(RayRenderStats *total, const RayRenderStats *stats);
+
+// preallocated secondary rays for one level of recursion
+typedef struct RayTraceFrame {
+  RayRay reflection;
+  RayRay transmission;
+} RayTraceFrame;
+
+// everything a render thread writes to while tracing. it's aligned and padded
+// to whole cache lines so threads never contend on a line, and it lives as
+// long as its renderer so nothing has to be set up again per render
+typedef struct RayRenderContext {
+  alignas(RAY_CACHE_LINE_SIZE) RayRenderStats stats;
+  int index;
+  RayRay primary;
+  // one frame per recursion depth
+  int num_frames;
+  RayTraceFrame *frames;
+  // transient vectors for the pixel being traced, reset after every pixel
+  RayArena *arena;
+  // shared and read only, set for the duration of a render
+  const RayPreparedScene *prepared;
+  // lights sampled per hit, <= 0 means every light in range
+  int light_samples;
+  // see RayRenderSettings
+  int area_light_samples;
+  int area_light_max_samples;
+  // scratch for picking lights, room for every light in the scene
+  int light_capacity;
+  int *lights;
+  double *light_weights;
+  // per scene light, index of the object that last blocked a shadow ray
+  // towards it or -1. neighbouring pixels tend to share blockers
+  int *occluders;
+  // reseeded per pixel
+  RayRng rng;
+  // only made when shadows are batched
+  RayShadowBatch *shadow_batch;
+  // whether renders should count perf events and in one pixel out of how
+  // many they're split by stage, see RayRenderSettings
+  bool count_perf;
+  int perf_sample_every;
+  // this thread's counters, while they're open
+  bool perf_open;
+  RayPerfCounters perf;
+  uint64_t perf_start[RAY_PERF_COUNTER_count];
+  // while the pixel is sampled, counts since the last stage switch go to
+  // stage
+  bool perf_sampling;
+  RAY_RENDER_STAGE stage;
+  uint64_t perf_last[RAY_PERF_COUNTER_count];
+  uint64_t perf_sampled[RAY_RENDER_STAGE_count][RAY_PERF_COUNTER_count];
+  // where each pixel's cost goes, when the renderer keeps a cost map, and
+  // the deepest recursion the pixel being traced has reached so far
+  RayCostMap *cost_map;
+  int depth_reached;
+} RayRenderContext;
+
+bool ray_init_render_context(RayRenderContext *ctx, int index);
+
+// make sure there's a frame for every depth up to and including max_depth
+bool ray_render_context_reserve(RayRenderContext *ctx, int max_depth);
+
+// make sure the light scratch has room for num_lights
+bool ray_render_context_reserve_lights(RayRenderContext *ctx, int num_lights);
+
+// opens perf counters for the calling thread if ctx->count_perf. if they
+// can't be opened the render just goes on without
+void ray_render_context_start_perf(RayRenderContext *ctx);
+
+// decides whether the pixel about to be traced is one the counts are split
+// by stage in. only to be called with the counters open
+void ray_render_context_begin_pixel(RayRenderContext *ctx, int x, int y);
+
+// counts what happened since the last switch towards the stage it was in.
+// only to be called while a pixel is sampled
+void ray_render_context_switch_stage(RayRenderContext *ctx,
+                                     RAY_RENDER_STAGE stage);
+
+// reads the thread's totals, splits them between the stages in proportion
+// to the sampled pixels' counts and closes the counters, if they're open
+void ray_render_context_stop_perf(RayRenderContext *ctx);
+
+// frees what the context owns, not the context itself
+void ray_free_render_context(RayRenderContext *ctx);
+
+#endif // ifndef INCLUDED_RAY_CONTEXT_H
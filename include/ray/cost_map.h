@@ -0,0 +1,78 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_COST_MAP_H
+#define INCLUDED_RAY_COST_MAP_H
+
+#include <stdbool.h>
+
+// what tracing a pixel cost, see RayRenderSettings.cost_map
+typedef enum RAY_PIXEL_COST {
+  // rays of any kind: primary, reflection, transmission and shadow
+  RAY_PIXEL_COST_rays,
+  // ray/object tests, as RayRenderStats.intersection_tests counts them
+  RAY_PIXEL_COST_intersection_tests,
+  // the deepest recursion any of its rays reached, 0 for just the primary
+  RAY_PIXEL_COST_depth,
+  // nanoseconds tracing it took on the monotonic clock
+  RAY_PIXEL_COST_time,
+  RAY_PIXEL_COST_count,
+} RAY_PIXEL_COST;
+
+// e.g. "rays", what ray_write_cost_maps puts in file names
+const char *ray_pixel_cost_name(RAY_PIXEL_COST cost);
+
+// one plane of floats per RAY_PIXEL_COST, for an image or the part of it a
+// framebuffer covers (x and y are the same as the framebuffer's)
+typedef struct RayCostMap {
+  int width;
+  int height;
+  int x;
+  int y;
+  float *data;
+} RayCostMap;
+
+// zero-initialized, NULL if either side isn't positive or it can't be
+// allocated
+RayCostMap *ray_create_cost_map(int width, int height);
+
+void ray_free_cost_map(RayCostMap *map);
+
+// width * height floats row by row from the top left
+float *ray_cost_map_plane(const RayCostMap *map, RAY_PIXEL_COST cost);
+
+// what a plane's false colour image tops out at: the 99th percentile, so a
+// few outliers (a thread that got preempted, say) don't wash out the rest
+float ray_cost_map_scale(const RayCostMap *map, RAY_PIXEL_COST cost);
+
+// black for no cost, then blue through cyan, green and yellow to red at
+// ray_cost_map_scale and above
+bool ray_cost_map_write_png(const char *filename, const RayCostMap *map,
+                            RAY_PIXEL_COST cost);
+
+// the plane as it is, a single channel portable float map
+bool ray_cost_map_write_pfm(const char *filename, const RayCostMap *map,
+                            RAY_PIXEL_COST cost);
+
+// every plane next to the image at image_path, with its extension swapped
+// for the plane's name, e.g. render.png gets render.rays.png,
+// render.depth.png and so on. raw writes .pfm files instead of .png
+bool ray_write_cost_maps(const RayCostMap *map, const char *image_path,
+                         bool raw);
+
+#endif // ifndef INCLUDED_RAY_COST_MAP_H
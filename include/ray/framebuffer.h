@@ -0,0 +1,64 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_FRAMEBUFFER_H
+#define INCLUDED_RAY_FRAMEBUFFER_H
+
+#include <stddef.h>
+
+#include "gsl/gsl_vector.h"
+
+#include "tile.h"
+
+// linear, unclamped rgb as renders produce it, before any tone mapping. the
+// channels are interleaved floats row by row from the top left, one
+// contiguous (cache line aligned) block
+typedef struct RayFramebuffer {
+  int width;
+  int height;
+  // where the framebuffer's top left pixel is in the image, for one that
+  // only holds part of it. pixels are still addressed from 0 within it
+  int x;
+  int y;
+  float *data;
+  // set when data points into a mapped file rather than its own allocation
+  // (see ray_map_raw_framebuffer), which is unmapped when it's freed
+  void *mapping;
+  size_t mapping_size;
+} RayFramebuffer;
+
+#define RAY_FRAMEBUFFER_CHANNELS 3
+
+// zero-initialized, NULL if either side isn't positive or it can't be
+// allocated
+RayFramebuffer *ray_create_framebuffer(int width, int height);
+
+void ray_free_framebuffer(RayFramebuffer *fb);
+
+// the channels of pixel (x, y)
+float *ray_framebuffer_pixel(const RayFramebuffer *fb, int x, int y);
+
+void ray_framebuffer_set(RayFramebuffer *fb, int x, int y,
+                         const gsl_vector *color);
+
+// copies the pixels of rect (in image coordinates, and inside both) from src
+// to the same place in dst
+void ray_framebuffer_paste(RayFramebuffer *dst, const RayFramebuffer *src,
+                           RayTile rect);
+
+#endif // ifndef INCLUDED_RAY_FRAMEBUFFER_H
@@ -0,0 +1,33 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_HASH_H
+#define INCLUDED_RAY_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 64 bit FNV-1a, for telling things apart (scenes, journal tiles, parsed
+// text, file names) rather than for anything that has to resist collisions
+// on purpose. hashes are chained by passing the last one back in, starting
+// from RAY_HASH_SEED
+#define RAY_HASH_SEED UINT64_C(0xcbf29ce484222325)
+
+uint64_t ray_hash_bytes(uint64_t hash, const void *data, size_t size);
+
+#endif // ifndef INCLUDED_RAY_HASH_H
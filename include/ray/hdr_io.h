@@ -0,0 +1,57 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_HDR_IO_H
+#define INCLUDED_RAY_HDR_IO_H
+
+#include <stdbool.h>
+
+#include "framebuffer.h"
+
+// portable float map, linear rgb that most compositing and image tools
+// read. rows are written straight from the framebuffer in the host's byte
+// order (which the header records) so nothing is converted per pixel
+bool ray_pfm_write(const char *filename, const RayFramebuffer *fb);
+
+// the same for any width * height pixels of 1 (gray) or 3 (rgb) channels,
+// row by row from the top
+bool ray_pfm_write_floats(const char *filename, const float *data, int width,
+                          int height, int channels);
+
+// the framebuffer's memory as is behind a 64 byte header:
+//
+//   char magic[8]         "RAYFB\0\0\0"
+//   uint32_t byte_order   0x01020304 in the writer's byte order
+//   uint32_t channels     always 3
+//   uint32_t width
+//   uint32_t height
+//   uint64_t data_offset  from the start of the file, 64
+//   (zero padding up to data_offset)
+//
+// followed by width * height * channels floats, row by row from the top.
+// meant for passing frames between tools on the same machine, not as an
+// archive format
+bool ray_raw_framebuffer_write(const char *filename, const RayFramebuffer *fb);
+
+// maps a raw framebuffer file into memory without copying or converting it.
+// the mapping is private, so the pixels can be written to (e.g. tone mapped
+// in place) without changing the file. NULL if it isn't a raw framebuffer
+// from a machine with the same byte order. free with ray_free_framebuffer
+RayFramebuffer *ray_map_raw_framebuffer(const char *filename);
+
+#endif // ifndef INCLUDED_RAY_HDR_IO_H
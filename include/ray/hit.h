@@ -0,0 +1,61 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_HIT_H
+#define INCLUDED_RAY_HIT_H
+
+#include "gsl/gsl_vector.h"
+
+#include "arena.h"
+#include "objects.h"
+#include "prepare.h"
+#include "ray.h"
+#include "tex_coord.h"
+
+// everything about a ray/surface hit that doesn't depend on the light or the
+// secondary rays, worked out once so shading only has to do the per light
+// maths
+typedef struct RayHitRecord {
+  const RayObject *object;
+  const RayMaterial *material;
+  double distance;
+  gsl_vector *point;
+  gsl_vector *normal;
+  // only computed for textured materials, zero otherwise
+  RayTexCoord tex_coord;
+  // owned by the material, not the record (except for cached textures,
+  // where it's allocated from the arena)
+  const gsl_vector *base_color;
+  // albedo / pi, the share of incoming light a diffuse surface gives back
+  double reflectance;
+  // how far rays leaving the surface are pushed off it
+  double bias;
+} RayHitRecord;
+
+// point and normal are allocated from arena
+void ray_hit_record_init(RayHitRecord *hit, const RayObject *object,
+                         const RayRay *ray, double distance,
+                         const RayPreparedScene *prepared, RayArena *arena);
+
+// the tex_coord and base_color part of ray_hit_record_init, for filling in
+// the rest of a record some other way. needs object, material, distance and
+// point set
+void ray_hit_record_color(RayHitRecord *hit, const RayPreparedScene *prepared,
+                          RayArena *arena);
+
+#endif // ifndef INCLUDED_RAY_HIT_H
@@ -31,17 +31,64 @@ typedef struct RayImg {
   const int height;
   const int channels;
   gsl_vector **const *const pixels;
+  // only for packed images: every pixel's channels, row by row, and the
+  // vectors pixels points to (views into data)
+  double *const data;
+  gsl_vector *const views;
 } RayImg;
 
+// any 8 or 16 bit png (palette, gray, rgb, with or without alpha) as an rgb
+// packed image, alpha is dropped
 RayImg *ray_read_img(const char *path);
 
 // create a zero-initialized image with given specs
 RayImg *ray_create_img(int width, int height, int channels);
 
+// an image whose pixels all live in one block (zeroed) rather than being
+// allocated separately, so they can't be replaced with ray_set_pixel. NULL
+// if it can't be allocated
+RayImg *ray_create_packed_img(int width, int height, int channels);
+
 void ray_free_img(RayImg *img);
 
 void ray_set_pixel(int x, int y, gsl_vector *color, RayImg *img);
 
+// row y as 8 bit samples, width * channels of them
+void ray_img_pack_row(const RayImg *img, int y, unsigned char *row);
+
+typedef enum RAY_PNG_FILTER {
+  // pick the best filter for every row (libpng's default)
+  RAY_PNG_FILTER_adaptive,
+  RAY_PNG_FILTER_none,
+  RAY_PNG_FILTER_sub,
+  RAY_PNG_FILTER_up,
+} RAY_PNG_FILTER;
+
+typedef enum RAY_PNG_PRESET {
+  // what ray_png_write uses, libpng's defaults on one thread
+  RAY_PNG_PRESET_default,
+  // for previews, quick to write but bigger
+  RAY_PNG_PRESET_fast,
+  // for keeping, as small as zlib will go however long it takes
+  RAY_PNG_PRESET_small,
+} RAY_PNG_PRESET;
+
+typedef struct RayPngOptions {
+  // zlib level from 0 (store) to 9, -1 means zlib's default
+  int compression_level;
+  RAY_PNG_FILTER filter;
+  // above 1, bands of rows are deflated on that many threads and stitched
+  // into one stream (slightly bigger than compressing it in one go). <= 0
+  // means one per online cpu
+  int num_threads;
+} RayPngOptions;
+
+RayPngOptions ray_png_options(RAY_PNG_PRESET preset);
+
 bool ray_png_write(char const *filename, const RayImg *img);
 
+// options may be NULL for the default preset
+bool ray_png_write_with_options(char const *filename, const RayImg *img,
+                                const RayPngOptions *options);
+
 #endif // ifndef INCLUDED_RAY_IMG_UTILS_H
\ No newline at end of file
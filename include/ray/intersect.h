@@ -25,6 +25,12 @@
 bool ray_intersects(const RayObject *plane, const RayRay *ray,
                     double *distance);
 
+// ray_intersects for an object already known to be of the type
+bool ray_sphere_intersects(const RayObject *sphere, const RayRay *ray,
+                           double *distance);
+bool ray_plane_intersects(const RayObject *plane, const RayRay *ray,
+                          double *distance);
+
 const RayObject *ray_closest_intersection(const RayObject *objects,
                                           int num_objects, const RayRay *ray,
                                           double *distance);
@@ -0,0 +1,63 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#ifndef INCLUDED_RAY_JOURNAL_H
+#define INCLUDED_RAY_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "framebuffer.h"
+#include "tile.h"
+
+// finished tiles of a render, appended to a file as they're done so a render
+// that's killed part way can pick up where it left off. a 64 byte header:
+//
+//   char magic[8]        "RAYJRNL\1"
+//   uint32_t width       of the image
+//   uint32_t height
+//   uint32_t num_tiles
+//   uint32_t reserved
+//   uint64_t tiles_hash  of every tile's position and size, in order
+//   uint64_t key         whatever the caller uses to tell scenes apart
+//   (zero padding up to 64 bytes)
+//
+// followed by any number of records, each a tile's index (uint32_t), 4 bytes
+// of padding and a 64 bit hash of its pixels, then the pixels themselves as
+// floats row by row. all in the writer's byte order. the last record can be
+// cut short by the writer dying half way through, which the hash catches
+
+typedef struct RayJournal RayJournal;
+
+// opens (or creates) the journal at path for an image of width x height cut
+// into tiles. if it already holds tiles for the same image, tiles and key,
+// they're copied into fb (which has to cover the whole image) and done[t] is
+// set for each, everything else is cleared. otherwise it's started again
+// from scratch. NULL if the file can't be opened or written
+RayJournal *ray_open_journal(const char *path, uint64_t key, int width,
+                             int height, const RayTile *tiles, int num_tiles,
+                             RayFramebuffer *fb, bool *done);
+
+// appends the given tiles' pixels from fb and waits for them to reach the
+// disk. false if they couldn't be written, in which case the journal stays
+// usable up to the last successful append
+bool ray_journal_append(RayJournal *journal, const RayFramebuffer *fb,
+                        const int *tiles, int count);
+
+void ray_close_journal(RayJournal *journal);
+
+#endif // ifndef INCLUDED_RAY_JOURNAL_H
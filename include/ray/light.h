@@ -19,21 +19,40 @@
 #ifndef INCLUDED_RAY_LIGHT_H
 #define INCLUDED_RAY_LIGHT_H
 
+#include <stdbool.h>
+
 #include "gsl/gsl_vector.h"
 
 typedef enum RAY_LIGHT_TYPE {
   RAY_LIGHT_TYPE_directional,
   RAY_LIGHT_TYPE_point,
+  RAY_LIGHT_TYPE_rect,
+  RAY_LIGHT_TYPE_sphere,
 } RAY_LIGHT_TYPE;
 
+// rect and sphere lights are area lights, they're sampled at a number of
+// points that each shade like a point light with an equal share of the
+// intensity. everywhere a single point is needed (culling, picking lights,
+// ray_light_direction_from etc.) the centre stands in for the whole light
 typedef struct RayLight {
   RAY_LIGHT_TYPE type;
   union {
     struct { // type = directional
       gsl_vector *direction;
     };
-    struct { // type = point
+    struct { // type = point, rect or sphere
+      // centre for area lights
       gsl_vector *position;
+      union {
+        struct { // type = rect
+          // the two edges, the rectangle is position +- u / 2 +- v / 2
+          gsl_vector *u;
+          gsl_vector *v;
+        };
+        struct { // type = sphere
+          double radius;
+        };
+      };
     };
   };
   gsl_vector *color;
@@ -42,10 +61,40 @@ typedef struct RayLight {
 
 gsl_vector *ray_light_direction_from(const RayLight *light, gsl_vector *hit_point);
 
+// same as ray_light_direction_from but writes into an existing vector
+void ray_light_direction_into(const RayLight *light,
+                              const gsl_vector *hit_point,
+                              gsl_vector *direction);
+
 double ray_light_intensity(const RayLight *light, gsl_vector *hit_point);
 
 double ray_light_distance(const RayLight *light, gsl_vector *hit_point);
 
+// what the functions above pick for each type, for callers that already
+// know it. area lights use the point light ones
+void ray_directional_light_direction_into(const RayLight *light,
+                                          const gsl_vector *hit_point,
+                                          gsl_vector *direction);
+void ray_point_light_direction_into(const RayLight *light,
+                                    const gsl_vector *hit_point,
+                                    gsl_vector *direction);
+double ray_point_light_intensity(const RayLight *light, gsl_vector *hit_point);
+double ray_point_light_distance(const RayLight *light, gsl_vector *hit_point);
+
+// distance past which the light's brightest channel falls below cutoff,
+// INFINITY for lights that don't fall off or a cutoff <= 0
+double ray_light_influence_radius(const RayLight *light, double cutoff);
+
+bool ray_light_is_area(const RayLight *light);
+
+// a point on an area light for shading hit_point. the light is split into a
+// side x side grid of strata and the point is jittered by (s, t), both in
+// [0, 1), inside stratum number `stratum`. spheres are only sampled on the
+// half facing hit_point
+void ray_light_sample_into(const RayLight *light, const gsl_vector *hit_point,
+                           int stratum, int side, double s, double t,
+                           gsl_vector *point);
+
 void ray_free_light(RayLight *light);
 
 #endif // ifndef INCLUDED_RAY_LIGHT_H
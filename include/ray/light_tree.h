@@ -0,0 +1,66 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_LIGHT_TREE_H
+#define INCLUDED_RAY_LIGHT_TREE_H
+
+#include <stdbool.h>
+
+#include "gsl/gsl_vector.h"
+
+#include "scene.h"
+
+// bounding volume hierarchy over the spheres of influence of a scene's point
+// lights, so shading a hit only has to look at the lights that can actually
+// light it. lights with no finite radius (directional ones, or everything
+// when there's no cutoff) are kept in a flat list and always returned
+typedef struct RayLightTreeNode {
+  double min[3];
+  double max[3];
+  // count > 0 for leaves, which own tree->order[start..start+count). inner
+  // nodes have their left child right after them and the right at `right`
+  int start;
+  int count;
+  int right;
+} RayLightTreeNode;
+
+typedef struct RayLightTree {
+  int num_nodes;
+  RayLightTreeNode *nodes;
+  // scene light indices in tree order
+  int *order;
+  // influence radius of every scene light
+  double *radii;
+  // lights that reach everywhere, in scene order
+  int num_global;
+  int *global;
+} RayLightTree;
+
+// cutoff is the irradiance below which a light is considered to not reach a
+// point, <= 0 keeps every light everywhere
+bool ray_build_light_tree(const RayScene *scene, double cutoff,
+                          RayLightTree *tree);
+
+void ray_free_light_tree(RayLightTree *tree);
+
+// writes the index of every light reaching point to lights, which needs room
+// for all of the scene's lights. returns how many there were
+int ray_light_tree_query(const RayLightTree *tree, const RayScene *scene,
+                         const gsl_vector *point, int *lights);
+
+#endif // ifndef INCLUDED_RAY_LIGHT_TREE_H
@@ -20,7 +20,67 @@
 #define INCLUDED_RAY_LOADER_H
 
 #include "ray/scene.h"
+#include "ray/texture_cache.h"
 
 bool ray_scene_from_file(const char *path, RayScene *scene);
 
+// textures are opened in cache rather than decoded, so only the tiles that
+// are sampled are ever loaded. the cache has to outlive the scene
+bool ray_scene_from_file_with_cache(const char *path, RayTextureCache *cache,
+                                    RayScene *scene);
+
+// called as each object or light is loaded, with its index in the scene.
+// the pointer is only good until the callback returns (the array it's in
+// can still move), and textures haven't been decoded yet
+typedef struct RaySceneStreamHandlers {
+  void (*on_object)(const RayObject *object, int index, void *data);
+  void (*on_light)(const RayLight *light, int index, void *data);
+  void *data;
+} RaySceneStreamHandlers;
+
+// loads the same scenes as ray_scene_from_file_with_cache (cache can be
+// NULL) without ever holding the whole file as json. it's read a chunk at a
+// time and each object and light is parsed on its own and loaded before the
+// next is read, so on top of the scene itself it only needs room for the
+// biggest one of them. handlers can be NULL
+bool ray_scene_stream_from_file(const char *path, RayTextureCache *cache,
+                                const RaySceneStreamHandlers *handlers,
+                                RayScene *scene);
+
+// a scene that's reloaded in place as its file is edited. the file is
+// streamed again on every reload but only the objects, lights and settings
+// whose json changed are parsed and loaded, the rest are kept as they were,
+// as are the textures whose png hasn't changed
+typedef struct RayLiveScene RayLiveScene;
+
+// what a reload changed
+typedef struct RaySceneChanges {
+  bool settings;
+  // objects or lights were added, removed or reordered, so anything that
+  // refers to them by index has to be rebuilt rather than updated
+  bool moved;
+  // indices in the reloaded scene of objects that are new or changed
+  int num_changed_objects;
+  int *changed_objects;
+  int num_changed_lights;
+  // textures decoded again because their png changed
+  int num_reloaded_textures;
+} RaySceneChanges;
+
+// NULL if the file can't be loaded
+RayLiveScene *ray_load_live_scene(const char *path);
+
+// the current scene, which stays at the same address across reloads. it
+// belongs to the live scene, don't ray_free_scene it
+RayScene *ray_live_scene(RayLiveScene *live);
+
+// on failure (e.g. the file is mid edit and not valid json) the scene is
+// left as it was. changes can be NULL, otherwise free them with
+// ray_free_scene_changes. the scene can't be rendered during a reload
+bool ray_reload_live_scene(RayLiveScene *live, RaySceneChanges *changes);
+
+void ray_free_scene_changes(RaySceneChanges *changes);
+
+void ray_free_live_scene(RayLiveScene *live);
+
 #endif // ifndef INCLUDED_RAY_LOADER_H
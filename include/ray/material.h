@@ -21,6 +21,7 @@
 
 #include "img_utils.h"
 #include "tex_coord.h"
+#include "texture_cache.h"
 
 #include "gsl/gsl_vector.h"
 
@@ -48,6 +49,7 @@ typedef struct RaySurface {
 typedef enum RAY_COLORATION_TYPE {
   RAY_COLORATION_TYPE_color,
   RAY_COLORATION_TYPE_texture,
+  RAY_COLORATION_TYPE_cached_texture,
 } RAY_COLORATION_TYPE;
 
 typedef struct RayColoration {
@@ -59,9 +61,15 @@ typedef struct RayColoration {
     struct { // type = texture
       RayImg *texture;
     };
+    struct { // type = cached_texture
+      RayCachedTexture *cached_texture;
+    };
   };
 } RayColoration;
 
+// not for cached textures, the tile a texel is in can be evicted at any
+// time so they have no colour to hand out. sample them with
+// ray_cached_texture_sample_into instead
 gsl_vector *ray_coloration_color_get(const RayColoration *, RayTexCoord hit_point);
 
 void ray_free_coloration(RayColoration *coloration);
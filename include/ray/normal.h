@@ -25,4 +25,16 @@
 
 gsl_vector *ray_surface_normal(const RayObject *object, const gsl_vector *hit_point);
 
+// same as ray_surface_normal but writes into an existing vector
+void ray_surface_normal_into(const RayObject *object,
+                             const gsl_vector *hit_point, gsl_vector *normal);
+
+// ray_surface_normal_into for an object already known to be of the type
+void ray_sphere_surface_normal_into(const RayObject *sphere,
+                                    const gsl_vector *hit_point,
+                                    gsl_vector *normal);
+void ray_plane_surface_normal_into(const RayObject *plane,
+                                   const gsl_vector *hit_point,
+                                   gsl_vector *normal);
+
 #endif // ifndef INCLUDED_RAY_NORMAL_H
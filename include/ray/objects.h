@@ -49,6 +49,10 @@ typedef struct RayObject {
 RayTexCoord ray_object_tex_coord(const RayObject *object,
                                  gsl_vector *hit_point);
 
+// how many texture coordinates one unit of distance across the surface
+// covers, roughly, for picking a texture's level of detail
+double ray_object_tex_scale(const RayObject *object);
+
 void ray_free_object(RayObject *sphere);
 
 #endif // ifndef INCLUDED_RAY_OBJECTS_H
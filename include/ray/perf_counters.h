@@ -0,0 +1,69 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#ifndef INCLUDED_RAY_PERF_COUNTERS_H
+#define INCLUDED_RAY_PERF_COUNTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// a thread's hardware event counts through linux's perf_event_open, for
+// telling whether code is bound by compute or by memory. every counter is
+// optional, vms and containers often have no hardware counters at all (or
+// aren't allowed them) and a counter that can't be opened isn't counted.
+// elsewhere than linux none of them can be
+
+typedef enum RAY_PERF_COUNTER {
+  RAY_PERF_COUNTER_cycles,
+  RAY_PERF_COUNTER_instructions,
+  // level 1 data cache read misses
+  RAY_PERF_COUNTER_l1d_misses,
+  // last level cache misses
+  RAY_PERF_COUNTER_llc_misses,
+  RAY_PERF_COUNTER_branch_misses,
+  // nanoseconds the thread was on a cpu. a software counter, so it's there
+  // even when the hardware ones aren't
+  RAY_PERF_COUNTER_task_clock,
+  RAY_PERF_COUNTER_count,
+} RAY_PERF_COUNTER;
+
+// e.g. "l1d-misses"
+const char *ray_perf_counter_name(RAY_PERF_COUNTER counter);
+
+// the counters are read together as one group, so they all cover exactly
+// the same stretch of code
+typedef struct RayPerfCounters {
+  // -1 for counters that couldn't be opened
+  int fds[RAY_PERF_COUNTER_count];
+  // the one the group is read through
+  int leader;
+  // a bit (1 << RAY_PERF_COUNTER_x) for each counter that's open
+  unsigned available;
+} RayPerfCounters;
+
+// opens the counters for the calling thread (only) and starts them. false
+// if none of them could be opened, there's nothing to close then
+bool ray_open_perf_counters(RayPerfCounters *counters);
+
+// totals since the counters were opened, counters that aren't available
+// read as 0. false if they couldn't be read, values are all 0 then
+bool ray_read_perf_counters(const RayPerfCounters *counters,
+                            uint64_t values[RAY_PERF_COUNTER_count]);
+
+void ray_close_perf_counters(RayPerfCounters *counters);
+
+#endif // ifndef INCLUDED_RAY_PERF_COUNTERS_H
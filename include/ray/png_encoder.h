@@ -0,0 +1,37 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_PNG_ENCODER_H
+#define INCLUDED_RAY_PNG_ENCODER_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "img_utils.h"
+
+// RayPngOptions.num_threads to an actual count, at least 1
+int ray_png_resolve_threads(int requested);
+
+// writes img to file as a png without libpng. the rows are split into
+// num_threads bands that are filtered and deflated independently, each
+// ending on a byte boundary (a sync flush) so the pieces can be joined into a
+// single valid zlib stream, one IDAT chunk per band
+bool ray_png_encode_parallel(FILE *file, const RayImg *img,
+                             const RayPngOptions *options, int num_threads);
+
+#endif // ifndef INCLUDED_RAY_PNG_ENCODER_H
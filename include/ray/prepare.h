@@ -0,0 +1,157 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_PREPARE_H
+#define INCLUDED_RAY_PREPARE_H
+
+#include <stdbool.h>
+
+#include "light_tree.h"
+#include "ray.h"
+#include "real.h"
+#include "scene.h"
+
+// ray converted to the kernel precision
+typedef struct RayRealRay {
+  ray_real origin[3];
+  ray_real direction[3];
+} RayRealRay;
+
+// what a scene uses that the renderer can be built without, see
+// RayPreparedScene.features
+typedef enum RAY_SCENE_FEATURE {
+  RAY_SCENE_FEATURE_planes = 1 << 0,
+  // texture or cached texture colorations
+  RAY_SCENE_FEATURE_textures = 1 << 1,
+  RAY_SCENE_FEATURE_refraction = 1 << 2,
+  // any light that isn't directional
+  RAY_SCENE_FEATURE_local_lights = 1 << 3,
+  RAY_SCENE_FEATURE_all = (1 << 4) - 1,
+} RAY_SCENE_FEATURE;
+
+// copy of the scene geometry laid out for the intersection kernels: one
+// array per component (so a loop over them vectorizes) in ray_real
+// precision, padded with objects that can never be hit. built before every
+// render (unless the renderer's keeping it, see ray_renderer_apply_changes),
+// the scene must outlive it
+typedef struct RayPreparedScene {
+  const RayScene *scene;
+
+  int num_spheres;
+  int sphere_capacity;
+  ray_real *sphere_x;
+  ray_real *sphere_y;
+  ray_real *sphere_z;
+  ray_real *sphere_radius2;
+  // index of each sphere in scene->objects
+  int *sphere_objects;
+
+  int num_planes;
+  int plane_capacity;
+  ray_real *plane_px;
+  ray_real *plane_py;
+  ray_real *plane_pz;
+  ray_real *plane_nx;
+  ray_real *plane_ny;
+  ray_real *plane_nz;
+  int *plane_objects;
+  // where each object in scene->objects is in the arrays of its type
+  int *object_slots;
+
+  RayLightTree lights;
+
+  // RAY_SCENE_FEATURE bits for everything the scene uses. updates only ever
+  // add to it, so it can end up claiming a feature the scene no longer has
+  unsigned features;
+
+  // roughly the angle between neighbouring primary rays, so a surface at
+  // distance d is covered about d * pixel_spread wide by a pixel
+  double pixel_spread;
+} RayPreparedScene;
+
+// light_cutoff is passed on to ray_build_light_tree
+bool ray_prepare_scene(const RayScene *scene, double light_cutoff,
+                       RayPreparedScene *prepared);
+
+void ray_free_prepared_scene(RayPreparedScene *prepared);
+
+// brings prepared up to date after the scene's settings and the objects at
+// changed_objects were changed in place, e.g. by a live scene reload that
+// didn't move anything, without going over the rest of the objects. the
+// light tree is only rebuilt if lights_changed. false if it couldn't be
+// patched (an object changed type), in which case it has to be freed and
+// prepared again
+bool ray_update_prepared_scene(RayPreparedScene *prepared,
+                               const int *changed_objects,
+                               int num_changed_objects, bool lights_changed,
+                               double light_cutoff);
+
+void ray_real_ray_from(RayRealRay *real_ray, const RayRay *ray);
+
+// same contract as ray_closest_intersection. the kernels only pick the
+// object, in float builds its distance is recomputed in double so hit points
+// (and so the secondary rays leaving them) don't pick up float error
+const RayObject *
+ray_prepared_closest_intersection(const RayPreparedScene *prepared,
+                                  const RayRay *ray, double *distance);
+
+// for shadow rays: index in scene->objects of any object hit no further than
+// max_distance along the ray (not necessarily the closest), or -1
+int ray_prepared_any_intersection(const RayPreparedScene *prepared,
+                                  const RayRay *ray, double max_distance);
+
+// the same test against just the object at index object in scene->objects,
+// e.g. whatever blocked a shadow ray towards the same light last time. it
+// gives the same answer the full query would for that object
+bool ray_prepared_occludes(const RayPreparedScene *prepared, int object,
+                           const RayRay *ray, double max_distance);
+
+// a batch of shadow rays in kernel precision, one array per component.
+// directional lights can set shared_direction and only fill in the first
+// direction. every array needs room for count entries
+typedef struct RayShadowRays {
+  int count;
+  bool shared_direction;
+  // these get shuffled around while tracing
+  ray_real *ox;
+  ray_real *oy;
+  ray_real *oz;
+  ray_real *dx;
+  ray_real *dy;
+  ray_real *dz;
+  ray_real *max_distance;
+  // scratch
+  int *index;
+  unsigned char *hits;
+  // output in the original order, nonzero where something is in the way
+  unsigned char *occluded;
+} RayShadowRays;
+
+// batch version of ray_prepared_any_intersection. it goes object by object
+// over the whole batch rather than ray by ray over the scene, so each
+// object is loaded once and the inner loop runs across rays. rays that are
+// found to be blocked are regularly dropped from the batch
+void ray_prepared_occluded(const RayPreparedScene *prepared,
+                           RayShadowRays *rays);
+
+// distance to push a secondary ray's origin off hit_point so it doesn't hit
+// the surface it started on, never less than the scene's own shadow bias
+double ray_prepared_bias(const RayPreparedScene *prepared,
+                         const gsl_vector *hit_point);
+
+#endif // ifndef INCLUDED_RAY_PREPARE_H
@@ -42,4 +42,19 @@ bool ray_create_transmission(RayRay *ray, gsl_vector *normal,
                              gsl_vector *incident, gsl_vector *intersection,
                              double bias, double iof);
 
+// the _into variants write into the existing origin and direction vectors of
+// a ray instead of allocating new ones
+
+void ray_prime_ray_into(RayRay *ray, int x, int y, const RayScene *scene);
+
+void ray_reflection_into(RayRay *ray, const gsl_vector *normal,
+                         const gsl_vector *incident,
+                         const gsl_vector *intersection, double bias);
+
+// ray is left in an unspecified state if this returns false
+bool ray_transmission_into(RayRay *ray, const gsl_vector *normal,
+                           const gsl_vector *incident,
+                           const gsl_vector *intersection, double bias,
+                           double iof);
+
 #endif // ifndef INCLUDED_RAY_RAY_H
@@ -0,0 +1,53 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_REAL_H
+#define INCLUDED_RAY_REAL_H
+
+#include <float.h>
+#include <math.h>
+
+// scalar type used by the hot kernels, picked at configure time with the
+// RAY_SINGLE_PRECISION cmake option. the scene description itself stays in
+// doubles (gsl_vector), it's converted once when the scene is prepared
+#ifdef RAY_REAL_FLOAT
+typedef float ray_real;
+#define RAY_REAL_NAME "float"
+#define RAY_REAL_EPSILON FLT_EPSILON
+#define RAY_REAL_INFINITY HUGE_VALF
+#define ray_real_sqrt sqrtf
+#define ray_real_fabs fabsf
+#else
+typedef double ray_real;
+#define RAY_REAL_NAME "double"
+#define RAY_REAL_EPSILON DBL_EPSILON
+#define RAY_REAL_INFINITY HUGE_VAL
+#define ray_real_sqrt sqrt
+#define ray_real_fabs fabs
+#endif
+
+// lanes in a 256 bit (avx) register, kernel arrays are padded to a multiple
+// of this
+#define RAY_REAL_LANES ((int)(32 / sizeof(ray_real)))
+
+// how far (relative to the magnitude of the coordinates involved) secondary
+// ray origins have to be pushed off a surface to get clear of the rounding
+// error in the hit distance. small enough not to matter in double builds
+#define RAY_REAL_BIAS_SCALE (RAY_REAL_EPSILON * 16)
+
+#endif // ifndef INCLUDED_RAY_REAL_H
@@ -19,9 +19,193 @@
 #ifndef INCLUDED_RAY_RENDER_H
 #define INCLUDED_RAY_RENDER_H
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "context.h"
+#include "cost_map.h"
+#include "framebuffer.h"
 #include "img_utils.h"
+#include "loader.h"
 #include "scene.h"
+#include "tile.h"
+#include "tone_map.h"
+
+typedef struct RayRenderSettings {
+  // <= 0 means one per online cpu
+  int num_threads;
+  // side length of square tiles, <= 0 means the default
+  int tile_size;
+  RAY_TILE_ORDER tile_order;
+  // irradiance below which a point light is treated as not reaching a hit at
+  // all, so it's skipped without a shadow ray. <= 0 disables culling
+  double light_cutoff;
+  // when more lights than this reach a hit, only this many are picked (in
+  // proportion to their unshadowed contribution) and reweighted so the
+  // expected result is unchanged. <= 0 shades with every light in range
+  int light_samples;
+  // points sampled on an area light for every hit it shades, rounded down to
+  // a square number (at least 1). where they disagree about whether the
+  // light is blocked, passes of 4x as many more are added as long as the
+  // total stays within area_light_max_samples
+  int area_light_samples;
+  int area_light_max_samples;
+  // queue up a tile's shadow rays and trace them together, grouped by light,
+  // rather than one at a time while shading. progressive renders ignore it
+  bool batch_shadows;
+  // trace with the kernel built for every scene feature rather than one
+  // built for just the features the scene uses (see RAY_SCENE_FEATURE).
+  // they render the same, this is only for comparing them
+  bool generic_kernel;
+  // count hardware events with perf_event_open on every render thread, split
+  // up by what the thread was doing, see RayRenderStats.perf. counters that
+  // can't be opened are left out
+  bool perf_counters;
+  // reading the counters is a system call, which would swamp a pixel if it
+  // happened every time a thread moved on to another stage. so that's only
+  // done in about one pixel in this many, and the rest are only counted
+  // towards the totals. <= 1 splits up every pixel
+  int perf_sample_every;
+  // record what every pixel cost (rays, intersection tests, recursion depth
+  // and time) in a cost map, see ray_renderer_cost_map. progressive renders
+  // ignore it
+  bool cost_map;
+  // how the linear result is turned into the [0, 1] image renders return.
+  // doesn't apply to ray_renderer_render_hdr
+  RayToneMapSettings tone_map;
+} RayRenderSettings;
+
+RayRenderSettings ray_default_render_settings(void);
+
+// settings may be NULL to use the defaults
+RayImg *ray_render_scene_with_settings(const RayScene *scene,
+                                       const RayRenderSettings *settings);
 
 RayImg *ray_render_scene(const RayScene *scene);
 
+// owns one render context per thread, keep it around between renders to avoid
+// setting them up again
+typedef struct RayRenderer RayRenderer;
+
+// settings may be NULL to use the defaults
+RayRenderer *ray_create_renderer(const RayRenderSettings *settings);
+
+RayImg *ray_renderer_render(RayRenderer *renderer, const RayScene *scene);
+
+// the linear result before tone mapping, see ray_tone_map to turn it into an
+// image (as many times as needed, without tracing again)
+RayFramebuffer *ray_renderer_render_hdr(RayRenderer *renderer,
+                                        const RayScene *scene);
+
+// renders only the given tiles (in image coordinates, all inside the image)
+// into a framebuffer just big enough to hold them, whose x and y say where
+// it goes in the image. pixels come out exactly as they would in a render of
+// the whole image, anything in it not covered by a tile is left black. NULL
+// if a tile isn't inside the image or it runs out of memory
+RayFramebuffer *ray_renderer_render_tiles(RayRenderer *renderer,
+                                          const RayScene *scene,
+                                          const RayTile *tiles,
+                                          int num_tiles);
+
+// the same for a rectangle of the image (clipped to it), split up into the
+// renderer's tiles. NULL if nothing of it is left after clipping
+RayFramebuffer *ray_renderer_render_region(RayRenderer *renderer,
+                                           const RayScene *scene,
+                                           RayTile region);
+
+typedef struct RayCheckpointSettings {
+  // the journal, see ray/journal.h
+  const char *path;
+  // seconds between appending finished tiles to it, <= 0 means as soon as
+  // each one is done
+  double interval;
+  // anything that tells scenes (and settings that change the pixels) apart,
+  // e.g. a hash of the scene file. a journal with another key is started
+  // over rather than picked up
+  uint64_t key;
+} RayCheckpointSettings;
+
+// renders like ray_renderer_render_hdr while keeping a journal of the tiles
+// it's finished. if the journal is from an earlier render of the same image
+// (one that was killed part way, say) its tiles are loaded rather than
+// rendered again. the journal is left complete, delete it once the image is
+// safely written. if it stops being writable the render carries on without
+// it. NULL if the journal can't be opened at all
+RayFramebuffer *
+ray_renderer_render_checkpointed(RayRenderer *renderer, const RayScene *scene,
+                                 const RayCheckpointSettings *settings);
+
+// for scenes that are edited between renders, e.g. a live scene after
+// ray_reload_live_scene. normally every render prepares the scene it's given
+// from scratch (see ray/prepare.h). once changes have been applied for a
+// scene the renderer keeps its prepared copy instead, patching just the
+// changed objects and lights into it here, so renders of that scene go
+// straight to tracing. changes that move objects around are prepared from
+// scratch. until the renderer is freed or renders another scene, every edit
+// to this one has to be applied before it's rendered again. false if the
+// scene couldn't be prepared
+bool ray_renderer_apply_changes(RayRenderer *renderer, const RayScene *scene,
+                                const RaySceneChanges *changes);
+
+// totals over every thread for the last render
+RayRenderStats ray_renderer_stats(const RayRenderer *renderer);
+
+// the renderer's num_contexts per thread contexts, as the last render left
+// them
+const RayRenderContext *ray_renderer_contexts(const RayRenderer *renderer,
+                                              int *num_contexts);
+
+// what each pixel of the last render cost, covering the same pixels as the
+// framebuffer it rendered into, pixels it didn't trace (tiles loaded from a
+// journal, say) are left at zero. NULL unless RayRenderSettings.cost_map is
+// set. it belongs to the renderer and is reused by the next render
+const RayCostMap *ray_renderer_cost_map(const RayRenderer *renderer);
+
+void ray_free_renderer(RayRenderer *renderer);
+
+// shared flag that can be flipped from any thread to stop a render early
+typedef struct RayCancelToken {
+  atomic_bool cancelled;
+} RayCancelToken;
+
+void ray_cancel_token_init(RayCancelToken *token);
+
+void ray_cancel_token_cancel(RayCancelToken *token);
+
+bool ray_cancel_token_cancelled(RayCancelToken *token);
+
+// called from the rendering thread after each completed pass, step is the
+// pixel spacing that pass was sampled at (e.g. 8, 4, 2 then 1). the image is
+// tone mapped with the renderer's settings and only valid for the duration
+// of the call. return false to stop refining
+typedef bool (*RayProgressFn)(const RayImg *img, int step, void *user_data);
+
+// zeroed options are valid and mean: start at a step of 8, no time budget,
+// no cancellation and no callback
+typedef struct RayProgressiveOptions {
+  // spacing of the first pass, rounded down to a power of two
+  int initial_step;
+  // seconds from the start of the render before workers give up, <= 0 means
+  // no deadline
+  double time_budget;
+  RayCancelToken *cancel;
+  RayProgressFn on_pass;
+  void *user_data;
+} RayProgressiveOptions;
+
+// renders coarse to fine, filling unsampled pixels from the nearest coarser
+// sample so every pass is a usable preview. stops cleanly on cancellation or
+// when the time budget runs out and returns the best image so far.
+// completed_step (optional) is set to the step of the last finished pass, or
+// 0 if not even the first pass finished
+RayImg *ray_render_scene_progressive(const RayScene *scene,
+                                     const RayProgressiveOptions *options,
+                                     int *completed_step);
+
+RayImg *ray_renderer_render_progressive(RayRenderer *renderer,
+                                        const RayScene *scene,
+                                        const RayProgressiveOptions *options,
+                                        int *completed_step);
+
 #endif // ifndef INCLUDED_RAY_RENDER_H
@@ -0,0 +1,72 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#ifndef INCLUDED_RAY_RENDER_FARM_H
+#define INCLUDED_RAY_RENDER_FARM_H
+
+#include "framebuffer.h"
+#include "img_utils.h"
+#include "render.h"
+#include "scene.h"
+
+// splits one frame between several worker processes forked from this one,
+// so each starts off with the scene already loaded. the coordinator (the
+// calling thread) hands out batches of consecutive tiles over a unix socket
+// to each worker, which renders them with its own renderer and sends the
+// pixels back to be put together. a worker that crashes or hangs up only
+// loses the batches it was working on, they're handed to the others
+
+typedef struct RayFarmSettings {
+  // <= 0 means one per online cpu
+  int num_workers;
+  // tiles handed out at a time, <= 0 means the default
+  int batch_size;
+  // what each worker renders with. the coordinator cuts up the image using
+  // its tile size and order
+  RayRenderSettings render;
+  // called (if set) in each worker process as soon as it's started, with the
+  // worker's index from 0
+  void (*on_worker_start)(int worker, void *data);
+  void *data;
+} RayFarmSettings;
+
+// a worker per cpu, rendering on one thread each
+RayFarmSettings ray_default_farm_settings(void);
+
+typedef struct RayFarmStats {
+  int num_workers;
+  // workers that went away before the frame was done
+  int failed_workers;
+  int num_batches;
+  // batches that were handed out again after their worker went away
+  int requeued_batches;
+} RayFarmStats;
+
+// renders the whole image, with pixels exactly as ray_renderer_render_hdr
+// would give them. settings may be NULL to use the defaults, stats (if not
+// NULL) is filled in either way. NULL if the workers can't be started or
+// every one of them fails before the frame is done. best called while no
+// other threads are running, as the workers are forked
+RayFramebuffer *ray_farm_render_hdr(const RayScene *scene,
+                                    const RayFarmSettings *settings,
+                                    RayFarmStats *stats);
+
+// tone mapped with settings->render.tone_map
+RayImg *ray_farm_render(const RayScene *scene, const RayFarmSettings *settings,
+                        RayFarmStats *stats);
+
+#endif // ifndef INCLUDED_RAY_RENDER_FARM_H
@@ -0,0 +1,38 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_RNG_H
+#define INCLUDED_RAY_RNG_H
+
+#include <stdint.h>
+
+// small, fast and statistically decent (splitmix64), not for anything that
+// needs to be unpredictable. render threads seed one per pixel so sampled
+// images don't depend on which thread traced what
+typedef struct RayRng {
+  uint64_t state;
+} RayRng;
+
+void ray_rng_seed(RayRng *rng, uint64_t seed);
+
+uint64_t ray_rng_next(RayRng *rng);
+
+// uniform in [0, 1)
+double ray_rng_uniform(RayRng *rng);
+
+#endif // ifndef INCLUDED_RAY_RNG_H
@@ -19,6 +19,7 @@
 #ifndef INCLUDED_RAY_SCENE_H
 #define INCLUDED_RAY_SCENE_H
 
+#include "arena.h"
 #include "light.h"
 #include "objects.h"
 
@@ -33,6 +34,9 @@ typedef struct RayScene {
   RayObject *objects;
   int num_lights;
   RayLight *lights;
+  // everything in a loaded scene is allocated from here. NULL for scenes put
+  // together by hand, which get freed piece by piece
+  RayArena *arena;
 } RayScene;
 
 void ray_free_scene(RayScene *scene);
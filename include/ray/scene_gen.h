@@ -0,0 +1,70 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#ifndef INCLUDED_RAY_SCENE_GEN_H
+#define INCLUDED_RAY_SCENE_GEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "scene.h"
+
+// made up scenes of any size for seeing how things scale. spheres fill a box
+// in front of the camera that grows with their number (so they stay about as
+// dense), planes are a floor, a back wall and then more floors stacked under
+// the first where they can't be seen, and point lights hang above the front
+// half of the box. every element is drawn from its own stream of random
+// numbers seeded from seed, its kind and its index, so the same settings
+// always give the same scene and e.g. adding lights doesn't move any of the
+// spheres
+
+typedef struct RaySceneGenSettings {
+  uint64_t seed;
+  int width;
+  int height;
+  int num_spheres;
+  // 0 scatters the spheres evenly through the box, towards 1 they're drawn
+  // ever closer to num_clusters points in it
+  double clustering;
+  int num_clusters;
+  int num_planes;
+  int num_lights;
+  // fractions of the objects that are reflective and refractive, the rest
+  // are diffuse
+  double reflective_fraction;
+  double refractive_fraction;
+  // fraction of the objects with one of num_textures checkerboard textures
+  // (texture_size texels square) rather than a plain color
+  double textured_fraction;
+  int num_textures;
+  int texture_size;
+} RaySceneGenSettings;
+
+RaySceneGenSettings ray_default_scene_gen_settings(void);
+
+// the scene all in one arena, like a loaded one. false if it can't be
+// allocated
+bool ray_generate_scene(const RaySceneGenSettings *settings, RayScene *scene);
+
+// writes the same scene as json to path, a line per object and light, which
+// loads back into exactly what ray_generate_scene gives. textures are written
+// next to it as <path without .json>_texture<n>.png and referred to by those
+// paths. false if any of it can't be written
+bool ray_write_generated_scene(const RaySceneGenSettings *settings,
+                               const char *path);
+
+#endif // ifndef INCLUDED_RAY_SCENE_GEN_H
@@ -0,0 +1,39 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#ifndef INCLUDED_RAY_SCENE_WATCH_H
+#define INCLUDED_RAY_SCENE_WATCH_H
+
+// waits for a scene file to change on disk, to know when to reload a live
+// scene. editors often save by writing a new file and renaming it over the
+// old one, so it's the directory that's watched (with inotify where there is
+// one, otherwise by polling the file's modification time) for anything
+// written to or moved onto the file's name
+typedef struct RaySceneWatch RaySceneWatch;
+
+// NULL if the file's directory can't be watched
+RaySceneWatch *ray_create_scene_watch(const char *path);
+
+// blocks until the file changes, for at most timeout_ms (< 0 waits for as
+// long as it takes). changes that come in quick succession (e.g. an editor
+// writing then renaming) are returned as one. 1 if it changed, 0 if it timed
+// out and -1 on error
+int ray_scene_watch_wait(RaySceneWatch *watch, int timeout_ms);
+
+void ray_free_scene_watch(RaySceneWatch *watch);
+
+#endif // ifndef INCLUDED_RAY_SCENE_WATCH_H
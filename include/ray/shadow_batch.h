@@ -0,0 +1,106 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_SHADOW_BATCH_H
+#define INCLUDED_RAY_SHADOW_BATCH_H
+
+#include <stdbool.h>
+
+#include "gsl/gsl_vector.h"
+
+#include "prepare.h"
+
+// shadow rays queued up while shading a tile so they can be traced together,
+// grouped by light, instead of one at a time in between shading. the batch
+// also holds the deferred shading that depends on them: every diffuse hit
+// and the light contributions waiting on each ray
+typedef struct RayDeferredHit {
+  // index into the batch's pixels
+  int pixel;
+  // what the hit's diffuse colour is scaled by on its way to the pixel,
+  // the product of the reflectivities etc. along the path
+  double throughput[3];
+  // its contributions are parts[first..first+count)
+  int first;
+  int count;
+} RayDeferredHit;
+
+typedef struct RayDeferredPart {
+  double color[3];
+  // the shadow ray that decides whether it counts
+  int query;
+} RayDeferredPart;
+
+typedef struct RayShadowBatch {
+  int num_queries;
+  int query_capacity;
+  double (*origins)[3];
+  double (*directions)[3];
+  double *max_distances;
+  int *lights;
+  unsigned char *occluded;
+
+  int num_hits;
+  int hit_capacity;
+  RayDeferredHit *hits;
+
+  int num_parts;
+  int part_capacity;
+  RayDeferredPart *parts;
+
+  int num_pixels;
+  int pixel_capacity;
+  int *pixel_x;
+  int *pixel_y;
+  double (*colors)[3];
+
+  // one light's rays converted for the kernel while resolving
+  int ray_capacity;
+  int *ray_queries;
+  RayShadowRays rays;
+  // queries per light while resolving
+  int bucket_capacity;
+  int *buckets;
+} RayShadowBatch;
+
+RayShadowBatch *ray_create_shadow_batch(void);
+
+void ray_free_shadow_batch(RayShadowBatch *batch);
+
+// forget everything queued, keeping the memory
+void ray_shadow_batch_reset(RayShadowBatch *batch);
+
+// all of these return an index, or -1 when out of memory
+int ray_shadow_batch_add_pixel(RayShadowBatch *batch, int x, int y);
+
+int ray_shadow_batch_add_hit(RayShadowBatch *batch, int pixel,
+                             const double throughput[3]);
+
+// queue a shadow ray and a contribution to the last added hit that only
+// counts if the ray makes it to the light
+int ray_shadow_batch_add_part(RayShadowBatch *batch, const gsl_vector *origin,
+                              const gsl_vector *direction, double max_distance,
+                              int light, const gsl_vector *color);
+
+// trace every queued shadow ray, a light at a time, and sum the hits that
+// are lit into the pixel colours
+bool ray_shadow_batch_resolve(RayShadowBatch *batch,
+                              const RayPreparedScene *prepared,
+                              const RayScene *scene);
+
+#endif // ifndef INCLUDED_RAY_SHADOW_BATCH_H
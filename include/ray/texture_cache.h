@@ -0,0 +1,124 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#ifndef INCLUDED_RAY_TEXTURE_CACHE_H
+#define INCLUDED_RAY_TEXTURE_CACHE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gsl/gsl_vector.h"
+
+#include "tex_coord.h"
+
+// textures that are only paged in as far as they're actually seen. each png
+// is converted once into a cache file holding its whole mip chain as 8 bit
+// rgb tiles:
+//
+//   char magic[8]        "RAYTEX\0\1"
+//   uint32_t width       of the top level
+//   uint32_t height
+//   uint32_t tile_size   RAY_TEXTURE_TILE_SIZE
+//   uint32_t num_levels  halving each side (rounding down, never below 1)
+//                        down to 1x1
+//   (zero padding up to 64 bytes)
+//
+// followed by the tiles of each level from the top one down, row by row.
+// every tile is stored whole, the ones at the right and bottom edges are
+// padded out with the nearest texel, so any tile's offset can be worked out
+// from the header alone. samples load the tile they fall in on demand, and
+// once the cache's memory budget is used up the least recently used tiles
+// are reused for new ones
+
+#define RAY_TEXTURE_TILE_SIZE 64
+#define RAY_TEXTURE_MAX_LEVELS 24
+
+typedef struct RayTextureTile RayTextureTile;
+typedef struct RayTextureCache RayTextureCache;
+
+typedef struct RayTextureLevel {
+  int width;
+  int height;
+  int tiles_x;
+  int tiles_y;
+  // index of the level's first tile in the texture's slots
+  size_t first_slot;
+} RayTextureLevel;
+
+// one texture in a cache. all zero it's a closed texture that's safe to free
+typedef struct RayCachedTexture {
+  RayTextureCache *cache;
+  int fd;
+  int width;
+  int height;
+  int num_levels;
+  RayTextureLevel levels[RAY_TEXTURE_MAX_LEVELS];
+  // the resident tile for each tile of each level, NULL where it isn't
+  // loaded. read without locking, only changed with the cache locked
+  size_t num_slots;
+  _Atomic(RayTextureTile *) *slots;
+} RayCachedTexture;
+
+// samples that find their tile resident aren't counted, that would mean
+// every sample writing to the same counter
+typedef struct RayTextureCacheStats {
+  uint64_t misses;
+  uint64_t evictions;
+  size_t resident_bytes;
+} RayTextureCacheStats;
+
+// cache files go in directory, which has to exist. resident tiles never take
+// up more than budget bytes (though at least one tile is always allowed).
+// NULL if it can't be allocated
+RayTextureCache *ray_create_texture_cache(const char *directory,
+                                          size_t budget);
+
+// every texture opened in it has to be freed first
+void ray_free_texture_cache(RayTextureCache *cache);
+
+RayTextureCacheStats ray_texture_cache_stats(const RayTextureCache *cache);
+
+// opens the png at path into texture, converting it first if there's no
+// cache file for it yet or the png has changed since. no texels are loaded.
+// false (leaving texture closed) if the png can't be read or the cache file
+// can't be written. textures can be opened from several threads at once
+bool ray_texture_cache_open_into(RayTextureCache *cache, const char *path,
+                                 RayCachedTexture *texture);
+
+// the same but allocated, NULL on failure
+RayCachedTexture *ray_texture_cache_open(RayTextureCache *cache,
+                                         const char *path);
+
+// gives its tiles back to the cache and closes it, leaving it all zero
+void ray_close_cached_texture(RayCachedTexture *texture);
+
+// closes and frees one from ray_texture_cache_open (or allocated with malloc
+// and opened with ray_texture_cache_open_into)
+void ray_free_cached_texture(RayCachedTexture *texture);
+
+// the texel at tex_coord (wrapped the same way as plain textures) in the
+// level whose texels are closest to footprint in size, where footprint is
+// the width of the area being shaded in texture coordinates, so 0 always
+// samples the top level. loads the tile if it isn't resident. safe to call
+// from any number of threads, a sample of a resident tile doesn't lock
+void ray_cached_texture_sample_into(RayCachedTexture *texture,
+                                    RayTexCoord tex_coord, double footprint,
+                                    gsl_vector *color);
+
+#endif // ifndef INCLUDED_RAY_TEXTURE_CACHE_H
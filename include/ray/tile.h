@@ -0,0 +1,57 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_TILE_H
+#define INCLUDED_RAY_TILE_H
+
+#include <stdint.h>
+
+typedef enum RAY_TILE_ORDER {
+  // whole image rows top to bottom (no tiling)
+  RAY_TILE_ORDER_scanline,
+  // square tiles row by row
+  RAY_TILE_ORDER_raster,
+  // square tiles along a z-order curve
+  RAY_TILE_ORDER_morton,
+  // square tiles along a hilbert curve
+  RAY_TILE_ORDER_hilbert,
+} RAY_TILE_ORDER;
+
+typedef struct RayTile {
+  int x;
+  int y;
+  int width;
+  int height;
+} RayTile;
+
+// split a width x height image into tiles of at most tile_size x tile_size
+// (ignored for scanline order) and sort them into the given order.
+// returns a malloc'd array or NULL if the order is invalid
+RayTile *ray_create_tiles(int width, int height, int tile_size,
+                          RAY_TILE_ORDER order, int *num_tiles);
+
+// interleave the low 16 bits of x and y (x in the even bits)
+uint32_t ray_morton_encode(uint32_t x, uint32_t y);
+
+void ray_morton_decode(uint32_t code, uint32_t *x, uint32_t *y);
+
+// distance along a hilbert curve filling a side x side grid, side must be a
+// power of two
+uint32_t ray_hilbert_index(uint32_t side, uint32_t x, uint32_t y);
+
+#endif // ifndef INCLUDED_RAY_TILE_H
@@ -0,0 +1,59 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#ifndef INCLUDED_RAY_TONE_MAP_H
+#define INCLUDED_RAY_TONE_MAP_H
+
+#include <stddef.h>
+
+#include "framebuffer.h"
+#include "img_utils.h"
+
+typedef enum RAY_TONE_MAP {
+  // exposure then cut off at 1, what renders always did
+  RAY_TONE_MAP_clamp,
+  // x / (1 + x), compresses highlights instead of clipping them
+  RAY_TONE_MAP_reinhard,
+  // a fit of the aces filmic curve (Narkowicz 2015), slight toe and shoulder
+  RAY_TONE_MAP_aces,
+} RAY_TONE_MAP;
+
+typedef struct RayToneMapSettings {
+  RAY_TONE_MAP op;
+  // in stops, every pixel is scaled by 2^exposure before the curve
+  double exposure;
+} RayToneMapSettings;
+
+// clamp at an exposure of 0
+RayToneMapSettings ray_default_tone_map(void);
+
+// maps count linear values to [0, 1], out may be the same as in
+void ray_tone_map_floats(const float *in, float *out, size_t count,
+                         const RayToneMapSettings *settings);
+
+// settings may be NULL to use the defaults. img has to be the framebuffer's
+// size with 3 channels, any pixels it doesn't have yet are made. it's cheap
+// enough to call again for every change of exposure or curve
+void ray_tone_map_into(const RayFramebuffer *fb,
+                       const RayToneMapSettings *settings, RayImg *img);
+
+// a packed image, NULL if it can't be allocated
+RayImg *ray_tone_map(const RayFramebuffer *fb,
+                     const RayToneMapSettings *settings);
+
+#endif // ifndef INCLUDED_RAY_TONE_MAP_H
@@ -0,0 +1,169 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include "ray/arena.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define DEFAULT_BLOCK_SIZE (64 * 1024)
+
+// blocks start on their own cache line so arenas owned by different threads
+// never share one
+#define BLOCK_ALIGN 64
+
+#define HEADER_SIZE                                                            \
+  ((sizeof(RayArenaBlock) + alignof(max_align_t) - 1) &                        \
+   ~(alignof(max_align_t) - 1))
+
+static RayArenaBlock *create_block(size_t size) {
+  size_t total = HEADER_SIZE + size;
+  total = (total + BLOCK_ALIGN - 1) & ~(size_t)(BLOCK_ALIGN - 1);
+  RayArenaBlock *block = aligned_alloc(BLOCK_ALIGN, total);
+  if (block == NULL) {
+    return NULL;
+  }
+  *block = (RayArenaBlock){
+      .next = NULL,
+      .size = total - HEADER_SIZE,
+      .used = 0,
+  };
+  return block;
+}
+
+static unsigned char *block_data(RayArenaBlock *block) {
+  return (unsigned char *)block + HEADER_SIZE;
+}
+
+RayArena *ray_create_arena(size_t block_size) {
+  RayArena *arena = malloc(sizeof *arena);
+  if (arena == NULL) {
+    return NULL;
+  }
+  block_size = block_size == 0 ? DEFAULT_BLOCK_SIZE : block_size;
+  RayArenaBlock *first = create_block(block_size);
+  if (first == NULL) {
+    free(arena);
+    return NULL;
+  }
+  *arena = (RayArena){
+      .first = first,
+      .current = first,
+      .block_size = block_size,
+      .cleanups = NULL,
+  };
+  return arena;
+}
+
+void *ray_arena_alloc(RayArena *arena, size_t size) {
+  const size_t align = alignof(max_align_t);
+  size = (size + align - 1) & ~(align - 1);
+
+  RayArenaBlock *block = arena->current;
+  while (block->used + size > block->size) {
+    // blocks after the current one are left over from before a reset
+    if (block->next == NULL) {
+      size_t block_size = size > arena->block_size ? size : arena->block_size;
+      block->next = create_block(block_size);
+      if (block->next == NULL) {
+        return NULL;
+      }
+    }
+    block = block->next;
+    block->used = 0;
+    arena->current = block;
+  }
+
+  void *ptr = block_data(block) + block->used;
+  block->used += size;
+  return ptr;
+}
+
+gsl_vector *ray_arena_vec3(RayArena *arena) {
+  gsl_vector *vec = ray_arena_alloc(arena, sizeof *vec);
+  double *data = ray_arena_alloc(arena, 3 * (sizeof *data));
+  if (vec == NULL || data == NULL) {
+    return NULL;
+  }
+  *vec = gsl_vector_view_array(data, 3).vector;
+  return vec;
+}
+
+gsl_vector *ray_arena_create_vec3(RayArena *arena, double x, double y,
+                                  double z) {
+  gsl_vector *vec = ray_arena_vec3(arena);
+  if (vec == NULL) {
+    return NULL;
+  }
+  gsl_vector_set(vec, 0, x);
+  gsl_vector_set(vec, 1, y);
+  gsl_vector_set(vec, 2, z);
+  return vec;
+}
+
+bool ray_arena_add_cleanup(RayArena *arena, RayArenaCleanupFn fn, void *data) {
+  RayArenaCleanup *cleanup = ray_arena_alloc(arena, sizeof *cleanup);
+  if (cleanup == NULL) {
+    return false;
+  }
+  *cleanup = (RayArenaCleanup){
+      .next = arena->cleanups,
+      .fn = fn,
+      .data = data,
+  };
+  arena->cleanups = cleanup;
+  return true;
+}
+
+size_t ray_arena_used(const RayArena *arena) {
+  size_t used = 0;
+  for (RayArenaBlock *block = arena->first; block != arena->current;
+       block = block->next) {
+    used += block->used;
+  }
+  return used + arena->current->used;
+}
+
+static void run_cleanups(RayArena *arena) {
+  // the records themselves live in the arena so this has to happen before
+  // its memory is reused
+  for (RayArenaCleanup *cleanup = arena->cleanups; cleanup != NULL;
+       cleanup = cleanup->next) {
+    cleanup->fn(cleanup->data);
+  }
+  arena->cleanups = NULL;
+}
+
+void ray_arena_reset(RayArena *arena) {
+  run_cleanups(arena);
+  // later blocks are reset as they're reached again
+  arena->current = arena->first;
+  arena->first->used = 0;
+}
+
+void ray_free_arena(RayArena *arena) {
+  run_cleanups(arena);
+  RayArenaBlock *block = arena->first;
+  while (block != NULL) {
+    RayArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  free(arena);
+}
@@ -0,0 +1,398 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for clock_gettime and sysconf
+#define _POSIX_C_SOURCE 200809L
+
+#include "ray/autotune.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ray/hash.h"
+#include "ray/prepare.h"
+
+// primary rays shot for the coverage stats
+#define COVERAGE_COLUMNS 32
+#define COVERAGE_ROWS 24
+
+#define DEFAULT_CALIBRATION_PIXELS (80 * 60)
+// renders of each candidate on the calibration frame, the fastest counts
+#define CALIBRATION_RUNS 2
+
+// tiles per thread wanted so one slow tile doesn't leave the rest idle
+#define TILES_PER_THREAD 8
+#define MIN_TILE_SIZE 8
+#define MAX_TILE_SIZE 32
+// share of hits spawning secondary rays past which the cost of a tile is
+// uneven enough to want smaller ones
+#define UNEVEN_SECONDARY_SHARE 0.25
+
+static uint64_t hash_int(uint64_t hash, int val) {
+  return ray_hash_bytes(hash, &val, sizeof val);
+}
+
+static uint64_t hash_double(uint64_t hash, double val) {
+  return ray_hash_bytes(hash, &val, sizeof val);
+}
+
+static uint64_t hash_vec3(uint64_t hash, const gsl_vector *vec) {
+  for (size_t i = 0; i < 3; ++i) {
+    hash = hash_double(hash, gsl_vector_get(vec, i));
+  }
+  return hash;
+}
+
+static uint64_t hash_material(uint64_t hash, const RayMaterial *material) {
+  const RayColoration *coloration = &material->coloration;
+  hash = hash_int(hash, coloration->type);
+  if (coloration->type == RAY_COLORATION_TYPE_color) {
+    hash = hash_vec3(hash, coloration->color);
+  } else if (coloration->type == RAY_COLORATION_TYPE_texture) {
+    hash = hash_int(hash, coloration->texture->width);
+    hash = hash_int(hash, coloration->texture->height);
+  }
+  hash = hash_double(hash, material->albedo);
+  hash = hash_int(hash, material->surface.type);
+  if (material->surface.type == RAY_SURFACE_TYPE_reflective) {
+    hash = hash_double(hash, material->surface.reflectivity);
+  } else if (material->surface.type == RAY_SURFACE_TYPE_refractive) {
+    hash = hash_double(hash, material->surface.index);
+    hash = hash_double(hash, material->surface.transparency);
+  }
+  return hash;
+}
+
+static uint64_t hash_object(uint64_t hash, const RayObject *object) {
+  hash = hash_int(hash, object->type);
+  if (object->type == RAY_OBJECT_TYPE_sphere) {
+    hash = hash_vec3(hash, object->center);
+    hash = hash_double(hash, object->radius);
+  } else {
+    hash = hash_vec3(hash, object->point);
+    hash = hash_vec3(hash, object->normal);
+  }
+  return hash_material(hash, &object->material);
+}
+
+static uint64_t hash_light(uint64_t hash, const RayLight *light) {
+  hash = hash_int(hash, light->type);
+  // direction and position are the same member
+  hash = hash_vec3(hash, light->position);
+  if (light->type == RAY_LIGHT_TYPE_rect) {
+    hash = hash_vec3(hash, light->u);
+    hash = hash_vec3(hash, light->v);
+  } else if (light->type == RAY_LIGHT_TYPE_sphere) {
+    hash = hash_double(hash, light->radius);
+  }
+  hash = hash_vec3(hash, light->color);
+  return hash_double(hash, light->intensity);
+}
+
+uint64_t ray_scene_hash(const RayScene *scene) {
+  uint64_t hash = RAY_HASH_SEED;
+  hash = hash_int(hash, scene->width);
+  hash = hash_int(hash, scene->height);
+  hash = hash_double(hash, scene->fov);
+  hash = hash_double(hash, scene->shadow_bias);
+  hash = hash_double(hash, scene->max_recursion_depth);
+  hash = hash_int(hash, scene->num_objects);
+  for (int i = 0; i < scene->num_objects; ++i) {
+    hash = hash_object(hash, &scene->objects[i]);
+  }
+  hash = hash_int(hash, scene->num_lights);
+  for (int i = 0; i < scene->num_lights; ++i) {
+    hash = hash_light(hash, &scene->lights[i]);
+  }
+  return hash;
+}
+
+// coverage and secondary_share, by tracing a coarse grid of primary rays
+static void sample_coverage(const RayScene *scene,
+                            const RayPreparedScene *prepared,
+                            RaySceneStats *stats) {
+  double origin_data[3];
+  double direction_data[3];
+  gsl_vector origin = gsl_vector_view_array(origin_data, 3).vector;
+  gsl_vector direction = gsl_vector_view_array(direction_data, 3).vector;
+  RayRay ray = {.origin = &origin, .direction = &direction};
+  int hits = 0;
+  int secondary = 0;
+  for (int row = 0; row < COVERAGE_ROWS; ++row) {
+    for (int column = 0; column < COVERAGE_COLUMNS; ++column) {
+      // the middle of each cell of the grid
+      int x = (int)((column + 0.5) * scene->width / COVERAGE_COLUMNS);
+      int y = (int)((row + 0.5) * scene->height / COVERAGE_ROWS);
+      ray_prime_ray_into(&ray, x, y, scene);
+      const RayObject *object =
+          ray_prepared_closest_intersection(prepared, &ray, NULL);
+      if (object != NULL) {
+        hits += 1;
+        secondary +=
+            object->material.surface.type != RAY_SURFACE_TYPE_diffuse;
+      }
+    }
+  }
+  stats->coverage = (double)hits / (COVERAGE_ROWS * COVERAGE_COLUMNS);
+  stats->secondary_share = hits > 0 ? (double)secondary / hits : 0.0;
+}
+
+bool ray_analyse_scene(const RayScene *scene, RaySceneStats *stats) {
+  memset(stats, 0, sizeof *stats);
+  for (int i = 0; i < scene->num_objects; ++i) {
+    const RayObject *object = &scene->objects[i];
+    stats->num_spheres += object->type == RAY_OBJECT_TYPE_sphere;
+    stats->num_planes += object->type == RAY_OBJECT_TYPE_plane;
+    const RayMaterial *material = &object->material;
+    stats->num_diffuse += material->surface.type == RAY_SURFACE_TYPE_diffuse;
+    stats->num_reflective +=
+        material->surface.type == RAY_SURFACE_TYPE_reflective;
+    stats->num_refractive +=
+        material->surface.type == RAY_SURFACE_TYPE_refractive;
+    stats->num_textured +=
+        material->coloration.type != RAY_COLORATION_TYPE_color;
+  }
+  stats->num_lights = scene->num_lights;
+  for (int i = 0; i < scene->num_lights; ++i) {
+    const RayLight *light = &scene->lights[i];
+    stats->num_directional_lights +=
+        light->type == RAY_LIGHT_TYPE_directional;
+    stats->num_area_lights += ray_light_is_area(light);
+  }
+
+  RayPreparedScene prepared;
+  if (!ray_prepare_scene(scene, 0.0, &prepared)) {
+    return false;
+  }
+  sample_coverage(scene, &prepared, stats);
+  ray_free_prepared_scene(&prepared);
+  return true;
+}
+
+RayAutotuneSettings ray_default_autotune_settings(void) {
+  return (RayAutotuneSettings){
+      .base = ray_default_render_settings(),
+      .calibrate = true,
+      .calibration_pixels = DEFAULT_CALIBRATION_PIXELS,
+      .cache_path = NULL,
+  };
+}
+
+static int count_tiles(const RayScene *scene, int tile_size) {
+  return ((scene->width + tile_size - 1) / tile_size) *
+         ((scene->height + tile_size - 1) / tile_size);
+}
+
+static int online_cpus(void) {
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  return online > 0 ? (int)online : 1;
+}
+
+// settings from the stats alone
+static RayRenderSettings pick_settings(const RayScene *scene,
+                                       const RaySceneStats *stats,
+                                       const RayRenderSettings *base) {
+  RayRenderSettings settings = *base;
+  int num_threads = base->num_threads;
+  if (num_threads <= 0) {
+    num_threads = online_cpus();
+  }
+
+  // scanline renders hand out rows, the tile size doesn't matter
+  if (settings.tile_order != RAY_TILE_ORDER_scanline) {
+    int tile_size = stats->secondary_share > UNEVEN_SECONDARY_SHARE
+                        ? MAX_TILE_SIZE / 2
+                        : MAX_TILE_SIZE;
+    while (tile_size > MIN_TILE_SIZE &&
+           count_tiles(scene, tile_size) < TILES_PER_THREAD * num_threads) {
+      tile_size /= 2;
+    }
+    settings.tile_size = tile_size;
+    // threads past one per tile would have nothing to do
+    const int num_tiles = count_tiles(scene, tile_size);
+    num_threads = num_threads < num_tiles ? num_threads : num_tiles;
+  }
+  settings.num_threads = num_threads;
+
+  // with the generated scenes batching came out ahead or level at every
+  // size, as long as there are shadow rays to batch at all
+  settings.batch_shadows = stats->num_lights > 0;
+  return settings;
+}
+
+static double seconds_since(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) +
+         (double)(now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// fastest of CALIBRATION_RUNS renders, negative if one fails
+static double time_renders(const RayScene *scene,
+                           const RayRenderSettings *settings) {
+  RayRenderer *renderer = ray_create_renderer(settings);
+  if (renderer == NULL) {
+    return -1.0;
+  }
+  double best = -1.0;
+  for (int run = 0; run < CALIBRATION_RUNS; ++run) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    RayFramebuffer *fb = ray_renderer_render_hdr(renderer, scene);
+    const double elapsed = seconds_since(&start);
+    if (fb == NULL) {
+      best = -1.0;
+      break;
+    }
+    ray_free_framebuffer(fb);
+    best = best < 0.0 || elapsed < best ? elapsed : best;
+  }
+  ray_free_renderer(renderer);
+  return best;
+}
+
+// times every tile size from MIN_TILE_SIZE to MAX_TILE_SIZE, with shadows
+// batched and not, on a copy of the scene that's only smaller (it shares the
+// objects and lights)
+static bool calibrate(const RayScene *scene, int max_pixels,
+                      RayAutotuneResult *result) {
+  RayScene small = *scene;
+  const double pixels = (double)scene->width * scene->height;
+  if (pixels > max_pixels) {
+    const double scale = sqrt(max_pixels / pixels);
+    small.width = (int)fmax(1.0, floor(scene->width * scale));
+    small.height = (int)fmax(1.0, floor(scene->height * scale));
+  }
+
+  const RayRenderSettings picked = result->settings;
+  const bool tiled = picked.tile_order != RAY_TILE_ORDER_scanline;
+  double best = -1.0;
+  for (int tile_size = MIN_TILE_SIZE; tile_size <= MAX_TILE_SIZE;
+       tile_size *= 2) {
+    if (!tiled && tile_size != MIN_TILE_SIZE) {
+      break;
+    }
+    for (int batch = 0; batch < 2; ++batch) {
+      RayRenderSettings candidate = picked;
+      candidate.tile_size = tiled ? tile_size : picked.tile_size;
+      candidate.batch_shadows = batch;
+      const double seconds = time_renders(&small, &candidate);
+      if (seconds < 0.0) {
+        return false;
+      }
+      if (best < 0.0 || seconds < best) {
+        best = seconds;
+        result->settings = candidate;
+      }
+    }
+  }
+  result->calibrated = true;
+  result->calibration_seconds = best;
+  return true;
+}
+
+// what results are cached under. besides the scene, the threads picked
+// depend on the machine and the base settings, as does the tile size on the
+// tile order
+static uint64_t cache_key(uint64_t scene_hash, const RayRenderSettings *base) {
+  uint64_t hash = hash_int(scene_hash, online_cpus());
+  hash = hash_int(hash, base->num_threads);
+  return hash_int(hash, base->tile_order);
+}
+
+// the last entry for key wins. false if there isn't a usable one
+static bool read_cache(const char *path, uint64_t key, bool calibrated,
+                       RayAutotuneResult *result) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    return false;
+  }
+  bool found = false;
+  char line[256];
+  while (fgets(line, sizeof line, file) != NULL) {
+    uint64_t line_key = 0;
+    int line_calibrated = 0;
+    int num_threads = 0;
+    int tile_size = 0;
+    int batch_shadows = 0;
+    if (sscanf(line, "%" SCNx64 " %d %d %d %d", &line_key, &line_calibrated,
+               &num_threads, &tile_size, &batch_shadows) != 5 ||
+        line_key != key || (calibrated && !line_calibrated) ||
+        num_threads <= 0 || tile_size <= 0) {
+      continue;
+    }
+    result->settings.num_threads = num_threads;
+    result->settings.tile_size = tile_size;
+    result->settings.batch_shadows = batch_shadows != 0;
+    result->calibrated = line_calibrated != 0;
+    found = true;
+  }
+  fclose(file);
+  return found;
+}
+
+static void append_cache(const char *path, uint64_t key,
+                         const RayAutotuneResult *result) {
+  FILE *file = fopen(path, "a");
+  if (file == NULL) {
+    return;
+  }
+  const RayRenderSettings *settings = &result->settings;
+  fprintf(file, "%016" PRIx64 " %d %d %d %d\n", key, result->calibrated,
+          settings->num_threads, settings->tile_size, settings->batch_shadows);
+  fclose(file);
+}
+
+bool ray_autotune(const RayScene *scene, const RayAutotuneSettings *settings,
+                  RayAutotuneResult *result) {
+  const RayAutotuneSettings defaults = ray_default_autotune_settings();
+  if (settings == NULL) {
+    settings = &defaults;
+  }
+  memset(result, 0, sizeof *result);
+  result->settings = settings->base;
+  result->scene_hash = ray_scene_hash(scene);
+  const uint64_t key = cache_key(result->scene_hash, &settings->base);
+
+  if (settings->cache_path != NULL &&
+      read_cache(settings->cache_path, key, settings->calibrate, result)) {
+    result->from_cache = true;
+    return true;
+  }
+
+  if (!ray_analyse_scene(scene, &result->stats)) {
+    return false;
+  }
+  result->settings = pick_settings(scene, &result->stats, &settings->base);
+  if (settings->calibrate) {
+    const int max_pixels = settings->calibration_pixels > 0
+                               ? settings->calibration_pixels
+                               : DEFAULT_CALIBRATION_PIXELS;
+    if (!calibrate(scene, max_pixels, result)) {
+      return false;
+    }
+  }
+
+  if (settings->cache_path != NULL) {
+    append_cache(settings->cache_path, key, result);
+  }
+  return true;
+}
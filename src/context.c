@@ -0,0 +1,219 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include "ray/context.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void ray_render_stats_add(RayRenderStats *total, const RayRenderStats *stats) {
+  total->primary_rays += stats->primary_rays;
+  total->reflection_rays += stats->reflection_rays;
+  total->transmission_rays += stats->transmission_rays;
+  total->shadow_rays += stats->shadow_rays;
+  total->intersection_tests += stats->intersection_tests;
+  total->culled_lights += stats->culled_lights;
+  total->occluder_cache_hits += stats->occluder_cache_hits;
+  total->occluder_cache_misses += stats->occluder_cache_misses;
+  total->area_light_samples += stats->area_light_samples;
+  total->area_light_refinements += stats->area_light_refinements;
+  total->tiles += stats->tiles;
+  total->perf_counters |= stats->perf_counters;
+  for (int s = 0; s < RAY_RENDER_STAGE_count; ++s) {
+    for (int c = 0; c < RAY_PERF_COUNTER_count; ++c) {
+      total->perf[s][c] += stats->perf[s][c];
+    }
+  }
+}
+
+const char *ray_render_stage_name(RAY_RENDER_STAGE stage) {
+  return (stage == RAY_RENDER_STAGE_primary)     ? "primary"
+         : (stage == RAY_RENDER_STAGE_shading)   ? "shading"
+         : (stage == RAY_RENDER_STAGE_shadow)    ? "shadow"
+         : (stage == RAY_RENDER_STAGE_secondary) ? "secondary"
+         : (stage == RAY_RENDER_STAGE_output)    ? "output"
+                                                 : "unknown";
+}
+
+static RayRay alloc_ray(void) {
+  RayRay ray = {
+      .origin = gsl_vector_calloc(3),
+      .direction = gsl_vector_calloc(3),
+  };
+  return ray;
+}
+
+bool ray_init_render_context(RayRenderContext *ctx, int index) {
+  memset(ctx, 0, sizeof *ctx);
+  ctx->index = index;
+  ctx->arena = ray_create_arena(0);
+  if (ctx->arena == NULL) {
+    return false;
+  }
+  ctx->primary = alloc_ray();
+  return true;
+}
+
+bool ray_render_context_reserve(RayRenderContext *ctx, int max_depth) {
+  int num_frames = max_depth < 0 ? 1 : max_depth + 1;
+  if (num_frames <= ctx->num_frames) {
+    return true;
+  }
+
+  RayTraceFrame *frames =
+      realloc(ctx->frames, num_frames * (sizeof *ctx->frames));
+  if (frames == NULL) {
+    return false;
+  }
+  for (int f = ctx->num_frames; f < num_frames; f += 1) {
+    frames[f] = (RayTraceFrame){
+        .reflection = alloc_ray(),
+        .transmission = alloc_ray(),
+    };
+  }
+  ctx->frames = frames;
+  ctx->num_frames = num_frames;
+  return true;
+}
+
+bool ray_render_context_reserve_lights(RayRenderContext *ctx, int num_lights) {
+  if (num_lights <= ctx->light_capacity) {
+    return true;
+  }
+  int *lights = realloc(ctx->lights, num_lights * (sizeof *ctx->lights));
+  if (lights == NULL) {
+    return false;
+  }
+  ctx->lights = lights;
+  double *weights =
+      realloc(ctx->light_weights, num_lights * (sizeof *ctx->light_weights));
+  if (weights == NULL) {
+    return false;
+  }
+  ctx->light_weights = weights;
+  int *occluders =
+      realloc(ctx->occluders, num_lights * (sizeof *ctx->occluders));
+  if (occluders == NULL) {
+    return false;
+  }
+  ctx->occluders = occluders;
+  ctx->light_capacity = num_lights;
+  return true;
+}
+
+void ray_render_context_start_perf(RayRenderContext *ctx) {
+  if (!ctx->count_perf || ctx->perf_open) {
+    return;
+  }
+  if (!ray_open_perf_counters(&ctx->perf)) {
+    return;
+  }
+  if (!ray_read_perf_counters(&ctx->perf, ctx->perf_start)) {
+    ray_close_perf_counters(&ctx->perf);
+    return;
+  }
+  ctx->perf_open = true;
+  ctx->perf_sampling = false;
+  memset(ctx->perf_sampled, 0, sizeof ctx->perf_sampled);
+  ctx->stats.perf_counters |= ctx->perf.available;
+}
+
+void ray_render_context_begin_pixel(RayRenderContext *ctx, int x, int y) {
+  // scattered rather than on a grid, so the sample doesn't line up with
+  // tiles or anything in the scene
+  const uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u);
+  const bool sample =
+      ctx->perf_sample_every <= 1 || hash % ctx->perf_sample_every == 0;
+  if (sample == ctx->perf_sampling) {
+    return;
+  }
+  if (sample) {
+    if (!ray_read_perf_counters(&ctx->perf, ctx->perf_last)) {
+      return;
+    }
+    ctx->stage = RAY_RENDER_STAGE_output;
+  } else {
+    // whatever was left of the last sampled pixel
+    ray_render_context_switch_stage(ctx, RAY_RENDER_STAGE_output);
+  }
+  ctx->perf_sampling = sample;
+}
+
+void ray_render_context_switch_stage(RayRenderContext *ctx,
+                                     RAY_RENDER_STAGE stage) {
+  uint64_t values[RAY_PERF_COUNTER_count];
+  // a failed read leaves it all to the next one
+  if (!ray_read_perf_counters(&ctx->perf, values)) {
+    return;
+  }
+  uint64_t *counts = ctx->perf_sampled[ctx->stage];
+  for (int c = 0; c < RAY_PERF_COUNTER_count; ++c) {
+    counts[c] += values[c] - ctx->perf_last[c];
+    ctx->perf_last[c] = values[c];
+  }
+  ctx->stage = stage;
+}
+
+void ray_render_context_stop_perf(RayRenderContext *ctx) {
+  if (!ctx->perf_open) {
+    return;
+  }
+  if (ctx->perf_sampling) {
+    ray_render_context_switch_stage(ctx, RAY_RENDER_STAGE_output);
+  }
+  uint64_t end[RAY_PERF_COUNTER_count];
+  if (ray_read_perf_counters(&ctx->perf, end)) {
+    for (int c = 0; c < RAY_PERF_COUNTER_count; ++c) {
+      const uint64_t total = end[c] - ctx->perf_start[c];
+      uint64_t sampled = 0;
+      for (int s = 0; s < RAY_RENDER_STAGE_count; ++s) {
+        sampled += ctx->perf_sampled[s][c];
+      }
+      if (sampled == 0) {
+        ctx->stats.perf[RAY_RENDER_STAGE_output][c] += total;
+        continue;
+      }
+      // whatever's left over from rounding goes to output too
+      uint64_t split = 0;
+      for (int s = 0; s < RAY_RENDER_STAGE_output; ++s) {
+        const uint64_t share = (uint64_t)((double)total *
+                                          ctx->perf_sampled[s][c] / sampled);
+        ctx->stats.perf[s][c] += share;
+        split += share;
+      }
+      ctx->stats.perf[RAY_RENDER_STAGE_output][c] +=
+          total > split ? total - split : 0;
+    }
+  }
+  ray_close_perf_counters(&ctx->perf);
+  ctx->perf_open = false;
+}
+
+void ray_free_render_context(RayRenderContext *ctx) {
+  for (int f = 0; f < ctx->num_frames; f += 1) {
+    ray_ray_free(ctx->frames[f].reflection);
+    ray_ray_free(ctx->frames[f].transmission);
+  }
+  free(ctx->frames);
+  free(ctx->lights);
+  free(ctx->light_weights);
+  free(ctx->occluders);
+  ray_free_shadow_batch(ctx->shadow_batch);
+  ray_ray_free(ctx->primary);
+  ray_free_arena(ctx->arena);
+}
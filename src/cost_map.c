@@ -0,0 +1,171 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include "ray/cost_map.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ray/hdr_io.h"
+#include "ray/img_utils.h"
+
+// of the values in a plane, what the false colour tops out at
+#define SCALE_PERCENTILE 0.99
+
+const char *ray_pixel_cost_name(RAY_PIXEL_COST cost) {
+  static const char *const names[RAY_PIXEL_COST_count] = {
+      [RAY_PIXEL_COST_rays] = "rays",
+      [RAY_PIXEL_COST_intersection_tests] = "tests",
+      [RAY_PIXEL_COST_depth] = "depth",
+      [RAY_PIXEL_COST_time] = "time",
+  };
+  return cost >= 0 && cost < RAY_PIXEL_COST_count ? names[cost] : "unknown";
+}
+
+static size_t plane_size(const RayCostMap *map) {
+  return (size_t)map->width * map->height;
+}
+
+RayCostMap *ray_create_cost_map(int width, int height) {
+  if (width <= 0 || height <= 0) {
+    return NULL;
+  }
+  RayCostMap *map = malloc(sizeof *map);
+  if (map == NULL) {
+    return NULL;
+  }
+  *map = (RayCostMap){
+      .width = width,
+      .height = height,
+  };
+  map->data = calloc(plane_size(map) * RAY_PIXEL_COST_count, sizeof(float));
+  if (map->data == NULL) {
+    free(map);
+    return NULL;
+  }
+  return map;
+}
+
+void ray_free_cost_map(RayCostMap *map) {
+  if (map == NULL) {
+    return;
+  }
+  free(map->data);
+  free(map);
+}
+
+float *ray_cost_map_plane(const RayCostMap *map, RAY_PIXEL_COST cost) {
+  assert(cost >= 0 && cost < RAY_PIXEL_COST_count && "invalid pixel cost");
+  return map->data + plane_size(map) * cost;
+}
+
+static int compare_floats(const void *a, const void *b) {
+  const float lhs = *(const float *)a;
+  const float rhs = *(const float *)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+float ray_cost_map_scale(const RayCostMap *map, RAY_PIXEL_COST cost) {
+  const size_t size = plane_size(map);
+  float *sorted = malloc(size * (sizeof *sorted));
+  if (sorted == NULL) {
+    // the maximum doesn't need a copy
+    const float *plane = ray_cost_map_plane(map, cost);
+    float max = 0.0f;
+    for (size_t i = 0; i < size; ++i) {
+      max = plane[i] > max ? plane[i] : max;
+    }
+    return max;
+  }
+  memcpy(sorted, ray_cost_map_plane(map, cost), size * (sizeof *sorted));
+  qsort(sorted, size, sizeof *sorted, compare_floats);
+  const float scale = sorted[(size_t)((double)(size - 1) * SCALE_PERCENTILE)];
+  free(sorted);
+  return scale;
+}
+
+// blue, cyan, green, yellow then red as t goes from 0 to 1
+static void false_color(double t, double *rgb) {
+  static const double stops[][3] = {
+      {0.0, 0.0, 1.0}, {0.0, 1.0, 1.0}, {0.0, 1.0, 0.0},
+      {1.0, 1.0, 0.0}, {1.0, 0.0, 0.0},
+  };
+  const int last = (int)(sizeof stops / sizeof stops[0]) - 1;
+  t = t < 0.0 ? 0.0 : t > 1.0 ? 1.0 : t;
+  const double position = t * last;
+  int stop = (int)position;
+  stop = stop < last ? stop : last - 1;
+  const double blend = position - stop;
+  for (size_t c = 0; c < 3; ++c) {
+    rgb[c] = stops[stop][c] * (1.0 - blend) + stops[stop + 1][c] * blend;
+  }
+}
+
+bool ray_cost_map_write_png(const char *filename, const RayCostMap *map,
+                            RAY_PIXEL_COST cost) {
+  RayImg *img = ray_create_packed_img(map->width, map->height, 3);
+  if (img == NULL) {
+    fprintf(stderr, "out of memory while writing \"%s\"\n", filename);
+    return false;
+  }
+  const float *plane = ray_cost_map_plane(map, cost);
+  const float scale = ray_cost_map_scale(map, cost);
+  for (size_t i = 0; i < plane_size(map); ++i) {
+    // anything that cost nothing stays black
+    if (plane[i] > 0.0f) {
+      false_color(scale > 0.0f ? plane[i] / scale : 1.0, img->data + i * 3);
+    }
+  }
+  bool success = ray_png_write(filename, img);
+  ray_free_img(img);
+  return success;
+}
+
+bool ray_cost_map_write_pfm(const char *filename, const RayCostMap *map,
+                            RAY_PIXEL_COST cost) {
+  return ray_pfm_write_floats(filename, ray_cost_map_plane(map, cost),
+                              map->width, map->height, 1);
+}
+
+bool ray_write_cost_maps(const RayCostMap *map, const char *image_path,
+                         bool raw) {
+  // the extension only counts if it's in the last part of the path
+  const char *slash = strrchr(image_path, '/');
+  const char *dot = strrchr(image_path, '.');
+  const size_t stem = dot != NULL && (slash == NULL || dot > slash)
+                          ? (size_t)(dot - image_path)
+                          : strlen(image_path);
+  // room for the longest name and extension
+  char *path = malloc(stem + 32);
+  if (path == NULL) {
+    fprintf(stderr, "out of memory while writing cost maps\n");
+    return false;
+  }
+
+  bool success = true;
+  for (int cost = 0; success && cost < RAY_PIXEL_COST_count; ++cost) {
+    snprintf(path, stem + 32, "%.*s.%s.%s", (int)stem, image_path,
+             ray_pixel_cost_name(cost), raw ? "pfm" : "png");
+    success = raw ? ray_cost_map_write_pfm(path, map, cost)
+                  : ray_cost_map_write_png(path, map, cost);
+  }
+  free(path);
+  return success;
+}
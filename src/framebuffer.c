@@ -0,0 +1,102 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+// for munmap
+#define _POSIX_C_SOURCE 200809L
+
+#include "ray/framebuffer.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define FRAMEBUFFER_ALIGN 64
+
+RayFramebuffer *ray_create_framebuffer(int width, int height) {
+  if (width <= 0 || height <= 0) {
+    return NULL;
+  }
+  size_t size = (size_t)width * height * RAY_FRAMEBUFFER_CHANNELS *
+                (sizeof(float));
+  // aligned_alloc wants a multiple of the alignment
+  size = (size + FRAMEBUFFER_ALIGN - 1) & ~(size_t)(FRAMEBUFFER_ALIGN - 1);
+
+  RayFramebuffer *fb = malloc(sizeof *fb);
+  if (fb == NULL) {
+    return NULL;
+  }
+  float *data = aligned_alloc(FRAMEBUFFER_ALIGN, size);
+  if (data == NULL) {
+    free(fb);
+    return NULL;
+  }
+  memset(data, 0, size);
+
+  *fb = (RayFramebuffer){
+      .width = width,
+      .height = height,
+      .data = data,
+  };
+  return fb;
+}
+
+void ray_free_framebuffer(RayFramebuffer *fb) {
+  if (fb == NULL) {
+    return;
+  }
+  if (fb->mapping != NULL) {
+    munmap(fb->mapping, fb->mapping_size);
+  } else {
+    free(fb->data);
+  }
+  free(fb);
+}
+
+float *ray_framebuffer_pixel(const RayFramebuffer *fb, int x, int y) {
+  return fb->data + ((size_t)y * fb->width + x) * RAY_FRAMEBUFFER_CHANNELS;
+}
+
+void ray_framebuffer_set(RayFramebuffer *fb, int x, int y,
+                         const gsl_vector *color) {
+  assert(color->size == RAY_FRAMEBUFFER_CHANNELS &&
+         "colors must have a component per channel");
+  assert(x >= 0 && x < fb->width && "x must be inside the framebuffer");
+  assert(y >= 0 && y < fb->height && "y must be inside the framebuffer");
+  float *pixel = ray_framebuffer_pixel(fb, x, y);
+  for (int c = 0; c < RAY_FRAMEBUFFER_CHANNELS; ++c) {
+    pixel[c] = (float)gsl_vector_get(color, c);
+  }
+}
+
+void ray_framebuffer_paste(RayFramebuffer *dst, const RayFramebuffer *src,
+                           RayTile rect) {
+  assert(rect.x >= dst->x && rect.x + rect.width <= dst->x + dst->width &&
+         rect.y >= dst->y && rect.y + rect.height <= dst->y + dst->height &&
+         "rect must be inside the destination");
+  assert(rect.x >= src->x && rect.x + rect.width <= src->x + src->width &&
+         rect.y >= src->y && rect.y + rect.height <= src->y + src->height &&
+         "rect must be inside the source");
+  const size_t row_size =
+      (size_t)rect.width * RAY_FRAMEBUFFER_CHANNELS * (sizeof(float));
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    memcpy(ray_framebuffer_pixel(dst, rect.x - dst->x, y - dst->y),
+           ray_framebuffer_pixel(src, rect.x - src->x, y - src->y), row_size);
+  }
+}
@@ -0,0 +1,222 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+// for writev, mmap and sysconf
+#define _POSIX_C_SOURCE 200809L
+
+#include "ray/hdr_io.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define RAW_MAGIC "RAYFB\0\0\0"
+#define RAW_BYTE_ORDER 0x01020304u
+#define RAW_DATA_OFFSET 64
+
+typedef struct RawHeader {
+  char magic[8];
+  uint32_t byte_order;
+  uint32_t channels;
+  uint32_t width;
+  uint32_t height;
+  uint64_t data_offset;
+  char padding[RAW_DATA_OFFSET - 32];
+} RawHeader;
+
+_Static_assert(sizeof(RawHeader) == RAW_DATA_OFFSET,
+               "raw header must fill the space before the data");
+
+static bool host_is_little_endian(void) {
+  const uint16_t one = 1;
+  return *(const unsigned char *)&one == 1;
+}
+
+static size_t row_size(const RayFramebuffer *fb) {
+  return (size_t)fb->width * RAY_FRAMEBUFFER_CHANNELS * (sizeof(float));
+}
+
+// writev can stop short (and takes a limited number of buffers per call), so
+// keep going from wherever it got to. the iovecs are used up in the process
+static bool write_all(int fd, struct iovec *iov, int count) {
+  long max_iov = sysconf(_SC_IOV_MAX);
+  // the least posix allows
+  max_iov = max_iov > 0 ? max_iov : 16;
+  while (count > 0) {
+    int batch = count < max_iov ? count : (int)max_iov;
+    ssize_t written = writev(fd, iov, batch);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    while (count > 0 && (size_t)written >= iov->iov_len) {
+      written -= (ssize_t)iov->iov_len;
+      iov += 1;
+      count -= 1;
+    }
+    if (count > 0) {
+      iov->iov_base = (char *)iov->iov_base + written;
+      iov->iov_len -= (size_t)written;
+    }
+  }
+  return true;
+}
+
+static bool write_file(const char *filename, struct iovec *iov, int count) {
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "failed to open file \"%s\"\n", filename);
+    return false;
+  }
+  bool success = write_all(fd, iov, count);
+  if (close(fd) != 0) {
+    success = false;
+  }
+  if (!success) {
+    fprintf(stderr, "error while writing \"%s\"\n", filename);
+  }
+  return success;
+}
+
+bool ray_pfm_write(const char *filename, const RayFramebuffer *fb) {
+  return ray_pfm_write_floats(filename, fb->data, fb->width, fb->height,
+                              RAY_FRAMEBUFFER_CHANNELS);
+}
+
+bool ray_pfm_write_floats(const char *filename, const float *data, int width,
+                          int height, int channels) {
+  assert(filename != NULL && "filename cannot be null");
+  assert((channels == 1 || channels == 3) && "pfm is either gray or rgb");
+  // PF is rgb and Pf gray, a negative scale means little endian data
+  char header[64];
+  int header_size = snprintf(header, sizeof header, "%s\n%d %d\n%s\n",
+                             channels == 3 ? "PF" : "Pf", width, height,
+                             host_is_little_endian() ? "-1.0" : "1.0");
+
+  // pfm rows go from the bottom up, so one buffer per row in reverse
+  const size_t row_bytes = (size_t)width * channels * (sizeof *data);
+  const int count = height + 1;
+  struct iovec *iov = malloc(count * (sizeof *iov));
+  if (iov == NULL) {
+    fprintf(stderr, "out of memory while writing \"%s\"\n", filename);
+    return false;
+  }
+  iov[0] = (struct iovec){.iov_base = header, .iov_len = header_size};
+  for (int y = 0; y < height; ++y) {
+    iov[height - y] = (struct iovec){
+        .iov_base = (void *)(data + (size_t)y * width * channels),
+        .iov_len = row_bytes,
+    };
+  }
+
+  bool success = write_file(filename, iov, count);
+  free(iov);
+  return success;
+}
+
+bool ray_raw_framebuffer_write(const char *filename,
+                               const RayFramebuffer *fb) {
+  assert(filename != NULL && "filename cannot be null");
+  RawHeader header = {
+      .magic = RAW_MAGIC,
+      .byte_order = RAW_BYTE_ORDER,
+      .channels = RAY_FRAMEBUFFER_CHANNELS,
+      .width = (uint32_t)fb->width,
+      .height = (uint32_t)fb->height,
+      .data_offset = RAW_DATA_OFFSET,
+  };
+  struct iovec iov[2] = {
+      {.iov_base = &header, .iov_len = sizeof header},
+      {.iov_base = fb->data, .iov_len = row_size(fb) * fb->height},
+  };
+  return write_file(filename, iov, 2);
+}
+
+static bool valid_raw_header(const RawHeader *header, size_t file_size) {
+  if (memcmp(header->magic, RAW_MAGIC, sizeof header->magic) != 0) {
+    return false;
+  }
+  if (header->byte_order != RAW_BYTE_ORDER ||
+      header->channels != RAY_FRAMEBUFFER_CHANNELS ||
+      header->data_offset != RAW_DATA_OFFSET) {
+    return false;
+  }
+  if (header->width == 0 || header->width > INT32_MAX ||
+      header->height == 0 || header->height > INT32_MAX) {
+    return false;
+  }
+  const uint64_t data_size = (uint64_t)header->width * header->height *
+                             RAY_FRAMEBUFFER_CHANNELS * (sizeof(float));
+  return data_size <= file_size - RAW_DATA_OFFSET;
+}
+
+RayFramebuffer *ray_map_raw_framebuffer(const char *filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "failed to open file \"%s\"\n", filename);
+    return NULL;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < RAW_DATA_OFFSET) {
+    fprintf(stderr, "\"%s\" is too small to be a raw framebuffer\n",
+            filename);
+    close(fd);
+    return NULL;
+  }
+  const size_t size = (size_t)info.st_size;
+  void *mapping =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file alive by itself
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    fprintf(stderr, "failed to map \"%s\"\n", filename);
+    return NULL;
+  }
+
+  const RawHeader *header = mapping;
+  if (!valid_raw_header(header, size)) {
+    fprintf(stderr, "\"%s\" isn't a raw framebuffer for this machine\n",
+            filename);
+    munmap(mapping, size);
+    return NULL;
+  }
+
+  RayFramebuffer *fb = malloc(sizeof *fb);
+  if (fb == NULL) {
+    munmap(mapping, size);
+    return NULL;
+  }
+  *fb = (RayFramebuffer){
+      .width = (int)header->width,
+      .height = (int)header->height,
+      .data = (float *)((char *)mapping + header->data_offset),
+      .mapping = mapping,
+      .mapping_size = size,
+  };
+  return fb;
+}
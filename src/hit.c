@@ -0,0 +1,67 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include "ray/hit.h"
+
+#include "gsl/gsl_math.h"
+
+#include "ray/normal.h"
+
+void ray_hit_record_init(RayHitRecord *hit, const RayObject *object,
+                         const RayRay *ray, double distance,
+                         const RayPreparedScene *prepared, RayArena *arena) {
+  hit->object = object;
+  hit->material = &object->material;
+  hit->distance = distance;
+
+  hit->point = ray_arena_vec3(arena);
+  gsl_vector_memcpy(hit->point, ray->direction);
+  gsl_vector_scale(hit->point, distance);
+  gsl_vector_add(hit->point, ray->origin);
+
+  hit->normal = ray_arena_vec3(arena);
+  ray_surface_normal_into(object, hit->point, hit->normal);
+
+  ray_hit_record_color(hit, prepared, arena);
+
+  hit->reflectance = hit->material->albedo / M_PI;
+  hit->bias = ray_prepared_bias(prepared, hit->point);
+}
+
+void ray_hit_record_color(RayHitRecord *hit, const RayPreparedScene *prepared,
+                          RayArena *arena) {
+  const RayObject *object = hit->object;
+  const RayColoration *coloration = &hit->material->coloration;
+  hit->tex_coord = (RayTexCoord){0};
+  if (coloration->type == RAY_COLORATION_TYPE_texture ||
+      coloration->type == RAY_COLORATION_TYPE_cached_texture) {
+    hit->tex_coord = ray_object_tex_coord(object, hit->point);
+  }
+  if (coloration->type == RAY_COLORATION_TYPE_cached_texture) {
+    // only the length of this ray is known, not the whole path, so
+    // reflections pick a sharper level than they could
+    double footprint =
+        hit->distance * prepared->pixel_spread * ray_object_tex_scale(object);
+    gsl_vector *color = ray_arena_vec3(arena);
+    ray_cached_texture_sample_into(coloration->cached_texture,
+                                   hit->tex_coord, footprint, color);
+    hit->base_color = color;
+  } else {
+    hit->base_color = ray_coloration_color_get(coloration, hit->tex_coord);
+  }
+}
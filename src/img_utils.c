@@ -24,8 +24,37 @@
 
 #include "png.h" // png_*
 
+#include "ray/png_encoder.h"
 #include "ray/vec_utils.h"
 
+// gets any 8 or 16 bit, palette, gray or alpha png to 8 bit rgb
+static void set_rgb8_transforms(png_structp png_ptr, png_infop info_ptr) {
+  int color_type = png_get_color_type(png_ptr, info_ptr);
+  int bit_depth = png_get_bit_depth(png_ptr, info_ptr);
+
+  if (color_type == PNG_COLOR_TYPE_PALETTE) {
+    png_set_palette_to_rgb(png_ptr);
+  }
+  if (color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+    png_set_expand_gray_1_2_4_to_8(png_ptr);
+  }
+  if (bit_depth == 16) {
+    png_set_scale_16(png_ptr);
+  }
+  if (color_type == PNG_COLOR_TYPE_GRAY ||
+      color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+    png_set_gray_to_rgb(png_ptr);
+  }
+  // textures are opaque, and the palette expansion turns a trns chunk into
+  // alpha as well
+  if ((color_type & PNG_COLOR_MASK_ALPHA) ||
+      png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
+    png_set_strip_alpha(png_ptr);
+  }
+  png_set_interlace_handling(png_ptr);
+  png_read_update_info(png_ptr, info_ptr);
+}
+
 RayImg *ray_read_img(const char *path) {
   FILE *infile = fopen(path, "rb");
   if (infile == NULL) {
@@ -34,15 +63,17 @@ RayImg *ray_read_img(const char *path) {
   }
 
   unsigned char sig[8];
-  fread(sig, 1, 8, infile);
-  if (!png_check_sig(sig, 8)) {
+  if (fread(sig, 1, 8, infile) != 8 || png_sig_cmp(sig, 0, 8) != 0) {
     fprintf(stderr, "file passed to read_img wasn't a png (or is corrupted)\n");
+    fclose(infile);
     return NULL;
   }
 
-  png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_structp png_ptr =
+      png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
   if (png_ptr == NULL) {
     fprintf(stderr, "initialization of libpng failed\n");
+    fclose(infile);
     return NULL;
   }
 
@@ -50,47 +81,63 @@ RayImg *ray_read_img(const char *path) {
   if (info_ptr == NULL) {
     fprintf(stderr, "initiliazation if info struct failed\n");
     png_destroy_read_struct(&png_ptr, NULL, NULL);
+    fclose(infile);
     return NULL;
   }
 
+  // volatile so they're still valid after a longjmp back here
+  png_bytep volatile bytes = NULL;
+  png_bytep *volatile rows = NULL;
   if (setjmp(png_jmpbuf(png_ptr))) {
     fprintf(stderr, "something went wrong while reading png\n");
+    free(bytes);
+    free(rows);
     png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
+    fclose(infile);
     return NULL;
   }
 
   png_init_io(png_ptr, infile);
   png_set_sig_bytes(png_ptr, 8);
   png_read_info(png_ptr, info_ptr);
+  set_rgb8_transforms(png_ptr, info_ptr);
 
-  unsigned int uwidth;
-  unsigned int uheight;
-  int bit_depth;
-  int color_type;
-  png_get_IHDR(png_ptr, info_ptr, &uwidth, &uheight, &bit_depth, &color_type, NULL, NULL, NULL);
-  assert(bit_depth == 8);
+  png_uint_32 uwidth = png_get_image_width(png_ptr, info_ptr);
+  png_uint_32 uheight = png_get_image_height(png_ptr, info_ptr);
   assert(uwidth <= INT_MAX);
   assert(uheight <= INT_MAX);
-  assert(color_type == PNG_COLOR_TYPE_RGB && "color type must be rgb (no alpha)");
-
   int width = (int)uwidth;
   int height = (int)uheight;
   int channels = 3;
+  size_t row_size = png_get_rowbytes(png_ptr, info_ptr);
+  if (row_size != (size_t)width * channels) {
+    png_error(png_ptr, "transforms must leave 8 bit rgb");
+  }
 
-  RayImg *img = ray_create_img(width, height, channels);
+  // the whole image is decoded in one go into a single buffer
+  bytes = malloc(row_size * height);
+  rows = malloc(height * (sizeof *rows));
+  if (bytes == NULL || rows == NULL) {
+    png_error(png_ptr, "out of memory");
+  }
   for (int y = 0; y < height; ++y) {
-    png_bytep row = malloc(width * channels * (sizeof *row));
-    png_read_row(png_ptr, row, NULL);
-    for (int x = 0; x < width; ++x) {
-      int row_x = x * channels;
-      double r = (double)row[row_x] / UCHAR_MAX;
-      double g = (double)row[row_x + 1] / UCHAR_MAX;
-      double b = (double)row[row_x + 2] / UCHAR_MAX;
-      img->pixels[y][x] = ray_create_vec3(r, g, b);
-    }
-    free(row);
+    rows[y] = bytes + row_size * y;
+  }
+  png_read_image(png_ptr, rows);
+  png_read_end(png_ptr, NULL);
+
+  RayImg *img = ray_create_packed_img(width, height, channels);
+  if (img == NULL) {
+    png_error(png_ptr, "out of memory");
+  }
+  const size_t count = row_size * height;
+  double *data = img->data;
+  for (size_t i = 0; i < count; ++i) {
+    data[i] = (double)bytes[i] / UCHAR_MAX;
   }
 
+  free(bytes);
+  free(rows);
   png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
   fclose(infile);
 
@@ -116,10 +163,48 @@ RayImg *ray_create_img(int width, int height, int channels) {
   return img;
 }
 
+RayImg *ray_create_packed_img(int width, int height, int channels) {
+  const size_t num_pixels = (size_t)width * height;
+  double *data = calloc(num_pixels * channels, sizeof *data);
+  gsl_vector *views = malloc(num_pixels * (sizeof *views));
+  if (data == NULL || views == NULL) {
+    free(data);
+    free(views);
+    return NULL;
+  }
+
+  RayImg *img = ray_create_img(width, height, channels);
+  for (int y = 0; y < height; y += 1) {
+    for (int x = 0; x < width; x += 1) {
+      size_t p = (size_t)y * width + x;
+      views[p] = gsl_vector_view_array(data + p * channels, channels).vector;
+      img->pixels[y][x] = &views[p];
+    }
+  }
+  // the fields are const once made, same as the rest
+  RayImg stack_img = {
+      .width = width,
+      .height = height,
+      .channels = channels,
+      .pixels = img->pixels,
+      .data = data,
+      .views = views,
+  };
+  memcpy(img, &stack_img, sizeof stack_img);
+
+  return img;
+}
+
 void ray_free_img(RayImg *img) {
+  if (img->data != NULL) {
+    free(img->data);
+    free(img->views);
+  }
   for (int y = 0; y < img->height; y += 1) {
-    for (int x = 0; x < img->width; x += 1) {
-      gsl_vector_free(img->pixels[y][x]);
+    if (img->data == NULL) {
+      for (int x = 0; x < img->width; x += 1) {
+        gsl_vector_free(img->pixels[y][x]);
+      }
     }
     free(img->pixels[y]);
   }
@@ -137,18 +222,52 @@ void ray_set_pixel(int x, int y, gsl_vector *color, RayImg *img) {
   img->pixels[y][x] = color;
 }
 
-bool ray_png_write(char const *filename, const RayImg *img) {
-  assert(filename != NULL && "filename cannot be null");
-  FILE *outfile = fopen(filename, "wb");
-  if (outfile == NULL) {
-    fprintf(stderr, "failed to open file \"%s\"\n", filename);
-    return false;
+void ray_img_pack_row(const RayImg *img, int y, unsigned char *row) {
+  for (int x = 0; x < img->width; ++x) {
+    gsl_vector *color = img->pixels[y][x];
+    assert(color != NULL && "null vector in image");
+    int row_x = img->channels * x;
+    for (int c = 0; c < img->channels; ++c) {
+      row[row_x + c] = (unsigned char)(gsl_vector_get(color, c) * UCHAR_MAX);
+    }
+  }
+}
+
+RayPngOptions ray_png_options(RAY_PNG_PRESET preset) {
+  switch (preset) {
+  case RAY_PNG_PRESET_fast:
+    return (RayPngOptions){
+        .compression_level = 1,
+        .filter = RAY_PNG_FILTER_sub,
+        .num_threads = 0,
+    };
+  case RAY_PNG_PRESET_small:
+    return (RayPngOptions){
+        .compression_level = 9,
+        .filter = RAY_PNG_FILTER_adaptive,
+        .num_threads = 1,
+    };
+  default:
+    return (RayPngOptions){
+        .compression_level = -1,
+        .filter = RAY_PNG_FILTER_adaptive,
+        .num_threads = 1,
+    };
   }
+}
+
+static int png_filter_flags(RAY_PNG_FILTER filter) {
+  return (filter == RAY_PNG_FILTER_none)  ? PNG_FILTER_NONE
+         : (filter == RAY_PNG_FILTER_sub) ? PNG_FILTER_SUB
+         : (filter == RAY_PNG_FILTER_up)  ? PNG_FILTER_UP
+                                          : PNG_ALL_FILTERS;
+}
 
+static bool write_with_libpng(FILE *outfile, const RayImg *img,
+                              const RayPngOptions *options) {
   png_structp png_ptr =
       png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
   if (png_ptr == NULL) {
-    fclose(outfile);
     fprintf(stderr, "png_create_write_struct failed\n");
     return false;
   }
@@ -156,16 +275,17 @@ bool ray_png_write(char const *filename, const RayImg *img) {
   png_infop info_ptr = png_create_info_struct(png_ptr);
   if (info_ptr == NULL) {
     png_destroy_write_struct(&png_ptr, NULL);
-    fclose(outfile);
     fprintf(stderr, "png_create_info_struct failed\n");
     return false;
   }
 
   png_init_io(png_ptr, outfile);
 
+  // volatile so it's still valid after a longjmp back here
+  png_bytep volatile row = NULL;
   if (setjmp(png_jmpbuf(png_ptr))) {
+    free(row);
     png_destroy_write_struct(&png_ptr, &info_ptr);
-    fclose(outfile);
     fprintf(stderr, "error during writing\n");
     return false;
   }
@@ -174,28 +294,56 @@ bool ray_png_write(char const *filename, const RayImg *img) {
                img->channels == 3 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY,
                PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
                PNG_FILTER_TYPE_BASE);
+  if (options->compression_level >= 0) {
+    png_set_compression_level(png_ptr, options->compression_level);
+  }
+  png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE,
+                 png_filter_flags(options->filter));
 
   png_write_info(png_ptr, info_ptr);
 
+  row = malloc(img->width * img->channels * (sizeof *row));
   for (int y = 0; y < img->height; ++y) {
-    png_bytep row = malloc(img->width * img->channels * (sizeof *row));
-    for (int x = 0; x < img->width; ++x) {
-      gsl_vector *color = img->pixels[y][x];
-      assert(color != NULL && "null vector in image");
-      int row_x = img->channels * x;
-      row[row_x] = (unsigned char)(gsl_vector_get(color, 0) * UCHAR_MAX);
-      row[row_x + 1] = (unsigned char)(gsl_vector_get(color, 1) * UCHAR_MAX);
-      row[row_x + 2] = (unsigned char)(gsl_vector_get(color, 2) * UCHAR_MAX);
-    }
+    ray_img_pack_row(img, y, row);
     png_write_row(png_ptr, row);
-    free(row);
   }
+  free(row);
 
   png_write_end(png_ptr, NULL);
 
   // cleanup
   png_destroy_write_struct(&png_ptr, &info_ptr);
-  fclose(outfile);
-
   return true;
 }
+
+bool ray_png_write(char const *filename, const RayImg *img) {
+  return ray_png_write_with_options(filename, img, NULL);
+}
+
+bool ray_png_write_with_options(char const *filename, const RayImg *img,
+                                const RayPngOptions *options) {
+  assert(filename != NULL && "filename cannot be null");
+  const RayPngOptions default_options =
+      ray_png_options(RAY_PNG_PRESET_default);
+  if (options == NULL) {
+    options = &default_options;
+  }
+
+  FILE *outfile = fopen(filename, "wb");
+  if (outfile == NULL) {
+    fprintf(stderr, "failed to open file \"%s\"\n", filename);
+    return false;
+  }
+
+  int num_threads = ray_png_resolve_threads(options->num_threads);
+  bool success = num_threads > 1 && img->height > 1
+                     ? ray_png_encode_parallel(outfile, img, options,
+                                               num_threads)
+                     : write_with_libpng(outfile, img, options);
+
+  if (fclose(outfile) != 0 && success) {
+    fprintf(stderr, "failed to write file \"%s\"\n", filename);
+    success = false;
+  }
+  return success;
+}
@@ -26,15 +26,15 @@ typedef bool (*intersect_fn)(const RayObject *, const RayRay *, double *);
 
 bool ray_sphere_intersects(const RayObject *sphere, const RayRay *ray,
                            double *distance) {
-  gsl_vector *l = gsl_vector_alloc(3);
-  gsl_vector_memcpy(l, sphere->center);
-  gsl_vector_sub(l, ray->origin);
+  double l_data[3];
+  gsl_vector l = gsl_vector_view_array(l_data, 3).vector;
+  gsl_vector_memcpy(&l, sphere->center);
+  gsl_vector_sub(&l, ray->origin);
   double adj;
-  gsl_blas_ddot(l, ray->direction, &adj);
+  gsl_blas_ddot(&l, ray->direction, &adj);
   double d2;
-  gsl_blas_ddot(l, l, &d2);
+  gsl_blas_ddot(&l, &l, &d2);
   d2 -= (adj * adj);
-  gsl_vector_free(l);
   double radius2 = sphere->radius * sphere->radius;
   if (d2 > radius2) {
     return false;
@@ -63,12 +63,12 @@ bool ray_plane_intersects(const RayObject *plane, const RayRay *ray,
   double denom;
   gsl_blas_ddot(plane->normal, ray->direction, &denom);
   if (denom > 1e-6) {
-    gsl_vector *v = gsl_vector_alloc(3);
-    gsl_vector_memcpy(v, plane->point);
-    gsl_vector_sub(v, ray->origin);
-    gsl_blas_ddot(v, plane->normal, distance);
+    double v_data[3];
+    gsl_vector v = gsl_vector_view_array(v_data, 3).vector;
+    gsl_vector_memcpy(&v, plane->point);
+    gsl_vector_sub(&v, ray->origin);
+    gsl_blas_ddot(&v, plane->normal, distance);
     *distance /= denom;
-    gsl_vector_free(v);
     if (*distance >= 0.0) {
       return true;
     }
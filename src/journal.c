@@ -0,0 +1,242 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for pread, ftruncate and fdatasync
+#define _POSIX_C_SOURCE 200809L
+
+#include "ray/journal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ray/hash.h"
+
+#define JOURNAL_MAGIC "RAYJRNL\1"
+#define JOURNAL_HEADER_SIZE 64
+
+typedef struct JournalHeader {
+  char magic[8];
+  uint32_t width;
+  uint32_t height;
+  uint32_t num_tiles;
+  uint32_t reserved;
+  uint64_t tiles_hash;
+  uint64_t key;
+  char padding[JOURNAL_HEADER_SIZE - 40];
+} JournalHeader;
+
+_Static_assert(sizeof(JournalHeader) == JOURNAL_HEADER_SIZE,
+               "journal header must be the size it says it is");
+
+typedef struct RecordHeader {
+  uint32_t tile;
+  uint32_t padding;
+  uint64_t hash;
+} RecordHeader;
+
+struct RayJournal {
+  int fd;
+  // where the next record goes, the end of the last whole one
+  off_t size;
+  const RayTile *tiles;
+  int num_tiles;
+  // big enough for a record of the largest tile
+  char *buffer;
+};
+
+static uint64_t hash_tiles(const RayTile *tiles, int num_tiles) {
+  uint64_t hash = RAY_HASH_SEED;
+  for (int t = 0; t < num_tiles; ++t) {
+    const int32_t fields[4] = {tiles[t].x, tiles[t].y, tiles[t].width,
+                               tiles[t].height};
+    hash = ray_hash_bytes(hash, fields, sizeof fields);
+  }
+  return hash;
+}
+
+static size_t tile_bytes(const RayTile *tile) {
+  return (size_t)tile->width * tile->height * RAY_FRAMEBUFFER_CHANNELS *
+         (sizeof(float));
+}
+
+static size_t row_bytes(const RayTile *tile) {
+  return (size_t)tile->width * RAY_FRAMEBUFFER_CHANNELS * (sizeof(float));
+}
+
+static bool write_all(int fd, const void *data, size_t size) {
+  const char *bytes = data;
+  while (size > 0) {
+    ssize_t written = write(fd, bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += written;
+    size -= (size_t)written;
+  }
+  return true;
+}
+
+static bool read_all_at(int fd, void *data, size_t size, off_t offset) {
+  char *bytes = data;
+  while (size > 0) {
+    ssize_t got = pread(fd, bytes, size, offset);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return false;
+    }
+    bytes += got;
+    size -= (size_t)got;
+    offset += got;
+  }
+  return true;
+}
+
+// copies every whole record's tile into fb, returning where the last one
+// ends
+static off_t replay(RayJournal *journal, RayFramebuffer *fb, bool *done) {
+  off_t offset = JOURNAL_HEADER_SIZE;
+  RecordHeader record;
+  while (read_all_at(journal->fd, &record, sizeof record, offset)) {
+    if (record.tile >= (uint32_t)journal->num_tiles) {
+      break;
+    }
+    const RayTile *tile = &journal->tiles[record.tile];
+    const size_t size = tile_bytes(tile);
+    if (!read_all_at(journal->fd, journal->buffer, size,
+                     offset + (off_t)sizeof record) ||
+        ray_hash_bytes(RAY_HASH_SEED, journal->buffer, size) != record.hash) {
+      break;
+    }
+    const char *row = journal->buffer;
+    for (int y = tile->y; y < tile->y + tile->height; ++y) {
+      memcpy(ray_framebuffer_pixel(fb, tile->x - fb->x, y - fb->y), row,
+             row_bytes(tile));
+      row += row_bytes(tile);
+    }
+    done[record.tile] = true;
+    offset += (off_t)(sizeof record + size);
+  }
+  return offset;
+}
+
+RayJournal *ray_open_journal(const char *path, uint64_t key, int width,
+                             int height, const RayTile *tiles, int num_tiles,
+                             RayFramebuffer *fb, bool *done) {
+  RayJournal *journal = malloc(sizeof *journal);
+  if (journal == NULL) {
+    return NULL;
+  }
+  size_t largest = 0;
+  for (int t = 0; t < num_tiles; ++t) {
+    largest = tile_bytes(&tiles[t]) > largest ? tile_bytes(&tiles[t])
+                                              : largest;
+    done[t] = false;
+  }
+  *journal = (RayJournal){
+      .fd = open(path, O_RDWR | O_CREAT, 0644),
+      .tiles = tiles,
+      .num_tiles = num_tiles,
+      .buffer = malloc(sizeof(RecordHeader) + largest),
+  };
+  if (journal->fd < 0 || journal->buffer == NULL) {
+    fprintf(stderr, "failed to open journal \"%s\"\n", path);
+    ray_close_journal(journal);
+    return NULL;
+  }
+
+  JournalHeader expected = {
+      .magic = JOURNAL_MAGIC,
+      .width = (uint32_t)width,
+      .height = (uint32_t)height,
+      .num_tiles = (uint32_t)num_tiles,
+      .tiles_hash = hash_tiles(tiles, num_tiles),
+      .key = key,
+  };
+  JournalHeader header;
+  if (read_all_at(journal->fd, &header, sizeof header, 0) &&
+      memcmp(&header, &expected, sizeof header) == 0) {
+    journal->size = replay(journal, fb, done);
+  } else {
+    journal->size = JOURNAL_HEADER_SIZE;
+    if (ftruncate(journal->fd, 0) != 0 ||
+        !write_all(journal->fd, &expected, sizeof expected)) {
+      fprintf(stderr, "failed to write journal \"%s\"\n", path);
+      ray_close_journal(journal);
+      return NULL;
+    }
+  }
+  // anything after the last whole record is a torn write
+  if (ftruncate(journal->fd, journal->size) != 0 ||
+      lseek(journal->fd, journal->size, SEEK_SET) != journal->size) {
+    fprintf(stderr, "failed to write journal \"%s\"\n", path);
+    ray_close_journal(journal);
+    return NULL;
+  }
+  return journal;
+}
+
+bool ray_journal_append(RayJournal *journal, const RayFramebuffer *fb,
+                        const int *tiles, int count) {
+  bool success = true;
+  for (int i = 0; i < count && success; ++i) {
+    const RayTile *tile = &journal->tiles[tiles[i]];
+    char *pixels = journal->buffer + sizeof(RecordHeader);
+    char *row = pixels;
+    for (int y = tile->y; y < tile->y + tile->height; ++y) {
+      memcpy(row, ray_framebuffer_pixel(fb, tile->x - fb->x, y - fb->y),
+             row_bytes(tile));
+      row += row_bytes(tile);
+    }
+    RecordHeader record = {
+        .tile = (uint32_t)tiles[i],
+        .hash = ray_hash_bytes(RAY_HASH_SEED, pixels, tile_bytes(tile)),
+    };
+    memcpy(journal->buffer, &record, sizeof record);
+    success = write_all(journal->fd, journal->buffer,
+                        sizeof record + tile_bytes(tile));
+  }
+  success = success && fdatasync(journal->fd) == 0;
+
+  if (success) {
+    journal->size = lseek(journal->fd, 0, SEEK_CUR);
+    return journal->size >= 0;
+  }
+  // drop whatever got written of this append so later ones follow on from
+  // the last whole record
+  if (ftruncate(journal->fd, journal->size) == 0) {
+    lseek(journal->fd, journal->size, SEEK_SET);
+  }
+  return false;
+}
+
+void ray_close_journal(RayJournal *journal) {
+  if (journal->fd >= 0) {
+    close(journal->fd);
+  }
+  free(journal->buffer);
+  free(journal);
+}
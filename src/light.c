@@ -25,39 +25,51 @@
 #include "gsl/gsl_math.h"
 #include "ray/vec_utils.h"
 
-typedef gsl_vector *(*direction_from_fn)(const RayLight *, gsl_vector *);
+typedef void (*direction_from_fn)(const RayLight *, const gsl_vector *,
+                                  gsl_vector *);
 
-gsl_vector *directional_direction_from(const RayLight *light,
-                                       gsl_vector *hit_point) {
-  gsl_vector *direction = gsl_vector_alloc(3);
+void ray_directional_light_direction_into(const RayLight *light,
+                                         const gsl_vector *hit_point,
+                                         gsl_vector *direction) {
   gsl_vector_memcpy(direction, light->direction);
   gsl_vector_scale(direction, -1.0);
   ray_vec_normalize(direction);
-  return direction;
 }
 
-gsl_vector *point_direction_from(const RayLight *light, gsl_vector *hit_point) {
-  gsl_vector *direction = gsl_vector_alloc(3);
+void ray_point_light_direction_into(const RayLight *light,
+                                   const gsl_vector *hit_point,
+                                   gsl_vector *direction) {
   gsl_vector_memcpy(direction, light->position);
   gsl_vector_sub(direction, hit_point);
   ray_vec_normalize(direction);
-  return direction;
 }
 
-gsl_vector *error_direction_from(const RayLight *light, gsl_vector *hit_point) {
+void error_direction_from(const RayLight *light, const gsl_vector *hit_point,
+                          gsl_vector *direction) {
   fprintf(stderr, "invalid light type in direction_from\n");
   exit(1);
 }
 
 direction_from_fn get_direction_from_fn(RAY_LIGHT_TYPE t) {
-  return (t == RAY_LIGHT_TYPE_directional) ? directional_direction_from
-         : (t == RAY_LIGHT_TYPE_point)     ? point_direction_from
-                                           : error_direction_from;
+  return (t == RAY_LIGHT_TYPE_directional)
+             ? ray_directional_light_direction_into
+         : (t == RAY_LIGHT_TYPE_point)  ? ray_point_light_direction_into
+         : (t == RAY_LIGHT_TYPE_rect)   ? ray_point_light_direction_into
+         : (t == RAY_LIGHT_TYPE_sphere) ? ray_point_light_direction_into
+                                        : error_direction_from;
+}
+
+void ray_light_direction_into(const RayLight *light,
+                              const gsl_vector *hit_point,
+                              gsl_vector *direction) {
+  get_direction_from_fn(light->type)(light, hit_point, direction);
 }
 
 gsl_vector *ray_light_direction_from(const RayLight *light,
                                      gsl_vector *hit_point) {
-  return get_direction_from_fn(light->type)(light, hit_point);
+  gsl_vector *direction = gsl_vector_alloc(3);
+  ray_light_direction_into(light, hit_point, direction);
+  return direction;
 }
 
 typedef double (*light_intensity_fn)(const RayLight *, gsl_vector *);
@@ -66,14 +78,13 @@ double directional_intensity(const RayLight *light, gsl_vector *hit_point) {
   return light->intensity;
 }
 
-double point_intensity(const RayLight *light, gsl_vector *hit_point) {
-  gsl_vector *direction = gsl_vector_alloc(3);
-  gsl_vector_memcpy(direction, light->position);
-  gsl_vector_sub(direction, hit_point);
-  double r = gsl_blas_dnrm2(
-      direction); // ? weirdly none without sqrt (I think?) (ineffecient?)a
-  gsl_vector_free(direction);
-  double r2 = r * r;
+double ray_point_light_intensity(const RayLight *light, gsl_vector *hit_point) {
+  double direction_data[3];
+  gsl_vector direction = gsl_vector_view_array(direction_data, 3).vector;
+  gsl_vector_memcpy(&direction, light->position);
+  gsl_vector_sub(&direction, hit_point);
+  double r2 = 0.0;
+  gsl_blas_ddot(&direction, &direction, &r2);
   return light->intensity / (4.0 * M_PI * r2);
 }
 
@@ -84,7 +95,9 @@ double error_intensity(const RayLight *light, gsl_vector *hit_point) {
 
 light_intensity_fn get_intensity_fn(RAY_LIGHT_TYPE t) {
   return (t == RAY_LIGHT_TYPE_directional) ? directional_intensity
-         : (t == RAY_LIGHT_TYPE_point)     ? point_intensity
+         : (t == RAY_LIGHT_TYPE_point)     ? ray_point_light_intensity
+         : (t == RAY_LIGHT_TYPE_rect)      ? ray_point_light_intensity
+         : (t == RAY_LIGHT_TYPE_sphere)    ? ray_point_light_intensity
                                            : error_intensity;
 }
 
@@ -98,13 +111,12 @@ double directional_distance(const RayLight *light, gsl_vector *hit_point) {
   return INFINITY;
 }
 
-double point_distance(const RayLight *light, gsl_vector *hit_point) {
-  gsl_vector *distance = gsl_vector_alloc(3);
-  gsl_vector_memcpy(distance, light->position);
-  gsl_vector_sub(distance, hit_point);
-  double len = gsl_blas_dnrm2(distance);
-  gsl_vector_free(distance);
-  return len;
+double ray_point_light_distance(const RayLight *light, gsl_vector *hit_point) {
+  double distance_data[3];
+  gsl_vector distance = gsl_vector_view_array(distance_data, 3).vector;
+  gsl_vector_memcpy(&distance, light->position);
+  gsl_vector_sub(&distance, hit_point);
+  return gsl_blas_dnrm2(&distance);
 }
 
 double error_distance(const RayLight *light, gsl_vector *hit_point) {
@@ -114,7 +126,9 @@ double error_distance(const RayLight *light, gsl_vector *hit_point) {
 
 light_distance_fn get_light_distance_fn(RAY_LIGHT_TYPE t) {
   return (t == RAY_LIGHT_TYPE_directional) ? directional_distance
-         : (t == RAY_LIGHT_TYPE_point)     ? point_distance
+         : (t == RAY_LIGHT_TYPE_point)     ? ray_point_light_distance
+         : (t == RAY_LIGHT_TYPE_rect)      ? ray_point_light_distance
+         : (t == RAY_LIGHT_TYPE_sphere)    ? ray_point_light_distance
                                            : error_distance;
 }
 
@@ -122,6 +136,129 @@ double ray_light_distance(const RayLight *light, gsl_vector *hit_point) {
   return get_light_distance_fn(light->type)(light, hit_point);
 }
 
+typedef double (*influence_radius_fn)(const RayLight *, double);
+
+double directional_influence_radius(const RayLight *light, double cutoff) {
+  return INFINITY;
+}
+
+double point_influence_radius(const RayLight *light, double cutoff) {
+  if (cutoff <= 0.0) {
+    return INFINITY;
+  }
+  // solve the point light intensity * brightest channel = cutoff for the
+  // distance
+  double power = light->intensity * gsl_vector_max(light->color);
+  return power > 0.0 ? sqrt(power / (4.0 * M_PI * cutoff)) : 0.0;
+}
+
+// samples can sit anywhere on the light, so pad by the furthest one can be
+// from the centre
+double rect_influence_radius(const RayLight *light, double cutoff) {
+  double corner_data[3];
+  gsl_vector corner = gsl_vector_view_array(corner_data, 3).vector;
+  gsl_vector_memcpy(&corner, light->u);
+  gsl_vector_add(&corner, light->v);
+  double diagonal = gsl_blas_dnrm2(&corner);
+  gsl_vector_memcpy(&corner, light->u);
+  gsl_vector_sub(&corner, light->v);
+  diagonal = fmax(diagonal, gsl_blas_dnrm2(&corner));
+  return point_influence_radius(light, cutoff) + diagonal / 2.0;
+}
+
+double sphere_influence_radius(const RayLight *light, double cutoff) {
+  return point_influence_radius(light, cutoff) + light->radius;
+}
+
+double error_influence_radius(const RayLight *light, double cutoff) {
+  fprintf(stderr, "invalid light type in influence radius fn\n");
+  exit(1);
+}
+
+influence_radius_fn get_influence_radius_fn(RAY_LIGHT_TYPE t) {
+  return (t == RAY_LIGHT_TYPE_directional) ? directional_influence_radius
+         : (t == RAY_LIGHT_TYPE_point)     ? point_influence_radius
+         : (t == RAY_LIGHT_TYPE_rect)      ? rect_influence_radius
+         : (t == RAY_LIGHT_TYPE_sphere)    ? sphere_influence_radius
+                                           : error_influence_radius;
+}
+
+double ray_light_influence_radius(const RayLight *light, double cutoff) {
+  return get_influence_radius_fn(light->type)(light, cutoff);
+}
+
+bool ray_light_is_area(const RayLight *light) {
+  return light->type == RAY_LIGHT_TYPE_rect ||
+         light->type == RAY_LIGHT_TYPE_sphere;
+}
+
+typedef void (*light_sample_fn)(const RayLight *, const gsl_vector *, double,
+                                double, gsl_vector *);
+
+void rect_sample(const RayLight *light, const gsl_vector *hit_point, double s,
+                 double t, gsl_vector *point) {
+  gsl_vector_memcpy(point, light->position);
+  gsl_blas_daxpy(s - 0.5, light->u, point);
+  gsl_blas_daxpy(t - 0.5, light->v, point);
+}
+
+// uniform over the hemisphere facing the hit point, the other half is hidden
+// behind the front anyway
+void sphere_sample(const RayLight *light, const gsl_vector *hit_point,
+                   double s, double t, gsl_vector *point) {
+  double w_data[3];
+  gsl_vector w = gsl_vector_view_array(w_data, 3).vector;
+  gsl_vector_memcpy(&w, hit_point);
+  gsl_vector_sub(&w, light->position);
+  if (gsl_blas_dnrm2(&w) == 0.0) {
+    gsl_vector_set(&w, 2, 1.0);
+  }
+  ray_vec_normalize(&w);
+
+  // any two unit vectors perpendicular to w and each other
+  double a_data[3] = {0.0, 0.0, 0.0};
+  gsl_vector a = gsl_vector_view_array(a_data, 3).vector;
+  a_data[fabs(w_data[0]) < 0.9 ? 0 : 1] = 1.0;
+  double u_data[3];
+  gsl_vector u = gsl_vector_view_array(u_data, 3).vector;
+  gsl_vector_memcpy(&u, &w);
+  ray_vec3_cross(&u, &a);
+  ray_vec_normalize(&u);
+  double v_data[3];
+  gsl_vector v = gsl_vector_view_array(v_data, 3).vector;
+  gsl_vector_memcpy(&v, &w);
+  ray_vec3_cross(&v, &u);
+
+  const double z = s;
+  const double r = sqrt(fmax(0.0, 1.0 - z * z));
+  const double phi = 2.0 * M_PI * t;
+  gsl_vector_memcpy(point, light->position);
+  gsl_blas_daxpy(light->radius * z, &w, point);
+  gsl_blas_daxpy(light->radius * r * cos(phi), &u, point);
+  gsl_blas_daxpy(light->radius * r * sin(phi), &v, point);
+}
+
+void error_sample(const RayLight *light, const gsl_vector *hit_point,
+                  double s, double t, gsl_vector *point) {
+  fprintf(stderr, "invalid light type in sample fn\n");
+  exit(1);
+}
+
+light_sample_fn get_light_sample_fn(RAY_LIGHT_TYPE t) {
+  return (t == RAY_LIGHT_TYPE_rect)     ? rect_sample
+         : (t == RAY_LIGHT_TYPE_sphere) ? sphere_sample
+                                        : error_sample;
+}
+
+void ray_light_sample_into(const RayLight *light, const gsl_vector *hit_point,
+                           int stratum, int side, double s, double t,
+                           gsl_vector *point) {
+  assert(side > 0 && stratum >= 0 && stratum < side * side);
+  s = (stratum % side + s) / side;
+  t = (stratum / side + t) / side;
+  get_light_sample_fn(light->type)(light, hit_point, s, t, point);
+}
+
 typedef void (*light_free_fn)(RayLight *light);
 
 void free_directional_light(RayLight *light) {
@@ -130,6 +267,12 @@ void free_directional_light(RayLight *light) {
 
 void free_point_light(RayLight *light) { gsl_vector_free(light->position); }
 
+void free_rect_light(RayLight *light) {
+  gsl_vector_free(light->position);
+  gsl_vector_free(light->u);
+  gsl_vector_free(light->v);
+}
+
 void free_error_light(RayLight *light) {
   fprintf(stderr, "invalid type of light free\n");
   exit(1);
@@ -138,6 +281,8 @@ void free_error_light(RayLight *light) {
 light_free_fn get_light_free_fn(RAY_LIGHT_TYPE t) {
   return (t == RAY_LIGHT_TYPE_directional) ? free_directional_light
          : (t == RAY_LIGHT_TYPE_point)     ? free_point_light
+         : (t == RAY_LIGHT_TYPE_rect)      ? free_rect_light
+         : (t == RAY_LIGHT_TYPE_sphere)    ? free_point_light
                                            : free_error_light;
 }
 
@@ -0,0 +1,229 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include "ray/light_tree.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LEAF_SIZE 4
+// median splits keep the tree balanced, so this is plenty
+#define MAX_DEPTH 64
+
+typedef struct BuildState {
+  RayLightTree *tree;
+  const double *radii;
+  // light positions, parallel to tree->order while building
+  double (*centers)[3];
+} BuildState;
+
+static void swap_lights(BuildState *state, int a, int b) {
+  int order = state->tree->order[a];
+  state->tree->order[a] = state->tree->order[b];
+  state->tree->order[b] = order;
+  double center[3];
+  memcpy(center, state->centers[a], sizeof center);
+  memcpy(state->centers[a], state->centers[b], sizeof center);
+  memcpy(state->centers[b], center, sizeof center);
+}
+
+// partially sort [start, end) along axis so that nth is in its sorted place
+// with nothing greater before it and nothing smaller after it
+static void select_nth(BuildState *state, int start, int end, int nth,
+                       int axis) {
+  while (end - start > 1) {
+    double pivot = state->centers[(start + end) / 2][axis];
+    int i = start;
+    int j = end - 1;
+    while (i <= j) {
+      while (state->centers[i][axis] < pivot) {
+        i += 1;
+      }
+      while (state->centers[j][axis] > pivot) {
+        j -= 1;
+      }
+      if (i <= j) {
+        swap_lights(state, i, j);
+        i += 1;
+        j -= 1;
+      }
+    }
+    if (nth <= j) {
+      end = j + 1;
+    } else if (nth >= i) {
+      start = i;
+    } else {
+      return;
+    }
+  }
+}
+
+static int build_node(BuildState *state, int start, int end) {
+  RayLightTree *tree = state->tree;
+  int index = tree->num_nodes;
+  tree->num_nodes += 1;
+  RayLightTreeNode *node = &tree->nodes[index];
+
+  double center_min[3] = {INFINITY, INFINITY, INFINITY};
+  double center_max[3] = {-INFINITY, -INFINITY, -INFINITY};
+  for (int a = 0; a < 3; ++a) {
+    node->min[a] = INFINITY;
+    node->max[a] = -INFINITY;
+  }
+  for (int i = start; i < end; ++i) {
+    double radius = state->radii[tree->order[i]];
+    for (int a = 0; a < 3; ++a) {
+      double c = state->centers[i][a];
+      node->min[a] = fmin(node->min[a], c - radius);
+      node->max[a] = fmax(node->max[a], c + radius);
+      center_min[a] = fmin(center_min[a], c);
+      center_max[a] = fmax(center_max[a], c);
+    }
+  }
+
+  if (end - start <= LEAF_SIZE) {
+    node->start = start;
+    node->count = end - start;
+    node->right = -1;
+    return index;
+  }
+
+  int axis = 0;
+  for (int a = 1; a < 3; ++a) {
+    if (center_max[a] - center_min[a] > center_max[axis] - center_min[axis]) {
+      axis = a;
+    }
+  }
+  int middle = start + (end - start) / 2;
+  select_nth(state, start, end, middle, axis);
+
+  node->start = start;
+  node->count = 0;
+  build_node(state, start, middle);
+  int right = build_node(state, middle, end);
+  tree->nodes[index].right = right;
+  return index;
+}
+
+bool ray_build_light_tree(const RayScene *scene, double cutoff,
+                          RayLightTree *tree) {
+  memset(tree, 0, sizeof *tree);
+  const int num_lights = scene->num_lights;
+  // every bounded light could end up in its own leaf
+  const int max_nodes = num_lights > 0 ? 2 * num_lights : 1;
+  const int capacity = num_lights > 0 ? num_lights : 1;
+  tree->radii = malloc(capacity * (sizeof *tree->radii));
+  tree->global = malloc(capacity * (sizeof *tree->global));
+  tree->order = malloc(capacity * (sizeof *tree->order));
+  tree->nodes = malloc(max_nodes * (sizeof *tree->nodes));
+  double(*centers)[3] = malloc(capacity * (sizeof *centers));
+  if (tree->radii == NULL || tree->global == NULL || tree->order == NULL ||
+      tree->nodes == NULL || centers == NULL) {
+    free(centers);
+    ray_free_light_tree(tree);
+    return false;
+  }
+
+  int num_bounded = 0;
+  for (int l = 0; l < num_lights; ++l) {
+    const RayLight *light = &scene->lights[l];
+    double radius = ray_light_influence_radius(light, cutoff);
+    tree->radii[l] = radius;
+    if (isinf(radius)) {
+      tree->global[tree->num_global] = l;
+      tree->num_global += 1;
+    } else {
+      tree->order[num_bounded] = l;
+      for (int a = 0; a < 3; ++a) {
+        centers[num_bounded][a] = gsl_vector_get(light->position, a);
+      }
+      num_bounded += 1;
+    }
+  }
+
+  if (num_bounded > 0) {
+    BuildState state = {
+        .tree = tree,
+        .radii = tree->radii,
+        .centers = centers,
+    };
+    build_node(&state, 0, num_bounded);
+  }
+
+  free(centers);
+  return true;
+}
+
+void ray_free_light_tree(RayLightTree *tree) {
+  free(tree->nodes);
+  free(tree->order);
+  free(tree->radii);
+  free(tree->global);
+  memset(tree, 0, sizeof *tree);
+}
+
+static bool node_contains(const RayLightTreeNode *node, const double *p) {
+  return p[0] >= node->min[0] && p[0] <= node->max[0] &&
+         p[1] >= node->min[1] && p[1] <= node->max[1] &&
+         p[2] >= node->min[2] && p[2] <= node->max[2];
+}
+
+int ray_light_tree_query(const RayLightTree *tree, const RayScene *scene,
+                         const gsl_vector *point, int *lights) {
+  int count = tree->num_global;
+  memcpy(lights, tree->global, count * (sizeof *lights));
+  if (tree->num_nodes == 0) {
+    return count;
+  }
+
+  const double p[3] = {
+      gsl_vector_get(point, 0),
+      gsl_vector_get(point, 1),
+      gsl_vector_get(point, 2),
+  };
+  int stack[MAX_DEPTH];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const RayLightTreeNode *node = &tree->nodes[stack[--top]];
+    if (!node_contains(node, p)) {
+      continue;
+    }
+    if (node->count == 0) {
+      const int left = (int)(node - tree->nodes) + 1;
+      stack[top++] = node->right;
+      stack[top++] = left;
+      continue;
+    }
+    for (int i = node->start; i < node->start + node->count; ++i) {
+      const int l = tree->order[i];
+      const gsl_vector *position = scene->lights[l].position;
+      double d2 = 0.0;
+      for (int a = 0; a < 3; ++a) {
+        double d = gsl_vector_get(position, a) - p[a];
+        d2 += d * d;
+      }
+      if (d2 <= tree->radii[l] * tree->radii[l]) {
+        lights[count] = l;
+        count += 1;
+      }
+    }
+  }
+  return count;
+}
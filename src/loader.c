@@ -16,17 +16,51 @@
 //  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 //  USA
 
+// for sysconf, strdup and stat
+#define _POSIX_C_SOURCE 200809L
+
 #include "ray/loader.h"
 
+#include <ctype.h>
 #include <errno.h>
 #include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "json-c/json.h"
 
+#include "ray/arena.h"
+#include "ray/hash.h"
 #include "ray/material.h"
-#include "ray/vec_utils.h"
+
+// textures aren't decoded as the json is walked, materials get an empty image
+// (or closed cached texture) per distinct path that's filled in once every
+// texture has been decoded (several at a time)
+typedef struct TextureLoads {
+  // NULL to decode textures whole
+  RayTextureCache *cache;
+  int count;
+  int capacity;
+  // point into the json, only valid until it's put, unless copy_paths is set
+  // (for when each part of the json is put as soon as it's loaded), in which
+  // case they're copied into the arena
+  bool copy_paths;
+  // set when a live scene will own the textures (and their paths, which are
+  // strduped) rather than the arena. the first first_new were already
+  // decoded by an earlier load
+  bool live;
+  int first_new;
+  const char **paths;
+  // whichever of these the cache calls for
+  RayImg **images;
+  RayCachedTexture **cached;
+} TextureLoads;
 
 static bool get_root_int(json_object *root, const char *key, int *val) {
   json_object *int_obj = json_object_object_get(root, key);
@@ -54,7 +88,8 @@ static bool get_obj_double(json_object *root, const char *key, double *val) {
   return true;
 }
 
-static gsl_vector *get_obj_vec3(json_object *obj, const char *key) {
+static gsl_vector *get_obj_vec3(json_object *obj, const char *key,
+                                RayArena *arena) {
   json_object *vec3_obj = json_object_object_get(obj, key);
   if (vec3_obj == NULL) {
     return NULL;
@@ -74,10 +109,11 @@ static gsl_vector *get_obj_vec3(json_object *obj, const char *key) {
   if (!success) {
     return NULL;
   }
-  return ray_create_vec3(x, y, z);
+  return ray_arena_create_vec3(arena, x, y, z);
 }
 
-static gsl_vector *get_obj_rgb(json_object *obj, const char *key) {
+static gsl_vector *get_obj_rgb(json_object *obj, const char *key,
+                               RayArena *arena) {
   json_object *vec3_obj = json_object_object_get(obj, key);
   if (vec3_obj == NULL) {
     return NULL;
@@ -97,12 +133,13 @@ static gsl_vector *get_obj_rgb(json_object *obj, const char *key) {
   if (!success) {
     return NULL;
   }
-  return ray_create_vec3(r, g, b);
+  return ray_arena_create_vec3(arena, r, g, b);
 }
 
 static bool get_obj_material_color_coloration(json_object *obj,
-                                              RayColoration *coloration) {
-  gsl_vector *color = get_obj_rgb(obj, "color");
+                                              RayColoration *coloration,
+                                              RayArena *arena) {
+  gsl_vector *color = get_obj_rgb(obj, "color", arena);
   if (color == NULL) {
     return false;
   }
@@ -114,21 +151,175 @@ static bool get_obj_material_color_coloration(json_object *obj,
   return true;
 }
 
+static void free_img_cleanup(void *img) { ray_free_img(img); }
+
+static void free_cached_texture_cleanup(void *texture) {
+  ray_free_cached_texture(texture);
+}
+
+static void texture_coloration(const TextureLoads *textures, int t,
+                               RayColoration *coloration) {
+  if (textures->cache != NULL) {
+    *coloration = (RayColoration){
+        .type = RAY_COLORATION_TYPE_cached_texture,
+        .cached_texture = textures->cached[t],
+    };
+  } else {
+    *coloration = (RayColoration){
+        .type = RAY_COLORATION_TYPE_texture,
+        .texture = textures->images[t],
+    };
+  }
+}
+
+// points coloration at the texture that will hold the one at path, the same
+// one every time the path comes up
+static bool add_texture_load(TextureLoads *textures, const char *path,
+                             RayColoration *coloration, RayArena *arena) {
+  for (int t = 0; t < textures->count; ++t) {
+    if (strcmp(textures->paths[t], path) == 0) {
+      texture_coloration(textures, t, coloration);
+      return true;
+    }
+  }
+
+  if (textures->count == textures->capacity) {
+    int capacity = textures->capacity > 0 ? textures->capacity * 2 : 8;
+    const char **paths =
+        realloc(textures->paths, capacity * (sizeof *textures->paths));
+    if (paths == NULL) {
+      return false;
+    }
+    textures->paths = paths;
+    RayImg **images =
+        realloc(textures->images, capacity * (sizeof *textures->images));
+    if (images == NULL) {
+      return false;
+    }
+    textures->images = images;
+    RayCachedTexture **cached =
+        realloc(textures->cached, capacity * (sizeof *textures->cached));
+    if (cached == NULL) {
+      return false;
+    }
+    textures->cached = cached;
+    textures->capacity = capacity;
+  }
+
+  // zeroed they're a valid empty image and a closed texture, so the cleanup
+  // is safe even if the texture never gets decoded
+  void *texture = textures->cache != NULL
+                      ? calloc(1, sizeof(RayCachedTexture))
+                      : calloc(1, sizeof(RayImg));
+  if (texture == NULL) {
+    return false;
+  }
+  void (*cleanup)(void *) = textures->cache != NULL
+                                ? free_cached_texture_cleanup
+                                : free_img_cleanup;
+  if (textures->live) {
+    path = strdup(path);
+    if (path == NULL) {
+      free(texture);
+      return false;
+    }
+  } else if (!ray_arena_add_cleanup(arena, cleanup, texture)) {
+    free(texture);
+    return false;
+  } else if (textures->copy_paths) {
+    size_t size = strlen(path) + 1;
+    char *copy = ray_arena_alloc(arena, size);
+    if (copy == NULL) {
+      return false;
+    }
+    path = memcpy(copy, path, size);
+  }
+  int t = textures->count;
+  textures->paths[t] = path;
+  textures->images[t] = textures->cache != NULL ? NULL : texture;
+  textures->cached[t] = textures->cache != NULL ? texture : NULL;
+  textures->count += 1;
+  texture_coloration(textures, t, coloration);
+  return true;
+}
+
 static bool get_obj_material_texture_coloration(json_object *obj,
-                                                RayColoration *coloration) {
+                                                RayColoration *coloration,
+                                                TextureLoads *textures,
+                                                RayArena *arena) {
   const char *tex_path = json_object_get_string(obj);
-  RayImg *img = ray_read_img(tex_path);
+  if (tex_path == NULL) {
+    return false;
+  }
+  return add_texture_load(textures, tex_path, coloration, arena);
+}
 
-  *coloration = (RayColoration){
-      .type = RAY_COLORATION_TYPE_texture,
-      .texture = img,
-  };
+typedef struct TextureDecode {
+  TextureLoads *textures;
+  atomic_int next;
+  atomic_bool failed;
+} TextureDecode;
 
-  return true;
+static void *decode_textures_range(void *voidDecode) {
+  TextureDecode *decode = voidDecode;
+  TextureLoads *textures = decode->textures;
+  for (int t = atomic_fetch_add(&decode->next, 1); t < textures->count;
+       t = atomic_fetch_add(&decode->next, 1)) {
+    if (textures->cache != NULL) {
+      // converting is the slow part, opening one that's already converted
+      // reads nothing but its header
+      if (!ray_texture_cache_open_into(textures->cache, textures->paths[t],
+                                       textures->cached[t])) {
+        atomic_store(&decode->failed, true);
+      }
+      continue;
+    }
+    RayImg *img = ray_read_img(textures->paths[t]);
+    if (img == NULL) {
+      atomic_store(&decode->failed, true);
+      continue;
+    }
+    // move it into the image the materials already point at
+    memcpy(textures->images[t], img, sizeof *img);
+    free(img);
+  }
+  return NULL;
+}
+
+// every texture is read on a thread of its own (up to one per cpu)
+static bool decode_textures(TextureLoads *textures) {
+  TextureDecode decode = {.textures = textures};
+  atomic_init(&decode.next, textures->first_new);
+  atomic_init(&decode.failed, false);
+
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  int num_threads = online > 0 ? (int)online : 1;
+  int num_new = textures->count - textures->first_new;
+  num_threads = num_threads < num_new ? num_threads : num_new;
+  pthread_t *threads = NULL;
+  if (num_threads > 1) {
+    threads = malloc((num_threads - 1) * (sizeof *threads));
+  }
+  // this thread decodes too, as do any threads that couldn't be started
+  int started = 0;
+  while (threads != NULL && started < num_threads - 1 &&
+         pthread_create(&threads[started], NULL, decode_textures_range,
+                        &decode) == 0) {
+    started += 1;
+  }
+  decode_textures_range(&decode);
+  for (int t = 0; t < started; ++t) {
+    pthread_join(threads[t], NULL);
+  }
+  free(threads);
+
+  return !atomic_load(&decode.failed);
 }
 
 static bool get_obj_material_coloration(json_object *obj,
-                                        RayColoration *coloration) {
+                                        RayColoration *coloration,
+                                        TextureLoads *textures,
+                                        RayArena *arena) {
   json_object *coloration_obj = json_object_object_get(obj, "coloration");
   if (coloration_obj == NULL) {
     return false;
@@ -136,12 +327,14 @@ static bool get_obj_material_coloration(json_object *obj,
 
   json_object *color_obj = json_object_object_get(coloration_obj, "color");
   if (color_obj != NULL) {
-    return get_obj_material_color_coloration(coloration_obj, coloration);
+    return get_obj_material_color_coloration(coloration_obj, coloration,
+                                             arena);
   }
 
   json_object *tex_obj = json_object_object_get(coloration_obj, "texture");
   if (tex_obj != NULL) {
-    return get_obj_material_texture_coloration(tex_obj, coloration);
+    return get_obj_material_texture_coloration(tex_obj, coloration, textures,
+                                               arena);
   }
 
   return false;
@@ -195,14 +388,16 @@ static bool get_surface_object(json_object *source, RaySurface *surface) {
   return false;
 }
 
-static bool get_obj_material(json_object *obj, RayMaterial *material) {
+static bool get_obj_material(json_object *obj, RayMaterial *material,
+                             TextureLoads *textures, RayArena *arena) {
   json_object *material_obj = json_object_object_get(obj, "material");
   if (material_obj == NULL) {
     return false;
   }
 
   RayColoration coloration;
-  bool success = get_obj_material_coloration(material_obj, &coloration);
+  bool success = get_obj_material_coloration(material_obj, &coloration,
+                                             textures, arena);
   if (!success) {
     return false;
   }
@@ -228,8 +423,9 @@ static bool get_obj_material(json_object *obj, RayMaterial *material) {
   return true;
 }
 
-static bool get_obj_sphere(json_object *sphere_obj, RayObject *sphere) {
-  gsl_vector *center = get_obj_vec3(sphere_obj, "center");
+static bool get_obj_sphere(json_object *sphere_obj, RayObject *sphere,
+                           TextureLoads *textures, RayArena *arena) {
+  gsl_vector *center = get_obj_vec3(sphere_obj, "center", arena);
   if (center == NULL) {
     return false;
   }
@@ -240,7 +436,7 @@ static bool get_obj_sphere(json_object *sphere_obj, RayObject *sphere) {
   }
 
   RayMaterial material;
-  success = get_obj_material(sphere_obj, &material);
+  success = get_obj_material(sphere_obj, &material, textures, arena);
   if (!success) {
     return false;
   }
@@ -254,19 +450,20 @@ static bool get_obj_sphere(json_object *sphere_obj, RayObject *sphere) {
   return true;
 }
 
-static bool get_obj_plane(json_object *plane_obj, RayObject *plane) {
-  gsl_vector *point = get_obj_vec3(plane_obj, "point");
+static bool get_obj_plane(json_object *plane_obj, RayObject *plane,
+                          TextureLoads *textures, RayArena *arena) {
+  gsl_vector *point = get_obj_vec3(plane_obj, "point", arena);
   if (point == NULL) {
     return false;
   }
 
-  gsl_vector *normal = get_obj_vec3(plane_obj, "normal");
+  gsl_vector *normal = get_obj_vec3(plane_obj, "normal", arena);
   if (normal == NULL) {
     return false;
   }
 
   RayMaterial material;
-  bool success = get_obj_material(plane_obj, &material);
+  bool success = get_obj_material(plane_obj, &material, textures, arena);
   if (!success) {
     return false;
   }
@@ -281,26 +478,33 @@ static bool get_obj_plane(json_object *plane_obj, RayObject *plane) {
   return true;
 }
 
-static bool get_scene_object(json_object *source, RayObject *object) {
+static bool get_scene_object(json_object *source, RayObject *object,
+                             TextureLoads *textures, RayArena *arena) {
   json_object *sphere_obj = json_object_object_get(source, "sphere");
   if (sphere_obj != NULL) {
-    return get_obj_sphere(sphere_obj, object);
+    return get_obj_sphere(sphere_obj, object, textures, arena);
   }
   json_object *plane_obj = json_object_object_get(source, "plane");
   if (plane_obj != NULL) {
-    return get_obj_plane(plane_obj, object);
+    return get_obj_plane(plane_obj, object, textures, arena);
   }
   return false;
 }
 
-static RayObject *get_scene_objects(json_object *source, int *num_objects) {
+static RayObject *get_scene_objects(json_object *source, int *num_objects,
+                                    TextureLoads *textures, RayArena *arena) {
   json_object *objects_obj = json_object_object_get(source, "objects");
   if (objects_obj == NULL ||
       !json_object_is_type(objects_obj, json_type_array)) {
     return NULL;
   }
   *num_objects = json_object_array_length(objects_obj);
-  RayObject *objects = malloc(*num_objects * (sizeof *objects));
+  RayObject *objects =
+      ray_arena_alloc(arena, *num_objects * (sizeof *objects));
+  if (objects == NULL) {
+    fprintf(stderr, "out of memory while loading objects\n");
+    return NULL;
+  }
   for (int i = 0; i < *num_objects; ++i) {
     json_object *object_obj = json_object_array_get_idx(objects_obj, i);
     if (object_obj == NULL) {
@@ -308,7 +512,7 @@ static RayObject *get_scene_objects(json_object *source, int *num_objects) {
     }
 
     RayObject object;
-    bool success = get_scene_object(object_obj, &object);
+    bool success = get_scene_object(object_obj, &object, textures, arena);
     if (!success) {
       return NULL;
     }
@@ -318,13 +522,14 @@ static RayObject *get_scene_objects(json_object *source, int *num_objects) {
   return objects;
 }
 
-static bool get_scene_point_light(json_object *light_obj, RayLight *light) {
-  gsl_vector *position = get_obj_vec3(light_obj, "position");
+static bool get_scene_point_light(json_object *light_obj, RayLight *light,
+                                  RayArena *arena) {
+  gsl_vector *position = get_obj_vec3(light_obj, "position", arena);
   if (position == NULL) {
     return false;
   }
 
-  gsl_vector *color = get_obj_rgb(light_obj, "color");
+  gsl_vector *color = get_obj_rgb(light_obj, "color", arena);
   if (color == NULL) {
     return false;
   }
@@ -346,13 +551,13 @@ static bool get_scene_point_light(json_object *light_obj, RayLight *light) {
 }
 
 static bool get_scene_directional_light(json_object *light_obj,
-                                        RayLight *light) {
-  gsl_vector *direction = get_obj_vec3(light_obj, "direction");
+                                        RayLight *light, RayArena *arena) {
+  gsl_vector *direction = get_obj_vec3(light_obj, "direction", arena);
   if (direction == NULL) {
     return false;
   }
 
-  gsl_vector *color = get_obj_rgb(light_obj, "color");
+  gsl_vector *color = get_obj_rgb(light_obj, "color", arena);
   if (color == NULL) {
     return false;
   }
@@ -373,30 +578,86 @@ static bool get_scene_directional_light(json_object *light_obj,
   return true;
 }
 
-static bool get_scene_light(json_object *light_obj, RayLight *light) {
+static bool get_scene_rect_light(json_object *light_obj, RayLight *light,
+                                 RayArena *arena) {
+  // point light fields give the centre, colour and intensity
+  if (!get_scene_point_light(light_obj, light, arena)) {
+    return false;
+  }
+
+  gsl_vector *u = get_obj_vec3(light_obj, "u", arena);
+  if (u == NULL) {
+    return false;
+  }
+
+  gsl_vector *v = get_obj_vec3(light_obj, "v", arena);
+  if (v == NULL) {
+    return false;
+  }
+
+  light->type = RAY_LIGHT_TYPE_rect;
+  light->u = u;
+  light->v = v;
+
+  return true;
+}
+
+static bool get_scene_sphere_light(json_object *light_obj, RayLight *light,
+                                   RayArena *arena) {
+  if (!get_scene_point_light(light_obj, light, arena)) {
+    return false;
+  }
+
+  double radius;
+  bool success = get_obj_double(light_obj, "radius", &radius);
+  if (!success || radius < 0.0) {
+    return false;
+  }
+
+  light->type = RAY_LIGHT_TYPE_sphere;
+  light->radius = radius;
+
+  return true;
+}
+
+static bool get_scene_light(json_object *light_obj, RayLight *light,
+                            RayArena *arena) {
   json_object *dir_obj = json_object_object_get(light_obj, "directional");
   if (dir_obj != NULL) {
-    return get_scene_directional_light(dir_obj, light);
+    return get_scene_directional_light(dir_obj, light, arena);
   }
   json_object *point_obj = json_object_object_get(light_obj, "point");
   if (point_obj != NULL) {
-    return get_scene_point_light(point_obj, light);
+    return get_scene_point_light(point_obj, light, arena);
+  }
+  json_object *rect_obj = json_object_object_get(light_obj, "rect");
+  if (rect_obj != NULL) {
+    return get_scene_rect_light(rect_obj, light, arena);
+  }
+  json_object *sphere_obj = json_object_object_get(light_obj, "sphere");
+  if (sphere_obj != NULL) {
+    return get_scene_sphere_light(sphere_obj, light, arena);
   }
   return false;
 }
 
-static RayLight *get_scene_lights(json_object *source, int *num_lights) {
+static RayLight *get_scene_lights(json_object *source, int *num_lights,
+                                  RayArena *arena) {
   json_object *lights_obj = json_object_object_get(source, "lights");
   if (lights_obj == NULL) {
     return NULL;
   }
 
   *num_lights = json_object_array_length(lights_obj);
-  RayLight *lights = malloc(*num_lights * (sizeof *lights));
+  RayLight *lights = ray_arena_alloc(arena, *num_lights * (sizeof *lights));
+  if (lights == NULL) {
+    fprintf(stderr, "out of memory while loading lights\n");
+    return NULL;
+  }
   for (int i = 0; i < *num_lights; ++i) {
     json_object *light_obj = json_object_array_get_idx(lights_obj, i);
     RayLight light;
-    bool success = get_scene_light(light_obj, &light);
+    bool success = get_scene_light(light_obj, &light, arena);
     if (!success) {
       return NULL;
     }
@@ -405,11 +666,9 @@ static RayLight *get_scene_lights(json_object *source, int *num_lights) {
   return lights;
 }
 
-bool ray_scene_from_file(const char *path, RayScene *scene) {
-  json_object *root = json_object_from_file(path);
-  if (root == NULL) {
-    return false;
-  }
+// everything but the objects and lights
+static bool get_scene_settings(json_object *root, RayScene *scene,
+                               RayArena *arena) {
   int width;
   bool success = get_root_int(root, "width", &width);
   if (!success) {
@@ -438,35 +697,941 @@ bool ray_scene_from_file(const char *path, RayScene *scene) {
     return false;
   }
 
-  gsl_vector *background = get_obj_rgb(root, "background");
+  gsl_vector *background = get_obj_rgb(root, "background", arena);
   if (background == NULL) {
     return false;
   }
 
+  *scene = (RayScene){
+      .width = width,
+      .height = height,
+      .fov = fov,
+      .shadow_bias = shadow_bias,
+      .max_recursion_depth = max_recursion_depth,
+      .background = background,
+      .arena = arena,
+  };
+  return true;
+}
+
+static bool get_scene(json_object *root, RayScene *scene,
+                      TextureLoads *textures, RayArena *arena) {
+  if (!get_scene_settings(root, scene, arena)) {
+    return false;
+  }
+
   int num_objects;
-  RayObject *objects = get_scene_objects(root, &num_objects);
+  RayObject *objects =
+      get_scene_objects(root, &num_objects, textures, arena);
   if (objects == NULL) {
     return false;
   }
 
   int num_lights;
-  RayLight *lights = get_scene_lights(root, &num_lights);
+  RayLight *lights = get_scene_lights(root, &num_lights, arena);
   if (lights == NULL) {
     return false;
   }
 
-  *scene = (RayScene){
-      .width = width,
-      .height = height,
-      .fov = fov,
-      .shadow_bias = shadow_bias,
-      .max_recursion_depth = max_recursion_depth,
-      .background = background,
-      .num_objects = num_objects,
-      .objects = objects,
-      .num_lights = num_lights,
-      .lights = lights,
-  };
+  scene->num_objects = num_objects;
+  scene->objects = objects;
+  scene->num_lights = num_lights;
+  scene->lights = lights;
+  return true;
+}
+
+bool ray_scene_from_file(const char *path, RayScene *scene) {
+  return ray_scene_from_file_with_cache(path, NULL, scene);
+}
+
+bool ray_scene_from_file_with_cache(const char *path, RayTextureCache *cache,
+                                    RayScene *scene) {
+  json_object *root = json_object_from_file(path);
+  if (root == NULL) {
+    return false;
+  }
+
+  // the scene owns the arena from here on, and if loading fails part way
+  // through whatever was already loaded goes with it
+  RayArena *arena = ray_create_arena(0);
+  if (arena == NULL) {
+    json_object_put(root);
+    return false;
+  }
+
+  TextureLoads textures = {.cache = cache};
+  bool success =
+      get_scene(root, scene, &textures, arena) && decode_textures(&textures);
+  if (!success) {
+    ray_free_arena(arena);
+  }
+  free(textures.paths);
+  free(textures.images);
+  free(textures.cached);
   json_object_put(root);
+  return success;
+}
+
+// the scene file as it's read, a chunk at a time. the buffer only has to
+// hold whatever single value is being parsed, so it only grows past a chunk
+// for objects or lights bigger than that
+typedef struct JsonStream {
+  FILE *file;
+  char *buffer;
+  // one byte is always kept free so a value can be terminated in place
+  size_t capacity;
+  // first byte not consumed yet
+  size_t start;
+  // one past the last byte read
+  size_t end;
+} JsonStream;
+
+#define STREAM_CHUNK (64 * 1024)
+
+// makes sure the byte offset past start has been read, moving what hasn't
+// been consumed to the front of the buffer (and growing it if that's not
+// enough room) first. false at the end of the file
+static bool stream_fill(JsonStream *stream, size_t offset) {
+  while (stream->start + offset >= stream->end) {
+    if (feof(stream->file) || ferror(stream->file)) {
+      return false;
+    }
+    if (stream->start > 0) {
+      memmove(stream->buffer, stream->buffer + stream->start,
+              stream->end - stream->start);
+      stream->end -= stream->start;
+      stream->start = 0;
+    }
+    if (stream->end + 1 >= stream->capacity) {
+      size_t capacity = stream->capacity * 2;
+      char *buffer = realloc(stream->buffer, capacity);
+      if (buffer == NULL) {
+        return false;
+      }
+      stream->buffer = buffer;
+      stream->capacity = capacity;
+    }
+    stream->end += fread(stream->buffer + stream->end, 1,
+                         stream->capacity - 1 - stream->end, stream->file);
+  }
+  return true;
+}
+
+// the next character that isn't whitespace, which isn't consumed. '\0' at
+// the end of the file
+static char stream_peek(JsonStream *stream) {
+  while (stream_fill(stream, 0)) {
+    char c = stream->buffer[stream->start];
+    if (!isspace((unsigned char)c)) {
+      return c;
+    }
+    stream->start += 1;
+  }
+  return '\0';
+}
+
+static bool stream_accept(JsonStream *stream, char c) {
+  if (stream_peek(stream) != c) {
+    return false;
+  }
+  stream->start += 1;
+  return true;
+}
+
+// length of the value at start (after stream_peek), which is in the buffer
+// once this returns. only the brackets and strings are followed, json-c
+// checks the rest. 0 if it's cut off
+static size_t stream_value_length(JsonStream *stream) {
+  int depth = 0;
+  bool in_string = false;
+  bool escaped = false;
+  for (size_t i = 0;; ++i) {
+    if (stream->start + i >= stream->end && !stream_fill(stream, i)) {
+      return 0;
+    }
+    char c = stream->buffer[stream->start + i];
+    if (in_string) {
+      if (escaped) {
+        escaped = false;
+      } else if (c == '\\') {
+        escaped = true;
+      } else if (c == '"') {
+        in_string = false;
+        if (depth == 0) {
+          return i + 1;
+        }
+      }
+      continue;
+    }
+    if (c == '"') {
+      in_string = true;
+    } else if (c == '{' || c == '[') {
+      depth += 1;
+    } else if (c == '}' || c == ']') {
+      if (depth == 0) {
+        // the end of a number or literal
+        return i;
+      }
+      depth -= 1;
+      if (depth == 0) {
+        return i + 1;
+      }
+    } else if (depth == 0 && (c == ',' || isspace((unsigned char)c))) {
+      return i;
+    }
+  }
+}
+
+// the value text is parsed as is, terminated in place. NULL if it isn't
+// valid json
+static json_object *parse_text(char *text, size_t length) {
+  char after = text[length];
+  text[length] = '\0';
+  json_object *value = json_tokener_parse(text);
+  text[length] = after;
+  return value;
+}
+
+// the next value parsed on its own, then consumed
+static json_object *stream_parse_value(JsonStream *stream) {
+  stream_peek(stream);
+  size_t length = stream_value_length(stream);
+  if (length == 0) {
+    return NULL;
+  }
+  json_object *value = parse_text(stream->buffer + stream->start, length);
+  stream->start += length;
+  return value;
+}
+
+static uint64_t hash_text(const char *text, size_t length) {
+  return ray_hash_bytes(RAY_HASH_SEED, text, length);
+}
+
+// elements of a json array, turned into count items of size bytes in a
+// malloced array that's grown as it goes
+typedef struct StreamArray {
+  void *items;
+  int count;
+  int capacity;
+} StreamArray;
+
+static void *stream_array_push(StreamArray *array, size_t size) {
+  if (array->count == array->capacity) {
+    int capacity = array->capacity > 0 ? array->capacity * 2 : 64;
+    void *items = realloc(array->items, capacity * size);
+    if (items == NULL) {
+      return NULL;
+    }
+    array->items = items;
+    array->capacity = capacity;
+  }
+  array->count += 1;
+  return (char *)array->items + (array->count - 1) * size;
+}
+
+// what a live scene remembers about each object, light and its settings so
+// the next load can tell which haven't changed without keeping their json
+typedef struct ElementRecord {
+  // of the element's text, exactly as it was in the file
+  uint64_t hash;
+  // the load it was parsed in, which owns its memory
+  int generation;
+} ElementRecord;
+
+// the previous load's records sorted by hash
+typedef struct ElementLookup {
+  uint64_t hash;
+  int index;
+} ElementLookup;
+
+static int compare_lookups(const void *voidA, const void *voidB) {
+  const ElementLookup *a = voidA;
+  const ElementLookup *b = voidB;
+  return (a->hash > b->hash) - (a->hash < b->hash);
+}
+
+// the records of one of the previous load's arrays, to find elements in.
+// the lookup is only sorted once something isn't where it was
+typedef struct PreviousElements {
+  const ElementRecord *records;
+  int count;
+  ElementLookup *lookup;
+} PreviousElements;
+
+// index of an element with the given hash, or -1
+static int find_previous(PreviousElements *previous, int index,
+                         uint64_t hash) {
+  // most edits leave everything else where it was
+  if (index < previous->count && previous->records[index].hash == hash) {
+    return index;
+  }
+  if (previous->lookup == NULL) {
+    previous->lookup =
+        malloc((previous->count + 1) * (sizeof *previous->lookup));
+    if (previous->lookup == NULL) {
+      return -1;
+    }
+    for (int i = 0; i < previous->count; ++i) {
+      previous->lookup[i] =
+          (ElementLookup){.hash = previous->records[i].hash, .index = i};
+    }
+    qsort(previous->lookup, previous->count, sizeof *previous->lookup,
+          compare_lookups);
+  }
+  ElementLookup key = {.hash = hash};
+  const ElementLookup *found =
+      bsearch(&key, previous->lookup, previous->count, sizeof key,
+              compare_lookups);
+  return found != NULL ? found->index : -1;
+}
+
+typedef struct LiveGeneration {
+  // NULL once nothing from it is left
+  RayArena *arena;
+  int refs;
+} LiveGeneration;
+
+typedef struct LiveTexture {
+  char *path;
+  RayImg *img;
+  struct timespec modified;
+} LiveTexture;
+
+struct RayLiveScene {
+  char *path;
+  // arena is NULL, ray_free_live_scene frees it
+  RayScene scene;
+  ElementRecord *object_records;
+  ElementRecord *light_records;
+  ElementRecord settings_record;
+  StreamArray generations;
+  StreamArray textures;
+};
+
+typedef struct SceneStream {
+  JsonStream json;
+  const RaySceneStreamHandlers *handlers;
+  TextureLoads *textures;
+  // what's parsed is loaded into this, for live scenes that's the arena of
+  // the new generation
+  RayArena *arena;
+  StreamArray objects;
+  StreamArray lights;
+  bool seen_objects;
+  bool seen_lights;
+  // "{" then every setting as it turned up, parsed as one object at the end
+  char *settings;
+  size_t settings_length;
+  size_t settings_capacity;
+
+  // set when reloading a live scene. elements with the same text as one in
+  // the previous load are copied from it rather than parsed again
+  const RayLiveScene *previous;
+  int generation;
+  PreviousElements previous_objects;
+  PreviousElements previous_lights;
+  StreamArray object_records;
+  StreamArray light_records;
+  ElementRecord settings_record;
+  // an element was copied from a different index than it's at now
+  bool moved;
+} SceneStream;
+
+// records the element for the live scene and finds it in the previous load.
+// previous is set to the index it was at there, or -1 if it has to be
+// parsed. false if out of memory
+static bool stream_record(SceneStream *stream, StreamArray *records,
+                          PreviousElements *previous_elements,
+                          const char *text, size_t length, int *previous) {
+  *previous = -1;
+  if (stream->generation < 0) {
+    return true;
+  }
+  ElementRecord *record = stream_array_push(records, sizeof *record);
+  if (record == NULL) {
+    return false;
+  }
+  record->hash = hash_text(text, length);
+  record->generation = stream->generation;
+  if (stream->previous != NULL) {
+    int index = records->count - 1;
+    *previous = find_previous(previous_elements, index, record->hash);
+    if (*previous >= 0) {
+      record->generation = previous_elements->records[*previous].generation;
+      stream->moved = stream->moved || *previous != index;
+    }
+  }
+  return true;
+}
+
+static bool stream_object(SceneStream *stream, char *text, size_t length) {
+  RayObject *object = stream_array_push(&stream->objects, sizeof *object);
+  int previous;
+  if (object == NULL ||
+      !stream_record(stream, &stream->object_records,
+                     &stream->previous_objects, text, length, &previous)) {
+    return false;
+  }
+  if (previous >= 0) {
+    *object = stream->previous->scene.objects[previous];
+  } else {
+    json_object *object_obj = parse_text(text, length);
+    bool success = object_obj != NULL &&
+                   get_scene_object(object_obj, object, stream->textures,
+                                    stream->arena);
+    if (object_obj != NULL) {
+      json_object_put(object_obj);
+    }
+    if (!success) {
+      return false;
+    }
+  }
+  const RaySceneStreamHandlers *handlers = stream->handlers;
+  if (handlers != NULL && handlers->on_object != NULL) {
+    handlers->on_object(object, stream->objects.count - 1, handlers->data);
+  }
+  return true;
+}
+
+static bool stream_light(SceneStream *stream, char *text, size_t length) {
+  RayLight *light = stream_array_push(&stream->lights, sizeof *light);
+  int previous;
+  if (light == NULL ||
+      !stream_record(stream, &stream->light_records, &stream->previous_lights,
+                     text, length, &previous)) {
+    return false;
+  }
+  if (previous >= 0) {
+    *light = stream->previous->scene.lights[previous];
+  } else {
+    json_object *light_obj = parse_text(text, length);
+    bool success = light_obj != NULL &&
+                   get_scene_light(light_obj, light, stream->arena);
+    if (light_obj != NULL) {
+      json_object_put(light_obj);
+    }
+    if (!success) {
+      return false;
+    }
+  }
+  const RaySceneStreamHandlers *handlers = stream->handlers;
+  if (handlers != NULL && handlers->on_light != NULL) {
+    handlers->on_light(light, stream->lights.count - 1, handlers->data);
+  }
+  return true;
+}
+
+// each element is loaded before the next one is read
+static bool stream_elements(SceneStream *stream,
+                            bool (*load)(SceneStream *, char *, size_t)) {
+  if (!stream_accept(&stream->json, '[')) {
+    return false;
+  }
+  if (stream_accept(&stream->json, ']')) {
+    return true;
+  }
+  do {
+    stream_peek(&stream->json);
+    size_t length = stream_value_length(&stream->json);
+    if (length == 0 ||
+        !load(stream, stream->json.buffer + stream->json.start, length)) {
+      return false;
+    }
+    stream->json.start += length;
+  } while (stream_accept(&stream->json, ','));
+  return stream_accept(&stream->json, ']');
+}
+
+static bool append_setting(SceneStream *stream, const char *key,
+                           const char *value, size_t value_length) {
+  size_t key_length = strlen(key);
+  // ,"key": then the value, with room left for the closing } and '\0'
+  size_t needed = stream->settings_length + key_length + value_length + 6;
+  if (needed > stream->settings_capacity) {
+    size_t capacity = needed * 2;
+    char *settings = realloc(stream->settings, capacity);
+    if (settings == NULL) {
+      return false;
+    }
+    stream->settings = settings;
+    stream->settings_capacity = capacity;
+  }
+  char *end = stream->settings + stream->settings_length;
+  end += sprintf(end, "%s\"%s\":", stream->settings_length > 1 ? "," : "",
+                 key);
+  memcpy(end, value, value_length);
+  end += value_length;
+  *end = '\0';
+  stream->settings_length = end - stream->settings;
+  return true;
+}
+
+static bool is_setting(const char *key) {
+  static const char *const settings[] = {
+      "width",
+      "height",
+      "fov",
+      "shadow-bias",
+      "max-recursion-depth",
+      "background",
+  };
+  for (size_t i = 0; i < (sizeof settings) / (sizeof *settings); ++i) {
+    if (strcmp(key, settings[i]) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// one member of the root object. the objects and lights are loaded as they
+// go by, settings are kept as text and anything else is skipped
+static bool stream_member(SceneStream *stream) {
+  json_object *key_obj = stream_parse_value(&stream->json);
+  const char *key =
+      key_obj != NULL && json_object_is_type(key_obj, json_type_string)
+          ? json_object_get_string(key_obj)
+          : NULL;
+  bool success = key != NULL && stream_accept(&stream->json, ':');
+  if (success && strcmp(key, "objects") == 0) {
+    stream->seen_objects = true;
+    success = stream_elements(stream, stream_object);
+  } else if (success && strcmp(key, "lights") == 0) {
+    stream->seen_lights = true;
+    success = stream_elements(stream, stream_light);
+  } else if (success) {
+    stream_peek(&stream->json);
+    size_t length = stream_value_length(&stream->json);
+    success = length > 0 &&
+              (!is_setting(key) ||
+               append_setting(stream, key,
+                              stream->json.buffer + stream->json.start,
+                              length));
+    stream->json.start += length;
+  }
+  if (key_obj != NULL) {
+    json_object_put(key_obj);
+  }
+  return success;
+}
+
+static bool stream_scene(SceneStream *stream, RayScene *scene) {
+  if (!stream_accept(&stream->json, '{')) {
+    return false;
+  }
+  if (!stream_accept(&stream->json, '}')) {
+    do {
+      if (!stream_member(stream)) {
+        return false;
+      }
+    } while (stream_accept(&stream->json, ','));
+    if (!stream_accept(&stream->json, '}')) {
+      return false;
+    }
+  }
+  if (!stream->seen_objects || !stream->seen_lights) {
+    return false;
+  }
+
+  strcat(stream->settings, "}");
+  stream->settings_record = (ElementRecord){
+      .hash = hash_text(stream->settings, strlen(stream->settings)),
+      .generation = stream->generation,
+  };
+  const RayLiveScene *previous = stream->previous;
+  if (previous != NULL &&
+      previous->settings_record.hash == stream->settings_record.hash) {
+    *scene = previous->scene;
+    stream->settings_record.generation =
+        previous->settings_record.generation;
+    return true;
+  }
+  json_object *settings = json_tokener_parse(stream->settings);
+  if (settings == NULL) {
+    return false;
+  }
+  bool success = get_scene_settings(settings, scene, stream->arena);
+  json_object_put(settings);
+  return success;
+}
+
+// the arrays go to the arena, shrunk to fit
+static bool stream_adopt_array(StreamArray *array, size_t size,
+                               RayArena *arena) {
+  if (array->count == 0) {
+    free(array->items);
+    array->items = NULL;
+    return true;
+  }
+  void *items = realloc(array->items, array->count * size);
+  if (items != NULL) {
+    array->items = items;
+  }
+  if (!ray_arena_add_cleanup(arena, free, array->items)) {
+    return false;
+  }
+  return true;
+}
+
+static bool stream_open(SceneStream *stream, const char *path) {
+  stream->json.file = fopen(path, "rb");
+  stream->json.buffer = malloc(STREAM_CHUNK);
+  stream->json.capacity = STREAM_CHUNK;
+  stream->settings = malloc(3);
+  stream->settings_capacity = 3;
+  if (stream->json.file == NULL || stream->json.buffer == NULL ||
+      stream->settings == NULL) {
+    return false;
+  }
+  strcpy(stream->settings, "{");
+  stream->settings_length = 1;
+  return true;
+}
+
+// true if the whole file was a scene
+static bool stream_close(SceneStream *stream, bool success) {
+  if (stream->json.file != NULL) {
+    // only whitespace can follow the scene
+    success = success && stream_peek(&stream->json) == '\0' &&
+              !ferror(stream->json.file);
+    fclose(stream->json.file);
+  }
+  free(stream->json.buffer);
+  free(stream->settings);
+  return success;
+}
+
+bool ray_scene_stream_from_file(const char *path, RayTextureCache *cache,
+                                const RaySceneStreamHandlers *handlers,
+                                RayScene *scene) {
+  RayArena *arena = ray_create_arena(0);
+  if (arena == NULL) {
+    return false;
+  }
+  TextureLoads textures = {.cache = cache, .copy_paths = true};
+  SceneStream stream = {
+      .handlers = handlers,
+      .textures = &textures,
+      .arena = arena,
+      .generation = -1,
+  };
+  bool success = stream_open(&stream, path);
+  success = stream_close(&stream, success && stream_scene(&stream, scene));
+
+  if (success &&
+      stream_adopt_array(&stream.objects, sizeof(RayObject), arena)) {
+    scene->num_objects = stream.objects.count;
+    scene->objects = stream.objects.items;
+  } else {
+    free(stream.objects.items);
+    success = false;
+  }
+  if (success &&
+      stream_adopt_array(&stream.lights, sizeof(RayLight), arena)) {
+    scene->num_lights = stream.lights.count;
+    scene->lights = stream.lights.items;
+  } else {
+    free(stream.lights.items);
+    success = false;
+  }
+
+  success = success && decode_textures(&textures);
+  if (!success) {
+    ray_free_arena(arena);
+  }
+  free(textures.paths);
+  free(textures.images);
+  free(textures.cached);
+  return success;
+}
+
+// the materials point at img, so the new pixels are moved into it and the
+// old ones go with replacement
+static void replace_img(RayImg *img, RayImg *replacement) {
+  unsigned char old[sizeof *img];
+  memcpy(old, img, sizeof *img);
+  memcpy(img, replacement, sizeof *img);
+  memcpy(replacement, old, sizeof *img);
+  ray_free_img(replacement);
+}
+
+static bool same_time(const struct timespec *a, const struct timespec *b) {
+  return a->tv_sec == b->tv_sec && a->tv_nsec == b->tv_nsec;
+}
+
+// textures whose png has changed since they were decoded are decoded again.
+// ones that can't be (e.g. the png is half written) keep what they had
+static int refresh_textures(RayLiveScene *live) {
+  int num_reloaded = 0;
+  LiveTexture *textures = live->textures.items;
+  for (int t = 0; t < live->textures.count; ++t) {
+    struct stat png_stat;
+    if (stat(textures[t].path, &png_stat) != 0 ||
+        same_time(&png_stat.st_mtim, &textures[t].modified)) {
+      continue;
+    }
+    RayImg *img = ray_read_img(textures[t].path);
+    if (img != NULL) {
+      replace_img(textures[t].img, img);
+      textures[t].modified = png_stat.st_mtim;
+      num_reloaded += 1;
+    }
+  }
+  return num_reloaded;
+}
+
+// the live scene's textures go first, so materials that use them again share
+// them and only new ones are decoded
+static bool preload_textures(const RayLiveScene *live,
+                             TextureLoads *textures) {
+  int count = live->textures.count;
+  int capacity = count > 8 ? count : 8;
+  textures->paths = malloc(capacity * (sizeof *textures->paths));
+  textures->images = malloc(capacity * (sizeof *textures->images));
+  textures->cached = malloc(capacity * (sizeof *textures->cached));
+  if (textures->paths == NULL || textures->images == NULL ||
+      textures->cached == NULL) {
+    return false;
+  }
+  const LiveTexture *live_textures = live->textures.items;
+  for (int t = 0; t < count; ++t) {
+    textures->paths[t] = live_textures[t].path;
+    textures->images[t] = live_textures[t].img;
+    textures->cached[t] = NULL;
+  }
+  textures->count = count;
+  textures->first_new = count;
+  textures->capacity = capacity;
+  return true;
+}
+
+static bool adopt_textures(RayLiveScene *live, TextureLoads *textures) {
+  for (int t = textures->first_new; t < textures->count; ++t) {
+    LiveTexture *texture =
+        stream_array_push(&live->textures, sizeof *texture);
+    if (texture == NULL) {
+      // the ones already adopted stay, the rest are freed with the load
+      textures->first_new = t;
+      return false;
+    }
+    struct stat png_stat;
+    *texture = (LiveTexture){
+        .path = (char *)textures->paths[t],
+        .img = textures->images[t],
+    };
+    if (stat(texture->path, &png_stat) == 0) {
+      texture->modified = png_stat.st_mtim;
+    }
+  }
+  textures->first_new = textures->count;
+  return true;
+}
+
+// textures nothing uses any more are freed
+static void drop_unused_textures(RayLiveScene *live) {
+  LiveTexture *textures = live->textures.items;
+  int kept = 0;
+  for (int t = 0; t < live->textures.count; ++t) {
+    bool used = false;
+    for (int i = 0; i < live->scene.num_objects && !used; ++i) {
+      const RayColoration *coloration =
+          &live->scene.objects[i].material.coloration;
+      used = coloration->type == RAY_COLORATION_TYPE_texture &&
+             coloration->texture == textures[t].img;
+    }
+    if (used) {
+      textures[kept++] = textures[t];
+    } else {
+      ray_free_img(textures[t].img);
+      free(textures[t].path);
+    }
+  }
+  live->textures.count = kept;
+}
+
+// counts what's left from each load and frees the ones nothing is left from
+static void release_generations(RayLiveScene *live) {
+  LiveGeneration *generations = live->generations.items;
+  for (int g = 0; g < live->generations.count; ++g) {
+    generations[g].refs = 0;
+  }
+  for (int i = 0; i < live->scene.num_objects; ++i) {
+    generations[live->object_records[i].generation].refs += 1;
+  }
+  for (int i = 0; i < live->scene.num_lights; ++i) {
+    generations[live->light_records[i].generation].refs += 1;
+  }
+  generations[live->settings_record.generation].refs += 1;
+  for (int g = 0; g < live->generations.count; ++g) {
+    if (generations[g].refs == 0 && generations[g].arena != NULL) {
+      ray_free_arena(generations[g].arena);
+      generations[g].arena = NULL;
+    }
+  }
+}
+
+static void free_stream_load(SceneStream *stream, TextureLoads *textures) {
+  for (int t = textures->first_new; t < textures->count; ++t) {
+    ray_free_img(textures->images[t]);
+    free((char *)textures->paths[t]);
+  }
+  free(textures->paths);
+  free(textures->images);
+  free(textures->cached);
+  free(stream->objects.items);
+  free(stream->lights.items);
+  free(stream->object_records.items);
+  free(stream->light_records.items);
+  free(stream->previous_objects.lookup);
+  free(stream->previous_lights.lookup);
+}
+
+static int *changed_indices(const ElementRecord *records, int count,
+                            int generation, int *num_changed) {
+  int *changed = malloc((count + 1) * (sizeof *changed));
+  *num_changed = 0;
+  for (int i = 0; changed != NULL && i < count; ++i) {
+    if (records[i].generation == generation) {
+      changed[(*num_changed)++] = i;
+    }
+  }
+  return changed;
+}
+
+bool ray_reload_live_scene(RayLiveScene *live, RaySceneChanges *changes) {
+  RaySceneChanges found = {0};
+
+  // everything parsed this time goes in a new generation
+  LiveGeneration *generation =
+      stream_array_push(&live->generations, sizeof *generation);
+  if (generation == NULL) {
+    return false;
+  }
+  *generation = (LiveGeneration){.arena = ray_create_arena(0)};
+  const int g = live->generations.count - 1;
+  const bool first = g == 0;
+
+  TextureLoads textures = {.live = true};
+  SceneStream stream = {
+      .textures = &textures,
+      .arena = generation->arena,
+      .previous = first ? NULL : live,
+      .generation = g,
+  };
+  if (!first) {
+    stream.previous_objects = (PreviousElements){
+        .records = live->object_records,
+        .count = live->scene.num_objects,
+    };
+    stream.previous_lights = (PreviousElements){
+        .records = live->light_records,
+        .count = live->scene.num_lights,
+    };
+  }
+  RayScene scene;
+  bool success = generation->arena != NULL &&
+                 preload_textures(live, &textures) &&
+                 stream_open(&stream, live->path);
+  success = stream_close(&stream, success && stream_scene(&stream, &scene));
+  success = success && decode_textures(&textures);
+
+  int num_objects = stream.objects.count;
+  int num_lights = stream.lights.count;
+  found.changed_objects =
+      success ? changed_indices(stream.object_records.items, num_objects, g,
+                                &found.num_changed_objects)
+              : NULL;
+  success = success && found.changed_objects != NULL &&
+            adopt_textures(live, &textures);
+  if (!success) {
+    free(found.changed_objects);
+    free_stream_load(&stream, &textures);
+    if (generation->arena != NULL) {
+      ray_free_arena(generation->arena);
+    }
+    live->generations.count -= 1;
+    return false;
+  }
+
+  const ElementRecord *light_records = stream.light_records.items;
+  for (int i = 0; i < num_lights; ++i) {
+    found.num_changed_lights += light_records[i].generation == g;
+  }
+  found.settings = stream.settings_record.generation == g;
+  found.moved = first || stream.moved ||
+                num_objects != live->scene.num_objects ||
+                num_lights != live->scene.num_lights;
+
+  free(live->scene.objects);
+  free(live->scene.lights);
+  free(live->object_records);
+  free(live->light_records);
+  scene.num_objects = num_objects;
+  scene.objects = stream.objects.items;
+  scene.num_lights = num_lights;
+  scene.lights = stream.lights.items;
+  scene.arena = NULL;
+  live->scene = scene;
+  live->object_records = stream.object_records.items;
+  live->light_records = stream.light_records.items;
+  live->settings_record = stream.settings_record;
+  stream.objects.items = NULL;
+  stream.lights.items = NULL;
+  stream.object_records.items = NULL;
+  stream.light_records.items = NULL;
+  free_stream_load(&stream, &textures);
+
+  release_generations(live);
+  drop_unused_textures(live);
+  // only now the file's known to be good, so a broken one doesn't leave the
+  // old scene with new textures. ones that were just decoded are up to date
+  found.num_reloaded_textures = refresh_textures(live);
+  if (changes != NULL) {
+    *changes = found;
+  } else {
+    ray_free_scene_changes(&found);
+  }
   return true;
 }
+
+RayLiveScene *ray_load_live_scene(const char *path) {
+  RayLiveScene *live = calloc(1, sizeof *live);
+  if (live == NULL) {
+    return NULL;
+  }
+  live->path = strdup(path);
+  if (live->path == NULL || !ray_reload_live_scene(live, NULL)) {
+    ray_free_live_scene(live);
+    return NULL;
+  }
+  return live;
+}
+
+RayScene *ray_live_scene(RayLiveScene *live) { return &live->scene; }
+
+void ray_free_scene_changes(RaySceneChanges *changes) {
+  free(changes->changed_objects);
+  changes->changed_objects = NULL;
+}
+
+void ray_free_live_scene(RayLiveScene *live) {
+  free(live->scene.objects);
+  free(live->scene.lights);
+  free(live->object_records);
+  free(live->light_records);
+  LiveGeneration *generations = live->generations.items;
+  for (int g = 0; g < live->generations.count; ++g) {
+    if (generations[g].arena != NULL) {
+      ray_free_arena(generations[g].arena);
+    }
+  }
+  free(generations);
+  LiveTexture *textures = live->textures.items;
+  for (int t = 0; t < live->textures.count; ++t) {
+    ray_free_img(textures[t].img);
+    free(textures[t].path);
+  }
+  free(textures);
+  free(live->path);
+  free(live);
+}
@@ -55,6 +55,12 @@ gsl_vector *texture_color_get(const RayColoration *coloration,
   return coloration->texture->pixels[tex_y][tex_x];
 }
 
+gsl_vector *cached_texture_color_get(const RayColoration *coloration,
+                                     RayTexCoord tex_coord) {
+  fprintf(stderr, "cached textures can only be sampled into a colour\n");
+  exit(1);
+}
+
 gsl_vector *error_color_get(const RayColoration *coloration, RayTexCoord tex_coord) {
   fprintf(stderr, "invalid coloration type in color get\n");
   exit(1);
@@ -63,7 +69,8 @@ gsl_vector *error_color_get(const RayColoration *coloration, RayTexCoord tex_coo
 color_get_fn get_color_get_fn(RAY_COLORATION_TYPE t) {
   return (t == RAY_COLORATION_TYPE_color)     ? color_color_get
          : (t == RAY_COLORATION_TYPE_texture) ? texture_color_get
-                                              : error_color_get;
+         : (t == RAY_COLORATION_TYPE_cached_texture) ? cached_texture_color_get
+                                                     : error_color_get;
 }
 
 gsl_vector *ray_coloration_color_get(const RayColoration *coloration,
@@ -81,6 +88,10 @@ void free_texture_coloration(RayColoration *coloration) {
   ray_free_img(coloration->texture);
 }
 
+void free_cached_texture_coloration(RayColoration *coloration) {
+  ray_free_cached_texture(coloration->cached_texture);
+}
+
 void free_error_coloration(RayColoration *coloration) {
   fprintf(stderr, "invalid coloration type in coloration free\n");
   exit(1);
@@ -89,7 +100,9 @@ void free_error_coloration(RayColoration *coloration) {
 free_coloration_fn get_free_coloration_fn(RAY_COLORATION_TYPE t) {
   return (t == RAY_COLORATION_TYPE_color)     ? free_color_coloration
          : (t == RAY_COLORATION_TYPE_texture) ? free_texture_coloration
-                                              : free_error_coloration;
+         : (t == RAY_COLORATION_TYPE_cached_texture)
+             ? free_cached_texture_coloration
+             : free_error_coloration;
 }
 
 void ray_free_coloration(RayColoration *coloration) {
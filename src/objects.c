@@ -40,55 +40,54 @@ bool probablyEqual(double a, double b) {
 typedef RayTexCoord (*tex_coord_fn)(const RayObject *, gsl_vector *);
 
 RayTexCoord sphere_tex_coord(const RayObject *sphere, gsl_vector *hit_point) {
-  gsl_vector *hit_vec = gsl_vector_alloc(3);
-  gsl_vector_memcpy(hit_vec, hit_point);
-  gsl_vector_sub(hit_vec, sphere->center);
+  double hit_x =
+      gsl_vector_get(hit_point, 0) - gsl_vector_get(sphere->center, 0);
+  double hit_y =
+      gsl_vector_get(hit_point, 1) - gsl_vector_get(sphere->center, 1);
+  double hit_z =
+      gsl_vector_get(hit_point, 2) - gsl_vector_get(sphere->center, 2);
   RayTexCoord coords = {
-      .x = (1.0 +
-            (atan2(gsl_vector_get(hit_vec, 2), gsl_vector_get(hit_vec, 0)) /
-             M_PI)) *
-           0.5,
-      .y = acos(gsl_vector_get(hit_vec, 1) / sphere->radius) / M_PI,
+      .x = (1.0 + (atan2(hit_z, hit_x) / M_PI)) * 0.5,
+      .y = acos(hit_y / sphere->radius) / M_PI,
   };
-  gsl_vector_free(hit_vec);
   return coords;
 }
 
 RayTexCoord plane_tex_coord(const RayObject *plane, gsl_vector *hit_point) {
-  gsl_vector *forward = ray_create_vec3(0.0, 0.0, 1.0);
-  gsl_vector *x_axis = gsl_vector_alloc(3);
-  gsl_vector_memcpy(x_axis, plane->normal);
-  ray_vec3_cross(x_axis, forward);
-  gsl_vector_free(forward);
-  double length = gsl_blas_dnrm2(x_axis);
+  // scratch vectors live on the stack, this runs for every shaded hit
+  double forward_data[3] = {0.0, 0.0, 1.0};
+  gsl_vector forward = gsl_vector_view_array(forward_data, 3).vector;
+  double x_axis_data[3];
+  gsl_vector x_axis = gsl_vector_view_array(x_axis_data, 3).vector;
+  gsl_vector_memcpy(&x_axis, plane->normal);
+  ray_vec3_cross(&x_axis, &forward);
+  double length = gsl_blas_dnrm2(&x_axis);
   if (probablyEqual(length, 0.0)) {
-    gsl_vector *up = ray_create_vec3(0.0, 1.0, 0.0);
-    gsl_vector_memcpy(x_axis, plane->normal);
-    ray_vec3_cross(x_axis, up);
-    gsl_vector_free(up);
+    double up_data[3] = {0.0, 1.0, 0.0};
+    gsl_vector up = gsl_vector_view_array(up_data, 3).vector;
+    gsl_vector_memcpy(&x_axis, plane->normal);
+    ray_vec3_cross(&x_axis, &up);
   }
 
-  gsl_vector *y_axis = gsl_vector_alloc(3);
-  gsl_vector_memcpy(y_axis, plane->normal);
-  ray_vec3_cross(y_axis, x_axis);
+  double y_axis_data[3];
+  gsl_vector y_axis = gsl_vector_view_array(y_axis_data, 3).vector;
+  gsl_vector_memcpy(&y_axis, plane->normal);
+  ray_vec3_cross(&y_axis, &x_axis);
 
-  gsl_vector *hit_vec = gsl_vector_alloc(3);
-  gsl_vector_memcpy(hit_vec, hit_point);
-  gsl_vector_sub(hit_vec, plane->point);
+  double hit_vec_data[3];
+  gsl_vector hit_vec = gsl_vector_view_array(hit_vec_data, 3).vector;
+  gsl_vector_memcpy(&hit_vec, hit_point);
+  gsl_vector_sub(&hit_vec, plane->point);
 
   double x = 0.0;
-  gsl_blas_ddot(hit_vec, x_axis, &x);
+  gsl_blas_ddot(&hit_vec, &x_axis, &x);
   double y = 0.0;
-  gsl_blas_ddot(hit_vec, y_axis, &y);
+  gsl_blas_ddot(&hit_vec, &y_axis, &y);
   RayTexCoord coord = {
       .x = x,
       .y = y,
   };
 
-  gsl_vector_free(hit_vec);
-  gsl_vector_free(x_axis);
-  gsl_vector_free(y_axis);
-
   return coord;
 }
 
@@ -108,6 +107,31 @@ RayTexCoord ray_object_tex_coord(const RayObject *object,
   return get_tex_coord_fn(object->type)(object, hit_point);
 }
 
+typedef double (*tex_scale_fn)(const RayObject *);
+
+// the whole texture wraps once around the equator
+double sphere_tex_scale(const RayObject *sphere) {
+  return 1.0 / (2.0 * M_PI * sphere->radius);
+}
+
+// plane texture coordinates are distances in the plane
+double plane_tex_scale(const RayObject *plane) { return 1.0; }
+
+double error_tex_scale(const RayObject *object) {
+  fprintf(stderr, "unknown object type to find the tex scale of\n");
+  exit(1);
+}
+
+tex_scale_fn get_tex_scale_fn(enum RAY_OBJECT_TYPE t) {
+  return (t == RAY_OBJECT_TYPE_sphere)  ? sphere_tex_scale
+         : (t == RAY_OBJECT_TYPE_plane) ? plane_tex_scale
+                                        : error_tex_scale;
+}
+
+double ray_object_tex_scale(const RayObject *object) {
+  return get_tex_scale_fn(object->type)(object);
+}
+
 typedef void (*obj_free_fn)(RayObject *);
 
 void free_sphere(RayObject *sphere) { gsl_vector_free(sphere->center); }
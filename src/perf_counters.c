@@ -0,0 +1,155 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for syscall
+#define _GNU_SOURCE
+
+#include "ray/perf_counters.h"
+
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char *ray_perf_counter_name(RAY_PERF_COUNTER counter) {
+  return (counter == RAY_PERF_COUNTER_cycles)          ? "cycles"
+         : (counter == RAY_PERF_COUNTER_instructions)  ? "instructions"
+         : (counter == RAY_PERF_COUNTER_l1d_misses)    ? "l1d-misses"
+         : (counter == RAY_PERF_COUNTER_llc_misses)    ? "llc-misses"
+         : (counter == RAY_PERF_COUNTER_branch_misses) ? "branch-misses"
+         : (counter == RAY_PERF_COUNTER_task_clock)    ? "task-clock"
+                                                       : "unknown";
+}
+
+#ifdef __linux__
+
+#define HW_CACHE_CONFIG(cache, op, result)                                     \
+  ((cache) | ((op) << 8) | ((result) << 16))
+
+static void counter_event(RAY_PERF_COUNTER counter, __u32 *type,
+                          __u64 *config) {
+  switch (counter) {
+  case RAY_PERF_COUNTER_cycles:
+    *type = PERF_TYPE_HARDWARE;
+    *config = PERF_COUNT_HW_CPU_CYCLES;
+    break;
+  case RAY_PERF_COUNTER_instructions:
+    *type = PERF_TYPE_HARDWARE;
+    *config = PERF_COUNT_HW_INSTRUCTIONS;
+    break;
+  case RAY_PERF_COUNTER_l1d_misses:
+    *type = PERF_TYPE_HW_CACHE;
+    *config =
+        HW_CACHE_CONFIG(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ,
+                        PERF_COUNT_HW_CACHE_RESULT_MISS);
+    break;
+  case RAY_PERF_COUNTER_llc_misses:
+    *type = PERF_TYPE_HARDWARE;
+    *config = PERF_COUNT_HW_CACHE_MISSES;
+    break;
+  case RAY_PERF_COUNTER_branch_misses:
+    *type = PERF_TYPE_HARDWARE;
+    *config = PERF_COUNT_HW_BRANCH_MISSES;
+    break;
+  default:
+    *type = PERF_TYPE_SOFTWARE;
+    *config = PERF_COUNT_SW_TASK_CLOCK;
+    break;
+  }
+}
+
+bool ray_open_perf_counters(RayPerfCounters *counters) {
+  counters->leader = -1;
+  counters->available = 0;
+  for (int c = 0; c < RAY_PERF_COUNTER_count; ++c) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    counter_event(c, &attr.type, &attr.config);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    // this thread only, on whichever cpu it's on
+    counters->fds[c] = (int)syscall(SYS_perf_event_open, &attr, 0, -1,
+                                    counters->leader, 0);
+    if (counters->fds[c] < 0) {
+      continue;
+    }
+    if (counters->leader < 0) {
+      counters->leader = counters->fds[c];
+    }
+    counters->available |= 1u << c;
+  }
+  return counters->available != 0;
+}
+
+bool ray_read_perf_counters(const RayPerfCounters *counters,
+                            uint64_t values[RAY_PERF_COUNTER_count]) {
+  memset(values, 0, RAY_PERF_COUNTER_count * sizeof *values);
+  // the number of counters in the group, then their values in the order
+  // they were opened
+  uint64_t group[1 + RAY_PERF_COUNTER_count];
+  ssize_t size = read(counters->leader, group, sizeof group);
+  if (size < (ssize_t)sizeof group[0] ||
+      (size_t)size < (1 + group[0]) * sizeof group[0]) {
+    return false;
+  }
+  uint64_t next = 0;
+  for (int c = 0; c < RAY_PERF_COUNTER_count && next < group[0]; ++c) {
+    if (counters->available & (1u << c)) {
+      values[c] = group[1 + next];
+      next += 1;
+    }
+  }
+  return true;
+}
+
+void ray_close_perf_counters(RayPerfCounters *counters) {
+  // members first, the leader holds the group together
+  for (int c = RAY_PERF_COUNTER_count - 1; c >= 0; --c) {
+    if (counters->fds[c] >= 0) {
+      close(counters->fds[c]);
+      counters->fds[c] = -1;
+    }
+  }
+  counters->leader = -1;
+  counters->available = 0;
+}
+
+#else // ifdef __linux__
+
+bool ray_open_perf_counters(RayPerfCounters *counters) {
+  for (int c = 0; c < RAY_PERF_COUNTER_count; ++c) {
+    counters->fds[c] = -1;
+  }
+  counters->leader = -1;
+  counters->available = 0;
+  return false;
+}
+
+bool ray_read_perf_counters(const RayPerfCounters *counters,
+                            uint64_t values[RAY_PERF_COUNTER_count]) {
+  memset(values, 0, RAY_PERF_COUNTER_count * sizeof *values);
+  return false;
+}
+
+void ray_close_perf_counters(RayPerfCounters *counters) {}
+
+#endif // ifdef __linux__
@@ -0,0 +1,353 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+// for sysconf
+#define _POSIX_C_SOURCE 200809L
+
+#include "ray/png_encoder.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "zlib.h"
+
+int ray_png_resolve_threads(int requested) {
+  if (requested > 0) {
+    return requested;
+  }
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  return online > 0 ? (int)online : 1;
+}
+
+enum {
+  FILTER_NONE = 0,
+  FILTER_SUB = 1,
+  FILTER_UP = 2,
+  FILTER_AVERAGE = 3,
+  FILTER_PAETH = 4,
+  NUM_FILTERS = 5,
+};
+
+static unsigned char paeth(unsigned char a, unsigned char b, unsigned char c) {
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  return (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+}
+
+// out gets the filter type byte then the filtered samples. prev is the
+// unfiltered row above (all zeroes for the first row), bpp the bytes per
+// pixel
+static void filter_row(int type, const unsigned char *row,
+                       const unsigned char *prev, size_t size, int bpp,
+                       unsigned char *out) {
+  out[0] = (unsigned char)type;
+  unsigned char *filtered = out + 1;
+  for (size_t i = 0; i < size; ++i) {
+    unsigned char left = i >= (size_t)bpp ? row[i - bpp] : 0;
+    unsigned char up = prev[i];
+    unsigned char up_left = i >= (size_t)bpp ? prev[i - bpp] : 0;
+    unsigned char predictor = (type == FILTER_SUB)       ? left
+                              : (type == FILTER_UP)      ? up
+                              : (type == FILTER_AVERAGE) ? (left + up) / 2
+                              : (type == FILTER_PAETH)
+                                  ? paeth(left, up, up_left)
+                                  : 0;
+    filtered[i] = (unsigned char)(row[i] - predictor);
+  }
+}
+
+// the usual heuristic (and libpng's), smallest sum of the filtered bytes
+// taken as signed
+static unsigned long filtered_cost(const unsigned char *filtered,
+                                   size_t size) {
+  unsigned long cost = 0;
+  for (size_t i = 0; i < size; ++i) {
+    cost += (unsigned long)abs((signed char)filtered[i]);
+  }
+  return cost;
+}
+
+typedef struct Band {
+  const RayImg *img;
+  const RayPngOptions *options;
+  int first_row;
+  int end_row;
+  bool last;
+  // deflated rows, ending in a sync flush or (for the last band) the end of
+  // the deflate stream
+  unsigned char *out;
+  size_t out_size;
+  size_t out_capacity;
+  // of the uncompressed (filtered) rows, to combine into the stream's
+  uLong adler;
+  uLong in_size;
+  bool success;
+  // false if it's encoded on the calling thread
+  bool threaded;
+  pthread_t thread;
+} Band;
+
+// deflate all of the stream's input, growing the output buffer as needed
+static bool deflate_into(z_stream *stream, Band *band, int flush) {
+  for (;;) {
+    if (stream->avail_out == 0) {
+      size_t capacity = band->out_capacity * 2 + 1024;
+      unsigned char *grown = realloc(band->out, capacity);
+      if (grown == NULL) {
+        return false;
+      }
+      band->out = grown;
+      band->out_capacity = capacity;
+      stream->next_out = grown + band->out_size;
+      stream->avail_out = (uInt)(capacity - band->out_size);
+    }
+    uInt avail_before = stream->avail_out;
+    int status = deflate(stream, flush);
+    band->out_size += avail_before - stream->avail_out;
+    if (status == Z_STREAM_ERROR) {
+      return false;
+    }
+    // anything left over would have filled the output
+    bool done = flush == Z_FINISH
+                    ? status == Z_STREAM_END
+                    : stream->avail_in == 0 && stream->avail_out > 0;
+    if (done) {
+      return true;
+    }
+  }
+}
+
+static void *encode_band(void *voidBand) {
+  Band *band = voidBand;
+  const RayImg *img = band->img;
+  const size_t size = (size_t)img->width * img->channels;
+  const int bpp = img->channels;
+
+  // two packed rows (this and the one above) and a filtered row per
+  // candidate filter
+  unsigned char *scratch = calloc(size * 2 + (size + 1) * NUM_FILTERS, 1);
+  z_stream stream = {0};
+  // raw deflate, the zlib header and checksum are written around the bands
+  if (scratch == NULL ||
+      deflateInit2(&stream, band->options->compression_level, Z_DEFLATED,
+                   -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    free(scratch);
+    band->success = false;
+    return NULL;
+  }
+  unsigned char *prev = scratch;
+  unsigned char *row = scratch + size;
+  unsigned char *filtered = scratch + size * 2;
+
+  // usually enough for the whole band in one go
+  const uLong in_size = (uLong)(band->end_row - band->first_row) * (size + 1);
+  band->out_capacity = deflateBound(&stream, in_size) + 64;
+  band->out = malloc(band->out_capacity);
+  band->out_size = 0;
+  stream.next_out = band->out;
+  stream.avail_out = band->out != NULL ? (uInt)band->out_capacity : 0;
+  band->out_capacity = band->out != NULL ? band->out_capacity : 0;
+  band->adler = adler32(0L, Z_NULL, 0);
+  band->in_size = 0;
+  bool success = true;
+  if (band->first_row > 0) {
+    ray_img_pack_row(img, band->first_row - 1, prev);
+  }
+  for (int y = band->first_row; y < band->end_row && success; ++y) {
+    ray_img_pack_row(img, y, row);
+
+    const unsigned char *chosen = filtered;
+    const RAY_PNG_FILTER filter = band->options->filter;
+    if (filter == RAY_PNG_FILTER_adaptive) {
+      unsigned long best = ULONG_MAX;
+      for (int type = 0; type < NUM_FILTERS; ++type) {
+        unsigned char *candidate = filtered + (size + 1) * type;
+        filter_row(type, row, prev, size, bpp, candidate);
+        unsigned long cost = filtered_cost(candidate + 1, size);
+        if (cost < best) {
+          best = cost;
+          chosen = candidate;
+        }
+      }
+    } else {
+      int type = (filter == RAY_PNG_FILTER_sub)  ? FILTER_SUB
+                 : (filter == RAY_PNG_FILTER_up) ? FILTER_UP
+                                                 : FILTER_NONE;
+      filter_row(type, row, prev, size, bpp, filtered);
+    }
+
+    band->adler = adler32(band->adler, chosen, (uInt)(size + 1));
+    band->in_size += size + 1;
+    stream.next_in = (unsigned char *)chosen;
+    stream.avail_in = (uInt)(size + 1);
+    success = deflate_into(&stream, band, Z_NO_FLUSH);
+
+    unsigned char *swap = prev;
+    prev = row;
+    row = swap;
+  }
+  success = success && deflate_into(&stream, band,
+                                    band->last ? Z_FINISH : Z_SYNC_FLUSH);
+
+  deflateEnd(&stream);
+  free(scratch);
+  band->success = success;
+  return NULL;
+}
+
+static void put_u32(unsigned char *out, uint32_t value) {
+  out[0] = (unsigned char)(value >> 24);
+  out[1] = (unsigned char)(value >> 16);
+  out[2] = (unsigned char)(value >> 8);
+  out[3] = (unsigned char)value;
+}
+
+// a chunk's data can come in two pieces so band output doesn't have to be
+// copied to add the zlib header or checksum
+static bool write_chunk(FILE *file, const char *type,
+                        const unsigned char *data, size_t size,
+                        const unsigned char *extra, size_t extra_size) {
+  if (size + extra_size > 0x7fffffff) {
+    return false;
+  }
+  unsigned char header[8];
+  put_u32(header, (uint32_t)(size + extra_size));
+  memcpy(header + 4, type, 4);
+  // crc32 starts over when given a null buffer
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, header + 4, 4);
+  if (size > 0) {
+    crc = crc32(crc, data, (uInt)size);
+  }
+  if (extra_size > 0) {
+    crc = crc32(crc, extra, (uInt)extra_size);
+  }
+  unsigned char trailer[4];
+  put_u32(trailer, (uint32_t)crc);
+  return fwrite(header, 1, 8, file) == 8 &&
+         fwrite(data, 1, size, file) == size &&
+         fwrite(extra, 1, extra_size, file) == extra_size &&
+         fwrite(trailer, 1, 4, file) == 4;
+}
+
+static bool write_stream(FILE *file, const RayImg *img, const Band *bands,
+                         int num_bands, int level) {
+  static const unsigned char signature[8] = {0x89, 'P',  'N',  'G',
+                                             '\r', '\n', 0x1a, '\n'};
+  unsigned char ihdr[13];
+  put_u32(ihdr, (uint32_t)img->width);
+  put_u32(ihdr + 4, (uint32_t)img->height);
+  ihdr[8] = 8;
+  ihdr[9] = img->channels == 3 ? 2 : 0;
+  // deflate compression, adaptive filtering, no interlacing
+  ihdr[10] = 0;
+  ihdr[11] = 0;
+  ihdr[12] = 0;
+  if (fwrite(signature, 1, 8, file) != 8 ||
+      !write_chunk(file, "IHDR", ihdr, 13, NULL, 0)) {
+    return false;
+  }
+
+  // a 32k window and the level hint, padded so the header is a multiple
+  // of 31
+  unsigned int level_hint =
+      level < 0 ? 2 : level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+  unsigned int header = (0x78u << 8) | (level_hint << 6);
+  header += (31 - header % 31) % 31;
+  unsigned char zlib_header[2] = {(unsigned char)(header >> 8),
+                                  (unsigned char)header};
+  if (!write_chunk(file, "IDAT", zlib_header, 2, NULL, 0)) {
+    return false;
+  }
+
+  uLong adler = adler32(0L, Z_NULL, 0);
+  for (int b = 0; b < num_bands; ++b) {
+    adler = adler32_combine(adler, bands[b].adler, (z_off_t)bands[b].in_size);
+    unsigned char checksum[4];
+    put_u32(checksum, (uint32_t)adler);
+    bool last = b == num_bands - 1;
+    if (!write_chunk(file, "IDAT", bands[b].out, bands[b].out_size, checksum,
+                     last ? 4 : 0)) {
+      return false;
+    }
+  }
+  return write_chunk(file, "IEND", NULL, 0, NULL, 0);
+}
+
+bool ray_png_encode_parallel(FILE *file, const RayImg *img,
+                             const RayPngOptions *options, int num_threads) {
+  int num_bands = num_threads < img->height ? num_threads : img->height;
+  num_bands = num_bands > 0 ? num_bands : 1;
+  Band *bands = calloc(num_bands, sizeof *bands);
+  if (bands == NULL) {
+    fprintf(stderr, "out of memory while encoding png\n");
+    return false;
+  }
+
+  const int rows_per_band = (img->height + num_bands - 1) / num_bands;
+  for (int b = 0; b < num_bands; ++b) {
+    int first_row = b * rows_per_band;
+    int end_row = first_row + rows_per_band;
+    bands[b] = (Band){
+        .img = img,
+        .options = options,
+        .first_row = first_row < img->height ? first_row : img->height,
+        .end_row = end_row < img->height ? end_row : img->height,
+        .last = b == num_bands - 1,
+    };
+  }
+
+  // the first band is done on this thread, and so is any band that didn't
+  // get a thread of its own
+  for (int b = 1; b < num_bands; ++b) {
+    bands[b].threaded =
+        pthread_create(&bands[b].thread, NULL, encode_band, &bands[b]) == 0;
+  }
+  for (int b = 0; b < num_bands; ++b) {
+    if (!bands[b].threaded) {
+      encode_band(&bands[b]);
+    }
+  }
+  bool success = true;
+  for (int b = 0; b < num_bands; ++b) {
+    if (bands[b].threaded) {
+      pthread_join(bands[b].thread, NULL);
+    }
+    success = success && bands[b].success;
+  }
+
+  if (success) {
+    success = write_stream(file, img, bands, num_bands,
+                           options->compression_level);
+  }
+  if (!success) {
+    fprintf(stderr, "error while encoding png\n");
+  }
+
+  for (int b = 0; b < num_bands; ++b) {
+    free(bands[b].out);
+  }
+  free(bands);
+  return success;
+}
@@ -0,0 +1,599 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include "ray/prepare.h"
+
+#include "ray/intersect.h"
+
+#include <math.h>
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gsl/gsl_math.h"
+
+// objects are intersected this many at a time, the distances go into a small
+// stack buffer before the (scalar) search for the closest
+#define KERNEL_CHUNK 64
+
+#define KERNEL_ALIGN 32
+
+static int round_up(int val, int multiple) {
+  return ((val + multiple - 1) / multiple) * multiple;
+}
+
+static ray_real *alloc_reals(int capacity) {
+  size_t size = capacity * sizeof(ray_real);
+  size = (size + KERNEL_ALIGN - 1) & ~(size_t)(KERNEL_ALIGN - 1);
+  // aligned_alloc can't be asked for 0 bytes portably
+  return aligned_alloc(KERNEL_ALIGN, size > 0 ? size : KERNEL_ALIGN);
+}
+
+static ray_real vec_real(const gsl_vector *vec, size_t i) {
+  return (ray_real)gsl_vector_get(vec, i);
+}
+
+static void prepare_sphere(RayPreparedScene *prepared, int sphere,
+                           const RayObject *object) {
+  prepared->sphere_x[sphere] = vec_real(object->center, 0);
+  prepared->sphere_y[sphere] = vec_real(object->center, 1);
+  prepared->sphere_z[sphere] = vec_real(object->center, 2);
+  prepared->sphere_radius2[sphere] =
+      (ray_real)(object->radius * object->radius);
+}
+
+static void prepare_plane(RayPreparedScene *prepared, int plane,
+                          const RayObject *object) {
+  prepared->plane_px[plane] = vec_real(object->point, 0);
+  prepared->plane_py[plane] = vec_real(object->point, 1);
+  prepared->plane_pz[plane] = vec_real(object->point, 2);
+  prepared->plane_nx[plane] = vec_real(object->normal, 0);
+  prepared->plane_ny[plane] = vec_real(object->normal, 1);
+  prepared->plane_nz[plane] = vec_real(object->normal, 2);
+}
+
+static unsigned object_features(const RayObject *object) {
+  const RayMaterial *material = &object->material;
+  unsigned features = 0;
+  if (object->type == RAY_OBJECT_TYPE_plane) {
+    features |= RAY_SCENE_FEATURE_planes;
+  }
+  if (material->coloration.type != RAY_COLORATION_TYPE_color) {
+    features |= RAY_SCENE_FEATURE_textures;
+  }
+  if (material->surface.type == RAY_SURFACE_TYPE_refractive) {
+    features |= RAY_SCENE_FEATURE_refraction;
+  }
+  return features;
+}
+
+static unsigned light_features(const RayScene *scene) {
+  for (int i = 0; i < scene->num_lights; ++i) {
+    if (scene->lights[i].type != RAY_LIGHT_TYPE_directional) {
+      return RAY_SCENE_FEATURE_local_lights;
+    }
+  }
+  return 0;
+}
+
+static void prepare_settings(RayPreparedScene *prepared) {
+  const RayScene *scene = prepared->scene;
+  prepared->pixel_spread = 0.0;
+  if (scene->height > 0) {
+    prepared->pixel_spread =
+        2.0 * tan(scene->fov * M_PI / 360.0) / (double)scene->height;
+  }
+}
+
+bool ray_prepare_scene(const RayScene *scene, double light_cutoff,
+                       RayPreparedScene *prepared) {
+  memset(prepared, 0, sizeof *prepared);
+  prepared->scene = scene;
+  prepare_settings(prepared);
+
+  int num_spheres = 0;
+  int num_planes = 0;
+  for (int i = 0; i < scene->num_objects; ++i) {
+    if (scene->objects[i].type == RAY_OBJECT_TYPE_sphere) {
+      num_spheres += 1;
+    } else if (scene->objects[i].type == RAY_OBJECT_TYPE_plane) {
+      num_planes += 1;
+    }
+  }
+
+  prepared->num_spheres = num_spheres;
+  prepared->sphere_capacity = round_up(num_spheres, RAY_REAL_LANES);
+  const int sphere_capacity = prepared->sphere_capacity;
+  prepared->sphere_x = alloc_reals(sphere_capacity);
+  prepared->sphere_y = alloc_reals(sphere_capacity);
+  prepared->sphere_z = alloc_reals(sphere_capacity);
+  prepared->sphere_radius2 = alloc_reals(sphere_capacity);
+  prepared->sphere_objects =
+      malloc((sphere_capacity + 1) * (sizeof *prepared->sphere_objects));
+
+  prepared->num_planes = num_planes;
+  prepared->plane_capacity = round_up(num_planes, RAY_REAL_LANES);
+  const int plane_capacity = prepared->plane_capacity;
+  prepared->plane_px = alloc_reals(plane_capacity);
+  prepared->plane_py = alloc_reals(plane_capacity);
+  prepared->plane_pz = alloc_reals(plane_capacity);
+  prepared->plane_nx = alloc_reals(plane_capacity);
+  prepared->plane_ny = alloc_reals(plane_capacity);
+  prepared->plane_nz = alloc_reals(plane_capacity);
+  prepared->plane_objects =
+      malloc((plane_capacity + 1) * (sizeof *prepared->plane_objects));
+  prepared->object_slots =
+      malloc((scene->num_objects + 1) * (sizeof *prepared->object_slots));
+
+  if (prepared->object_slots == NULL || prepared->sphere_x == NULL ||
+      prepared->sphere_y == NULL || prepared->sphere_z == NULL ||
+      prepared->sphere_radius2 == NULL || prepared->sphere_objects == NULL ||
+      prepared->plane_px == NULL || prepared->plane_py == NULL ||
+      prepared->plane_pz == NULL || prepared->plane_nx == NULL ||
+      prepared->plane_ny == NULL || prepared->plane_nz == NULL ||
+      prepared->plane_objects == NULL) {
+    ray_free_prepared_scene(prepared);
+    return false;
+  }
+
+  int sphere = 0;
+  int plane = 0;
+  prepared->features = light_features(scene);
+  for (int i = 0; i < scene->num_objects; ++i) {
+    const RayObject *object = &scene->objects[i];
+    prepared->features |= object_features(object);
+    if (object->type == RAY_OBJECT_TYPE_sphere) {
+      prepare_sphere(prepared, sphere, object);
+      prepared->sphere_objects[sphere] = i;
+      prepared->object_slots[i] = sphere;
+      sphere += 1;
+    } else if (object->type == RAY_OBJECT_TYPE_plane) {
+      prepare_plane(prepared, plane, object);
+      prepared->plane_objects[plane] = i;
+      prepared->object_slots[i] = plane;
+      plane += 1;
+    } else {
+      prepared->object_slots[i] = -1;
+    }
+  }
+
+  // padding: spheres with an infinitely negative squared radius and planes
+  // with a zero normal are always missed. -1 isn't enough for the sphere,
+  // transmission rays aren't normalised so d2 can go well below zero
+  for (; sphere < sphere_capacity; ++sphere) {
+    prepared->sphere_x[sphere] = 0;
+    prepared->sphere_y[sphere] = 0;
+    prepared->sphere_z[sphere] = 0;
+    prepared->sphere_radius2[sphere] = -RAY_REAL_INFINITY;
+    prepared->sphere_objects[sphere] = -1;
+  }
+  for (; plane < plane_capacity; ++plane) {
+    prepared->plane_px[plane] = 0;
+    prepared->plane_py[plane] = 0;
+    prepared->plane_pz[plane] = 0;
+    prepared->plane_nx[plane] = 0;
+    prepared->plane_ny[plane] = 0;
+    prepared->plane_nz[plane] = 0;
+    prepared->plane_objects[plane] = -1;
+  }
+
+  if (!ray_build_light_tree(scene, light_cutoff, &prepared->lights)) {
+    ray_free_prepared_scene(prepared);
+    return false;
+  }
+
+  return true;
+}
+
+void ray_free_prepared_scene(RayPreparedScene *prepared) {
+  free(prepared->sphere_x);
+  free(prepared->sphere_y);
+  free(prepared->sphere_z);
+  free(prepared->sphere_radius2);
+  free(prepared->sphere_objects);
+  free(prepared->plane_px);
+  free(prepared->plane_py);
+  free(prepared->plane_pz);
+  free(prepared->plane_nx);
+  free(prepared->plane_ny);
+  free(prepared->plane_nz);
+  free(prepared->plane_objects);
+  free(prepared->object_slots);
+  ray_free_light_tree(&prepared->lights);
+  memset(prepared, 0, sizeof *prepared);
+}
+
+bool ray_update_prepared_scene(RayPreparedScene *prepared,
+                               const int *changed_objects,
+                               int num_changed_objects, bool lights_changed,
+                               double light_cutoff) {
+  const RayScene *scene = prepared->scene;
+  prepare_settings(prepared);
+  for (int c = 0; c < num_changed_objects; ++c) {
+    int i = changed_objects[c];
+    int slot = prepared->object_slots[i];
+    const RayObject *object = &scene->objects[i];
+    prepared->features |= object_features(object);
+    // the slot it had is only any good if it's still the same kind of
+    // object
+    if (object->type == RAY_OBJECT_TYPE_sphere && slot >= 0 &&
+        slot < prepared->num_spheres && prepared->sphere_objects[slot] == i) {
+      prepare_sphere(prepared, slot, object);
+    } else if (object->type == RAY_OBJECT_TYPE_plane && slot >= 0 &&
+               slot < prepared->num_planes &&
+               prepared->plane_objects[slot] == i) {
+      prepare_plane(prepared, slot, object);
+    } else {
+      return false;
+    }
+  }
+  if (lights_changed) {
+    prepared->features |= light_features(scene);
+    ray_free_light_tree(&prepared->lights);
+    return ray_build_light_tree(scene, light_cutoff, &prepared->lights);
+  }
+  return true;
+}
+
+void ray_real_ray_from(RayRealRay *real_ray, const RayRay *ray) {
+  for (size_t i = 0; i < 3; ++i) {
+    real_ray->origin[i] = vec_real(ray->origin, i);
+    real_ray->direction[i] = vec_real(ray->direction, i);
+  }
+}
+
+// the kernels below are branch free so they vectorize, misses come out as
+// infinity. same maths as ray_sphere_intersects and ray_plane_intersects
+
+static void sphere_distances(const ray_real *restrict sx,
+                             const ray_real *restrict sy,
+                             const ray_real *restrict sz,
+                             const ray_real *restrict radius2, int count,
+                             const RayRealRay *ray,
+                             ray_real *restrict distances) {
+  const ray_real ox = ray->origin[0];
+  const ray_real oy = ray->origin[1];
+  const ray_real oz = ray->origin[2];
+  const ray_real dx = ray->direction[0];
+  const ray_real dy = ray->direction[1];
+  const ray_real dz = ray->direction[2];
+  for (int i = 0; i < count; ++i) {
+    ray_real lx = sx[i] - ox;
+    ray_real ly = sy[i] - oy;
+    ray_real lz = sz[i] - oz;
+    ray_real adj = lx * dx + ly * dy + lz * dz;
+    ray_real d2 = (lx * lx + ly * ly + lz * lz) - adj * adj;
+    ray_real disc = radius2[i] - d2;
+    ray_real thc = ray_real_sqrt(disc > 0 ? disc : 0);
+    ray_real i0 = adj - thc;
+    ray_real i1 = adj + thc;
+    ray_real t = i0 < 0 ? i1 : i0;
+    distances[i] = (disc < 0 || t < 0) ? RAY_REAL_INFINITY : t;
+  }
+}
+
+static void plane_distances(const ray_real *restrict px,
+                            const ray_real *restrict py,
+                            const ray_real *restrict pz,
+                            const ray_real *restrict nx,
+                            const ray_real *restrict ny,
+                            const ray_real *restrict nz, int count,
+                            const RayRealRay *ray,
+                            ray_real *restrict distances) {
+  const ray_real ox = ray->origin[0];
+  const ray_real oy = ray->origin[1];
+  const ray_real oz = ray->origin[2];
+  const ray_real dx = ray->direction[0];
+  const ray_real dy = ray->direction[1];
+  const ray_real dz = ray->direction[2];
+  for (int i = 0; i < count; ++i) {
+    ray_real denom = nx[i] * dx + ny[i] * dy + nz[i] * dz;
+    ray_real vx = px[i] - ox;
+    ray_real vy = py[i] - oy;
+    ray_real vz = pz[i] - oz;
+    ray_real along = vx * nx[i] + vy * ny[i] + vz * nz[i];
+    // dividing by a tiny (or zero) denominator is fine, it's thrown away
+    ray_real t = along / (denom > (ray_real)1e-6 ? denom : 1);
+    distances[i] =
+        (denom > (ray_real)1e-6 && t >= 0) ? t : RAY_REAL_INFINITY;
+  }
+}
+
+// whether a sphere or plane is in the way of a shadow ray before
+// max_distance, counting grazing (tangent) hits and hits right at
+// max_distance. every shadow ray test goes through these, one ray at a time,
+// in the cache check or across a batch, so they all agree on every ray
+static inline bool sphere_blocks(ray_real cx, ray_real cy, ray_real cz,
+                                 ray_real radius2, ray_real ox, ray_real oy,
+                                 ray_real oz, ray_real dx, ray_real dy,
+                                 ray_real dz, ray_real max_distance) {
+  ray_real lx = cx - ox;
+  ray_real ly = cy - oy;
+  ray_real lz = cz - oz;
+  ray_real adj = lx * dx + ly * dy + lz * dz;
+  ray_real d2 = (lx * lx + ly * ly + lz * lz) - adj * adj;
+  ray_real disc = radius2 - d2;
+  ray_real thc = ray_real_sqrt(disc > 0 ? disc : 0);
+  ray_real i0 = adj - thc;
+  ray_real i1 = adj + thc;
+  ray_real t = i0 < 0 ? i1 : i0;
+  return disc >= 0 && t >= 0 && t <= max_distance;
+}
+
+static inline bool plane_blocks(ray_real px, ray_real py, ray_real pz,
+                                ray_real nx, ray_real ny, ray_real nz,
+                                ray_real ox, ray_real oy, ray_real oz,
+                                ray_real dx, ray_real dy, ray_real dz,
+                                ray_real max_distance) {
+  ray_real denom = nx * dx + ny * dy + nz * dz;
+  ray_real along = (px - ox) * nx + (py - oy) * ny + (pz - oz) * nz;
+  ray_real t = along / (denom > (ray_real)1e-6 ? denom : 1);
+  return denom > (ray_real)1e-6 && t >= 0 && t <= max_distance;
+}
+
+static void closest_in_chunk(const ray_real *distances, const int *objects,
+                             int count, ray_real *best, int *best_object) {
+  for (int k = 0; k < count; ++k) {
+    if (distances[k] < *best) {
+      *best = distances[k];
+      *best_object = objects[k];
+    }
+  }
+}
+
+const RayObject *
+ray_prepared_closest_intersection(const RayPreparedScene *prepared,
+                                  const RayRay *ray, double *distance) {
+  RayRealRay real_ray;
+  ray_real_ray_from(&real_ray, ray);
+  alignas(KERNEL_ALIGN) ray_real distances[KERNEL_CHUNK];
+  ray_real best = RAY_REAL_INFINITY;
+  int best_object = -1;
+
+  for (int start = 0; start < prepared->sphere_capacity;
+       start += KERNEL_CHUNK) {
+    int left = prepared->sphere_capacity - start;
+    int count = left < KERNEL_CHUNK ? left : KERNEL_CHUNK;
+    sphere_distances(prepared->sphere_x + start, prepared->sphere_y + start,
+                     prepared->sphere_z + start,
+                     prepared->sphere_radius2 + start, count, &real_ray,
+                     distances);
+    closest_in_chunk(distances, prepared->sphere_objects + start, count,
+                     &best, &best_object);
+  }
+
+  for (int start = 0; start < prepared->plane_capacity;
+       start += KERNEL_CHUNK) {
+    int left = prepared->plane_capacity - start;
+    int count = left < KERNEL_CHUNK ? left : KERNEL_CHUNK;
+    plane_distances(prepared->plane_px + start, prepared->plane_py + start,
+                    prepared->plane_pz + start, prepared->plane_nx + start,
+                    prepared->plane_ny + start, prepared->plane_nz + start,
+                    count, &real_ray, distances);
+    closest_in_chunk(distances, prepared->plane_objects + start, count, &best,
+                     &best_object);
+  }
+
+  if (best_object < 0) {
+    if (distance != NULL) {
+      *distance = 0.0;
+    }
+    return NULL;
+  }
+  const RayObject *object = &prepared->scene->objects[best_object];
+  double best_distance = (double)best;
+#ifdef RAY_REAL_FLOAT
+  double refined;
+  // a grazing hit can come out as a miss in double, keep the float one then
+  if (ray_intersects(object, ray, &refined)) {
+    best_distance = refined;
+  }
+#endif
+  if (distance != NULL) {
+    *distance = best_distance;
+  }
+  return object;
+}
+
+// the first object in a chunk whose hit flag is set, or -1
+static int first_hit(const unsigned char *hits, const int *objects,
+                     int count) {
+  for (int k = 0; k < count; ++k) {
+    if (hits[k]) {
+      return objects[k];
+    }
+  }
+  return -1;
+}
+
+int ray_prepared_any_intersection(const RayPreparedScene *prepared,
+                                  const RayRay *ray, double max_distance) {
+  RayRealRay real_ray;
+  ray_real_ray_from(&real_ray, ray);
+  const ray_real *o = real_ray.origin;
+  const ray_real *d = real_ray.direction;
+  const ray_real max = (ray_real)max_distance;
+  unsigned char hits[KERNEL_CHUNK];
+
+  // planes first, they're the big occluders. padding never blocks anything
+  for (int start = 0; start < prepared->plane_capacity;
+       start += KERNEL_CHUNK) {
+    int left = prepared->plane_capacity - start;
+    int count = left < KERNEL_CHUNK ? left : KERNEL_CHUNK;
+    for (int k = 0; k < count; ++k) {
+      const int p = start + k;
+      hits[k] = plane_blocks(prepared->plane_px[p], prepared->plane_py[p],
+                             prepared->plane_pz[p], prepared->plane_nx[p],
+                             prepared->plane_ny[p], prepared->plane_nz[p],
+                             o[0], o[1], o[2], d[0], d[1], d[2], max);
+    }
+    int object = first_hit(hits, prepared->plane_objects + start, count);
+    if (object >= 0) {
+      return object;
+    }
+  }
+
+  for (int start = 0; start < prepared->sphere_capacity;
+       start += KERNEL_CHUNK) {
+    int left = prepared->sphere_capacity - start;
+    int count = left < KERNEL_CHUNK ? left : KERNEL_CHUNK;
+    for (int k = 0; k < count; ++k) {
+      const int s = start + k;
+      hits[k] = sphere_blocks(prepared->sphere_x[s], prepared->sphere_y[s],
+                              prepared->sphere_z[s],
+                              prepared->sphere_radius2[s], o[0], o[1], o[2],
+                              d[0], d[1], d[2], max);
+    }
+    int object = first_hit(hits, prepared->sphere_objects + start, count);
+    if (object >= 0) {
+      return object;
+    }
+  }
+
+  return -1;
+}
+
+bool ray_prepared_occludes(const RayPreparedScene *prepared, int object,
+                           const RayRay *ray, double max_distance) {
+  RayRealRay real_ray;
+  ray_real_ray_from(&real_ray, ray);
+  const ray_real *o = real_ray.origin;
+  const ray_real *d = real_ray.direction;
+  const ray_real max = (ray_real)max_distance;
+  const int slot = prepared->object_slots[object];
+  if (prepared->scene->objects[object].type == RAY_OBJECT_TYPE_sphere) {
+    return sphere_blocks(prepared->sphere_x[slot], prepared->sphere_y[slot],
+                         prepared->sphere_z[slot],
+                         prepared->sphere_radius2[slot], o[0], o[1], o[2],
+                         d[0], d[1], d[2], max);
+  }
+  return plane_blocks(prepared->plane_px[slot], prepared->plane_py[slot],
+                      prepared->plane_pz[slot], prepared->plane_nx[slot],
+                      prepared->plane_ny[slot], prepared->plane_nz[slot],
+                      o[0], o[1], o[2], d[0], d[1], d[2], max);
+}
+
+// one object against the first count rays of the batch, a zero stride on
+// the direction covers rays that all share one
+static void sphere_occludes(ray_real cx, ray_real cy, ray_real cz,
+                            ray_real radius2, RayShadowRays *rays, int count,
+                            int stride) {
+  const ray_real *restrict ox = rays->ox;
+  const ray_real *restrict oy = rays->oy;
+  const ray_real *restrict oz = rays->oz;
+  const ray_real *restrict dx = rays->dx;
+  const ray_real *restrict dy = rays->dy;
+  const ray_real *restrict dz = rays->dz;
+  const ray_real *restrict max_distance = rays->max_distance;
+  unsigned char *restrict hits = rays->hits;
+  for (int i = 0; i < count; ++i) {
+    hits[i] |= sphere_blocks(cx, cy, cz, radius2, ox[i], oy[i], oz[i],
+                             dx[i * stride], dy[i * stride], dz[i * stride],
+                             max_distance[i]);
+  }
+}
+
+static void plane_occludes(ray_real px, ray_real py, ray_real pz, ray_real nx,
+                           ray_real ny, ray_real nz, RayShadowRays *rays,
+                           int count, int stride) {
+  const ray_real *restrict ox = rays->ox;
+  const ray_real *restrict oy = rays->oy;
+  const ray_real *restrict oz = rays->oz;
+  const ray_real *restrict dx = rays->dx;
+  const ray_real *restrict dy = rays->dy;
+  const ray_real *restrict dz = rays->dz;
+  const ray_real *restrict max_distance = rays->max_distance;
+  unsigned char *restrict hits = rays->hits;
+  for (int i = 0; i < count; ++i) {
+    hits[i] |= plane_blocks(px, py, pz, nx, ny, nz, ox[i], oy[i], oz[i],
+                            dx[i * stride], dy[i * stride], dz[i * stride],
+                            max_distance[i]);
+  }
+}
+
+// record the blocked rays among the first count and move the rest to the
+// front, returns how many are left
+static int drop_occluded(RayShadowRays *rays, int count, int stride) {
+  int kept = 0;
+  for (int i = 0; i < count; ++i) {
+    if (rays->hits[i]) {
+      rays->occluded[rays->index[i]] = 1;
+      continue;
+    }
+    rays->ox[kept] = rays->ox[i];
+    rays->oy[kept] = rays->oy[i];
+    rays->oz[kept] = rays->oz[i];
+    rays->dx[kept * stride] = rays->dx[i * stride];
+    rays->dy[kept * stride] = rays->dy[i * stride];
+    rays->dz[kept * stride] = rays->dz[i * stride];
+    rays->max_distance[kept] = rays->max_distance[i];
+    rays->index[kept] = rays->index[i];
+    rays->hits[kept] = 0;
+    kept += 1;
+  }
+  return kept;
+}
+
+// objects tested between drops, dropping is about as expensive as a test
+#define DROP_INTERVAL 4
+
+void ray_prepared_occluded(const RayPreparedScene *prepared,
+                           RayShadowRays *rays) {
+  const int stride = rays->shared_direction ? 0 : 1;
+  int count = rays->count;
+  if (count <= 0) {
+    return;
+  }
+  for (int i = 0; i < count; ++i) {
+    rays->index[i] = i;
+  }
+  memset(rays->hits, 0, count);
+  memset(rays->occluded, 0, count);
+
+  // planes first, they're the big occluders. padding is skipped, there's no
+  // inner loop over objects to keep full
+  const int num_objects = prepared->num_planes + prepared->num_spheres;
+  for (int o = 0; o < num_objects && count > 0; ++o) {
+    if (o < prepared->num_planes) {
+      plane_occludes(prepared->plane_px[o], prepared->plane_py[o],
+                     prepared->plane_pz[o], prepared->plane_nx[o],
+                     prepared->plane_ny[o], prepared->plane_nz[o], rays,
+                     count, stride);
+    } else {
+      const int s = o - prepared->num_planes;
+      sphere_occludes(prepared->sphere_x[s], prepared->sphere_y[s],
+                      prepared->sphere_z[s], prepared->sphere_radius2[s], rays,
+                      count, stride);
+    }
+    if ((o + 1) % DROP_INTERVAL == 0 || o + 1 == num_objects) {
+      count = drop_occluded(rays, count, stride);
+    }
+  }
+}
+
+double ray_prepared_bias(const RayPreparedScene *prepared,
+                         const gsl_vector *hit_point) {
+  double magnitude = 0.0;
+  for (size_t i = 0; i < 3; ++i) {
+    double component = fabs(gsl_vector_get(hit_point, i));
+    magnitude = component > magnitude ? component : magnitude;
+  }
+  double bias = RAY_REAL_BIAS_SCALE * (1.0 + magnitude);
+  double scene_bias = prepared->scene->shadow_bias;
+  return bias > scene_bias ? bias : scene_bias;
+}
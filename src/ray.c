@@ -28,7 +28,7 @@ void ray_ray_free(RayRay ray) {
   gsl_vector_free(ray.direction);
 }
 
-RayRay ray_create_prime_ray(int x, int y, const RayScene *scene) {
+void ray_prime_ray_into(RayRay *ray, int x, int y, const RayScene *scene) {
   double fov_rad = scene->fov * M_PI / 180.0;
   double fov_adjust = tan(fov_rad / 2.0);
   double aspect_ratio = (double)scene->width / (double)scene->height;
@@ -38,42 +38,57 @@ RayRay ray_create_prime_ray(int x, int y, const RayScene *scene) {
   double sensor_y =
       (1.0 - (((double)y + 0.5) / (double)scene->height) * 2.0) * fov_adjust;
 
-  gsl_vector *origin = gsl_vector_calloc(3);
-  gsl_vector *direction = ray_create_vec3(sensor_x, sensor_y, -1.0);
+  gsl_vector_set_zero(ray->origin);
+  gsl_vector *direction = ray->direction;
+  gsl_vector_set(direction, 0, sensor_x);
+  gsl_vector_set(direction, 1, sensor_y);
+  gsl_vector_set(direction, 2, -1.0);
   double inverse_length = 1.0 / gsl_blas_dnrm2(direction);
   gsl_vector_scale(direction, inverse_length);
+}
+
+RayRay ray_create_prime_ray(int x, int y, const RayScene *scene) {
   RayRay ray = {
-      .origin = origin,
-      .direction = direction,
+      .origin = gsl_vector_alloc(3),
+      .direction = gsl_vector_alloc(3),
   };
+  ray_prime_ray_into(&ray, x, y, scene);
   return ray;
 }
 
-RayRay ray_create_reflection(gsl_vector *normal, gsl_vector *incident,
-                             gsl_vector *intersection, double bias) {
-  gsl_vector *origin = gsl_vector_alloc(3);
+void ray_reflection_into(RayRay *ray, const gsl_vector *normal,
+                         const gsl_vector *incident,
+                         const gsl_vector *intersection, double bias) {
+  gsl_vector *origin = ray->origin;
   gsl_vector_memcpy(origin, normal);
   gsl_vector_scale(origin, bias);
   gsl_vector_add(origin, intersection);
 
   double norm_dot_incident = 0.0;
   gsl_blas_ddot(incident, normal, &norm_dot_incident);
-  gsl_vector *direction = gsl_vector_alloc(3);
+  gsl_vector *direction = ray->direction;
   gsl_vector_memcpy(direction, normal);
   gsl_vector_scale(direction, -2.0 * norm_dot_incident);
   gsl_vector_add(direction, incident);
+}
 
+RayRay ray_create_reflection(gsl_vector *normal, gsl_vector *incident,
+                             gsl_vector *intersection, double bias) {
   RayRay ray = {
-      .origin = origin,
-      .direction = direction,
+      .origin = gsl_vector_alloc(3),
+      .direction = gsl_vector_alloc(3),
   };
+  ray_reflection_into(&ray, normal, incident, intersection, bias);
   return ray;
 }
 
-bool ray_create_transmission(RayRay *ray, gsl_vector *normal,
-                             gsl_vector *incident, gsl_vector *intersection,
-                             double bias, double iof_t) {
-  gsl_vector *refrac_n = gsl_vector_alloc(3);
+bool ray_transmission_into(RayRay *ray, const gsl_vector *normal,
+                           const gsl_vector *incident,
+                           const gsl_vector *intersection, double bias,
+                           double iof_t) {
+  double refrac_n_data[3];
+  gsl_vector refrac_n_view = gsl_vector_view_array(refrac_n_data, 3).vector;
+  gsl_vector *refrac_n = &refrac_n_view;
   gsl_vector_memcpy(refrac_n, normal);
   double iof_i = RAY_IOF_I;
   double i_dot_n;
@@ -91,16 +106,15 @@ bool ray_create_transmission(RayRay *ray, gsl_vector *normal,
   double iof = iof_i / iof_t;
   double k = 1.0 - ((iof * iof) * (1.0 - (i_dot_n * i_dot_n)));
   if (k < 0.0) {
-    gsl_vector_free(refrac_n);
     return false;
   }
 
-  gsl_vector *origin = gsl_vector_alloc(3);
+  gsl_vector *origin = ray->origin;
   gsl_vector_memcpy(origin, refrac_n);
   gsl_vector_scale(origin, -bias);
   gsl_vector_add(origin, intersection);
 
-  gsl_vector *direction = gsl_vector_alloc(3);
+  gsl_vector *direction = ray->direction;
   gsl_vector_memcpy(direction, refrac_n);
   gsl_vector_scale(direction, i_dot_n);
   gsl_vector_add(direction, incident);
@@ -111,11 +125,21 @@ bool ray_create_transmission(RayRay *ray, gsl_vector *normal,
 
   gsl_vector_sub(direction, refrac_n);
 
-  *ray = (RayRay){
-      .origin = origin,
-      .direction = direction,
-  };
+  return true;
+}
 
-  gsl_vector_free(refrac_n);
+bool ray_create_transmission(RayRay *ray, gsl_vector *normal,
+                             gsl_vector *incident, gsl_vector *intersection,
+                             double bias, double iof) {
+  RayRay transmission = {
+      .origin = gsl_vector_alloc(3),
+      .direction = gsl_vector_alloc(3),
+  };
+  if (!ray_transmission_into(&transmission, normal, incident, intersection,
+                             bias, iof)) {
+    ray_ray_free(transmission);
+    return false;
+  }
+  *ray = transmission;
   return true;
 }
@@ -16,49 +16,116 @@
 //  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 //  USA
 
+// for clock_gettime and sysconf
+#define _POSIX_C_SOURCE 200809L
+
 #include "ray/render.h"
 
 #include <assert.h>
 #include <pthread.h>
+#include <stdalign.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "gsl/gsl_blas.h"
 #include "gsl/gsl_math.h"
 
+#include "ray/context.h"
+#include "ray/hit.h"
 #include "ray/intersect.h"
+#include "ray/journal.h"
+#include "ray/light_tree.h"
 #include "ray/normal.h"
+#include "ray/prepare.h"
 #include "ray/ray.h"
-#include "ray/tex_coord.h"
-#include "ray/vec_utils.h"
+#include "ray/tile.h"
+
+// all vectors made while tracing come from the thread's arena and are thrown
+// away together once the pixel is done
+
+static gsl_vector *arena_zero_vec3(RayRenderContext *ctx) {
+  gsl_vector *vec = ray_arena_vec3(ctx->arena);
+  gsl_vector_set_zero(vec);
+  return vec;
+}
+
+// splits up the thread's perf counts, see RAY_RENDER_STAGE. only a branch
+// unless they're being counted
+static void enter_stage(RayRenderContext *ctx, RAY_RENDER_STAGE stage) {
+  if (ctx->perf_sampling && ctx->stage != stage) {
+    ray_render_context_switch_stage(ctx, stage);
+  }
+}
 
-static gsl_vector *get_hit_point(const RayRay ray, double hit_distance) {
-  gsl_vector *hit_point = gsl_vector_alloc(3);
-  gsl_vector_memcpy(hit_point, ray.direction);
-  gsl_vector_scale(hit_point, hit_distance);
-  gsl_vector_add(hit_point, ray.origin);
-  return hit_point;
+// callers go on to shade whatever it finds
+static const RayObject *closest_intersection(RayRenderContext *ctx,
+                                             const RayScene *scene,
+                                             const RayRay *ray, int depth,
+                                             double *distance) {
+  enter_stage(ctx, depth == 0 ? RAY_RENDER_STAGE_primary
+                              : RAY_RENDER_STAGE_secondary);
+  ctx->stats.intersection_tests += scene->num_objects;
+  if (depth > ctx->depth_reached) {
+    ctx->depth_reached = depth;
+  }
+  const RayObject *object =
+      ray_prepared_closest_intersection(ctx->prepared, ray, distance);
+  enter_stage(ctx, RAY_RENDER_STAGE_shading);
+  return object;
 }
 
-static bool is_in_light(gsl_vector *surface_normal, gsl_vector *hit_point,
-                        gsl_vector *dir_to_light, double light_distance,
-                        const RayScene *scene) {
+static bool shadow_ray_clear(RayRenderContext *ctx, int light,
+                             const RayHitRecord *hit,
+                             gsl_vector *dir_to_light, double light_distance,
+                             const RayScene *scene) {
   // find the shadow origin by adding a small fudge factor to the hit
   // point (to prevent shadow acne)
-  gsl_vector *shadow_origin = gsl_vector_alloc(3);
-  gsl_vector_memcpy(shadow_origin, surface_normal);
-  gsl_vector_scale(shadow_origin, scene->shadow_bias);
-  gsl_vector_add(shadow_origin, hit_point);
+  gsl_vector *shadow_origin = ray_arena_vec3(ctx->arena);
+  gsl_vector_memcpy(shadow_origin, hit->normal);
+  gsl_vector_scale(shadow_origin, hit->bias);
+  gsl_vector_add(shadow_origin, hit->point);
   RayRay shadow_ray = {
       .origin = shadow_origin,
       .direction = dir_to_light,
   };
 
   // ray from hit point to light for shadows on other objects
-  double intersect_distance = 0.0;
-  const RayObject *in_light_intersect = ray_closest_intersection(
-      scene->objects, scene->num_objects, &shadow_ray, &intersect_distance);
-  // free allocated vectors
-  gsl_vector_free(shadow_origin);
-  return in_light_intersect == NULL || intersect_distance > light_distance;
+  ctx->stats.shadow_rays += 1;
+
+  // anything in the way will do, so try whatever blocked this light last.
+  // it's tested in kernel precision, same as the full query
+  const int cached = ctx->occluders[light];
+  if (cached >= 0) {
+    ctx->stats.intersection_tests += 1;
+    if (ray_prepared_occludes(ctx->prepared, cached, &shadow_ray,
+                              light_distance)) {
+      ctx->stats.occluder_cache_hits += 1;
+      return false;
+    }
+    ctx->stats.occluder_cache_misses += 1;
+  }
+
+  ctx->stats.intersection_tests += scene->num_objects;
+  const int occluder =
+      ray_prepared_any_intersection(ctx->prepared, &shadow_ray, light_distance);
+  if (occluder < 0) {
+    return true;
+  }
+  ctx->occluders[light] = occluder;
+  return false;
+}
+
+static bool is_in_light(RayRenderContext *ctx, int light,
+                        const RayHitRecord *hit, gsl_vector *dir_to_light,
+                        double light_distance, const RayScene *scene) {
+  enter_stage(ctx, RAY_RENDER_STAGE_shadow);
+  const bool lit =
+      shadow_ray_clear(ctx, light, hit, dir_to_light, light_distance, scene);
+  enter_stage(ctx, RAY_RENDER_STAGE_shading);
+  return lit;
 }
 
 // mathy stuff to calculate the light power
@@ -75,59 +142,144 @@ static double get_light_power(gsl_vector *surface_normal,
   return light_power;
 }
 
-gsl_vector *shade_diffuse_part(RayMaterial material, RayTexCoord tex_coord,
-                               gsl_vector *light_color, double light_power,
-                               double light_reflected) {
+void shade_diffuse_part(gsl_vector *color, const RayHitRecord *hit,
+                        const gsl_vector *light_color, double light_power) {
   // calculate the color of the light
-  gsl_vector *color = gsl_vector_alloc(3);
-  gsl_vector *base_color =
-      ray_coloration_color_get(&material.coloration, tex_coord);
-  gsl_vector_memcpy(color, base_color);
+  gsl_vector_memcpy(color, hit->base_color);
   gsl_vector_mul(color, light_color);
   gsl_vector_scale(color, light_power);
-  gsl_vector_scale(color, light_reflected);
-  return color;
+  gsl_vector_scale(color, hit->reflectance);
 }
 
-gsl_vector *shade_diffuse(const RayScene *scene, const RayObject *intersection,
-                          gsl_vector *hit_point, gsl_vector *surface_normal) {
-  gsl_vector *color = gsl_vector_calloc(3);
-  for (int l = 0; l < scene->num_lights; ++l) {
-    const RayLight *light = &scene->lights[l];
+// picks the lights that shade the hit, leaving their indices in
+// ctx->lights and what each one's contribution is scaled by in
+// ctx->light_weights. returns how many were picked
+static int select_lights(RayRenderContext *ctx, const RayScene *scene,
+                         const RayHitRecord *hit, gsl_vector *dir_to_light) {
+  int *lights = ctx->lights;
+  double *weights = ctx->light_weights;
+  const int num_lights =
+      ray_light_tree_query(&ctx->prepared->lights, scene, hit->point, lights);
+  ctx->stats.culled_lights += scene->num_lights - num_lights;
 
-    // get the normal to any light
-    gsl_vector *dir_to_light = ray_light_direction_from(light, hit_point);
-
-    double light_distance = ray_light_distance(light, hit_point);
-
-    bool in_light = is_in_light(surface_normal, hit_point, dir_to_light,
-                                light_distance, scene);
-
-    double light_intensity =
-        in_light ? ray_light_intensity(light, hit_point) : 0.0;
+  if (ctx->light_samples <= 0 || num_lights <= ctx->light_samples) {
+    for (int i = 0; i < num_lights; ++i) {
+      weights[i] = 1.0;
+    }
+    return num_lights;
+  }
 
-    double light_power =
-        get_light_power(surface_normal, dir_to_light, light_intensity);
+  // running total of each light's unshadowed contribution
+  double total = 0.0;
+  for (int i = 0; i < num_lights; ++i) {
+    const RayLight *light = &scene->lights[lights[i]];
+    ray_light_direction_into(light, hit->point, dir_to_light);
+    double intensity = ray_light_intensity(light, hit->point);
+    total += get_light_power(hit->normal, dir_to_light, intensity) *
+             gsl_vector_max(light->color);
+    weights[i] = total;
+  }
+  if (total <= 0.0) {
+    return 0;
+  }
 
-    // light math is done so so is this
-    gsl_vector_free(dir_to_light);
+  // evenly spaced picks from a random start (systematic sampling), a light
+  // picked n times is shaded once with n times the weight. picks only move
+  // entries towards the front so the arrays are reused for the result
+  const double step = total / ctx->light_samples;
+  double next = ray_rng_uniform(&ctx->rng) * step;
+  double previous = 0.0;
+  int picked = 0;
+  for (int i = 0; i < num_lights && next < total; ++i) {
+    const double running = weights[i];
+    const double power = running - previous;
+    previous = running;
+    int hits = 0;
+    while (next < running) {
+      hits += 1;
+      next += step;
+    }
+    if (hits > 0) {
+      lights[picked] = lights[i];
+      weights[picked] = hits * step / power;
+      picked += 1;
+    }
+  }
+  return picked;
+}
 
-    // calculate amount of reflected light based of albedo
-    double light_reflected = intersection->material.albedo / M_PI;
+static int area_light_side(const RayRenderContext *ctx) {
+  int side = 1;
+  while ((side + 1) * (side + 1) <= ctx->area_light_samples) {
+    side += 1;
+  }
+  return side;
+}
 
-    RayTexCoord tex_coord = ray_object_tex_coord(intersection, hit_point);
+// power from one point on an area light, which shines like a point light
+// there. leaves the direction and distance to it for the shadow ray
+static double area_sample_power(RayRenderContext *ctx, const RayLight *light,
+                                const RayHitRecord *hit, int stratum,
+                                int side, gsl_vector *dir_to_light,
+                                double *light_distance) {
+  const double s = ray_rng_uniform(&ctx->rng);
+  const double t = ray_rng_uniform(&ctx->rng);
+  ray_light_sample_into(light, hit->point, stratum, side, s, t,
+                        dir_to_light);
+  gsl_vector_sub(dir_to_light, hit->point);
+  *light_distance = gsl_blas_dnrm2(dir_to_light);
+  if (*light_distance <= 0.0) {
+    return 0.0;
+  }
+  gsl_vector_scale(dir_to_light, 1.0 / *light_distance);
+  const double intensity = light->intensity / (4.0 * M_PI * *light_distance *
+                                               *light_distance);
+  return get_light_power(hit->normal, dir_to_light, intensity);
+}
 
-    gsl_vector *color_part =
-        shade_diffuse_part(intersection->material, tex_coord, light->color,
-                           light_power, light_reflected);
-    // add to net color
-    gsl_vector_add(color, color_part);
-    gsl_vector_free(color_part);
+// one side x side stratified pass over an area light, returns the summed
+// power of the samples that weren't blocked
+static double area_light_pass(RayRenderContext *ctx, const RayScene *scene,
+                              int light_index, const RayHitRecord *hit,
+                              int side, gsl_vector *dir_to_light, int *lit) {
+  const RayLight *light = &scene->lights[light_index];
+  double total = 0.0;
+  for (int stratum = 0; stratum < side * side; ++stratum) {
+    double light_distance = 0.0;
+    const double power = area_sample_power(ctx, light, hit, stratum, side,
+                                           dir_to_light, &light_distance);
+    if (power > 0.0 && is_in_light(ctx, light_index, hit, dir_to_light,
+                                   light_distance, scene)) {
+      total += power;
+      *lit += 1;
+    }
   }
+  ctx->stats.area_light_samples += side * side;
+  return total;
+}
 
-  // clamp between 0.0 & 1.0 to prevent problems with image output
-  ray_vec_clamp(color);
-  return color;
+// average shadowed power over stratified points on an area light. the first
+// pass is all that's taken where its samples agree, i.e. fully lit or fully
+// shadowed, and only a penumbra pays for the finer passes
+static double area_light_power(RayRenderContext *ctx, const RayScene *scene,
+                               int light_index, const RayHitRecord *hit,
+                               gsl_vector *dir_to_light) {
+  int side = area_light_side(ctx);
+  int lit = 0;
+  double total =
+      area_light_pass(ctx, scene, light_index, hit, side, dir_to_light, &lit);
+  int taken = side * side;
+  bool refined = false;
+  while (lit > 0 && lit < taken &&
+         taken + 4 * side * side <= ctx->area_light_max_samples) {
+    side *= 2;
+    total +=
+        area_light_pass(ctx, scene, light_index, hit, side, dir_to_light, &lit);
+    taken += side * side;
+    refined = true;
+  }
+  ctx->stats.area_light_refinements += refined;
+  return total / taken;
 }
 
 double fresnel(gsl_vector *incident, gsl_vector *normal, double index) {
@@ -155,195 +307,1208 @@ double fresnel(gsl_vector *incident, gsl_vector *normal, double index) {
   }
 }
 
-gsl_vector *cast_ray(const RayScene *scene, RayRay ray, int depth);
+// cast_ray_<features>, see render_kernel.inc. kernels[features] can render
+// any scene whose prepared features are among those bits
+#define KERNEL_NAME(name, features) name##_##features
+#define KERNEL_NAME_OF(name, features) KERNEL_NAME(name, features)
+#define KERNEL(name) KERNEL_NAME_OF(name, KERNEL_FEATURES)
+
+#define KERNEL_FEATURES 0
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 1
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 2
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 3
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 4
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 5
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 6
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 7
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 8
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 9
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 10
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 11
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 12
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 13
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 14
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+#define KERNEL_FEATURES 15
+#include "render_kernel.inc"
+#undef KERNEL_FEATURES
+
+typedef gsl_vector *(*kernel_fn)(RayRenderContext *, const RayScene *,
+                                 const RayRay *, int);
+
+static_assert(RAY_SCENE_FEATURE_all == 15, "one kernel per feature set");
+static const kernel_fn kernels[RAY_SCENE_FEATURE_all + 1] = {
+    cast_ray_0,  cast_ray_1,  cast_ray_2,  cast_ray_3,
+    cast_ray_4,  cast_ray_5,  cast_ray_6,  cast_ray_7,
+    cast_ray_8,  cast_ray_9,  cast_ray_10, cast_ray_11,
+    cast_ray_12, cast_ray_13, cast_ray_14, cast_ray_15,
+};
+
+// batched shadows walk the same paths as cast_ray/get_color, but instead of
+// building colours up on the way back they pass the throughput down (what a
+// hit's colour ends up scaled by in the pixel) and leave each diffuse hit
+// waiting on its shadow rays in the context's batch. the pixel is only put
+// together once the whole tile's shadow rays have been traced
+
+static void batch_out_of_memory(void) {
+  fprintf(stderr, "out of memory while batching shadow rays\n");
+  exit(1);
+}
+
+static void scale3(double *out, const double *in, double scale) {
+  for (size_t c = 0; c < 3; ++c) {
+    out[c] = in[c] * scale;
+  }
+}
+
+// visibility isn't known until the batch resolves, so there's nothing to
+// adapt to and batched area lights only ever get the first pass
+static void defer_area_light(RayRenderContext *ctx, const RayScene *scene,
+                             int light_index, double weight,
+                             const RayHitRecord *hit,
+                             const gsl_vector *shadow_origin) {
+  const RayLight *light = &scene->lights[light_index];
+  gsl_vector *dir_to_light = ray_arena_vec3(ctx->arena);
+  gsl_vector *color_part = ray_arena_vec3(ctx->arena);
+  const int side = area_light_side(ctx);
+  const double share = weight / (side * side);
+  for (int stratum = 0; stratum < side * side; ++stratum) {
+    double light_distance = 0.0;
+    const double light_power =
+        area_sample_power(ctx, light, hit, stratum, side, dir_to_light,
+                          &light_distance) *
+        share;
+    if (light_power <= 0.0) {
+      continue;
+    }
+    shade_diffuse_part(color_part, hit, light->color, light_power);
+    ctx->stats.shadow_rays += 1;
+    ctx->stats.intersection_tests += scene->num_objects;
+    if (ray_shadow_batch_add_part(ctx->shadow_batch, shadow_origin,
+                                  dir_to_light, light_distance, light_index,
+                                  color_part) < 0) {
+      batch_out_of_memory();
+    }
+  }
+  ctx->stats.area_light_samples += side * side;
+}
 
-gsl_vector *get_color(const RayScene *scene, const RayRay ray,
-                      const RayObject *intersection, double distance,
-                      int depth) {
-  gsl_vector *hit_point = get_hit_point(ray, distance);
+static void defer_diffuse(RayRenderContext *ctx, const RayScene *scene,
+                          const RayHitRecord *hit, const double *throughput,
+                          int pixel) {
+  RayShadowBatch *batch = ctx->shadow_batch;
+  if (ray_shadow_batch_add_hit(batch, pixel, throughput) < 0) {
+    batch_out_of_memory();
+  }
 
-  gsl_vector *surface_normal = ray_surface_normal(intersection, hit_point);
+  gsl_vector *dir_to_light = ray_arena_vec3(ctx->arena);
+  gsl_vector *color_part = ray_arena_vec3(ctx->arena);
+  // same for every light, see is_in_light
+  gsl_vector *shadow_origin = ray_arena_vec3(ctx->arena);
+  gsl_vector_memcpy(shadow_origin, hit->normal);
+  gsl_vector_scale(shadow_origin, hit->bias);
+  gsl_vector_add(shadow_origin, hit->point);
 
-  const RayMaterial *material = &intersection->material;
+  const int num_lights = select_lights(ctx, scene, hit, dir_to_light);
+  for (int i = 0; i < num_lights; ++i) {
+    const RayLight *light = &scene->lights[ctx->lights[i]];
+    if (ray_light_is_area(light)) {
+      defer_area_light(ctx, scene, ctx->lights[i], ctx->light_weights[i], hit,
+                       shadow_origin);
+      continue;
+    }
+    ray_light_direction_into(light, hit->point, dir_to_light);
+    double light_intensity =
+        ray_light_intensity(light, hit->point) * ctx->light_weights[i];
+    double light_power =
+        get_light_power(hit->normal, dir_to_light, light_intensity);
+    if (light_power <= 0.0) {
+      continue;
+    }
+    double light_distance = ray_light_distance(light, hit->point);
+
+    shade_diffuse_part(color_part, hit, light->color, light_power);
+    ctx->stats.shadow_rays += 1;
+    ctx->stats.intersection_tests += scene->num_objects;
+    if (ray_shadow_batch_add_part(batch, shadow_origin, dir_to_light,
+                                  light_distance, ctx->lights[i],
+                                  color_part) < 0) {
+      batch_out_of_memory();
+    }
+  }
+}
+
+static void defer_ray(RayRenderContext *ctx, const RayScene *scene,
+                      const RayRay *ray, int depth, const double *throughput,
+                      int pixel);
+
+static void defer_hit(RayRenderContext *ctx, const RayScene *scene,
+                      const RayRay *ray, const RayObject *intersection,
+                      double distance, int depth, const double *throughput,
+                      int pixel) {
+  RayHitRecord hit;
+  ray_hit_record_init(&hit, intersection, ray, distance, ctx->prepared,
+                      ctx->arena);
+  const RayMaterial *material = hit.material;
+  RayTraceFrame *frame = &ctx->frames[depth];
+  double scaled[3];
 
-  gsl_vector *color = NULL;
   switch (material->surface.type) {
   case RAY_SURFACE_TYPE_diffuse:
-    color = shade_diffuse(scene, intersection, hit_point, surface_normal);
+    defer_diffuse(ctx, scene, &hit, throughput, pixel);
     break;
   case RAY_SURFACE_TYPE_reflective: {
-    color = shade_diffuse(scene, intersection, hit_point, surface_normal);
-    RayRay reflection_ray = ray_create_reflection(
-        surface_normal, ray.direction, hit_point, scene->shadow_bias);
-    double reflectivity = intersection->material.surface.reflectivity;
-    gsl_vector_scale(color, 1.0 - reflectivity);
-    gsl_vector *reflected = cast_ray(scene, reflection_ray, depth + 1);
-    gsl_vector_scale(reflected, reflectivity);
-    gsl_vector_add(color, reflected);
-    ray_ray_free(reflection_ray);
-    gsl_vector_free(reflected);
+    double reflectivity = material->surface.reflectivity;
+    scale3(scaled, throughput, 1.0 - reflectivity);
+    defer_diffuse(ctx, scene, &hit, scaled, pixel);
+    RayRay *reflection_ray = &frame->reflection;
+    ray_reflection_into(reflection_ray, hit.normal, ray->direction, hit.point,
+                        hit.bias);
+    ctx->stats.reflection_rays += 1;
+    scale3(scaled, throughput, reflectivity);
+    defer_ray(ctx, scene, reflection_ray, depth + 1, scaled, pixel);
   } break;
   case RAY_SURFACE_TYPE_refractive: {
-    double kr = fresnel(ray.direction, surface_normal, material->surface.index);
-
-    RayTexCoord tex_coord = ray_object_tex_coord(intersection, hit_point);
-    gsl_vector *surface_color =
-        ray_coloration_color_get(&material->coloration, tex_coord);
+    double kr = fresnel(ray->direction, hit.normal, material->surface.index);
+    // both rays are tinted by the surface
+    double filtered[3];
+    for (size_t c = 0; c < 3; ++c) {
+      filtered[c] = throughput[c] * material->surface.transparency *
+                    gsl_vector_get(hit.base_color, c);
+    }
 
-    gsl_vector *refraction_color = NULL;
     if (kr < 1.0) {
-      RayRay transmission_ray;
-      bool success = ray_create_transmission(
-          &transmission_ray, surface_normal, ray.direction, hit_point,
-          scene->shadow_bias, material->surface.index);
+      RayRay *transmission_ray = &frame->transmission;
+      bool success = ray_transmission_into(
+          transmission_ray, hit.normal, ray->direction, hit.point, hit.bias,
+          material->surface.index);
       assert(success && "transmission ray creation must succeed (or "
                         "something's wrong with fernel stuff)");
-      refraction_color = cast_ray(scene, transmission_ray, depth + 1);
-      ray_ray_free(transmission_ray);
-    } else {
-      refraction_color = ray_create_vec3(0.0, 0.0, 0.0);
-    }
-    gsl_vector_scale(refraction_color, 1.0 - kr);
-
-    RayRay reflection_ray = ray_create_reflection(
-        surface_normal, ray.direction, hit_point, scene->shadow_bias);
-    gsl_vector *reflection_color = cast_ray(scene, reflection_ray, depth + 1);
-    ray_ray_free(reflection_ray);
-    gsl_vector_scale(reflection_color, kr);
-
-    color = gsl_vector_alloc(3);
-    gsl_vector_memcpy(color, reflection_color);
-    gsl_vector_add(color, refraction_color);
-    // gsl_vector_memcpy(color, refraction_color);
-    gsl_vector_scale(color, material->surface.transparency);
-    gsl_vector_mul(color, surface_color);
-
-    gsl_vector_free(refraction_color);
-    gsl_vector_free(reflection_color);
+      ctx->stats.transmission_rays += 1;
+      scale3(scaled, filtered, 1.0 - kr);
+      defer_ray(ctx, scene, transmission_ray, depth + 1, scaled, pixel);
+    }
+
+    RayRay *reflection_ray = &frame->reflection;
+    ray_reflection_into(reflection_ray, hit.normal, ray->direction, hit.point,
+                        hit.bias);
+    ctx->stats.reflection_rays += 1;
+    scale3(scaled, filtered, kr);
+    defer_ray(ctx, scene, reflection_ray, depth + 1, scaled, pixel);
   } break;
   default:
     fprintf(stderr, "invalid surface type in render\n");
     exit(1);
     break;
   }
-
-  gsl_vector_free(surface_normal);
-  gsl_vector_free(hit_point);
-
-  return color;
 }
 
-gsl_vector *cast_ray(const RayScene *scene, RayRay ray, int depth) {
+static void defer_ray(RayRenderContext *ctx, const RayScene *scene,
+                      const RayRay *ray, int depth, const double *throughput,
+                      int pixel) {
   if (depth > scene->max_recursion_depth) {
-    return ray_create_vec3(0.0, 0.0, 0.0);
+    return;
   }
 
   double distance = 0.0;
-  const RayObject *intersection = ray_closest_intersection(
-      scene->objects, scene->num_objects, &ray, &distance);
+  const RayObject *intersection =
+      closest_intersection(ctx, scene, ray, depth, &distance);
   if (intersection != NULL) {
-    return get_color(scene, ray, intersection, distance, depth);
-  } else {
-    return ray_create_vec3(0.0, 0.0, 0.0);
+    defer_hit(ctx, scene, ray, intersection, distance, depth, throughput,
+              pixel);
+  }
+}
+
+#define DEFAULT_TILE_SIZE 16
+
+RayRenderSettings ray_default_render_settings(void) {
+  return (RayRenderSettings){
+      .num_threads = 0,
+      .tile_size = DEFAULT_TILE_SIZE,
+      .tile_order = RAY_TILE_ORDER_hilbert,
+      .light_cutoff = 0.0,
+      .light_samples = 0,
+      .area_light_samples = 4,
+      .area_light_max_samples = 100,
+      .batch_shadows = false,
+      .generic_kernel = false,
+      .perf_counters = false,
+      .perf_sample_every = 64,
+      .cost_map = false,
+      .tone_map = ray_default_tone_map(),
+  };
+}
+
+static int resolve_num_threads(int requested) {
+  if (requested > 0) {
+    return requested;
+  }
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  return online > 0 ? (int)online : 1;
+}
+
+typedef struct RenderWorker {
+  RayRenderContext *ctx;
+  const void *job;
+} RenderWorker;
+
+struct RayRenderer {
+  RayRenderSettings settings;
+  int num_threads;
+  // one cache aligned context per thread
+  RayRenderContext *contexts;
+  RenderWorker *workers;
+  pthread_t *threads;
+  // rebuilt at the start of every render, unless it's being kept up to date
+  // for kept_scene through ray_renderer_apply_changes
+  RayPreparedScene prepared;
+  const RayScene *kept_scene;
+  // only rebuilt when the image size changes
+  RayTile *tiles;
+  int num_tiles;
+  int tiles_width;
+  int tiles_height;
+  // only with RayRenderSettings.cost_map, from the last render
+  RayCostMap *cost_map;
+};
+
+RayRenderer *ray_create_renderer(const RayRenderSettings *settings) {
+  RayRenderer *renderer = calloc(1, sizeof *renderer);
+  if (renderer == NULL) {
+    return NULL;
+  }
+  renderer->settings =
+      settings != NULL ? *settings : ray_default_render_settings();
+  if (renderer->settings.tile_size <= 0) {
+    renderer->settings.tile_size = DEFAULT_TILE_SIZE;
+  }
+
+  const int num_threads = resolve_num_threads(renderer->settings.num_threads);
+  renderer->contexts =
+      aligned_alloc(alignof(RayRenderContext),
+                    num_threads * (sizeof *renderer->contexts));
+  renderer->workers = malloc(num_threads * (sizeof *renderer->workers));
+  renderer->threads = malloc(num_threads * (sizeof *renderer->threads));
+  if (renderer->contexts == NULL || renderer->workers == NULL ||
+      renderer->threads == NULL) {
+    ray_free_renderer(renderer);
+    return NULL;
+  }
+
+  for (int t = 0; t < num_threads; t += 1) {
+    if (!ray_init_render_context(&renderer->contexts[t], t)) {
+      ray_free_renderer(renderer);
+      return NULL;
+    }
+    // only count contexts that need cleaning up
+    renderer->num_threads = t + 1;
+    renderer->workers[t] = (RenderWorker){
+        .ctx = &renderer->contexts[t],
+        .job = NULL,
+    };
+  }
+
+  return renderer;
+}
+
+void ray_free_renderer(RayRenderer *renderer) {
+  for (int t = 0; t < renderer->num_threads; t += 1) {
+    ray_free_render_context(&renderer->contexts[t]);
+  }
+  free(renderer->contexts);
+  free(renderer->workers);
+  free(renderer->threads);
+  free(renderer->tiles);
+  ray_free_cost_map(renderer->cost_map);
+  ray_free_prepared_scene(&renderer->prepared);
+  free(renderer);
+}
+
+RayRenderStats ray_renderer_stats(const RayRenderer *renderer) {
+  RayRenderStats total = {0};
+  for (int t = 0; t < renderer->num_threads; t += 1) {
+    ray_render_stats_add(&total, &renderer->contexts[t].stats);
+  }
+  return total;
+}
+
+const RayRenderContext *ray_renderer_contexts(const RayRenderer *renderer,
+                                              int *num_contexts) {
+  *num_contexts = renderer->num_threads;
+  return renderer->contexts;
+}
+
+const RayCostMap *ray_renderer_cost_map(const RayRenderer *renderer) {
+  return renderer->cost_map;
+}
+
+// after a render, or one that failed. a kept prepared scene stays for the
+// next one, otherwise the scene might not outlive the renderer
+static void release_prepared(RayRenderer *renderer) {
+  if (renderer->kept_scene == NULL) {
+    ray_free_prepared_scene(&renderer->prepared);
   }
 }
 
-#define NUM_THREADS 1
+static void forget_kept_scene(RayRenderer *renderer) {
+  ray_free_prepared_scene(&renderer->prepared);
+  renderer->kept_scene = NULL;
+}
+
+bool ray_renderer_apply_changes(RayRenderer *renderer, const RayScene *scene,
+                                const RaySceneChanges *changes) {
+  const double light_cutoff = renderer->settings.light_cutoff;
+  if (renderer->kept_scene == scene && !changes->moved &&
+      ray_update_prepared_scene(&renderer->prepared, changes->changed_objects,
+                                changes->num_changed_objects,
+                                changes->num_changed_lights > 0,
+                                light_cutoff)) {
+    return true;
+  }
+  // anything that can't be patched is prepared from scratch
+  forget_kept_scene(renderer);
+  if (!ray_prepare_scene(scene, light_cutoff, &renderer->prepared)) {
+    return false;
+  }
+  renderer->kept_scene = scene;
+  return true;
+}
 
-typedef struct ThreadImg {
-  pthread_mutex_t *lock;
-  RayImg *img;
-} ThreadImg;
+static bool prepare_contexts(RayRenderer *renderer, const RayScene *scene) {
+  if (renderer->kept_scene != scene) {
+    forget_kept_scene(renderer);
+    if (!ray_prepare_scene(scene, renderer->settings.light_cutoff,
+                           &renderer->prepared)) {
+      return false;
+    }
+  }
+  if (renderer->settings.generic_kernel) {
+    renderer->prepared.features = RAY_SCENE_FEATURE_all;
+  }
+  for (int t = 0; t < renderer->num_threads; t += 1) {
+    RayRenderContext *ctx = &renderer->contexts[t];
+    ctx->stats = (RayRenderStats){0};
+    ctx->prepared = &renderer->prepared;
+    ctx->light_samples = renderer->settings.light_samples;
+    ctx->area_light_samples = renderer->settings.area_light_samples;
+    ctx->area_light_max_samples = renderer->settings.area_light_max_samples;
+    ctx->count_perf = renderer->settings.perf_counters;
+    ctx->perf_sample_every = renderer->settings.perf_sample_every;
+    ctx->cost_map = NULL;
+    if (!ray_render_context_reserve(ctx, (int)scene->max_recursion_depth) ||
+        !ray_render_context_reserve_lights(ctx, scene->num_lights)) {
+      release_prepared(renderer);
+      return false;
+    }
+    // object indices from the last scene mean nothing now
+    for (int l = 0; l < scene->num_lights; l += 1) {
+      ctx->occluders[l] = -1;
+    }
+    if (renderer->settings.batch_shadows && ctx->shadow_batch == NULL) {
+      ctx->shadow_batch = ray_create_shadow_batch();
+      if (ctx->shadow_batch == NULL) {
+        release_prepared(renderer);
+        return false;
+      }
+    }
+  }
+  return true;
+}
 
-typedef struct RenderSceneRangeArgs {
+// run fn on every worker with the same job, any worker that can't get its own
+// thread is run on the calling one instead
+static void run_workers(RayRenderer *renderer, void *(*fn)(void *),
+                        const void *job) {
+  int started = 0;
+  for (int t = 0; t < renderer->num_threads; t += 1) {
+    renderer->workers[t].job = job;
+  }
+  for (int t = 0; t < renderer->num_threads; t += 1) {
+    if (pthread_create(&renderer->threads[t], NULL, fn,
+                       &renderer->workers[t]) != 0) {
+      break;
+    }
+    started += 1;
+  }
+  for (int t = started; t < renderer->num_threads; t += 1) {
+    fn(&renderer->workers[t]);
+  }
+  for (int t = 0; t < started; t += 1) {
+    pthread_join(renderer->threads[t], NULL);
+  }
+}
+
+// trace a single primary ray, the returned color lives in the context's
+// arena so it's only valid until the next reset
+static gsl_vector *trace_pixel(RayRenderContext *ctx, const RayScene *scene,
+                               int x, int y) {
+  if (ctx->perf_open) {
+    ray_render_context_begin_pixel(ctx, x, y);
+  }
+  RayRay *ray = &ctx->primary;
+  ray_prime_ray_into(ray, x, y, scene);
+  // sampling only depends on the pixel, not on the thread or the order
+  ray_rng_seed(&ctx->rng, ((uint64_t)y << 32) | (uint32_t)x);
+  ctx->stats.primary_rays += 1;
+  // get the closest object to the ray
+  return kernels[ctx->prepared->features](ctx, scene, ray, 0);
+}
+
+typedef struct TileQueue {
+  const RayTile *tiles;
+  int num_tiles;
+  // every thread bumps this once per tile so keep it on its own line
+  alignas(RAY_CACHE_LINE_SIZE) atomic_int next;
+  char padding[RAY_CACHE_LINE_SIZE - sizeof(atomic_int)];
+} TileQueue;
+
+typedef enum TILE_STATE {
+  TILE_STATE_todo,
+  TILE_STATE_done,
+  TILE_STATE_journaled,
+} TILE_STATE;
+
+typedef struct RenderCheckpoint {
+  RayJournal *journal;
+  const RayFramebuffer *fb;
+  long long interval_ns;
+  // which of the renderer's tiles each one in the queue is
+  int *tile_index;
+  // a TILE_STATE for each of the renderer's tiles
+  atomic_uchar *states;
+  int num_tiles;
+  // when the next append is due, on the monotonic clock
+  atomic_llong due_ns;
+  // only one thread appends at a time, the others carry on rendering
+  pthread_mutex_t lock;
+  // tiles being appended, and whether appending has given up. both only
+  // touched with the lock held
+  int *appending;
+  bool failed;
+} RenderCheckpoint;
+
+typedef struct RenderJob {
   const RayScene *scene;
-  ThreadImg *thread_img;
-  int start;
-  int range;
-} RenderSceneRangeArgs;
+  RayFramebuffer *fb;
+  TileQueue *queue;
+  // NULL unless finished tiles are being journaled
+  RenderCheckpoint *checkpoint;
+} RenderJob;
 
-void *ray_render_scene_range(void *voidArgs) {
-  RenderSceneRangeArgs *args = voidArgs;
-  const RayScene *scene = args->scene;
-  ThreadImg *thread_img = args->thread_img;
-  RayImg *img = ray_create_img(scene->width, args->range, 3);
+static long long now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
 
-  for (int y = 0; y < args->range; y += 1) {
-    for (int x = 0; x < scene->width; x += 1) {
-      RayRay ray = ray_create_prime_ray(x, args->start + y, scene);
-      // get the closest object to the ray
-      gsl_vector *color = cast_ray(scene, ray, 0);
-      ray_set_pixel(x, y, color, img);
-      ray_ray_free(ray);
+static uint64_t rays_traced(const RayRenderStats *stats) {
+  return stats->primary_rays + stats->reflection_rays +
+         stats->transmission_rays + stats->shadow_rays;
+}
+
+// where the stats and the clock were when a pixel started, for the cost map
+typedef struct PixelStart {
+  uint64_t rays;
+  uint64_t intersection_tests;
+  long long ns;
+} PixelStart;
+
+static void start_pixel_cost(RayRenderContext *ctx, PixelStart *start) {
+  if (ctx->cost_map == NULL) {
+    return;
+  }
+  ctx->depth_reached = 0;
+  *start = (PixelStart){
+      .rays = rays_traced(&ctx->stats),
+      .intersection_tests = ctx->stats.intersection_tests,
+      .ns = now_ns(),
+  };
+}
+
+static void finish_pixel_cost(RayRenderContext *ctx, const PixelStart *start,
+                              int x, int y) {
+  RayCostMap *map = ctx->cost_map;
+  if (map == NULL) {
+    return;
+  }
+  const long long ns = now_ns();
+  const size_t pixel = (size_t)(y - map->y) * map->width + (x - map->x);
+  ray_cost_map_plane(map, RAY_PIXEL_COST_rays)[pixel] =
+      (float)(rays_traced(&ctx->stats) - start->rays);
+  ray_cost_map_plane(map, RAY_PIXEL_COST_intersection_tests)[pixel] =
+      (float)(ctx->stats.intersection_tests - start->intersection_tests);
+  ray_cost_map_plane(map, RAY_PIXEL_COST_depth)[pixel] =
+      (float)ctx->depth_reached;
+  ray_cost_map_plane(map, RAY_PIXEL_COST_time)[pixel] =
+      (float)(ns - start->ns);
+}
+
+static void render_pixel(RayRenderContext *ctx, const RayScene *scene, int x,
+                         int y, RayFramebuffer *fb) {
+  PixelStart start;
+  start_pixel_cost(ctx, &start);
+  gsl_vector *color = trace_pixel(ctx, scene, x, y);
+  enter_stage(ctx, RAY_RENDER_STAGE_output);
+  ray_framebuffer_set(fb, x - fb->x, y - fb->y, color);
+  ray_arena_reset(ctx->arena);
+  finish_pixel_cost(ctx, &start, x, y);
+}
+
+// the batched version of render_pixel, the pixel's colour isn't known until
+// the batch is resolved. its shadow rays are counted towards its cost but the
+// time they take isn't, that's spent resolving the batch
+static void defer_pixel(RayRenderContext *ctx, const RayScene *scene, int x,
+                        int y, RayFramebuffer *fb) {
+  PixelStart start;
+  start_pixel_cost(ctx, &start);
+  int pixel = ray_shadow_batch_add_pixel(ctx->shadow_batch, x, y);
+  if (pixel < 0) {
+    batch_out_of_memory();
+  }
+  if (ctx->perf_open) {
+    ray_render_context_begin_pixel(ctx, x, y);
+  }
+  RayRay *ray = &ctx->primary;
+  ray_prime_ray_into(ray, x, y, scene);
+  ray_rng_seed(&ctx->rng, ((uint64_t)y << 32) | (uint32_t)x);
+  ctx->stats.primary_rays += 1;
+  const double throughput[3] = {1.0, 1.0, 1.0};
+  defer_ray(ctx, scene, ray, 0, throughput, pixel);
+  enter_stage(ctx, RAY_RENDER_STAGE_output);
+  ray_arena_reset(ctx->arena);
+  finish_pixel_cost(ctx, &start, x, y);
+}
+
+typedef void (*pixel_fn)(RayRenderContext *, const RayScene *, int, int,
+                         RayFramebuffer *);
+
+static void visit_tile(RayRenderContext *ctx, const RayScene *scene,
+                       const RayTile *tile, RayFramebuffer *fb, pixel_fn fn) {
+  // single rows (scanline order) have no locality to gain from reordering
+  if (tile->height == 1) {
+    for (int x = tile->x; x < tile->x + tile->width; x += 1) {
+      fn(ctx, scene, x, tile->y, fb);
+    }
+    return;
+  }
+
+  // walk the tile in z-order so consecutive pixels stay close together
+  uint32_t side = 1;
+  while (side < (uint32_t)tile->width || side < (uint32_t)tile->height) {
+    side *= 2;
+  }
+  for (uint32_t code = 0; code < side * side; code += 1) {
+    uint32_t local_x;
+    uint32_t local_y;
+    ray_morton_decode(code, &local_x, &local_y);
+    if (local_x >= (uint32_t)tile->width ||
+        local_y >= (uint32_t)tile->height) {
+      continue;
     }
+    fn(ctx, scene, tile->x + (int)local_x, tile->y + (int)local_y, fb);
   }
+}
 
-  pthread_mutex_lock(thread_img->lock);
+static void render_tile(RayRenderContext *ctx, const RayScene *scene,
+                        const RayTile *tile, RayFramebuffer *fb) {
+  ctx->stats.tiles += 1;
+  RayShadowBatch *batch = ctx->shadow_batch;
+  if (batch == NULL) {
+    visit_tile(ctx, scene, tile, fb, render_pixel);
+    return;
+  }
 
-  for (int y = 0; y < args->range; y += 1) {
-    for (int x = 0; x < scene->width; x += 1) {
-      thread_img->img->pixels[args->start + y][x] = img->pixels[y][x];
-      img->pixels[y][x] = NULL;
+  ray_shadow_batch_reset(batch);
+  visit_tile(ctx, scene, tile, fb, defer_pixel);
+  enter_stage(ctx, RAY_RENDER_STAGE_shadow);
+  if (!ray_shadow_batch_resolve(batch, ctx->prepared, scene)) {
+    batch_out_of_memory();
+  }
+  enter_stage(ctx, RAY_RENDER_STAGE_output);
+  for (int p = 0; p < batch->num_pixels; ++p) {
+    const double *color = batch->colors[p];
+    float *pixel = ray_framebuffer_pixel(fb, batch->pixel_x[p] - fb->x,
+                                         batch->pixel_y[p] - fb->y);
+    for (int c = 0; c < RAY_FRAMEBUFFER_CHANNELS; ++c) {
+      pixel[c] = (float)color[c];
     }
   }
+}
 
-  pthread_mutex_unlock(thread_img->lock);
+// appends every finished tile that isn't in the journal yet, with the lock
+// held
+static void append_checkpoint(RenderCheckpoint *checkpoint) {
+  if (checkpoint->failed) {
+    return;
+  }
+  int count = 0;
+  for (int t = 0; t < checkpoint->num_tiles; ++t) {
+    // acquire so the tile's pixels are all there
+    if (atomic_load_explicit(&checkpoint->states[t], memory_order_acquire) ==
+        TILE_STATE_done) {
+      checkpoint->appending[count++] = t;
+    }
+  }
+  if (count == 0) {
+    return;
+  }
+  if (!ray_journal_append(checkpoint->journal, checkpoint->fb,
+                          checkpoint->appending, count)) {
+    fprintf(stderr, "failed to write a checkpoint, carrying on without\n");
+    checkpoint->failed = true;
+    return;
+  }
+  for (int i = 0; i < count; ++i) {
+    atomic_store_explicit(&checkpoint->states[checkpoint->appending[i]],
+                          TILE_STATE_journaled, memory_order_relaxed);
+  }
+}
+
+static void finish_tile(RenderCheckpoint *checkpoint, int queued) {
+  atomic_store_explicit(&checkpoint->states[checkpoint->tile_index[queued]],
+                        TILE_STATE_done, memory_order_release);
+  long long now = now_ns();
+  if (now < atomic_load_explicit(&checkpoint->due_ns, memory_order_relaxed) ||
+      pthread_mutex_trylock(&checkpoint->lock) != 0) {
+    return;
+  }
+  append_checkpoint(checkpoint);
+  atomic_store_explicit(&checkpoint->due_ns,
+                        now_ns() + checkpoint->interval_ns,
+                        memory_order_relaxed);
+  pthread_mutex_unlock(&checkpoint->lock);
+}
+
+void *ray_render_scene_range(void *voidArgs) {
+  RenderWorker *worker = voidArgs;
+  const RenderJob *job = worker->job;
+  TileQueue *queue = job->queue;
+  ray_render_context_start_perf(worker->ctx);
 
-  ray_free_img(img);
+  // tiles are taken in curve order so the tiles in flight at any moment (and
+  // each thread's consecutive tiles) stay close together on screen. every
+  // tile is owned by exactly one thread so pixels can be written directly
+  for (int t = atomic_fetch_add(&queue->next, 1); t < queue->num_tiles;
+       t = atomic_fetch_add(&queue->next, 1)) {
+    render_tile(worker->ctx, job->scene, &queue->tiles[t], job->fb);
+    if (job->checkpoint != NULL) {
+      finish_tile(job->checkpoint, t);
+    }
+  }
 
+  ray_render_context_stop_perf(worker->ctx);
   return NULL;
 }
 
-typedef struct ThreadCtx {
-  pthread_t thread;
-  RenderSceneRangeArgs *args;
-} ThreadCtx;
+static bool prepare_tiles(RayRenderer *renderer, const RayScene *scene) {
+  if (renderer->tiles != NULL && renderer->tiles_width == scene->width &&
+      renderer->tiles_height == scene->height) {
+    return true;
+  }
+  free(renderer->tiles);
+  renderer->tiles = ray_create_tiles(
+      scene->width, scene->height, renderer->settings.tile_size,
+      renderer->settings.tile_order, &renderer->num_tiles);
+  renderer->tiles_width = scene->width;
+  renderer->tiles_height = scene->height;
+  return renderer->tiles != NULL;
+}
+
+// a zeroed cost map covering the same pixels as fb, reusing the last one if
+// it's the same size
+static bool prepare_cost_map(RayRenderer *renderer, const RayFramebuffer *fb) {
+  RayCostMap *map = renderer->cost_map;
+  if (map == NULL || map->width != fb->width || map->height != fb->height) {
+    ray_free_cost_map(map);
+    map = renderer->cost_map = ray_create_cost_map(fb->width, fb->height);
+    if (map == NULL) {
+      return false;
+    }
+  } else {
+    memset(map->data, 0,
+           (size_t)map->width * map->height * RAY_PIXEL_COST_count *
+               (sizeof *map->data));
+  }
+  map->x = fb->x;
+  map->y = fb->y;
+  return true;
+}
+
+// renders tiles into fb, which has to cover them all. checkpoint may be NULL
+static bool render_tiles_into(RayRenderer *renderer, const RayScene *scene,
+                              const RayTile *tiles, int num_tiles,
+                              RayFramebuffer *fb,
+                              RenderCheckpoint *checkpoint) {
+  if (!prepare_contexts(renderer, scene)) {
+    return false;
+  }
+  if (renderer->settings.cost_map) {
+    if (!prepare_cost_map(renderer, fb)) {
+      release_prepared(renderer);
+      return false;
+    }
+    for (int t = 0; t < renderer->num_threads; t += 1) {
+      renderer->contexts[t].cost_map = renderer->cost_map;
+    }
+  }
+
+  TileQueue queue = {
+      .tiles = tiles,
+      .num_tiles = num_tiles,
+  };
+  atomic_init(&queue.next, 0);
+
+  RenderJob job = {
+      .scene = scene,
+      .fb = fb,
+      .queue = &queue,
+      .checkpoint = checkpoint,
+  };
+  run_workers(renderer, &ray_render_scene_range, &job);
+
+  release_prepared(renderer);
+  return true;
+}
+
+RayFramebuffer *ray_renderer_render_hdr(RayRenderer *renderer,
+                                        const RayScene *scene) {
+  RayFramebuffer *fb = ray_create_framebuffer(scene->width, scene->height);
+  if (fb == NULL) {
+    return NULL;
+  }
+  if (!prepare_tiles(renderer, scene) ||
+      !render_tiles_into(renderer, scene, renderer->tiles,
+                         renderer->num_tiles, fb, NULL)) {
+    ray_free_framebuffer(fb);
+    return NULL;
+  }
+  return fb;
+}
+
+RayFramebuffer *ray_renderer_render_tiles(RayRenderer *renderer,
+                                          const RayScene *scene,
+                                          const RayTile *tiles,
+                                          int num_tiles) {
+  if (num_tiles <= 0) {
+    return NULL;
+  }
+  RayTile bounds = tiles[0];
+  for (int t = 0; t < num_tiles; ++t) {
+    const RayTile *tile = &tiles[t];
+    if (tile->x < 0 || tile->y < 0 || tile->width <= 0 ||
+        tile->height <= 0 || tile->x + tile->width > scene->width ||
+        tile->y + tile->height > scene->height) {
+      fprintf(stderr, "tile %dx%d at (%d, %d) isn't inside the %dx%d image\n",
+              tile->width, tile->height, tile->x, tile->y, scene->width,
+              scene->height);
+      return NULL;
+    }
+    int right = bounds.x + bounds.width;
+    int bottom = bounds.y + bounds.height;
+    right = tile->x + tile->width > right ? tile->x + tile->width : right;
+    bottom = tile->y + tile->height > bottom ? tile->y + tile->height : bottom;
+    bounds.x = tile->x < bounds.x ? tile->x : bounds.x;
+    bounds.y = tile->y < bounds.y ? tile->y : bounds.y;
+    bounds.width = right - bounds.x;
+    bounds.height = bottom - bounds.y;
+  }
+
+  RayFramebuffer *fb = ray_create_framebuffer(bounds.width, bounds.height);
+  if (fb == NULL) {
+    return NULL;
+  }
+  fb->x = bounds.x;
+  fb->y = bounds.y;
+  if (!render_tiles_into(renderer, scene, tiles, num_tiles, fb, NULL)) {
+    ray_free_framebuffer(fb);
+    return NULL;
+  }
+  return fb;
+}
+
+RayFramebuffer *ray_renderer_render_region(RayRenderer *renderer,
+                                           const RayScene *scene,
+                                           RayTile region) {
+  // clipped to the image
+  int right = region.x + region.width;
+  int bottom = region.y + region.height;
+  region.x = region.x > 0 ? region.x : 0;
+  region.y = region.y > 0 ? region.y : 0;
+  region.width = (right < scene->width ? right : scene->width) - region.x;
+  region.height = (bottom < scene->height ? bottom : scene->height) - region.y;
+  if (region.width <= 0 || region.height <= 0) {
+    return NULL;
+  }
+
+  int num_tiles;
+  RayTile *tiles = ray_create_tiles(region.width, region.height,
+                                    renderer->settings.tile_size,
+                                    renderer->settings.tile_order, &num_tiles);
+  if (tiles == NULL) {
+    return NULL;
+  }
+  for (int t = 0; t < num_tiles; ++t) {
+    tiles[t].x += region.x;
+    tiles[t].y += region.y;
+  }
+  RayFramebuffer *fb =
+      ray_renderer_render_tiles(renderer, scene, tiles, num_tiles);
+  free(tiles);
+  return fb;
+}
+
+// everything a checkpointed render needs on top of a plain one, false if it
+// can't be allocated. the queue gets the tiles the journal doesn't have
+static bool create_checkpoint(RayRenderer *renderer, const RayScene *scene,
+                              const RayCheckpointSettings *settings,
+                              RayFramebuffer *fb, RenderCheckpoint *checkpoint,
+                              RayTile *queued, int *num_queued) {
+  const int num_tiles = renderer->num_tiles;
+  bool *done = malloc((num_tiles + 1) * (sizeof *done));
+  *checkpoint = (RenderCheckpoint){
+      .fb = fb,
+      .interval_ns = settings->interval > 0.0
+                         ? (long long)(settings->interval * 1e9)
+                         : 0,
+      .tile_index =
+          malloc((num_tiles + 1) * (sizeof *checkpoint->tile_index)),
+      .states = malloc((num_tiles + 1) * (sizeof *checkpoint->states)),
+      .num_tiles = num_tiles,
+      .appending = malloc((num_tiles + 1) * (sizeof *checkpoint->appending)),
+  };
+  if (done == NULL || checkpoint->tile_index == NULL ||
+      checkpoint->states == NULL || checkpoint->appending == NULL) {
+    free(done);
+    return false;
+  }
+  checkpoint->journal =
+      ray_open_journal(settings->path, settings->key, scene->width,
+                       scene->height, renderer->tiles, num_tiles, fb, done);
+  if (checkpoint->journal == NULL) {
+    free(done);
+    return false;
+  }
+
+  *num_queued = 0;
+  for (int t = 0; t < num_tiles; ++t) {
+    atomic_init(&checkpoint->states[t],
+                done[t] ? TILE_STATE_journaled : TILE_STATE_todo);
+    if (!done[t]) {
+      checkpoint->tile_index[*num_queued] = t;
+      queued[(*num_queued)++] = renderer->tiles[t];
+    }
+  }
+  free(done);
+  atomic_init(&checkpoint->due_ns, now_ns() + checkpoint->interval_ns);
+  pthread_mutex_init(&checkpoint->lock, NULL);
+  return true;
+}
+
+static void free_checkpoint(RenderCheckpoint *checkpoint) {
+  if (checkpoint->journal != NULL) {
+    ray_close_journal(checkpoint->journal);
+    pthread_mutex_destroy(&checkpoint->lock);
+  }
+  free(checkpoint->tile_index);
+  free(checkpoint->states);
+  free(checkpoint->appending);
+}
+
+RayFramebuffer *
+ray_renderer_render_checkpointed(RayRenderer *renderer, const RayScene *scene,
+                                 const RayCheckpointSettings *settings) {
+  RayFramebuffer *fb = ray_create_framebuffer(scene->width, scene->height);
+  if (fb == NULL || !prepare_tiles(renderer, scene)) {
+    ray_free_framebuffer(fb);
+    return NULL;
+  }
+  RayTile *queued = malloc((renderer->num_tiles + 1) * (sizeof *queued));
+  RenderCheckpoint checkpoint = {0};
+  int num_queued;
+  bool success = queued != NULL &&
+                 create_checkpoint(renderer, scene, settings, fb, &checkpoint,
+                                   queued, &num_queued) &&
+                 render_tiles_into(renderer, scene, queued, num_queued, fb,
+                                   &checkpoint);
+  if (success) {
+    // whatever finished since the last append
+    append_checkpoint(&checkpoint);
+  }
+
+  free_checkpoint(&checkpoint);
+  free(queued);
+  if (!success) {
+    ray_free_framebuffer(fb);
+    return NULL;
+  }
+  return fb;
+}
+
+RayImg *ray_renderer_render(RayRenderer *renderer, const RayScene *scene) {
+  RayFramebuffer *fb = ray_renderer_render_hdr(renderer, scene);
+  if (fb == NULL) {
+    return NULL;
+  }
+  RayImg *img = ray_tone_map(fb, &renderer->settings.tone_map);
+  ray_free_framebuffer(fb);
+  return img;
+}
+
+RayImg *ray_render_scene_with_settings(const RayScene *scene,
+                                       const RayRenderSettings *settings) {
+  RayRenderer *renderer = ray_create_renderer(settings);
+  if (renderer == NULL) {
+    return NULL;
+  }
+  RayImg *img = ray_renderer_render(renderer, scene);
+  ray_free_renderer(renderer);
+  return img;
+}
 
 RayImg *ray_render_scene(const RayScene *scene) {
-  pthread_mutex_t lock;
+  return ray_render_scene_with_settings(scene, NULL);
+}
+
+void ray_cancel_token_init(RayCancelToken *token) {
+  atomic_init(&token->cancelled, false);
+}
+
+void ray_cancel_token_cancel(RayCancelToken *token) {
+  atomic_store(&token->cancelled, true);
+}
+
+bool ray_cancel_token_cancelled(RayCancelToken *token) {
+  return atomic_load(&token->cancelled);
+}
+
+#define DEFAULT_INITIAL_STEP 8
+
+typedef struct ProgressiveState {
+  const RayScene *scene;
+  RayFramebuffer *fb;
+  RayCancelToken *cancel;
+  bool has_deadline;
+  struct timespec deadline;
+  // set once any worker notices it should stop so the rest don't have to
+  // check the clock again
+  atomic_bool stopped;
+} ProgressiveState;
+
+typedef struct RenderPass {
+  ProgressiveState *state;
+  int step;
+  bool first;
+  int num_threads;
+} RenderPass;
+
+static bool deadline_passed(const struct timespec *deadline) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec > deadline->tv_sec ||
+         (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
 
-  if (pthread_mutex_init(&lock, NULL) != 0) {
+static bool progressive_should_stop(ProgressiveState *state) {
+  if (atomic_load_explicit(&state->stopped, memory_order_relaxed)) {
+    return true;
+  }
+  bool stop =
+      (state->cancel != NULL && ray_cancel_token_cancelled(state->cancel)) ||
+      (state->has_deadline && deadline_passed(&state->deadline));
+  if (stop) {
+    atomic_store(&state->stopped, true);
+  }
+  return stop;
+}
+
+// copy a sample over the step x step block it stands in for until a finer
+// pass replaces it
+static void fill_block(RayFramebuffer *fb, int x, int y, int step,
+                       const gsl_vector *color) {
+  int end_y = y + step < fb->height ? y + step : fb->height;
+  int end_x = x + step < fb->width ? x + step : fb->width;
+  for (int by = y; by < end_y; by += 1) {
+    for (int bx = x; bx < end_x; bx += 1) {
+      ray_framebuffer_set(fb, bx, by, color);
+    }
+  }
+}
+
+void *ray_render_pass_range(void *voidArgs) {
+  RenderWorker *worker = voidArgs;
+  RayRenderContext *ctx = worker->ctx;
+  const RenderPass *pass = worker->job;
+  ProgressiveState *state = pass->state;
+  const RayScene *scene = state->scene;
+  const int step = pass->step;
+  ray_render_context_start_perf(ctx);
+
+  // rows are interleaved between threads so each gets a similar share of the
+  // expensive parts of the image
+  for (int y = ctx->index * step; y < scene->height;
+       y += step * pass->num_threads) {
+    if (progressive_should_stop(state)) {
+      break;
+    }
+    // rows the previous pass already sampled only need the new columns
+    bool sampled_row = !pass->first && (y % (step * 2) == 0);
+    int x_start = sampled_row ? step : 0;
+    int x_step = sampled_row ? step * 2 : step;
+    for (int x = x_start; x < scene->width; x += x_step) {
+      gsl_vector *color = trace_pixel(ctx, scene, x, y);
+      enter_stage(ctx, RAY_RENDER_STAGE_output);
+      fill_block(state->fb, x, y, step, color);
+      ray_arena_reset(ctx->arena);
+    }
+  }
+
+  ray_render_context_stop_perf(ctx);
+  return NULL;
+}
+
+static int floor_power_of_two(int val) {
+  int pow = 1;
+  while (pow * 2 <= val) {
+    pow *= 2;
+  }
+  return pow;
+}
+
+RayImg *ray_renderer_render_progressive(RayRenderer *renderer,
+                                        const RayScene *scene,
+                                        const RayProgressiveOptions *options,
+                                        int *completed_step) {
+  const RayProgressiveOptions default_options = {0};
+  if (options == NULL) {
+    options = &default_options;
+  }
+
+  // zeroed, so every pixel is always valid and a cancelled render can still
+  // be written out
+  RayFramebuffer *fb = ray_create_framebuffer(scene->width, scene->height);
+  if (fb == NULL) {
+    return NULL;
+  }
+  if (!prepare_contexts(renderer, scene)) {
+    ray_free_framebuffer(fb);
+    return NULL;
+  }
+  RayImg *img = ray_create_packed_img(scene->width, scene->height, 3);
+  if (img == NULL) {
+    release_prepared(renderer);
+    ray_free_framebuffer(fb);
     return NULL;
   }
 
-  RayImg *img = ray_create_img(scene->width, scene->height, 3);
-  ThreadImg thread_img = {
-      .lock = &lock,
-      .img = img,
+  ProgressiveState state = {
+      .scene = scene,
+      .fb = fb,
+      .cancel = options->cancel,
+      .has_deadline = options->time_budget > 0.0,
   };
+  atomic_init(&state.stopped, false);
+  if (state.has_deadline) {
+    clock_gettime(CLOCK_MONOTONIC, &state.deadline);
+    double whole = 0.0;
+    double frac = modf(options->time_budget, &whole);
+    state.deadline.tv_sec += (time_t)whole;
+    state.deadline.tv_nsec += (long)(frac * 1e9);
+    if (state.deadline.tv_nsec >= 1000000000L) {
+      state.deadline.tv_sec += 1;
+      state.deadline.tv_nsec -= 1000000000L;
+    }
+  }
 
-  const int thread_range = scene->height / NUM_THREADS;
-  ThreadCtx threads[NUM_THREADS];
-  for (int t = 0; t < NUM_THREADS; t += 1) {
-    int adjusted_range = thread_range;
-    if (t == (NUM_THREADS - 1)) {
-      adjusted_range += (scene->height % NUM_THREADS);
-    }
-    int start = thread_range * t;
-    int range = adjusted_range;
-    RenderSceneRangeArgs *args = malloc(sizeof *args);
-    *args = (RenderSceneRangeArgs){
-        .scene = scene,
-        .thread_img = &thread_img,
-        .start = start,
-        .range = range,
+  int step = floor_power_of_two(options->initial_step > 0
+                                    ? options->initial_step
+                                    : DEFAULT_INITIAL_STEP);
+  int last_step = 0;
+  for (bool first = true; step >= 1; step /= 2, first = false) {
+    RenderPass pass = {
+        .state = &state,
+        .step = step,
+        .first = first,
+        .num_threads = renderer->num_threads,
     };
-    pthread_t thread;
-    if (pthread_create(&thread, NULL, &ray_render_scene_range, args) != 0) {
-      return NULL;
+    run_workers(renderer, &ray_render_pass_range, &pass);
+
+    if (atomic_load(&state.stopped)) {
+      break;
+    }
+
+    last_step = step;
+    if (options->on_pass == NULL) {
+      continue;
+    }
+    ray_tone_map_into(fb, &renderer->settings.tone_map, img);
+    if (!options->on_pass(img, step, options->user_data)) {
+      break;
     }
-    ThreadCtx thread_ctx = {
-        .thread = thread,
-        .args = args,
-    };
-    threads[t] = thread_ctx;
   }
 
-  for (int t = 0; t < NUM_THREADS; t += 1) {
-    pthread_join(threads[t].thread, NULL);
-    free(threads[t].args);
+  release_prepared(renderer);
+  ray_tone_map_into(fb, &renderer->settings.tone_map, img);
+  ray_free_framebuffer(fb);
+
+  if (completed_step != NULL) {
+    *completed_step = last_step;
   }
+  return img;
+}
 
-  pthread_mutex_destroy(&lock);
+RayImg *ray_render_scene_progressive(const RayScene *scene,
+                                     const RayProgressiveOptions *options,
+                                     int *completed_step) {
+  RayRenderer *renderer = ray_create_renderer(NULL);
+  if (renderer == NULL) {
+    return NULL;
+  }
+  RayImg *img = ray_renderer_render_progressive(renderer, scene, options,
+                                                completed_step);
+  ray_free_renderer(renderer);
   return img;
 }
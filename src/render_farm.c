@@ -0,0 +1,416 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for fork, socketpair, kill, waitpid and sysconf
+#define _POSIX_C_SOURCE 200809L
+
+#include "ray/render_farm.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "ray/tile.h"
+
+#define DEFAULT_BATCH_SIZE 8
+// batches a worker has been sent but hasn't answered yet, so it has the next
+// one to start on as soon as it sends one back
+#define MAX_PENDING 2
+
+// all that's sent either way is batch indices, the tiles themselves were
+// worked out before the workers were forked so both sides already have
+// them. the answer to a batch is its index followed by the pixels of each
+// of its tiles in turn, row by row
+
+typedef struct FarmBatches {
+  const RayTile *tiles;
+  int num_tiles;
+  int batch_size;
+  int num_batches;
+} FarmBatches;
+
+typedef struct FarmWorker {
+  pid_t pid;
+  // -1 once it's gone
+  int fd;
+  // oldest first
+  int pending[MAX_PENDING];
+  int num_pending;
+} FarmWorker;
+
+RayFarmSettings ray_default_farm_settings(void) {
+  RayRenderSettings render = ray_default_render_settings();
+  render.num_threads = 1;
+  return (RayFarmSettings){
+      .num_workers = 0,
+      .batch_size = DEFAULT_BATCH_SIZE,
+      .render = render,
+      .on_worker_start = NULL,
+      .data = NULL,
+  };
+}
+
+static int batch_first_tile(const FarmBatches *batches, int batch) {
+  return batch * batches->batch_size;
+}
+
+static int batch_num_tiles(const FarmBatches *batches, int batch) {
+  int first = batch_first_tile(batches, batch);
+  return first + batches->batch_size < batches->num_tiles
+             ? batches->batch_size
+             : batches->num_tiles - first;
+}
+
+static size_t batch_size_bytes(const FarmBatches *batches, int batch) {
+  size_t pixels = 0;
+  int first = batch_first_tile(batches, batch);
+  for (int t = first; t < first + batch_num_tiles(batches, batch); ++t) {
+    pixels += (size_t)batches->tiles[t].width * batches->tiles[t].height;
+  }
+  return pixels * RAY_FRAMEBUFFER_CHANNELS * (sizeof(float));
+}
+
+// send and recv can both stop short. MSG_NOSIGNAL so the other end going
+// away is an error rather than SIGPIPE
+static bool send_all(int fd, const void *data, size_t size) {
+  const char *bytes = data;
+  while (size > 0) {
+    ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += sent;
+    size -= (size_t)sent;
+  }
+  return true;
+}
+
+// false on errors and if the other end hangs up first
+static bool recv_all(int fd, void *data, size_t size) {
+  char *bytes = data;
+  while (size > 0) {
+    ssize_t received = recv(fd, bytes, size, 0);
+    if (received < 0 && errno == EINTR) {
+      continue;
+    }
+    if (received <= 0) {
+      return false;
+    }
+    bytes += received;
+    size -= (size_t)received;
+  }
+  return true;
+}
+
+// what a worker process does until the coordinator hangs up
+static void run_worker(const RayScene *scene, const FarmBatches *batches,
+                       const RayFarmSettings *settings, int fd) {
+  RayRenderer *renderer = ray_create_renderer(&settings->render);
+  size_t capacity = 0;
+  char *reply = NULL;
+  int batch;
+  while (renderer != NULL && recv_all(fd, &batch, sizeof batch)) {
+    if (batch < 0 || batch >= batches->num_batches) {
+      break;
+    }
+    const RayTile *tiles = &batches->tiles[batch_first_tile(batches, batch)];
+    const int num_tiles = batch_num_tiles(batches, batch);
+    size_t size = sizeof batch + batch_size_bytes(batches, batch);
+    if (size > capacity) {
+      free(reply);
+      reply = malloc(size);
+      capacity = reply != NULL ? size : 0;
+    }
+    RayFramebuffer *fb =
+        ray_renderer_render_tiles(renderer, scene, tiles, num_tiles);
+    if (reply == NULL || fb == NULL) {
+      ray_free_framebuffer(fb);
+      break;
+    }
+
+    memcpy(reply, &batch, sizeof batch);
+    char *pixels = reply + sizeof batch;
+    for (int t = 0; t < num_tiles; ++t) {
+      const RayTile *tile = &tiles[t];
+      size_t row_size =
+          (size_t)tile->width * RAY_FRAMEBUFFER_CHANNELS * (sizeof(float));
+      for (int y = tile->y; y < tile->y + tile->height; ++y) {
+        memcpy(pixels,
+               ray_framebuffer_pixel(fb, tile->x - fb->x, y - fb->y),
+               row_size);
+        pixels += row_size;
+      }
+    }
+    ray_free_framebuffer(fb);
+    if (!send_all(fd, reply, size)) {
+      break;
+    }
+  }
+  free(reply);
+  if (renderer != NULL) {
+    ray_free_renderer(renderer);
+  }
+}
+
+static void close_worker(FarmWorker *worker) {
+  if (worker->fd >= 0) {
+    close(worker->fd);
+    worker->fd = -1;
+  }
+}
+
+// forks the workers, false if any can't be started (the ones that were
+// still need stopping)
+static bool start_workers(const RayScene *scene, const FarmBatches *batches,
+                          const RayFarmSettings *settings,
+                          FarmWorker *workers, int num_workers) {
+  // anything buffered would be written again by every worker
+  fflush(NULL);
+  for (int w = 0; w < num_workers; ++w) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+      fprintf(stderr, "failed to create a socket for render worker %d\n", w);
+      return false;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+      // only its own end of its own socket
+      for (int other = 0; other < w; ++other) {
+        close_worker(&workers[other]);
+      }
+      close(fds[0]);
+      if (settings->on_worker_start != NULL) {
+        settings->on_worker_start(w, settings->data);
+      }
+      run_worker(scene, batches, settings, fds[1]);
+      _exit(0);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+      close(fds[0]);
+      fprintf(stderr, "failed to start render worker %d\n", w);
+      return false;
+    }
+    workers[w] = (FarmWorker){.pid = pid, .fd = fds[0]};
+  }
+  return true;
+}
+
+// hangs up on every worker still there and waits for them to finish
+static void stop_workers(FarmWorker *workers, int num_workers) {
+  for (int w = 0; w < num_workers; ++w) {
+    close_worker(&workers[w]);
+  }
+  for (int w = 0; w < num_workers; ++w) {
+    if (workers[w].pid > 0) {
+      while (waitpid(workers[w].pid, NULL, 0) < 0 && errno == EINTR) {
+      }
+    }
+  }
+}
+
+// a worker that's gone away (or sent back nonsense) gets no more batches,
+// and the ones it had go back on the queue
+static void fail_worker(FarmWorker *worker, int *queue, int *queued,
+                        RayFarmStats *stats) {
+  close_worker(worker);
+  kill(worker->pid, SIGKILL);
+  for (int p = worker->num_pending - 1; p >= 0; --p) {
+    queue[(*queued)++] = worker->pending[p];
+  }
+  stats->requeued_batches += worker->num_pending;
+  stats->failed_workers += 1;
+  worker->num_pending = 0;
+}
+
+// reads a worker's answer to its oldest batch into fb
+static bool receive_batch(const FarmBatches *batches, FarmWorker *worker,
+                          RayFramebuffer *fb, float *scratch) {
+  int batch;
+  if (!recv_all(worker->fd, &batch, sizeof batch) ||
+      batch != worker->pending[0] ||
+      !recv_all(worker->fd, scratch, batch_size_bytes(batches, batch))) {
+    return false;
+  }
+  const float *pixels = scratch;
+  int first = batch_first_tile(batches, batch);
+  for (int t = first; t < first + batch_num_tiles(batches, batch); ++t) {
+    const RayTile *tile = &batches->tiles[t];
+    size_t row_length = (size_t)tile->width * RAY_FRAMEBUFFER_CHANNELS;
+    for (int y = tile->y; y < tile->y + tile->height; ++y) {
+      memcpy(ray_framebuffer_pixel(fb, tile->x, y), pixels,
+             row_length * (sizeof *pixels));
+      pixels += row_length;
+    }
+  }
+  memmove(worker->pending, worker->pending + 1,
+          (worker->num_pending - 1) * (sizeof *worker->pending));
+  worker->num_pending -= 1;
+  return true;
+}
+
+// hands out batches until they've all come back, false if every worker is
+// gone first
+static bool coordinate(const FarmBatches *batches, FarmWorker *workers,
+                       int num_workers, RayFramebuffer *fb,
+                       RayFarmStats *stats) {
+  // every batch is always exactly one of queued, pending with a worker or
+  // done, so the queue never needs more room than there are batches
+  int *queue = malloc((batches->num_batches + 1) * (sizeof *queue));
+  struct pollfd *polls = malloc(num_workers * (sizeof *polls));
+  int *polled = malloc(num_workers * (sizeof *polled));
+  size_t largest = 0;
+  for (int b = 0; b < batches->num_batches; ++b) {
+    size_t size = batch_size_bytes(batches, b);
+    largest = size > largest ? size : largest;
+  }
+  float *scratch = malloc(largest + 1);
+  bool success = queue != NULL && polls != NULL && polled != NULL &&
+                 scratch != NULL;
+
+  // popped from the end, so first batch first
+  int queued = batches->num_batches;
+  for (int b = 0; success && b < batches->num_batches; ++b) {
+    queue[b] = batches->num_batches - 1 - b;
+  }
+  int done = 0;
+  while (success && done < batches->num_batches) {
+    int num_polls = 0;
+    for (int w = 0; w < num_workers; ++w) {
+      FarmWorker *worker = &workers[w];
+      while (worker->fd >= 0 && worker->num_pending < MAX_PENDING &&
+             queued > 0) {
+        int batch = queue[--queued];
+        worker->pending[worker->num_pending++] = batch;
+        if (!send_all(worker->fd, &batch, sizeof batch)) {
+          fail_worker(worker, queue, &queued, stats);
+        }
+      }
+      if (worker->fd >= 0 && worker->num_pending > 0) {
+        polls[num_polls] = (struct pollfd){.fd = worker->fd, .events = POLLIN};
+        polled[num_polls++] = w;
+      }
+    }
+    if (num_polls == 0) {
+      fprintf(stderr, "every render worker failed\n");
+      success = false;
+      break;
+    }
+
+    if (poll(polls, num_polls, -1) < 0) {
+      success = errno == EINTR;
+      continue;
+    }
+    for (int p = 0; p < num_polls; ++p) {
+      if (polls[p].revents == 0) {
+        continue;
+      }
+      FarmWorker *worker = &workers[polled[p]];
+      if (receive_batch(batches, worker, fb, scratch)) {
+        done += 1;
+      } else {
+        fail_worker(worker, queue, &queued, stats);
+      }
+    }
+  }
+
+  free(queue);
+  free(polls);
+  free(polled);
+  free(scratch);
+  return success;
+}
+
+RayFramebuffer *ray_farm_render_hdr(const RayScene *scene,
+                                    const RayFarmSettings *settings,
+                                    RayFarmStats *stats) {
+  RayFarmSettings defaults = ray_default_farm_settings();
+  settings = settings != NULL ? settings : &defaults;
+  RayFarmStats ignored;
+  stats = stats != NULL ? stats : &ignored;
+
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  int num_workers = settings->num_workers > 0 ? settings->num_workers
+                    : online > 0              ? (int)online
+                                              : 1;
+  int tile_size = settings->render.tile_size > 0
+                      ? settings->render.tile_size
+                      : ray_default_render_settings().tile_size;
+  FarmBatches batches = {
+      .batch_size = settings->batch_size > 0 ? settings->batch_size
+                                             : DEFAULT_BATCH_SIZE,
+  };
+  RayTile *tiles =
+      ray_create_tiles(scene->width, scene->height, tile_size,
+                       settings->render.tile_order, &batches.num_tiles);
+  batches.tiles = tiles;
+  batches.num_batches =
+      (batches.num_tiles + batches.batch_size - 1) / batches.batch_size;
+  *stats = (RayFarmStats){
+      .num_workers = num_workers,
+      .num_batches = batches.num_batches,
+  };
+
+  RayFramebuffer *fb = ray_create_framebuffer(scene->width, scene->height);
+  FarmWorker *workers = calloc(num_workers, sizeof *workers);
+  if (tiles == NULL || fb == NULL || workers == NULL) {
+    free(tiles);
+    ray_free_framebuffer(fb);
+    free(workers);
+    return NULL;
+  }
+  for (int w = 0; w < num_workers; ++w) {
+    workers[w] = (FarmWorker){.pid = -1, .fd = -1};
+  }
+
+  bool success =
+      start_workers(scene, &batches, settings, workers, num_workers) &&
+      coordinate(&batches, workers, num_workers, fb, stats);
+  stop_workers(workers, num_workers);
+
+  free(workers);
+  free(tiles);
+  if (!success) {
+    ray_free_framebuffer(fb);
+    return NULL;
+  }
+  return fb;
+}
+
+RayImg *ray_farm_render(const RayScene *scene, const RayFarmSettings *settings,
+                        RayFarmStats *stats) {
+  RayFarmSettings defaults = ray_default_farm_settings();
+  settings = settings != NULL ? settings : &defaults;
+  RayFramebuffer *fb = ray_farm_render_hdr(scene, settings, stats);
+  if (fb == NULL) {
+    return NULL;
+  }
+  RayImg *img = ray_tone_map(fb, &settings->render.tone_map);
+  ray_free_framebuffer(fb);
+  return img;
+}
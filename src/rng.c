@@ -0,0 +1,38 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include "ray/rng.h"
+
+void ray_rng_seed(RayRng *rng, uint64_t seed) {
+  rng->state = seed;
+  // mix the seed so neighbouring pixels don't start off correlated
+  ray_rng_next(rng);
+}
+
+uint64_t ray_rng_next(RayRng *rng) {
+  rng->state += UINT64_C(0x9e3779b97f4a7c15);
+  uint64_t z = rng->state;
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
+double ray_rng_uniform(RayRng *rng) {
+  // top 53 bits fill a double's mantissa exactly
+  return (double)(ray_rng_next(rng) >> 11) * 0x1.0p-53;
+}
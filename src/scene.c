@@ -19,6 +19,13 @@
 #include "ray/scene.h"
 
 void ray_free_scene(RayScene *scene) {
+  if (scene->arena != NULL) {
+    // objects, lights and their vectors all live in the arena and textures
+    // are registered as cleanups so there's nothing to walk
+    ray_free_arena(scene->arena);
+    return;
+  }
+
   gsl_vector_free(scene->background);
   for (int i = 0; i < scene->num_objects; ++i) {
     ray_free_object(&scene->objects[i]);
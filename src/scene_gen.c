@@ -0,0 +1,542 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ray/img_utils.h"
+#include "ray/rng.h"
+#include "ray/scene_gen.h"
+
+// what each element's random numbers are drawn from
+typedef enum GEN_STREAM {
+  GEN_STREAM_cluster,
+  GEN_STREAM_sphere,
+  GEN_STREAM_plane,
+  GEN_STREAM_light,
+  GEN_STREAM_texture,
+} GEN_STREAM;
+
+// where things go, worked out once from the settings
+typedef struct GenLayout {
+  // the box the spheres are in
+  double low[3];
+  double high[3];
+  double radius;
+  int num_clusters;
+  // the settings' fractions turned into thresholds on one uniform draw
+  double reflective_below;
+  double refractive_below;
+  int num_textures;
+} GenLayout;
+
+// an element as plain numbers, before it's made into a RayObject or written
+typedef struct GenMaterial {
+  double color[3];
+  // -1 for a plain color
+  int texture;
+  double albedo;
+  RaySurface surface;
+} GenMaterial;
+
+typedef struct GenObject {
+  enum RAY_OBJECT_TYPE type;
+  // centre for spheres, a point on it for planes
+  double position[3];
+  double radius;
+  double normal[3];
+  GenMaterial material;
+} GenObject;
+
+typedef struct GenLight {
+  double position[3];
+  double color[3];
+  double intensity;
+} GenLight;
+
+#define GEN_SPACING 1.5
+
+RaySceneGenSettings ray_default_scene_gen_settings(void) {
+  return (RaySceneGenSettings){
+      .seed = 1,
+      .width = 320,
+      .height = 240,
+      .num_spheres = 1000,
+      .clustering = 0.0,
+      .num_clusters = 8,
+      .num_planes = 2,
+      .num_lights = 4,
+      .reflective_fraction = 0.1,
+      .refractive_fraction = 0.05,
+      .textured_fraction = 0.0,
+      .num_textures = 4,
+      .texture_size = 256,
+  };
+}
+
+static void element_rng(const RaySceneGenSettings *settings,
+                        GEN_STREAM stream, int index, RayRng *rng) {
+  // ray_rng_seed mixes this, so neighbouring indices aren't related
+  ray_rng_seed(rng, settings->seed * UINT64_C(0x100000001b3) +
+                        ((uint64_t)stream << 40) + (uint64_t)index);
+}
+
+static double uniform_between(RayRng *rng, double low, double high) {
+  return low + (high - low) * ray_rng_uniform(rng);
+}
+
+static int uniform_index(RayRng *rng, int count) {
+  int index = (int)(ray_rng_uniform(rng) * count);
+  return index < count ? index : count - 1;
+}
+
+static GenLayout create_layout(const RaySceneGenSettings *settings) {
+  // a cube about GEN_SPACING per sphere along each side, far enough in front
+  // of the camera that a 90 degree fov takes it all in
+  int num_spheres = settings->num_spheres > 0 ? settings->num_spheres : 1;
+  double side = GEN_SPACING * cbrt(num_spheres);
+  side = side > 4.0 ? side : 4.0;
+  double near = side / 2.0 + 2.0;
+  GenLayout layout = {
+      .low = {-side / 2.0, -side / 2.0, -near - side},
+      .high = {side / 2.0, side / 2.0, -near},
+      .radius = 0.3 * GEN_SPACING,
+      .num_clusters = settings->num_clusters > 0 ? settings->num_clusters : 1,
+      .reflective_below = settings->reflective_fraction,
+      .refractive_below =
+          settings->reflective_fraction + settings->refractive_fraction,
+      .num_textures = settings->textured_fraction > 0.0 &&
+                              settings->texture_size > 0
+                          ? settings->num_textures
+                          : 0,
+  };
+  return layout;
+}
+
+static GenMaterial random_material(const GenLayout *layout, RayRng *rng,
+                                   double textured_fraction) {
+  GenMaterial material = {
+      .color = {uniform_between(rng, 0.1, 1.0), uniform_between(rng, 0.1, 1.0),
+                uniform_between(rng, 0.1, 1.0)},
+      .texture = -1,
+      .albedo = 0.18,
+      .surface = {.type = RAY_SURFACE_TYPE_diffuse},
+  };
+  // drawn whether or not they're used so the fractions don't change what
+  // comes after
+  double textured = ray_rng_uniform(rng);
+  int texture = layout->num_textures > 0
+                    ? uniform_index(rng, layout->num_textures)
+                    : -1;
+  double surface = ray_rng_uniform(rng);
+  double a = ray_rng_uniform(rng);
+  double b = ray_rng_uniform(rng);
+  if (texture >= 0 && textured < textured_fraction) {
+    material.texture = texture;
+  }
+  if (surface < layout->reflective_below) {
+    material.surface = (RaySurface){
+        .type = RAY_SURFACE_TYPE_reflective,
+        .reflectivity = 0.3 + 0.6 * a,
+    };
+  } else if (surface < layout->refractive_below) {
+    material.surface = (RaySurface){
+        .type = RAY_SURFACE_TYPE_refractive,
+        .index = 1.3 + 0.4 * a,
+        .transparency = 0.8 + 0.2 * b,
+    };
+  }
+  return material;
+}
+
+static void cluster_center(const RaySceneGenSettings *settings,
+                           const GenLayout *layout, int cluster,
+                           double center[3]) {
+  RayRng rng;
+  element_rng(settings, GEN_STREAM_cluster, cluster, &rng);
+  for (int i = 0; i < 3; ++i) {
+    center[i] = uniform_between(&rng, layout->low[i], layout->high[i]);
+  }
+}
+
+static GenObject generate_sphere(const RaySceneGenSettings *settings,
+                                 const GenLayout *layout, int index) {
+  RayRng rng;
+  element_rng(settings, GEN_STREAM_sphere, index, &rng);
+  GenObject object = {.type = RAY_OBJECT_TYPE_sphere};
+
+  // a point anywhere in the box pulled towards the sphere's cluster
+  double center[3];
+  cluster_center(settings, layout, uniform_index(&rng, layout->num_clusters),
+                 center);
+  double clustering = settings->clustering < 0.0   ? 0.0
+                      : settings->clustering > 1.0 ? 1.0
+                                                   : settings->clustering;
+  for (int i = 0; i < 3; ++i) {
+    double anywhere = uniform_between(&rng, layout->low[i], layout->high[i]);
+    object.position[i] =
+        center[i] + (anywhere - center[i]) * (1.0 - clustering);
+  }
+  object.radius = layout->radius * uniform_between(&rng, 0.5, 1.0);
+  object.material =
+      random_material(layout, &rng, settings->textured_fraction);
+  return object;
+}
+
+static GenObject generate_plane(const RaySceneGenSettings *settings,
+                                const GenLayout *layout, int index) {
+  RayRng rng;
+  element_rng(settings, GEN_STREAM_plane, index, &rng);
+  // normals point away from the camera, like in the hand written scenes
+  GenObject object = {.type = RAY_OBJECT_TYPE_plane};
+  if (index == 1) {
+    object.position[2] = layout->low[2] - 2.0 * layout->radius;
+    object.normal[2] = -1.0;
+  } else {
+    double below = index == 0 ? 0.0 : 0.5 * (index - 1);
+    object.position[1] = layout->low[1] - layout->radius - below;
+    object.normal[1] = -1.0;
+  }
+  object.material =
+      random_material(layout, &rng, settings->textured_fraction);
+  return object;
+}
+
+static GenLight generate_light(const RaySceneGenSettings *settings,
+                               const GenLayout *layout, int index) {
+  RayRng rng;
+  element_rng(settings, GEN_STREAM_light, index, &rng);
+  double side = layout->high[0] - layout->low[0];
+  double middle = (layout->low[2] + layout->high[2]) / 2.0;
+  GenLight light = {
+      .position = {uniform_between(&rng, layout->low[0], layout->high[0]),
+                   layout->high[1] + uniform_between(&rng, 1.0, side / 2.0),
+                   uniform_between(&rng, middle, 0.0)},
+      .color = {1.0, uniform_between(&rng, 0.7, 1.0),
+                uniform_between(&rng, 0.5, 1.0)},
+      // about the same light in total however many there are, enough to
+      // light up the far side of the box
+      .intensity = 400.0 * side * side / settings->num_lights *
+                   uniform_between(&rng, 0.5, 1.5),
+  };
+  return light;
+}
+
+// a checkerboard of two colors, in 8 bit steps so writing it as a png and
+// reading it back gives exactly the same texels
+static RayImg *generate_texture(const RaySceneGenSettings *settings,
+                                int index) {
+  RayRng rng;
+  element_rng(settings, GEN_STREAM_texture, index, &rng);
+  double colors[2][3];
+  for (int c = 0; c < 2; ++c) {
+    for (int i = 0; i < 3; ++i) {
+      colors[c][i] = (double)uniform_index(&rng, UCHAR_MAX + 1) / UCHAR_MAX;
+    }
+  }
+  const int size = settings->texture_size;
+  const int checks = 2 << uniform_index(&rng, 4);
+  RayImg *img = ray_create_packed_img(size, size, 3);
+  if (img == NULL) {
+    return NULL;
+  }
+  for (int y = 0; y < size; ++y) {
+    for (int x = 0; x < size; ++x) {
+      int check = (x * checks / size + y * checks / size) % 2;
+      memcpy(img->data + ((size_t)y * size + x) * 3, colors[check],
+             sizeof colors[check]);
+    }
+  }
+  return img;
+}
+
+static RayMaterial create_material(RayArena *arena, const GenMaterial *gen,
+                                   RayImg *const *textures) {
+  RayMaterial material = {
+      .albedo = gen->albedo,
+      .surface = gen->surface,
+  };
+  if (gen->texture >= 0) {
+    material.coloration = (RayColoration){
+        .type = RAY_COLORATION_TYPE_texture,
+        .texture = textures[gen->texture],
+    };
+  } else {
+    material.coloration = (RayColoration){
+        .type = RAY_COLORATION_TYPE_color,
+        .color = ray_arena_create_vec3(arena, gen->color[0], gen->color[1],
+                                       gen->color[2]),
+    };
+  }
+  return material;
+}
+
+static RayObject create_object(RayArena *arena, const GenObject *gen,
+                               RayImg *const *textures) {
+  RayObject object = {
+      .type = gen->type,
+      .material = create_material(arena, &gen->material, textures),
+  };
+  if (gen->type == RAY_OBJECT_TYPE_sphere) {
+    object.center = ray_arena_create_vec3(arena, gen->position[0],
+                                          gen->position[1], gen->position[2]);
+    object.radius = gen->radius;
+  } else {
+    object.point = ray_arena_create_vec3(arena, gen->position[0],
+                                         gen->position[1], gen->position[2]);
+    object.normal = ray_arena_create_vec3(arena, gen->normal[0],
+                                          gen->normal[1], gen->normal[2]);
+  }
+  return object;
+}
+
+static void free_img_cleanup(void *img) { ray_free_img(img); }
+
+bool ray_generate_scene(const RaySceneGenSettings *settings, RayScene *scene) {
+  const GenLayout layout = create_layout(settings);
+  const int num_objects = settings->num_spheres + settings->num_planes;
+  RayArena *arena = ray_create_arena(0);
+  if (arena == NULL) {
+    return false;
+  }
+  *scene = (RayScene){
+      .width = settings->width,
+      .height = settings->height,
+      .fov = 90.0,
+      .shadow_bias = 1e-12,
+      .max_recursion_depth = 4,
+      .background = ray_arena_create_vec3(arena, 0.73, 0.92, 1.0),
+      .num_objects = num_objects,
+      .objects = ray_arena_alloc(arena, (num_objects + 1) *
+                                            (sizeof *scene->objects)),
+      .num_lights = settings->num_lights,
+      .lights = ray_arena_alloc(arena, (settings->num_lights + 1) *
+                                           (sizeof *scene->lights)),
+      .arena = arena,
+  };
+  RayImg **textures =
+      ray_arena_alloc(arena, (layout.num_textures + 1) * (sizeof *textures));
+  if (scene->background == NULL || scene->objects == NULL ||
+      scene->lights == NULL || textures == NULL) {
+    ray_free_arena(arena);
+    return false;
+  }
+
+  for (int t = 0; t < layout.num_textures; ++t) {
+    textures[t] = generate_texture(settings, t);
+    if (textures[t] == NULL ||
+        !ray_arena_add_cleanup(arena, free_img_cleanup, textures[t])) {
+      ray_free_img(textures[t]);
+      ray_free_arena(arena);
+      return false;
+    }
+  }
+
+  for (int i = 0; i < settings->num_spheres; ++i) {
+    GenObject gen = generate_sphere(settings, &layout, i);
+    scene->objects[i] = create_object(arena, &gen, textures);
+  }
+  for (int i = 0; i < settings->num_planes; ++i) {
+    GenObject gen = generate_plane(settings, &layout, i);
+    scene->objects[settings->num_spheres + i] =
+        create_object(arena, &gen, textures);
+  }
+  for (int i = 0; i < settings->num_lights; ++i) {
+    GenLight gen = generate_light(settings, &layout, i);
+    scene->lights[i] = (RayLight){
+        .type = RAY_LIGHT_TYPE_point,
+        .position = ray_arena_create_vec3(arena, gen.position[0],
+                                          gen.position[1], gen.position[2]),
+        .color = ray_arena_create_vec3(arena, gen.color[0], gen.color[1],
+                                       gen.color[2]),
+        .intensity = gen.intensity,
+    };
+  }
+
+  // vectors come back NULL if the arena couldn't get another block
+  bool success = true;
+  for (int i = 0; i < num_objects && success; ++i) {
+    const RayObject *object = &scene->objects[i];
+    success = (object->type == RAY_OBJECT_TYPE_sphere
+                   ? object->center != NULL
+                   : object->point != NULL && object->normal != NULL) &&
+              (object->material.coloration.type !=
+                   RAY_COLORATION_TYPE_color ||
+               object->material.coloration.color != NULL);
+  }
+  for (int i = 0; i < settings->num_lights && success; ++i) {
+    success = scene->lights[i].position != NULL &&
+              scene->lights[i].color != NULL;
+  }
+  if (!success) {
+    ray_free_arena(arena);
+  }
+  return success;
+}
+
+// enough digits that every double reads back as itself
+#define GEN_REAL "%.17g"
+#define GEN_VECTOR                                                            \
+  "{\"x\": " GEN_REAL ", \"y\": " GEN_REAL ", \"z\": " GEN_REAL "}"
+#define GEN_COLOR                                                             \
+  "{\"r\": " GEN_REAL ", \"g\": " GEN_REAL ", \"b\": " GEN_REAL "}"
+
+static void write_material(FILE *file, const GenMaterial *material,
+                           char *const *texture_paths) {
+  fprintf(file, "\"material\": {\"coloration\": ");
+  if (material->texture >= 0) {
+    fprintf(file, "{\"texture\": \"%s\"}", texture_paths[material->texture]);
+  } else {
+    fprintf(file, "{\"color\": " GEN_COLOR "}", material->color[0],
+            material->color[1], material->color[2]);
+  }
+  fprintf(file, ", \"albedo\": " GEN_REAL ", \"surface\": ", material->albedo);
+  const RaySurface *surface = &material->surface;
+  switch (surface->type) {
+  case RAY_SURFACE_TYPE_diffuse:
+    fprintf(file, "\"diffuse\"");
+    break;
+  case RAY_SURFACE_TYPE_reflective:
+    fprintf(file, "{\"reflective\": {\"reflectivity\": " GEN_REAL "}}",
+            surface->reflectivity);
+    break;
+  case RAY_SURFACE_TYPE_refractive:
+    fprintf(file,
+            "{\"refractive\": {\"index\": " GEN_REAL
+            ", \"transparency\": " GEN_REAL "}}",
+            surface->index, surface->transparency);
+    break;
+  }
+  fprintf(file, "}");
+}
+
+static void write_object(FILE *file, const GenObject *object,
+                         char *const *texture_paths, bool last) {
+  if (object->type == RAY_OBJECT_TYPE_sphere) {
+    fprintf(file,
+            "    {\"sphere\": {\"center\": " GEN_VECTOR
+            ", \"radius\": " GEN_REAL ", ",
+            object->position[0], object->position[1], object->position[2],
+            object->radius);
+  } else {
+    fprintf(file,
+            "    {\"plane\": {\"point\": " GEN_VECTOR
+            ", \"normal\": " GEN_VECTOR ", ",
+            object->position[0], object->position[1], object->position[2],
+            object->normal[0], object->normal[1], object->normal[2]);
+  }
+  write_material(file, &object->material, texture_paths);
+  fprintf(file, "}}%s\n", last ? "" : ",");
+}
+
+// <path without .json>_texture<index>.png, NULL if out of memory
+static char *texture_path(const char *path, int index) {
+  size_t stem = strlen(path);
+  if (stem >= 5 && strcmp(path + stem - 5, ".json") == 0) {
+    stem -= 5;
+  }
+  int length = snprintf(NULL, 0, "%.*s_texture%d.png", (int)stem, path, index);
+  char *texture = malloc(length + 1);
+  if (texture != NULL) {
+    snprintf(texture, length + 1, "%.*s_texture%d.png", (int)stem, path,
+             index);
+  }
+  return texture;
+}
+
+static bool write_textures(const RaySceneGenSettings *settings,
+                           const char *path, int num_textures,
+                           char **texture_paths) {
+  for (int t = 0; t < num_textures; ++t) {
+    texture_paths[t] = texture_path(path, t);
+    RayImg *img = generate_texture(settings, t);
+    bool success = texture_paths[t] != NULL && img != NULL &&
+                   ray_png_write(texture_paths[t], img);
+    if (img != NULL) {
+      ray_free_img(img);
+    }
+    if (!success) {
+      fprintf(stderr, "failed to write texture %d for %s\n", t, path);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ray_write_generated_scene(const RaySceneGenSettings *settings,
+                               const char *path) {
+  const GenLayout layout = create_layout(settings);
+  char **texture_paths =
+      calloc(layout.num_textures + 1, sizeof *texture_paths);
+  if (texture_paths == NULL ||
+      !write_textures(settings, path, layout.num_textures, texture_paths)) {
+    if (texture_paths != NULL) {
+      for (int t = 0; t < layout.num_textures; ++t) {
+        free(texture_paths[t]);
+      }
+    }
+    free(texture_paths);
+    return false;
+  }
+
+  FILE *file = fopen(path, "w");
+  if (file != NULL) {
+    fprintf(file,
+            "{\n  \"width\": %d, \"height\": %d, \"fov\": 90.0,\n"
+            "  \"shadow-bias\": 1e-12, \"max-recursion-depth\": 4,\n"
+            "  \"background\": {\"r\": 0.73, \"g\": 0.92, \"b\": 1.0},\n"
+            "  \"objects\": [\n",
+            settings->width, settings->height);
+    const int num_objects = settings->num_spheres + settings->num_planes;
+    for (int i = 0; i < settings->num_spheres; ++i) {
+      GenObject object = generate_sphere(settings, &layout, i);
+      write_object(file, &object, texture_paths, i + 1 == num_objects);
+    }
+    for (int i = 0; i < settings->num_planes; ++i) {
+      GenObject object = generate_plane(settings, &layout, i);
+      write_object(file, &object, texture_paths,
+                   settings->num_spheres + i + 1 == num_objects);
+    }
+    fprintf(file, "  ],\n  \"lights\": [\n");
+    for (int i = 0; i < settings->num_lights; ++i) {
+      GenLight light = generate_light(settings, &layout, i);
+      fprintf(file,
+              "    {\"point\": {\"position\": " GEN_VECTOR
+              ", \"color\": " GEN_COLOR ", \"intensity\": " GEN_REAL "}}%s\n",
+              light.position[0], light.position[1], light.position[2],
+              light.color[0], light.color[1], light.color[2], light.intensity,
+              i + 1 < settings->num_lights ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+  }
+  bool success = file != NULL && !ferror(file);
+  if (file != NULL) {
+    success = fclose(file) == 0 && success;
+  }
+  if (!success) {
+    fprintf(stderr, "failed to write %s\n", path);
+  }
+
+  for (int t = 0; t < layout.num_textures; ++t) {
+    free(texture_paths[t]);
+  }
+  free(texture_paths);
+  return success;
+}
@@ -0,0 +1,186 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for strdup, nanosleep and clock_gettime
+#define _POSIX_C_SOURCE 200809L
+
+#include "ray/scene_watch.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+// how long things have to be quiet after a change before it's reported
+#define SETTLE_MS 20
+// how often the modification time is checked without inotify
+#define POLL_MS 100
+
+struct RaySceneWatch {
+  char *path;
+  // the file's name in its directory
+  const char *name;
+  int fd;
+  struct timespec modified;
+};
+
+static int elapsed_ms(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int)((now.tv_sec - start->tv_sec) * 1000 +
+               (now.tv_nsec - start->tv_nsec) / 1000000);
+}
+
+static int remaining_ms(const struct timespec *start, int timeout_ms) {
+  if (timeout_ms < 0) {
+    return -1;
+  }
+  int remaining = timeout_ms - elapsed_ms(start);
+  return remaining > 0 ? remaining : 0;
+}
+
+// zero if the file doesn't exist (mid save)
+static struct timespec modified_time(const char *path) {
+  struct stat file_stat;
+  if (stat(path, &file_stat) != 0) {
+    return (struct timespec){0};
+  }
+  return file_stat.st_mtim;
+}
+
+RaySceneWatch *ray_create_scene_watch(const char *path) {
+  RaySceneWatch *watch = calloc(1, sizeof *watch);
+  if (watch == NULL) {
+    return NULL;
+  }
+  watch->path = strdup(path);
+  if (watch->path == NULL) {
+    free(watch);
+    return NULL;
+  }
+  watch->fd = -1;
+  watch->modified = modified_time(path);
+  char *slash = strrchr(watch->path, '/');
+  watch->name = slash != NULL ? slash + 1 : watch->path;
+
+#ifdef __linux__
+  watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (watch->fd >= 0) {
+    // the directory is the path up to the name
+    char *directory = slash != NULL ? strndup(path, slash - watch->path + 1)
+                                    : strdup(".");
+    int added = directory != NULL
+                    ? inotify_add_watch(watch->fd, directory,
+                                        IN_CLOSE_WRITE | IN_MOVED_TO)
+                    : -1;
+    free(directory);
+    if (added < 0) {
+      ray_free_scene_watch(watch);
+      return NULL;
+    }
+  }
+#endif
+  return watch;
+}
+
+#ifdef __linux__
+// reads whatever events are waiting, true if any were for the file
+static bool read_events(RaySceneWatch *watch) {
+  bool changed = false;
+  char buffer[4096]
+      __attribute__((aligned(__alignof__(struct inotify_event))));
+  for (;;) {
+    ssize_t got = read(watch->fd, buffer, sizeof buffer);
+    if (got <= 0) {
+      return changed;
+    }
+    for (char *at = buffer; at < buffer + got;) {
+      const struct inotify_event *event = (const struct inotify_event *)at;
+      changed = changed ||
+                (event->len > 0 && strcmp(event->name, watch->name) == 0);
+      at += sizeof *event + event->len;
+    }
+  }
+}
+
+static int wait_inotify(RaySceneWatch *watch, int timeout_ms) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  struct pollfd poll_fd = {.fd = watch->fd, .events = POLLIN};
+  for (;;) {
+    int ready = poll(&poll_fd, 1, remaining_ms(&start, timeout_ms));
+    if (ready < 0 && errno != EINTR) {
+      return -1;
+    }
+    if (ready > 0 && read_events(watch)) {
+      break;
+    }
+    if (ready == 0) {
+      return 0;
+    }
+  }
+  // let the rest of the save land
+  while (poll(&poll_fd, 1, SETTLE_MS) > 0) {
+    read_events(watch);
+  }
+  return 1;
+}
+#endif
+
+static int wait_polling(RaySceneWatch *watch, int timeout_ms) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (;;) {
+    struct timespec modified = modified_time(watch->path);
+    if (modified.tv_sec != watch->modified.tv_sec ||
+        modified.tv_nsec != watch->modified.tv_nsec) {
+      watch->modified = modified;
+      return 1;
+    }
+    int remaining = remaining_ms(&start, timeout_ms);
+    if (remaining == 0) {
+      return 0;
+    }
+    int sleep_ms = remaining > 0 && remaining < POLL_MS ? remaining : POLL_MS;
+    nanosleep(&(struct timespec){.tv_nsec = sleep_ms * 1000000L}, NULL);
+  }
+}
+
+int ray_scene_watch_wait(RaySceneWatch *watch, int timeout_ms) {
+#ifdef __linux__
+  if (watch->fd >= 0) {
+    return wait_inotify(watch, timeout_ms);
+  }
+#endif
+  return wait_polling(watch, timeout_ms);
+}
+
+void ray_free_scene_watch(RaySceneWatch *watch) {
+  if (watch->fd >= 0) {
+    close(watch->fd);
+  }
+  free(watch->path);
+  free(watch);
+}
@@ -0,0 +1,282 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include "ray/shadow_batch.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// capacity to grow to so that needed fits, or 0 if it already does
+static int grow_to(int capacity, int needed) {
+  if (needed <= capacity) {
+    return 0;
+  }
+  int grown = capacity > 0 ? capacity * 2 : 64;
+  return grown < needed ? needed : grown;
+}
+
+// realloc that leaves the original in place on failure
+static bool resize(void *array_ptr, int capacity, size_t size) {
+  void **array = array_ptr;
+  void *resized = realloc(*array, capacity * size);
+  if (resized == NULL) {
+    return false;
+  }
+  *array = resized;
+  return true;
+}
+
+RayShadowBatch *ray_create_shadow_batch(void) {
+  return calloc(1, sizeof(RayShadowBatch));
+}
+
+void ray_free_shadow_batch(RayShadowBatch *batch) {
+  if (batch == NULL) {
+    return;
+  }
+  free(batch->origins);
+  free(batch->directions);
+  free(batch->max_distances);
+  free(batch->lights);
+  free(batch->occluded);
+  free(batch->hits);
+  free(batch->parts);
+  free(batch->pixel_x);
+  free(batch->pixel_y);
+  free(batch->colors);
+  free(batch->ray_queries);
+  free(batch->rays.ox);
+  free(batch->rays.oy);
+  free(batch->rays.oz);
+  free(batch->rays.dx);
+  free(batch->rays.dy);
+  free(batch->rays.dz);
+  free(batch->rays.max_distance);
+  free(batch->rays.index);
+  free(batch->rays.hits);
+  free(batch->rays.occluded);
+  free(batch->buckets);
+  free(batch);
+}
+
+void ray_shadow_batch_reset(RayShadowBatch *batch) {
+  batch->num_queries = 0;
+  batch->num_hits = 0;
+  batch->num_parts = 0;
+  batch->num_pixels = 0;
+}
+
+int ray_shadow_batch_add_pixel(RayShadowBatch *batch, int x, int y) {
+  int capacity = grow_to(batch->pixel_capacity, batch->num_pixels + 1);
+  if (capacity > 0) {
+    if (!resize(&batch->pixel_x, capacity, sizeof *batch->pixel_x) ||
+        !resize(&batch->pixel_y, capacity, sizeof *batch->pixel_y) ||
+        !resize(&batch->colors, capacity, sizeof *batch->colors)) {
+      return -1;
+    }
+    batch->pixel_capacity = capacity;
+  }
+  int pixel = batch->num_pixels;
+  batch->pixel_x[pixel] = x;
+  batch->pixel_y[pixel] = y;
+  memset(batch->colors[pixel], 0, sizeof batch->colors[pixel]);
+  batch->num_pixels += 1;
+  return pixel;
+}
+
+int ray_shadow_batch_add_hit(RayShadowBatch *batch, int pixel,
+                             const double throughput[3]) {
+  int capacity = grow_to(batch->hit_capacity, batch->num_hits + 1);
+  if (capacity > 0) {
+    if (!resize(&batch->hits, capacity, sizeof *batch->hits)) {
+      return -1;
+    }
+    batch->hit_capacity = capacity;
+  }
+  RayDeferredHit *hit = &batch->hits[batch->num_hits];
+  hit->pixel = pixel;
+  memcpy(hit->throughput, throughput, sizeof hit->throughput);
+  hit->first = batch->num_parts;
+  hit->count = 0;
+  batch->num_hits += 1;
+  return batch->num_hits - 1;
+}
+
+static int add_query(RayShadowBatch *batch, const gsl_vector *origin,
+                     const gsl_vector *direction, double max_distance,
+                     int light) {
+  int capacity = grow_to(batch->query_capacity, batch->num_queries + 1);
+  if (capacity > 0) {
+    if (!resize(&batch->origins, capacity, sizeof *batch->origins) ||
+        !resize(&batch->directions, capacity, sizeof *batch->directions) ||
+        !resize(&batch->max_distances, capacity,
+                sizeof *batch->max_distances) ||
+        !resize(&batch->lights, capacity, sizeof *batch->lights) ||
+        !resize(&batch->occluded, capacity, sizeof *batch->occluded)) {
+      return -1;
+    }
+    batch->query_capacity = capacity;
+  }
+  int query = batch->num_queries;
+  for (size_t a = 0; a < 3; ++a) {
+    batch->origins[query][a] = gsl_vector_get(origin, a);
+    batch->directions[query][a] = gsl_vector_get(direction, a);
+  }
+  batch->max_distances[query] = max_distance;
+  batch->lights[query] = light;
+  batch->occluded[query] = 0;
+  batch->num_queries += 1;
+  return query;
+}
+
+int ray_shadow_batch_add_part(RayShadowBatch *batch, const gsl_vector *origin,
+                              const gsl_vector *direction, double max_distance,
+                              int light, const gsl_vector *color) {
+  int capacity = grow_to(batch->part_capacity, batch->num_parts + 1);
+  if (capacity > 0) {
+    if (!resize(&batch->parts, capacity, sizeof *batch->parts)) {
+      return -1;
+    }
+    batch->part_capacity = capacity;
+  }
+  int query = add_query(batch, origin, direction, max_distance, light);
+  if (query < 0) {
+    return -1;
+  }
+  RayDeferredPart *part = &batch->parts[batch->num_parts];
+  for (size_t c = 0; c < 3; ++c) {
+    part->color[c] = gsl_vector_get(color, c);
+  }
+  part->query = query;
+  batch->hits[batch->num_hits - 1].count += 1;
+  batch->num_parts += 1;
+  return batch->num_parts - 1;
+}
+
+static bool reserve_rays(RayShadowBatch *batch, int count) {
+  int capacity = grow_to(batch->ray_capacity, count);
+  if (capacity == 0) {
+    return true;
+  }
+  RayShadowRays *rays = &batch->rays;
+  if (!resize(&batch->ray_queries, capacity, sizeof *batch->ray_queries) ||
+      !resize(&rays->ox, capacity, sizeof *rays->ox) ||
+      !resize(&rays->oy, capacity, sizeof *rays->oy) ||
+      !resize(&rays->oz, capacity, sizeof *rays->oz) ||
+      !resize(&rays->dx, capacity, sizeof *rays->dx) ||
+      !resize(&rays->dy, capacity, sizeof *rays->dy) ||
+      !resize(&rays->dz, capacity, sizeof *rays->dz) ||
+      !resize(&rays->max_distance, capacity, sizeof *rays->max_distance) ||
+      !resize(&rays->index, capacity, sizeof *rays->index) ||
+      !resize(&rays->hits, capacity, sizeof *rays->hits) ||
+      !resize(&rays->occluded, capacity, sizeof *rays->occluded)) {
+    return false;
+  }
+  batch->ray_capacity = capacity;
+  return true;
+}
+
+// group the queries by light (a counting sort into ray_queries), then run
+// each group through the occlusion kernel
+static bool trace_queries(RayShadowBatch *batch,
+                          const RayPreparedScene *prepared,
+                          const RayScene *scene) {
+  const int num_lights = scene->num_lights;
+  int capacity = grow_to(batch->bucket_capacity, num_lights + 1);
+  if (capacity > 0) {
+    if (!resize(&batch->buckets, capacity, sizeof *batch->buckets)) {
+      return false;
+    }
+    batch->bucket_capacity = capacity;
+  }
+  if (!reserve_rays(batch, batch->num_queries)) {
+    return false;
+  }
+
+  int *buckets = batch->buckets;
+  memset(buckets, 0, (num_lights + 1) * (sizeof *buckets));
+  for (int q = 0; q < batch->num_queries; ++q) {
+    buckets[batch->lights[q] + 1] += 1;
+  }
+  for (int l = 0; l < num_lights; ++l) {
+    buckets[l + 1] += buckets[l];
+  }
+  // buckets[l] is now where light l's queries start, bumped as they go in
+  for (int q = 0; q < batch->num_queries; ++q) {
+    batch->ray_queries[buckets[batch->lights[q]]] = q;
+    buckets[batch->lights[q]] += 1;
+  }
+
+  RayShadowRays *rays = &batch->rays;
+  int start = 0;
+  for (int l = 0; l < num_lights; ++l) {
+    const int end = buckets[l];
+    if (end == start) {
+      continue;
+    }
+    const int *queries = &batch->ray_queries[start];
+    rays->count = end - start;
+    // every ray towards a directional light points the same way
+    rays->shared_direction =
+        scene->lights[l].type == RAY_LIGHT_TYPE_directional;
+    for (int i = 0; i < rays->count; ++i) {
+      const int q = queries[i];
+      rays->ox[i] = (ray_real)batch->origins[q][0];
+      rays->oy[i] = (ray_real)batch->origins[q][1];
+      rays->oz[i] = (ray_real)batch->origins[q][2];
+      rays->dx[i] = (ray_real)batch->directions[q][0];
+      rays->dy[i] = (ray_real)batch->directions[q][1];
+      rays->dz[i] = (ray_real)batch->directions[q][2];
+      rays->max_distance[i] = (ray_real)batch->max_distances[q];
+    }
+    ray_prepared_occluded(prepared, rays);
+    for (int i = 0; i < rays->count; ++i) {
+      batch->occluded[queries[i]] = rays->occluded[i];
+    }
+    start = end;
+  }
+  return true;
+}
+
+bool ray_shadow_batch_resolve(RayShadowBatch *batch,
+                              const RayPreparedScene *prepared,
+                              const RayScene *scene) {
+  if (!trace_queries(batch, prepared, scene)) {
+    return false;
+  }
+
+  for (int h = 0; h < batch->num_hits; ++h) {
+    const RayDeferredHit *hit = &batch->hits[h];
+    // summed in the same order shade_diffuse would have
+    double sum_data[3] = {0.0, 0.0, 0.0};
+    for (int p = hit->first; p < hit->first + hit->count; ++p) {
+      const RayDeferredPart *part = &batch->parts[p];
+      if (batch->occluded[part->query]) {
+        continue;
+      }
+      for (size_t c = 0; c < 3; ++c) {
+        sum_data[c] += part->color[c];
+      }
+    }
+    double *color = batch->colors[hit->pixel];
+    for (size_t c = 0; c < 3; ++c) {
+      color[c] += hit->throughput[c] * sum_data[c];
+    }
+  }
+  return true;
+}
@@ -0,0 +1,617 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for pread, mkstemp and fdopen
+#define _POSIX_C_SOURCE 200809L
+
+#include "ray/texture_cache.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ray/hash.h"
+#include "ray/img_utils.h"
+
+#define TILE_SIZE RAY_TEXTURE_TILE_SIZE
+#define TILE_BYTES (TILE_SIZE * TILE_SIZE * 3)
+#define CACHE_MAGIC "RAYTEX\0\1"
+#define CACHE_DATA_OFFSET 64
+
+typedef struct CacheHeader {
+  char magic[8];
+  uint32_t width;
+  uint32_t height;
+  uint32_t tile_size;
+  uint32_t num_levels;
+  unsigned char padding[CACHE_DATA_OFFSET - 24];
+} CacheHeader;
+
+static_assert(sizeof(CacheHeader) == CACHE_DATA_OFFSET,
+              "cache header must fill the space before the tiles");
+
+// tiles are reused for whatever is loaded next rather than freed, so a
+// sample that's still reading one that's just been evicted reads memory
+// that's there, only maybe no longer the texels it wanted. version is odd
+// while the texels are being replaced, samples that see it change while
+// they read go round again (a seqlock)
+struct RayTextureTile {
+  atomic_uint version;
+  // set on every sample, cleared as the clock hand passes
+  atomic_bool referenced;
+  // guarded by the cache's lock, owner is NULL for free tiles
+  RayCachedTexture *owner;
+  size_t slot;
+  unsigned char texels[TILE_BYTES];
+};
+
+struct RayTextureCache {
+  char *directory;
+  size_t max_tiles;
+  pthread_mutex_t lock;
+  // every tile there is, in use or not. they're never freed while the cache
+  // is around, so samples can't end up reading freed memory
+  RayTextureTile **tiles;
+  size_t tile_capacity;
+  atomic_size_t num_tiles;
+  // where the clock hand is, the next tile considered for eviction
+  size_t hand;
+  atomic_uint_fast64_t misses;
+  atomic_uint_fast64_t evictions;
+};
+
+RayTextureCache *ray_create_texture_cache(const char *directory,
+                                          size_t budget) {
+  assert(directory != NULL && "directory cannot be null");
+  RayTextureCache *cache = calloc(1, sizeof *cache);
+  if (cache == NULL) {
+    return NULL;
+  }
+  cache->directory = strdup(directory);
+  if (cache->directory == NULL ||
+      pthread_mutex_init(&cache->lock, NULL) != 0) {
+    free(cache->directory);
+    free(cache);
+    return NULL;
+  }
+  cache->max_tiles = budget / sizeof(RayTextureTile);
+  cache->max_tiles = cache->max_tiles > 0 ? cache->max_tiles : 1;
+  atomic_init(&cache->num_tiles, 0);
+  atomic_init(&cache->misses, 0);
+  atomic_init(&cache->evictions, 0);
+  return cache;
+}
+
+void ray_free_texture_cache(RayTextureCache *cache) {
+  size_t num_tiles = atomic_load(&cache->num_tiles);
+  for (size_t t = 0; t < num_tiles; ++t) {
+    assert(cache->tiles[t]->owner == NULL &&
+           "textures must be freed before their cache");
+    free(cache->tiles[t]);
+  }
+  free(cache->tiles);
+  pthread_mutex_destroy(&cache->lock);
+  free(cache->directory);
+  free(cache);
+}
+
+RayTextureCacheStats ray_texture_cache_stats(const RayTextureCache *cache) {
+  return (RayTextureCacheStats){
+      .misses = atomic_load(&cache->misses),
+      .evictions = atomic_load(&cache->evictions),
+      .resident_bytes =
+          atomic_load(&cache->num_tiles) * sizeof(RayTextureTile),
+  };
+}
+
+// fills in the levels and slot count from the size of the top level
+static bool layout_levels(RayCachedTexture *texture, int width, int height) {
+  if (width <= 0 || height <= 0) {
+    return false;
+  }
+  texture->width = width;
+  texture->height = height;
+  texture->num_levels = 0;
+  size_t slot = 0;
+  for (;;) {
+    if (texture->num_levels == RAY_TEXTURE_MAX_LEVELS) {
+      return false;
+    }
+    RayTextureLevel *level = &texture->levels[texture->num_levels];
+    level->width = width;
+    level->height = height;
+    level->tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    level->tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+    level->first_slot = slot;
+    slot += (size_t)level->tiles_x * (size_t)level->tiles_y;
+    texture->num_levels += 1;
+    if (width == 1 && height == 1) {
+      break;
+    }
+    width = width > 1 ? width / 2 : 1;
+    height = height > 1 ? height / 2 : 1;
+  }
+  texture->num_slots = slot;
+  return true;
+}
+
+static off_t slot_offset(size_t slot) {
+  return CACHE_DATA_OFFSET + (off_t)slot * TILE_BYTES;
+}
+
+// the next level down, each texel the average of the ones above it that it
+// covers. where a side is odd that's sometimes three rather than two, so
+// every texel above counts towards the next level
+static unsigned char *downsample(const unsigned char *texels, int width,
+                                 int height, int next_width,
+                                 int next_height) {
+  unsigned char *next =
+      malloc((size_t)next_width * (size_t)next_height * 3);
+  if (next == NULL) {
+    return NULL;
+  }
+  for (int y = 0; y < next_height; ++y) {
+    int y0 = (int)((long)y * height / next_height);
+    int y1 = (int)((long)(y + 1) * height / next_height);
+    for (int x = 0; x < next_width; ++x) {
+      int x0 = (int)((long)x * width / next_width);
+      int x1 = (int)((long)(x + 1) * width / next_width);
+      int count = (x1 - x0) * (y1 - y0);
+      for (int c = 0; c < 3; ++c) {
+        int sum = 0;
+        for (int src_y = y0; src_y < y1; ++src_y) {
+          for (int src_x = x0; src_x < x1; ++src_x) {
+            sum += texels[((size_t)src_y * width + src_x) * 3 + c];
+          }
+        }
+        next[((size_t)y * next_width + x) * 3 + c] =
+            (unsigned char)((sum + count / 2) / count);
+      }
+    }
+  }
+  return next;
+}
+
+// every tile of a level, edge tiles padded with the nearest texel
+static bool write_level_tiles(FILE *file, const unsigned char *texels,
+                              const RayTextureLevel *level) {
+  unsigned char tile[TILE_BYTES];
+  for (int ty = 0; ty < level->tiles_y; ++ty) {
+    for (int tx = 0; tx < level->tiles_x; ++tx) {
+      for (int y = 0; y < TILE_SIZE; ++y) {
+        int src_y = ty * TILE_SIZE + y;
+        src_y = src_y < level->height ? src_y : level->height - 1;
+        for (int x = 0; x < TILE_SIZE; ++x) {
+          int src_x = tx * TILE_SIZE + x;
+          src_x = src_x < level->width ? src_x : level->width - 1;
+          memcpy(&tile[((size_t)y * TILE_SIZE + x) * 3],
+                 &texels[((size_t)src_y * level->width + src_x) * 3], 3);
+        }
+      }
+      if (fwrite(tile, 1, sizeof tile, file) != sizeof tile) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool write_levels(FILE *file, const RayCachedTexture *layout,
+                         unsigned char *texels) {
+  CacheHeader header = {
+      .width = (uint32_t)layout->width,
+      .height = (uint32_t)layout->height,
+      .tile_size = TILE_SIZE,
+      .num_levels = (uint32_t)layout->num_levels,
+  };
+  memcpy(header.magic, CACHE_MAGIC, sizeof header.magic);
+  if (fwrite(&header, 1, sizeof header, file) != sizeof header) {
+    free(texels);
+    return false;
+  }
+
+  for (int l = 0; l < layout->num_levels; ++l) {
+    const RayTextureLevel *level = &layout->levels[l];
+    if (!write_level_tiles(file, texels, level)) {
+      free(texels);
+      return false;
+    }
+    if (l + 1 < layout->num_levels) {
+      const RayTextureLevel *next = &layout->levels[l + 1];
+      unsigned char *next_texels = downsample(
+          texels, level->width, level->height, next->width, next->height);
+      free(texels);
+      texels = next_texels;
+      if (texels == NULL) {
+        return false;
+      }
+    }
+  }
+  free(texels);
+  return true;
+}
+
+// written to a temporary file that's renamed into place, so nothing ever
+// sees half a cache file, even if several processes convert the same png
+static bool convert(const char *png_path, const char *cache_path) {
+  RayImg *img = ray_read_img(png_path);
+  if (img == NULL) {
+    return false;
+  }
+  RayCachedTexture layout = {0};
+  if (!layout_levels(&layout, img->width, img->height)) {
+    fprintf(stderr, "\"%s\" is too big to cache\n", png_path);
+    ray_free_img(img);
+    return false;
+  }
+  unsigned char *texels = malloc((size_t)img->width * img->height * 3);
+  if (texels == NULL) {
+    ray_free_img(img);
+    return false;
+  }
+  // rounded so the texels come back out exactly as they were read
+  for (int y = 0; y < img->height; ++y) {
+    for (int x = 0; x < img->width; ++x) {
+      for (size_t c = 0; c < 3; ++c) {
+        double value = gsl_vector_get(img->pixels[y][x], c);
+        value = value < 0.0 ? 0.0 : value > 1.0 ? 1.0 : value;
+        texels[((size_t)y * img->width + x) * 3 + c] =
+            (unsigned char)lround(value * UCHAR_MAX);
+      }
+    }
+  }
+  ray_free_img(img);
+
+  size_t length = strlen(cache_path);
+  char *temp_path = malloc(length + sizeof ".XXXXXX");
+  if (temp_path == NULL) {
+    free(texels);
+    return false;
+  }
+  memcpy(temp_path, cache_path, length);
+  memcpy(temp_path + length, ".XXXXXX", sizeof ".XXXXXX");
+  int fd = mkstemp(temp_path);
+  FILE *file = fd >= 0 ? fdopen(fd, "wb") : NULL;
+  if (file == NULL) {
+    fprintf(stderr, "failed to create \"%s\"\n", temp_path);
+    if (fd >= 0) {
+      close(fd);
+      unlink(temp_path);
+    }
+    free(texels);
+    free(temp_path);
+    return false;
+  }
+
+  bool success = write_levels(file, &layout, texels);
+  if (fclose(file) != 0) {
+    success = false;
+  }
+  if (success && rename(temp_path, cache_path) != 0) {
+    success = false;
+  }
+  if (!success) {
+    fprintf(stderr, "error while writing \"%s\"\n", cache_path);
+    unlink(temp_path);
+  }
+  free(temp_path);
+  return success;
+}
+
+// <directory>/<file name>-<hash of the whole path>.raytex, so pngs with the
+// same name in different places don't share one
+static char *cache_path_for(const RayTextureCache *cache, const char *path) {
+  const uint64_t hash = ray_hash_bytes(RAY_HASH_SEED, path, strlen(path));
+  const char *name = strrchr(path, '/');
+  name = name != NULL ? name + 1 : path;
+
+  int length = snprintf(NULL, 0, "%s/%s-%016llx.raytex", cache->directory,
+                        name, (unsigned long long)hash);
+  char *cache_path = malloc((size_t)length + 1);
+  if (cache_path != NULL) {
+    snprintf(cache_path, (size_t)length + 1, "%s/%s-%016llx.raytex",
+             cache->directory, name, (unsigned long long)hash);
+  }
+  return cache_path;
+}
+
+static bool is_newer(const struct stat *a, const struct stat *b) {
+  return a->st_mtim.tv_sec > b->st_mtim.tv_sec ||
+         (a->st_mtim.tv_sec == b->st_mtim.tv_sec &&
+          a->st_mtim.tv_nsec >= b->st_mtim.tv_nsec);
+}
+
+static bool open_cache_file(const char *cache_path,
+                            RayCachedTexture *texture) {
+  int fd = open(cache_path, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  CacheHeader header;
+  struct stat file_stat;
+  bool valid =
+      pread(fd, &header, sizeof header, 0) == (ssize_t)sizeof header &&
+      memcmp(header.magic, CACHE_MAGIC, sizeof header.magic) == 0 &&
+      header.tile_size == TILE_SIZE && header.width <= INT_MAX &&
+      header.height <= INT_MAX &&
+      layout_levels(texture, (int)header.width, (int)header.height) &&
+      header.num_levels == (uint32_t)texture->num_levels &&
+      fstat(fd, &file_stat) == 0 &&
+      file_stat.st_size >= slot_offset(texture->num_slots);
+  if (!valid) {
+    close(fd);
+    return false;
+  }
+  texture->fd = fd;
+  return true;
+}
+
+bool ray_texture_cache_open_into(RayTextureCache *cache, const char *path,
+                                 RayCachedTexture *texture) {
+  assert(path != NULL && "path cannot be null");
+  *texture = (RayCachedTexture){0};
+
+  struct stat png_stat;
+  if (stat(path, &png_stat) != 0) {
+    fprintf(stderr, "failed to open \"%s\"\n", path);
+    return false;
+  }
+  char *cache_path = cache_path_for(cache, path);
+  if (cache_path == NULL) {
+    return false;
+  }
+
+  struct stat cache_stat;
+  bool fresh = stat(cache_path, &cache_stat) == 0 &&
+               is_newer(&cache_stat, &png_stat) &&
+               open_cache_file(cache_path, texture);
+  bool success = fresh || (convert(path, cache_path) &&
+                           open_cache_file(cache_path, texture));
+  free(cache_path);
+  if (!success) {
+    *texture = (RayCachedTexture){0};
+    return false;
+  }
+
+  texture->slots = malloc(texture->num_slots * (sizeof *texture->slots));
+  if (texture->slots == NULL) {
+    close(texture->fd);
+    *texture = (RayCachedTexture){0};
+    return false;
+  }
+  for (size_t s = 0; s < texture->num_slots; ++s) {
+    atomic_init(&texture->slots[s], NULL);
+  }
+  texture->cache = cache;
+  return true;
+}
+
+RayCachedTexture *ray_texture_cache_open(RayTextureCache *cache,
+                                         const char *path) {
+  RayCachedTexture *texture = malloc(sizeof *texture);
+  if (texture == NULL) {
+    return NULL;
+  }
+  if (!ray_texture_cache_open_into(cache, path, texture)) {
+    free(texture);
+    return NULL;
+  }
+  return texture;
+}
+
+void ray_close_cached_texture(RayCachedTexture *texture) {
+  if (texture->slots == NULL) {
+    return;
+  }
+  RayTextureCache *cache = texture->cache;
+  pthread_mutex_lock(&cache->lock);
+  for (size_t s = 0; s < texture->num_slots; ++s) {
+    RayTextureTile *tile = atomic_load(&texture->slots[s]);
+    if (tile != NULL) {
+      tile->owner = NULL;
+      atomic_store(&tile->referenced, false);
+    }
+  }
+  pthread_mutex_unlock(&cache->lock);
+  close(texture->fd);
+  free(texture->slots);
+  *texture = (RayCachedTexture){0};
+}
+
+void ray_free_cached_texture(RayCachedTexture *texture) {
+  ray_close_cached_texture(texture);
+  free(texture);
+}
+
+static bool read_at(int fd, void *data, size_t size, off_t offset) {
+  while (size > 0) {
+    ssize_t got = pread(fd, data, size, offset);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return false;
+    }
+    data = (char *)data + got;
+    size -= (size_t)got;
+    offset += got;
+  }
+  return true;
+}
+
+// a tile nobody's using, a new one while there's budget left and otherwise
+// the first one the clock hand finds that hasn't been sampled since it last
+// went past. NULL only if there are no tiles and none can be allocated. the
+// cache has to be locked
+static RayTextureTile *take_tile(RayTextureCache *cache) {
+  size_t num_tiles = atomic_load_explicit(&cache->num_tiles,
+                                          memory_order_relaxed);
+  if (num_tiles < cache->max_tiles) {
+    if (num_tiles == cache->tile_capacity) {
+      size_t capacity = cache->tile_capacity > 0 ? cache->tile_capacity * 2
+                                                 : 64;
+      RayTextureTile **tiles =
+          realloc(cache->tiles, capacity * (sizeof *cache->tiles));
+      if (tiles != NULL) {
+        cache->tiles = tiles;
+        cache->tile_capacity = capacity;
+      }
+    }
+    RayTextureTile *tile = NULL;
+    if (num_tiles < cache->tile_capacity) {
+      tile = malloc(sizeof *tile);
+    }
+    if (tile != NULL) {
+      atomic_init(&tile->version, 0);
+      atomic_init(&tile->referenced, false);
+      tile->owner = NULL;
+      cache->tiles[num_tiles] = tile;
+      atomic_store(&cache->num_tiles, num_tiles + 1);
+      return tile;
+    }
+    if (num_tiles == 0) {
+      return NULL;
+    }
+  }
+
+  // everything referenced at most gets a second chance, so this goes round
+  // no more than twice
+  for (;;) {
+    RayTextureTile *tile = cache->tiles[cache->hand];
+    cache->hand = (cache->hand + 1) % num_tiles;
+    if (tile->owner == NULL) {
+      return tile;
+    }
+    if (atomic_exchange_explicit(&tile->referenced, false,
+                                 memory_order_relaxed)) {
+      continue;
+    }
+    atomic_store_explicit(&tile->owner->slots[tile->slot], NULL,
+                          memory_order_release);
+    tile->owner = NULL;
+    atomic_fetch_add_explicit(&cache->evictions, 1, memory_order_relaxed);
+    return tile;
+  }
+}
+
+// the slow path of a sample, with the cache locked
+static void load_texel(RayCachedTexture *texture, size_t slot,
+                       size_t texel, unsigned char rgb[3]) {
+  RayTextureCache *cache = texture->cache;
+  pthread_mutex_lock(&cache->lock);
+  RayTextureTile *tile =
+      atomic_load_explicit(&texture->slots[slot], memory_order_relaxed);
+  if (tile == NULL) {
+    // another thread hasn't loaded it in the meantime
+    atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+    tile = take_tile(cache);
+  }
+  if (tile == NULL) {
+    // no memory for even one tile, go to the file for every texel
+    if (!read_at(texture->fd, rgb, 3, slot_offset(slot) + (off_t)texel)) {
+      memset(rgb, 0, 3);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return;
+  }
+
+  if (tile->owner == NULL) {
+    atomic_fetch_add_explicit(&tile->version, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    if (!read_at(texture->fd, tile->texels, TILE_BYTES, slot_offset(slot))) {
+      fprintf(stderr, "failed to read a texture tile\n");
+      memset(tile->texels, 0, TILE_BYTES);
+    }
+    atomic_fetch_add_explicit(&tile->version, 1, memory_order_release);
+    tile->owner = texture;
+    tile->slot = slot;
+    atomic_store_explicit(&texture->slots[slot], tile, memory_order_release);
+  }
+  atomic_store_explicit(&tile->referenced, true, memory_order_relaxed);
+  memcpy(rgb, &tile->texels[texel], 3);
+  pthread_mutex_unlock(&cache->lock);
+}
+
+// same as for plain textures
+static int wrap_coord(double val, int bound) {
+  int wrapped = (int)(val * bound) % bound;
+  return wrapped < 0 ? wrapped + bound : wrapped;
+}
+
+static int pick_level(const RayCachedTexture *texture, double footprint) {
+  int size = texture->width > texture->height ? texture->width
+                                              : texture->height;
+  double texels = footprint * size;
+  // also where the footprint isn't a number
+  if (!(texels >= 2.0)) {
+    return 0;
+  }
+  int level = ilogb(texels);
+  return level < texture->num_levels - 1 ? level : texture->num_levels - 1;
+}
+
+void ray_cached_texture_sample_into(RayCachedTexture *texture,
+                                    RayTexCoord tex_coord, double footprint,
+                                    gsl_vector *color) {
+  const RayTextureLevel *level =
+      &texture->levels[pick_level(texture, footprint)];
+  int x = wrap_coord(tex_coord.x, level->width);
+  int y = wrap_coord(tex_coord.y, level->height);
+  size_t slot = level->first_slot +
+                (size_t)(y / TILE_SIZE) * (size_t)level->tiles_x +
+                (size_t)(x / TILE_SIZE);
+  size_t texel =
+      ((size_t)(y % TILE_SIZE) * TILE_SIZE + (size_t)(x % TILE_SIZE)) * 3;
+
+  unsigned char rgb[3];
+  for (;;) {
+    RayTextureTile *tile =
+        atomic_load_explicit(&texture->slots[slot], memory_order_acquire);
+    if (tile == NULL) {
+      load_texel(texture, slot, texel, rgb);
+      break;
+    }
+    unsigned version =
+        atomic_load_explicit(&tile->version, memory_order_acquire);
+    memcpy(rgb, &tile->texels[texel], 3);
+    atomic_thread_fence(memory_order_acquire);
+    // still the same tile and nothing was written to it while it was read
+    if ((version & 1) == 0 &&
+        atomic_load_explicit(&tile->version, memory_order_relaxed) ==
+            version &&
+        atomic_load_explicit(&texture->slots[slot], memory_order_relaxed) ==
+            tile) {
+      // checked first so resident tiles aren't written to on every sample
+      if (!atomic_load_explicit(&tile->referenced, memory_order_relaxed)) {
+        atomic_store_explicit(&tile->referenced, true, memory_order_relaxed);
+      }
+      break;
+    }
+  }
+
+  for (size_t c = 0; c < 3; ++c) {
+    gsl_vector_set(color, c, rgb[c] / (double)UCHAR_MAX);
+  }
+}
@@ -0,0 +1,150 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include "ray/tile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// spread the low 16 bits out so there's a zero between each
+static uint32_t part_1_by_1(uint32_t n) {
+  n &= 0x0000ffff;
+  n = (n | (n << 8)) & 0x00ff00ff;
+  n = (n | (n << 4)) & 0x0f0f0f0f;
+  n = (n | (n << 2)) & 0x33333333;
+  n = (n | (n << 1)) & 0x55555555;
+  return n;
+}
+
+static uint32_t compact_1_by_1(uint32_t n) {
+  n &= 0x55555555;
+  n = (n | (n >> 1)) & 0x33333333;
+  n = (n | (n >> 2)) & 0x0f0f0f0f;
+  n = (n | (n >> 4)) & 0x00ff00ff;
+  n = (n | (n >> 8)) & 0x0000ffff;
+  return n;
+}
+
+uint32_t ray_morton_encode(uint32_t x, uint32_t y) {
+  return part_1_by_1(x) | (part_1_by_1(y) << 1);
+}
+
+void ray_morton_decode(uint32_t code, uint32_t *x, uint32_t *y) {
+  *x = compact_1_by_1(code);
+  *y = compact_1_by_1(code >> 1);
+}
+
+uint32_t ray_hilbert_index(uint32_t side, uint32_t x, uint32_t y) {
+  uint32_t d = 0;
+  for (uint32_t s = side / 2; s > 0; s /= 2) {
+    uint32_t rx = (x & s) > 0;
+    uint32_t ry = (y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+    // rotate the quadrant so the curve stays continuous
+    if (ry == 0) {
+      if (rx == 1) {
+        x = side - 1 - x;
+        y = side - 1 - y;
+      }
+      uint32_t tmp = x;
+      x = y;
+      y = tmp;
+    }
+  }
+  return d;
+}
+
+typedef struct KeyedTile {
+  uint32_t key;
+  RayTile tile;
+} KeyedTile;
+
+static int compare_keyed_tiles(const void *a, const void *b) {
+  uint32_t ka = ((const KeyedTile *)a)->key;
+  uint32_t kb = ((const KeyedTile *)b)->key;
+  return (ka > kb) - (ka < kb);
+}
+
+static RayTile *create_scanline_tiles(int width, int height, int *num_tiles) {
+  RayTile *tiles = malloc(height * (sizeof *tiles));
+  for (int y = 0; y < height; y += 1) {
+    tiles[y] = (RayTile){
+        .x = 0,
+        .y = y,
+        .width = width,
+        .height = 1,
+    };
+  }
+  *num_tiles = height;
+  return tiles;
+}
+
+RayTile *ray_create_tiles(int width, int height, int tile_size,
+                          RAY_TILE_ORDER order, int *num_tiles) {
+  if (order == RAY_TILE_ORDER_scanline) {
+    return create_scanline_tiles(width, height, num_tiles);
+  }
+  if (order != RAY_TILE_ORDER_raster && order != RAY_TILE_ORDER_morton &&
+      order != RAY_TILE_ORDER_hilbert) {
+    fprintf(stderr, "invalid tile order\n");
+    return NULL;
+  }
+
+  const int tiles_x = (width + tile_size - 1) / tile_size;
+  const int tiles_y = (height + tile_size - 1) / tile_size;
+  // the curves are defined over a square power of two grid so tiles off the
+  // edge of the image just leave gaps in the keys
+  uint32_t side = 1;
+  while (side < (uint32_t)tiles_x || side < (uint32_t)tiles_y) {
+    side *= 2;
+  }
+
+  const int count = tiles_x * tiles_y;
+  KeyedTile *keyed = malloc(count * (sizeof *keyed));
+  for (int ty = 0; ty < tiles_y; ty += 1) {
+    for (int tx = 0; tx < tiles_x; tx += 1) {
+      uint32_t key = (order == RAY_TILE_ORDER_morton)
+                         ? ray_morton_encode(tx, ty)
+                     : (order == RAY_TILE_ORDER_hilbert)
+                         ? ray_hilbert_index(side, tx, ty)
+                         : (uint32_t)(ty * tiles_x + tx);
+      int x = tx * tile_size;
+      int y = ty * tile_size;
+      keyed[ty * tiles_x + tx] = (KeyedTile){
+          .key = key,
+          .tile =
+              {
+                  .x = x,
+                  .y = y,
+                  .width = x + tile_size <= width ? tile_size : width - x,
+                  .height = y + tile_size <= height ? tile_size : height - y,
+              },
+      };
+    }
+  }
+  qsort(keyed, count, sizeof *keyed, compare_keyed_tiles);
+
+  RayTile *tiles = malloc(count * (sizeof *tiles));
+  for (int i = 0; i < count; i += 1) {
+    tiles[i] = keyed[i].tile;
+  }
+  free(keyed);
+
+  *num_tiles = count;
+  return tiles;
+}
@@ -0,0 +1,151 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include "ray/tone_map.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// the loops below are kept branch free over plain arrays so they vectorize,
+// each one handles the whole buffer for a single curve
+
+RayToneMapSettings ray_default_tone_map(void) {
+  return (RayToneMapSettings){
+      .op = RAY_TONE_MAP_clamp,
+      .exposure = 0.0,
+  };
+}
+
+static void clamp_floats(const float *restrict in, float *restrict out,
+                         size_t count, float scale) {
+  for (size_t i = 0; i < count; ++i) {
+    float v = in[i] * scale;
+    v = v < 0.0f ? 0.0f : v;
+    out[i] = v > 1.0f ? 1.0f : v;
+  }
+}
+
+static void reinhard_floats(const float *restrict in, float *restrict out,
+                            size_t count, float scale) {
+  for (size_t i = 0; i < count; ++i) {
+    float v = in[i] * scale;
+    v = v < 0.0f ? 0.0f : v;
+    out[i] = v / (1.0f + v);
+  }
+}
+
+static void aces_floats(const float *restrict in, float *restrict out,
+                        size_t count, float scale) {
+  for (size_t i = 0; i < count; ++i) {
+    float v = in[i] * scale;
+    v = v < 0.0f ? 0.0f : v;
+    v = (v * (2.51f * v + 0.03f)) / (v * (2.43f * v + 0.59f) + 0.14f);
+    out[i] = v > 1.0f ? 1.0f : v;
+  }
+}
+
+typedef void (*tone_map_fn)(const float *restrict, float *restrict, size_t,
+                            float);
+
+static void error_tone_map(const float *restrict in, float *restrict out,
+                           size_t count, float scale) {
+  fprintf(stderr, "invalid tone map operator\n");
+  exit(1);
+}
+
+static tone_map_fn get_tone_map_fn(RAY_TONE_MAP op) {
+  return (op == RAY_TONE_MAP_clamp)      ? clamp_floats
+         : (op == RAY_TONE_MAP_reinhard) ? reinhard_floats
+         : (op == RAY_TONE_MAP_aces)     ? aces_floats
+                                         : error_tone_map;
+}
+
+void ray_tone_map_floats(const float *in, float *out, size_t count,
+                         const RayToneMapSettings *settings) {
+  const float scale = (float)exp2(settings->exposure);
+  tone_map_fn fn = get_tone_map_fn(settings->op);
+  if (in == out) {
+    // restrict doesn't allow the two to alias, so go through a chunk of
+    // scratch on the stack
+    float chunk[1024];
+    for (size_t start = 0; start < count; start += 1024) {
+      size_t n = count - start < 1024 ? count - start : 1024;
+      fn(in + start, chunk, n, scale);
+      for (size_t i = 0; i < n; ++i) {
+        out[start + i] = chunk[i];
+      }
+    }
+    return;
+  }
+  fn(in, out, count, scale);
+}
+
+void ray_tone_map_into(const RayFramebuffer *fb,
+                       const RayToneMapSettings *settings, RayImg *img) {
+  assert(img->width == fb->width && img->height == fb->height &&
+         "image and framebuffer must be the same size");
+  assert(img->channels == RAY_FRAMEBUFFER_CHANNELS &&
+         "image must have a channel per framebuffer channel");
+  const RayToneMapSettings default_settings = ray_default_tone_map();
+  if (settings == NULL) {
+    settings = &default_settings;
+  }
+
+  // a row at a time so the mapped values are still in cache when they're
+  // copied out to the image's vectors
+  const size_t row_size = (size_t)fb->width * RAY_FRAMEBUFFER_CHANNELS;
+  float *row = malloc(row_size * (sizeof *row));
+  if (row == NULL) {
+    fprintf(stderr, "out of memory while tone mapping\n");
+    exit(1);
+  }
+  for (int y = 0; y < fb->height; ++y) {
+    ray_tone_map_floats(ray_framebuffer_pixel(fb, 0, y), row, row_size,
+                        settings);
+    if (img->data != NULL) {
+      double *packed = img->data + row_size * y;
+      for (size_t i = 0; i < row_size; ++i) {
+        packed[i] = row[i];
+      }
+      continue;
+    }
+    for (int x = 0; x < fb->width; ++x) {
+      if (img->pixels[y][x] == NULL) {
+        ray_set_pixel(x, y, gsl_vector_alloc(3), img);
+      }
+      const float *mapped = row + (size_t)x * RAY_FRAMEBUFFER_CHANNELS;
+      gsl_vector *pixel = img->pixels[y][x];
+      for (size_t c = 0; c < RAY_FRAMEBUFFER_CHANNELS; ++c) {
+        gsl_vector_set(pixel, c, mapped[c]);
+      }
+    }
+  }
+  free(row);
+}
+
+RayImg *ray_tone_map(const RayFramebuffer *fb,
+                     const RayToneMapSettings *settings) {
+  RayImg *img = ray_create_packed_img(fb->width, fb->height, 3);
+  if (img == NULL) {
+    return NULL;
+  }
+  ray_tone_map_into(fb, settings, img);
+  return img;
+}
@@ -0,0 +1,127 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include <assert.h>
+#include <math.h>
+
+#include "ray/loader.h"
+#include "ray/render.h"
+#include "ray/vec_utils.h"
+
+static RayImg *render(const RayScene *scene, int samples, int max_samples,
+                      RayRenderStats *stats) {
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.area_light_samples = samples;
+  settings.area_light_max_samples = max_samples;
+  RayRenderer *renderer = ray_create_renderer(&settings);
+  assert(renderer != NULL && "renderer creation must succeed");
+  RayImg *img = ray_renderer_render(renderer, scene);
+  assert(img != NULL && "render must produce an image");
+  *stats = ray_renderer_stats(renderer);
+  ray_free_renderer(renderer);
+  return img;
+}
+
+static double mean_difference(const RayImg *a, const RayImg *b) {
+  double total = 0.0;
+  for (int y = 0; y < a->height; ++y) {
+    for (int x = 0; x < a->width; ++x) {
+      for (size_t c = 0; c < 3; ++c) {
+        total += fabs(gsl_vector_get(a->pixels[y][x], c) -
+                      gsl_vector_get(b->pixels[y][x], c));
+      }
+    }
+  }
+  return total / (a->width * a->height * 3.0);
+}
+
+// adaptive sampling has to land close to sampling densely everywhere while
+// tracing far fewer shadow rays
+static void check_light(RayScene *scene, RayLight *light) {
+  RayLight *lights = scene->lights;
+  int num_lights = scene->num_lights;
+  scene->lights = light;
+  scene->num_lights = 1;
+
+  RayRenderStats adaptive_stats;
+  RayImg *adaptive = render(scene, 4, 100, &adaptive_stats);
+  RayRenderStats dense_stats;
+  RayImg *dense = render(scene, 64, 64, &dense_stats);
+
+  assert(adaptive_stats.area_light_refinements > 0 &&
+         "penumbras must be refined");
+  assert(dense_stats.area_light_refinements == 0 &&
+         "a single pass must not be refined");
+  assert(adaptive_stats.shadow_rays * 4 < dense_stats.shadow_rays &&
+         "adaptive sampling must trace far fewer shadow rays");
+  assert(mean_difference(adaptive, dense) < 0.01 &&
+         "adaptive sampling must converge on dense sampling");
+
+  ray_free_img(adaptive);
+  ray_free_img(dense);
+  scene->lights = lights;
+  scene->num_lights = num_lights;
+}
+
+int main() {
+  RayScene scene;
+  bool success = ray_scene_from_file("scene.json", &scene);
+  if (!success) {
+    fprintf(stderr, "failed to load scene.json\n");
+    return 1;
+  }
+  scene.width = 200;
+  scene.height = 150;
+
+  RayLight rect = {
+      .type = RAY_LIGHT_TYPE_rect,
+      .position = ray_create_vec3(-2.0, 10.0, -3.0),
+      .u = ray_create_vec3(4.0, 0.0, 0.0),
+      .v = ray_create_vec3(0.0, 0.0, 4.0),
+      .color = ray_create_vec3(1.0, 1.0, 1.0),
+      .intensity = 40000.0,
+  };
+
+  // samples stay on the rectangle
+  gsl_vector *point = gsl_vector_alloc(3);
+  for (int stratum = 0; stratum < 16; ++stratum) {
+    ray_light_sample_into(&rect, rect.position, stratum, 4, 0.999, 0.0, point);
+    assert(fabs(gsl_vector_get(point, 0) + 2.0) <= 2.0 &&
+           fabs(gsl_vector_get(point, 1) - 10.0) < 1e-12 &&
+           fabs(gsl_vector_get(point, 2) + 3.0) <= 2.0 &&
+           "rect samples must lie on the rect");
+  }
+  gsl_vector_free(point);
+
+  check_light(&scene, &rect);
+  ray_free_light(&rect);
+
+  RayLight sphere = {
+      .type = RAY_LIGHT_TYPE_sphere,
+      .position = ray_create_vec3(-2.0, 10.0, -3.0),
+      .radius = 2.0,
+      .color = ray_create_vec3(1.0, 1.0, 1.0),
+      .intensity = 40000.0,
+  };
+  check_light(&scene, &sphere);
+  ray_free_light(&sphere);
+
+  ray_free_scene(&scene);
+
+  return 0;
+}
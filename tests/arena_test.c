@@ -0,0 +1,70 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+
+#include "ray/arena.h"
+
+static int cleanup_order[4];
+static int num_cleanups = 0;
+
+static void record_cleanup(void *data) {
+  cleanup_order[num_cleanups] = *(int *)data;
+  num_cleanups += 1;
+}
+
+int main() {
+  RayArena *arena = ray_create_arena(256);
+  assert(arena != NULL && "arena creation must succeed");
+
+  for (int i = 0; i < 100; ++i) {
+    void *ptr = ray_arena_alloc(arena, 1 + i % 7);
+    assert(((uintptr_t)ptr % alignof(max_align_t)) == 0 &&
+           "allocations must be suitably aligned");
+  }
+
+  // bigger than a block still has to work
+  unsigned char *big = ray_arena_alloc(arena, 4096);
+  assert(big != NULL && "oversized allocations must succeed");
+  big[4095] = 1;
+
+  gsl_vector *vec = ray_arena_create_vec3(arena, 1.0, 2.0, 3.0);
+  assert(gsl_vector_get(vec, 2) == 3.0 && "arena vectors must hold values");
+
+  // after a reset the same memory gets handed out again
+  ray_arena_reset(arena);
+  assert(ray_arena_used(arena) == 0 && "reset must release everything");
+  void *first = ray_arena_alloc(arena, 16);
+  ray_arena_reset(arena);
+  void *again = ray_arena_alloc(arena, 16);
+  assert(again == first && "reset must reuse blocks");
+
+  int ids[3] = {1, 2, 3};
+  for (int i = 0; i < 3; ++i) {
+    bool success = ray_arena_add_cleanup(arena, record_cleanup, &ids[i]);
+    assert(success && "registering a cleanup must succeed");
+  }
+  ray_free_arena(arena);
+  assert(num_cleanups == 3 && "every cleanup must run");
+  assert(cleanup_order[0] == 3 && cleanup_order[2] == 1 &&
+         "cleanups run most recent first");
+
+  return 0;
+}
@@ -0,0 +1,147 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#include <assert.h>
+#include <stdio.h>
+
+#include "ray/autotune.h"
+#include "ray/img_utils.h"
+#include "ray/scene_gen.h"
+
+#define CACHE_PATH "autotune_test.cache"
+
+// tuning only touches settings that leave the pixels alone
+static void assert_same_image(const RayScene *scene,
+                              const RayRenderSettings *tuned) {
+  RayImg *a = ray_render_scene_with_settings(scene, NULL);
+  RayImg *b = ray_render_scene_with_settings(scene, tuned);
+  assert(a != NULL && b != NULL);
+  for (int y = 0; y < scene->height; ++y) {
+    for (int x = 0; x < scene->width; ++x) {
+      for (size_t c = 0; c < 3; ++c) {
+        assert(gsl_vector_get(a->pixels[y][x], c) ==
+               gsl_vector_get(b->pixels[y][x], c));
+      }
+    }
+  }
+  ray_free_img(a);
+  ray_free_img(b);
+}
+
+int main() {
+  remove(CACHE_PATH);
+
+  RaySceneGenSettings gen = ray_default_scene_gen_settings();
+  gen.width = 48;
+  gen.height = 32;
+  gen.num_spheres = 40;
+  gen.num_planes = 2;
+  gen.num_lights = 2;
+  gen.reflective_fraction = 0.5;
+  gen.refractive_fraction = 0.25;
+  RayScene scene;
+  bool success = ray_generate_scene(&gen, &scene);
+  assert(success && "scene must generate");
+
+  RaySceneStats stats;
+  success = ray_analyse_scene(&scene, &stats);
+  assert(success && "scene must analyse");
+  assert(stats.num_spheres == 40 && stats.num_planes == 2);
+  assert(stats.num_lights == 2 && stats.num_directional_lights == 0);
+  assert(stats.num_diffuse + stats.num_reflective + stats.num_refractive ==
+         42);
+  assert(stats.num_reflective > 0 && stats.num_refractive > 0);
+  // the floor and back wall fill whatever the spheres don't
+  assert(stats.coverage == 1.0);
+  assert(stats.secondary_share > 0.0 && stats.secondary_share < 1.0);
+
+  // the hash follows the content
+  const uint64_t hash = ray_scene_hash(&scene);
+  assert(ray_scene_hash(&scene) == hash);
+  double x = gsl_vector_get(scene.objects[0].center, 0);
+  gsl_vector_set(scene.objects[0].center, 0, x + 0.5);
+  assert(ray_scene_hash(&scene) != hash);
+  gsl_vector_set(scene.objects[0].center, 0, x);
+  assert(ray_scene_hash(&scene) == hash);
+
+  // from the stats alone, then cached
+  RayAutotuneSettings settings = ray_default_autotune_settings();
+  settings.calibrate = false;
+  settings.cache_path = CACHE_PATH;
+  RayAutotuneResult picked;
+  success = ray_autotune(&scene, &settings, &picked);
+  assert(success && "scene must tune from its stats");
+  assert(!picked.from_cache && !picked.calibrated);
+  assert(picked.scene_hash == hash);
+  assert(picked.settings.num_threads > 0 && picked.settings.tile_size > 0);
+  assert(picked.settings.batch_shadows);
+  RayAutotuneResult cached;
+  success = ray_autotune(&scene, &settings, &cached);
+  assert(success && "scene must tune from the cache");
+  assert(cached.from_cache && !cached.calibrated);
+  assert(cached.settings.num_threads == picked.settings.num_threads &&
+         cached.settings.tile_size == picked.settings.tile_size &&
+         cached.settings.batch_shadows == picked.settings.batch_shadows);
+  assert(cached.settings.tile_order == settings.base.tile_order &&
+         "the tile order must be the caller's");
+
+  // an uncalibrated entry doesn't do when calibration is asked for
+  settings.calibrate = true;
+  settings.calibration_pixels = 24 * 16;
+  RayAutotuneResult calibrated;
+  success = ray_autotune(&scene, &settings, &calibrated);
+  assert(success && "scene must tune by calibrating");
+  assert(!calibrated.from_cache && calibrated.calibrated);
+  assert(calibrated.calibration_seconds > 0.0);
+  success = ray_autotune(&scene, &settings, &cached);
+  assert(success && "calibrated scene must tune from the cache");
+  assert(cached.from_cache && cached.calibrated);
+  assert(cached.settings.tile_size == calibrated.settings.tile_size &&
+         cached.settings.batch_shadows == calibrated.settings.batch_shadows);
+
+  // another scene isn't found
+  gen.seed += 1;
+  RayScene other;
+  success = ray_generate_scene(&gen, &other);
+  assert(success && "other scene must generate");
+  success = ray_autotune(&other, &settings, &cached);
+  assert(success && "other scene must tune");
+  assert(!cached.from_cache);
+  ray_free_scene(&other);
+
+  // nor is the same scene tuned from other base settings
+  settings.base.num_threads = 2;
+  success = ray_autotune(&scene, &settings, &cached);
+  assert(success && !cached.from_cache &&
+         "other base threads must tune again");
+  settings.base.num_threads = 0;
+  settings.base.tile_order = RAY_TILE_ORDER_scanline;
+  success = ray_autotune(&scene, &settings, &cached);
+  assert(success && !cached.from_cache && "another tile order must tune again");
+  assert(cached.settings.tile_order == RAY_TILE_ORDER_scanline &&
+         "the tile order must be the caller's");
+  success = ray_autotune(&scene, &settings, &cached);
+  assert(success && cached.from_cache &&
+         cached.settings.tile_order == RAY_TILE_ORDER_scanline &&
+         "a cached result must keep the caller's tile order");
+
+  assert_same_image(&scene, &picked.settings);
+  assert_same_image(&scene, &calibrated.settings);
+
+  ray_free_scene(&scene);
+  remove(CACHE_PATH);
+}
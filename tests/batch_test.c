@@ -0,0 +1,70 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include <assert.h>
+#include <math.h>
+
+#include "ray/img_utils.h"
+#include "ray/loader.h"
+#include "ray/render.h"
+
+static RayImg *render(const RayScene *scene, bool batch_shadows,
+                      RayRenderStats *stats) {
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.batch_shadows = batch_shadows;
+  RayRenderer *renderer = ray_create_renderer(&settings);
+  assert(renderer != NULL && "renderer creation must succeed");
+  RayImg *img = ray_renderer_render(renderer, scene);
+  assert(img != NULL && "render must produce an image");
+  *stats = ray_renderer_stats(renderer);
+  ray_free_renderer(renderer);
+  return img;
+}
+
+int main() {
+  RayScene scene;
+  bool success = ray_scene_from_file("scene.json", &scene);
+  if (!success) {
+    fprintf(stderr, "failed to load scene.json\n");
+    return 1;
+  }
+
+  RayRenderStats immediate_stats;
+  RayImg *immediate = render(&scene, false, &immediate_stats);
+  RayRenderStats batched_stats;
+  RayImg *batched = render(&scene, true, &batched_stats);
+
+  assert(batched_stats.shadow_rays == immediate_stats.shadow_rays &&
+         "batching must trace the same shadow rays");
+  // the colours are only put together in a different order
+  for (int y = 0; y < scene.height; ++y) {
+    for (int x = 0; x < scene.width; ++x) {
+      for (size_t c = 0; c < 3; ++c) {
+        double a = gsl_vector_get(immediate->pixels[y][x], c);
+        double b = gsl_vector_get(batched->pixels[y][x], c);
+        assert(fabs(a - b) < 1e-9 && "batched shadows must match");
+      }
+    }
+  }
+
+  ray_free_img(immediate);
+  ray_free_img(batched);
+  ray_free_scene(&scene);
+
+  return 0;
+}
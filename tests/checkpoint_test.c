@@ -0,0 +1,119 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for truncate
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ray/render.h"
+#include "ray/scene_gen.h"
+
+#define PATH "checkpoint_test.journal"
+
+static bool same_pixels(const RayFramebuffer *a, const RayFramebuffer *b) {
+  return a->width == b->width && a->height == b->height &&
+         memcmp(a->data, b->data,
+                (size_t)a->width * a->height * RAY_FRAMEBUFFER_CHANNELS *
+                    sizeof(float)) == 0;
+}
+
+// renders with the journal and checks it comes out the same as whole,
+// returning how many tiles actually had to be rendered
+static uint64_t resume(RayRenderer *renderer, const RayScene *scene,
+                       uint64_t key, const RayFramebuffer *whole) {
+  RayCheckpointSettings settings = {
+      .path = PATH,
+      .interval = 0.0,
+      .key = key,
+  };
+  RayFramebuffer *fb =
+      ray_renderer_render_checkpointed(renderer, scene, &settings);
+  assert(fb != NULL && same_pixels(fb, whole));
+  ray_free_framebuffer(fb);
+  return ray_renderer_stats(renderer).tiles;
+}
+
+static off_t file_size(const char *path) {
+  struct stat info;
+  int result = stat(path, &info);
+  assert(result == 0 && "journal must exist");
+  return info.st_size;
+}
+
+int main() {
+  RaySceneGenSettings gen = ray_default_scene_gen_settings();
+  gen.num_spheres = 100;
+  gen.width = 96;
+  gen.height = 72;
+  RayScene scene;
+  bool success = ray_generate_scene(&gen, &scene);
+  assert(success && "scene must generate");
+
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.num_threads = 3;
+  RayRenderer *renderer = ray_create_renderer(&settings);
+  RayFramebuffer *whole = ray_renderer_render_hdr(renderer, &scene);
+  assert(whole != NULL);
+  const uint64_t num_tiles = ray_renderer_stats(renderer).tiles;
+
+  // from scratch every tile is rendered, and once it's all in the journal
+  // none are
+  remove(PATH);
+  uint64_t rendered = resume(renderer, &scene, 1, whole);
+  assert(rendered == num_tiles && "a new journal must render every tile");
+  const off_t complete = file_size(PATH);
+  rendered = resume(renderer, &scene, 1, whole);
+  assert(rendered == 0 && "a complete journal must render nothing");
+  off_t size = file_size(PATH);
+  assert(size == complete && "a complete journal must not grow");
+
+  // killed part way through writing a tile only the rest are rendered, and
+  // then the journal is whole again
+  int result = truncate(PATH, complete / 2);
+  assert(result == 0 && "journal must truncate");
+  rendered = resume(renderer, &scene, 1, whole);
+  assert(rendered > 0 && rendered < num_tiles);
+  size = file_size(PATH);
+  assert(size == complete && "a resumed journal must be whole again");
+
+  // a damaged tile is rendered again along with everything after it
+  FILE *file = fopen(PATH, "r+");
+  assert(file != NULL && "journal must open");
+  result = fseek(file, complete / 4, SEEK_SET);
+  assert(result == 0 && "journal must seek");
+  int byte = fgetc(file);
+  result = fseek(file, complete / 4, SEEK_SET);
+  assert(result == 0 && "journal must seek");
+  fputc(byte ^ 0xff, file);
+  fclose(file);
+  rendered = resume(renderer, &scene, 1, whole);
+  assert(rendered > num_tiles / 2 && rendered < num_tiles);
+
+  // and a journal for something else is started over
+  rendered = resume(renderer, &scene, 2, whole);
+  assert(rendered == num_tiles && "another key's journal must start over");
+
+  remove(PATH);
+  ray_free_framebuffer(whole);
+  ray_free_renderer(renderer);
+  ray_free_scene(&scene);
+}
@@ -0,0 +1,129 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "ray/img_utils.h"
+#include "ray/render.h"
+#include "ray/scene_gen.h"
+
+// with more than one thread the occluder caches depend on which thread took
+// which tile, so only a single thread has to do exactly the same tests
+static bool same_stats(const RayRenderStats *a, const RayRenderStats *b,
+                       bool single_thread) {
+  return a->primary_rays == b->primary_rays &&
+         a->reflection_rays == b->reflection_rays &&
+         a->transmission_rays == b->transmission_rays &&
+         a->shadow_rays == b->shadow_rays &&
+         a->culled_lights == b->culled_lights &&
+         a->area_light_samples == b->area_light_samples &&
+         a->area_light_refinements == b->area_light_refinements &&
+         a->tiles == b->tiles &&
+         (!single_thread ||
+          (a->intersection_tests == b->intersection_tests &&
+           a->occluder_cache_hits == b->occluder_cache_hits &&
+           a->occluder_cache_misses == b->occluder_cache_misses));
+}
+
+// every context is on its own cache lines, and has nothing left in its arena
+// that outlived a pixel
+static void check_contexts(const RayRenderer *renderer, int num_threads) {
+  int num_contexts;
+  const RayRenderContext *contexts =
+      ray_renderer_contexts(renderer, &num_contexts);
+  assert(num_contexts == num_threads && "there must be a context per thread");
+  assert(sizeof(RayRenderContext) % RAY_CACHE_LINE_SIZE == 0 &&
+         "contexts must be padded to whole cache lines");
+  for (int t = 0; t < num_contexts; ++t) {
+    const RayRenderContext *ctx = &contexts[t];
+    assert((uintptr_t)ctx % RAY_CACHE_LINE_SIZE == 0 &&
+           "contexts must start on a cache line");
+    assert(ctx->index == t && "contexts must know their thread");
+    assert(ray_arena_used(ctx->arena) == 0 &&
+           "the arena must be reset after the last pixel");
+    // the whole image's transient vectors would need many blocks
+    assert(ctx->arena->first->next == NULL &&
+           "the arena must be reset between pixels");
+  }
+}
+
+// the renderer keeps its contexts between renders, which mustn't change what
+// comes out of them. another scene goes in between, to leave something behind
+// if anything were kept that shouldn't be
+static void check_reuse(const RayScene *scene, const RayScene *other,
+                        int num_threads) {
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.num_threads = num_threads;
+  RayRenderer *renderer = ray_create_renderer(&settings);
+  assert(renderer != NULL && "renderer must be created");
+
+  RayImg *first = ray_renderer_render(renderer, scene);
+  assert(first != NULL && "first render must succeed");
+  const RayRenderStats first_stats = ray_renderer_stats(renderer);
+  check_contexts(renderer, num_threads);
+
+  RayImg *between = ray_renderer_render(renderer, other);
+  assert(between != NULL && "render of another scene must succeed");
+  ray_free_img(between);
+
+  RayImg *second = ray_renderer_render(renderer, scene);
+  assert(second != NULL && "second render must succeed");
+  const RayRenderStats second_stats = ray_renderer_stats(renderer);
+  check_contexts(renderer, num_threads);
+
+  assert(same_stats(&first_stats, &second_stats, num_threads == 1) &&
+         "a reused renderer must count the same");
+  for (int y = 0; y < scene->height; ++y) {
+    for (int x = 0; x < scene->width; ++x) {
+      for (size_t c = 0; c < 3; ++c) {
+        assert(gsl_vector_get(first->pixels[y][x], c) ==
+                   gsl_vector_get(second->pixels[y][x], c) &&
+               "a reused renderer must render the same image");
+      }
+    }
+  }
+
+  ray_free_img(first);
+  ray_free_img(second);
+  ray_free_renderer(renderer);
+}
+
+int main() {
+  RaySceneGenSettings gen = ray_default_scene_gen_settings();
+  gen.width = 96;
+  gen.height = 72;
+  gen.num_spheres = 60;
+  gen.reflective_fraction = 0.4;
+  gen.refractive_fraction = 0.2;
+  RayScene scene;
+  bool success = ray_generate_scene(&gen, &scene);
+  assert(success && "scene must generate");
+  gen.seed += 1;
+  gen.num_lights += 2;
+  RayScene other;
+  success = ray_generate_scene(&gen, &other);
+  assert(success && "other scene must generate");
+
+  for (int num_threads = 1; num_threads <= 3; num_threads += 2) {
+    check_reuse(&scene, &other, num_threads);
+  }
+
+  ray_free_scene(&other);
+  ray_free_scene(&scene);
+}
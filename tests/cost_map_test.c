@@ -0,0 +1,181 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ray/cost_map.h"
+#include "ray/img_utils.h"
+#include "ray/render.h"
+#include "ray/scene_gen.h"
+
+static uint64_t plane_sum(const RayCostMap *map, RAY_PIXEL_COST cost) {
+  const float *plane = ray_cost_map_plane(map, cost);
+  uint64_t sum = 0;
+  for (int i = 0; i < map->width * map->height; ++i) {
+    sum += (uint64_t)plane[i];
+  }
+  return sum;
+}
+
+static float cost_at(const RayCostMap *map, RAY_PIXEL_COST cost, int x,
+                     int y) {
+  return ray_cost_map_plane(map, cost)[(y - map->y) * map->width +
+                                       (x - map->x)];
+}
+
+static long file_size(const char *path) {
+  FILE *file = fopen(path, "rb");
+  assert(file != NULL);
+  int result = fseek(file, 0, SEEK_END);
+  assert(result == 0 && "cost map must seek");
+  long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+static void check_render(const RayScene *scene, bool batch_shadows) {
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.num_threads = 2;
+  settings.batch_shadows = batch_shadows;
+  RayImg *plain = ray_render_scene_with_settings(scene, &settings);
+  assert(plain != NULL);
+
+  settings.cost_map = true;
+  RayRenderer *renderer = ray_create_renderer(&settings);
+  assert(renderer != NULL);
+  assert(ray_renderer_cost_map(renderer) == NULL);
+  RayImg *img = ray_renderer_render(renderer, scene);
+  assert(img != NULL);
+  // keeping track changes nothing about the image
+  for (int y = 0; y < scene->height; ++y) {
+    for (int x = 0; x < scene->width; ++x) {
+      for (size_t c = 0; c < 3; ++c) {
+        assert(gsl_vector_get(plain->pixels[y][x], c) ==
+               gsl_vector_get(img->pixels[y][x], c));
+      }
+    }
+  }
+
+  const RayCostMap *map = ray_renderer_cost_map(renderer);
+  assert(map != NULL);
+  assert(map->width == scene->width && map->height == scene->height);
+  assert(map->x == 0 && map->y == 0);
+
+  // the pixels add up to the render's totals
+  const RayRenderStats stats = ray_renderer_stats(renderer);
+  assert(plane_sum(map, RAY_PIXEL_COST_rays) ==
+         stats.primary_rays + stats.reflection_rays +
+             stats.transmission_rays + stats.shadow_rays);
+  assert(plane_sum(map, RAY_PIXEL_COST_intersection_tests) ==
+         stats.intersection_tests);
+  float max_depth = 0.0f;
+  for (int y = 0; y < map->height; ++y) {
+    for (int x = 0; x < map->width; ++x) {
+      assert(cost_at(map, RAY_PIXEL_COST_rays, x, y) >= 1.0f);
+      assert(cost_at(map, RAY_PIXEL_COST_intersection_tests, x, y) >=
+             (float)scene->num_objects);
+      const float depth = cost_at(map, RAY_PIXEL_COST_depth, x, y);
+      assert(depth <= scene->max_recursion_depth);
+      max_depth = depth > max_depth ? depth : max_depth;
+      assert(cost_at(map, RAY_PIXEL_COST_time, x, y) >= 0.0f);
+    }
+  }
+  // there's glass and mirrors in the scene
+  assert(max_depth >= 1.0f);
+  assert(plane_sum(map, RAY_PIXEL_COST_time) > 0);
+
+  float full_rays[64][64];
+  for (int y = 0; y < map->height; ++y) {
+    for (int x = 0; x < map->width; ++x) {
+      full_rays[y][x] = cost_at(map, RAY_PIXEL_COST_rays, x, y);
+    }
+  }
+
+  // a region's map only covers the region, with the same costs
+  const RayTile region = {.x = 8, .y = 4, .width = 16, .height = 12};
+  RayFramebuffer *fb = ray_renderer_render_region(renderer, scene, region);
+  assert(fb != NULL);
+  map = ray_renderer_cost_map(renderer);
+  assert(map->width == region.width && map->height == region.height);
+  assert(map->x == region.x && map->y == region.y);
+  for (int y = region.y; y < region.y + region.height; ++y) {
+    for (int x = region.x; x < region.x + region.width; ++x) {
+      assert(cost_at(map, RAY_PIXEL_COST_rays, x, y) == full_rays[y][x]);
+    }
+  }
+
+  ray_free_framebuffer(fb);
+  ray_free_renderer(renderer);
+  ray_free_img(img);
+  ray_free_img(plain);
+}
+
+int main() {
+  RaySceneGenSettings gen = ray_default_scene_gen_settings();
+  gen.width = 48;
+  gen.height = 32;
+  gen.num_spheres = 30;
+  gen.reflective_fraction = 0.3;
+  gen.refractive_fraction = 0.2;
+  RayScene scene;
+  bool success = ray_generate_scene(&gen, &scene);
+  assert(success && "scene must generate");
+
+  check_render(&scene, false);
+  check_render(&scene, true);
+
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.cost_map = true;
+  RayRenderer *renderer = ray_create_renderer(&settings);
+  assert(renderer != NULL);
+  RayImg *img = ray_renderer_render(renderer, &scene);
+  assert(img != NULL);
+  const RayCostMap *map = ray_renderer_cost_map(renderer);
+
+  // written next to the image, with its extension swapped out
+  success = ray_write_cost_maps(map, "cost_map_test.png", false);
+  assert(success && "heatmaps must write");
+  for (int cost = 0; cost < RAY_PIXEL_COST_count; ++cost) {
+    char path[64];
+    snprintf(path, sizeof path, "cost_map_test.%s.png",
+             ray_pixel_cost_name(cost));
+    RayImg *heatmap = ray_read_img(path);
+    assert(heatmap != NULL);
+    assert(heatmap->width == scene.width && heatmap->height == scene.height);
+    ray_free_img(heatmap);
+  }
+  success = ray_write_cost_maps(map, "cost_map_test.png", true);
+  assert(success && "raw cost maps must write");
+  const long header_size =
+      file_size("cost_map_test.rays.pfm") -
+      (long)(scene.width * scene.height * sizeof(float));
+  // the scale is 1.0 rather than -1.0 on big endian machines
+  const long little_endian_header_size =
+      snprintf(NULL, 0, "Pf\n%d %d\n-1.0\n", scene.width, scene.height);
+  assert(header_size == little_endian_header_size ||
+         header_size == little_endian_header_size - 1);
+
+  // every pixel takes at least its primary ray
+  assert(ray_cost_map_scale(map, RAY_PIXEL_COST_rays) >= 1.0f);
+
+  ray_free_img(img);
+  ray_free_renderer(renderer);
+  ray_free_scene(&scene);
+}
@@ -0,0 +1,84 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ray/hdr_io.h"
+
+#define WIDTH 37
+#define HEIGHT 11
+
+int main() {
+  RayFramebuffer *fb = ray_create_framebuffer(WIDTH, HEIGHT);
+  assert(fb != NULL && "framebuffer creation must succeed");
+  for (int y = 0; y < HEIGHT; ++y) {
+    for (int x = 0; x < WIDTH; ++x) {
+      float *pixel = ray_framebuffer_pixel(fb, x, y);
+      pixel[0] = (float)x * 0.5f;
+      pixel[1] = (float)y * 100.0f;
+      pixel[2] = -1.0f / (1.0f + x + y);
+    }
+  }
+
+  // raw framebuffers come back exactly as they went out
+  bool success = ray_raw_framebuffer_write("hdr_io_test.rayfb", fb);
+  assert(success && "writing a raw framebuffer must succeed");
+  RayFramebuffer *mapped = ray_map_raw_framebuffer("hdr_io_test.rayfb");
+  assert(mapped != NULL && "mapping a raw framebuffer must succeed");
+  assert(mapped->width == WIDTH && mapped->height == HEIGHT &&
+         "mapped framebuffer must be the same size");
+  assert(memcmp(mapped->data, fb->data,
+                (sizeof(float)) * WIDTH * HEIGHT * 3) == 0 &&
+         "mapped pixels must match the written ones");
+  // private mapping, so writes don't reach the file
+  mapped->data[0] = 42.0f;
+  ray_free_framebuffer(mapped);
+  mapped = ray_map_raw_framebuffer("hdr_io_test.rayfb");
+  assert(mapped->data[0] == fb->data[0] &&
+         "writing to a mapping must not change the file");
+  ray_free_framebuffer(mapped);
+
+  mapped = ray_map_raw_framebuffer("scene.json");
+  assert(mapped == NULL && "other files must be rejected");
+
+  // pfm is bottom row first after a text header
+  success = ray_pfm_write("hdr_io_test.pfm", fb);
+  assert(success && "writing a pfm must succeed");
+  FILE *file = fopen("hdr_io_test.pfm", "rb");
+  assert(file != NULL && "the pfm must exist");
+  int width = 0;
+  int height = 0;
+  double scale = 0.0;
+  int matched = fscanf(file, "PF %d %d %lf", &width, &height, &scale);
+  assert(matched == 3 && width == WIDTH && height == HEIGHT &&
+         "pfm header must describe the framebuffer");
+  assert(fgetc(file) == '\n' && "pfm header must end in a single newline");
+  float row[WIDTH * 3];
+  size_t read = fread(row, sizeof row, 1, file);
+  assert(read == 1 && "pfm must hold a row of pixels");
+  assert(memcmp(row, ray_framebuffer_pixel(fb, 0, HEIGHT - 1), sizeof row) ==
+             0 &&
+         "the first pfm row must be the bottom one");
+  fclose(file);
+
+  ray_free_framebuffer(fb);
+
+  return 0;
+}
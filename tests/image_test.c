@@ -16,6 +16,11 @@
 //  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 //  USA
 
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+
+#include "png.h"
 #include "ray/img_utils.h"
 #include "ray/vec_utils.h"
 
@@ -23,15 +28,152 @@
 #define IMG_HEIGHT 20
 #define IMG_CHANNELS 3
 
+// whatever it's written with, an image has to read back the same
+static void check_round_trip(const RayImg *img, const RayPngOptions *options) {
+  bool success =
+      ray_png_write_with_options("image_test_options.png", img, options);
+  assert(success && "writing with options must succeed");
+  RayImg *read = ray_read_img("image_test_options.png");
+  assert(read != NULL && "written image must be readable");
+  assert(read->width == img->width && read->height == img->height &&
+         "written image must be the same size");
+  unsigned char expected[img->width * 3];
+  unsigned char actual[img->width * 3];
+  for (int y = 0; y < img->height; ++y) {
+    ray_img_pack_row(img, y, expected);
+    ray_img_pack_row(read, y, actual);
+    assert(memcmp(expected, actual, sizeof expected) == 0 &&
+           "written pixels must read back the same");
+  }
+  ray_free_img(read);
+}
+
+#define VARIANT_WIDTH 5
+#define VARIANT_HEIGHT 3
+
+// a png of the given type whose pixels all have gray level or palette index
+// x + y * VARIANT_WIDTH, at full opacity where there's alpha, with a trns
+// chunk making palette entries see-through if asked
+static void write_variant(const char *path, int color_type, int bit_depth,
+                          bool transparency) {
+  FILE *file = fopen(path, "wb");
+  assert(file != NULL && "variant file must open");
+  png_structp png_ptr =
+      png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  png_init_io(png_ptr, file);
+  png_set_IHDR(png_ptr, info_ptr, VARIANT_WIDTH, VARIANT_HEIGHT, bit_depth,
+               color_type, PNG_INTERLACE_ADAM7, PNG_COMPRESSION_TYPE_BASE,
+               PNG_FILTER_TYPE_BASE);
+  if (color_type == PNG_COLOR_TYPE_PALETTE) {
+    png_color palette[VARIANT_WIDTH * VARIANT_HEIGHT];
+    for (int i = 0; i < VARIANT_WIDTH * VARIANT_HEIGHT; ++i) {
+      palette[i] = (png_color){.red = i, .green = i, .blue = i};
+    }
+    png_set_PLTE(png_ptr, info_ptr, palette, VARIANT_WIDTH * VARIANT_HEIGHT);
+    if (transparency) {
+      png_byte alpha[VARIANT_WIDTH * VARIANT_HEIGHT];
+      for (int i = 0; i < VARIANT_WIDTH * VARIANT_HEIGHT; ++i) {
+        alpha[i] = i * 16;
+      }
+      png_set_tRNS(png_ptr, info_ptr, alpha, VARIANT_WIDTH * VARIANT_HEIGHT,
+                   NULL);
+    }
+  }
+  png_write_info(png_ptr, info_ptr);
+  const int channels = png_get_channels(png_ptr, info_ptr);
+  const int bytes = bit_depth / 8;
+  png_byte rows[VARIANT_HEIGHT][VARIANT_WIDTH * 4 * 2];
+  png_bytep row_pointers[VARIANT_HEIGHT];
+  for (int y = 0; y < VARIANT_HEIGHT; ++y) {
+    for (int x = 0; x < VARIANT_WIDTH; ++x) {
+      int value = x + y * VARIANT_WIDTH;
+      for (int c = 0; c < channels; ++c) {
+        bool alpha = (color_type & PNG_COLOR_MASK_ALPHA) && c == channels - 1;
+        png_bytep sample = &rows[y][(x * channels + c) * bytes];
+        // 16 bit samples are big endian, v * 257 scales back down to v
+        sample[0] = alpha ? 255 : value;
+        if (bytes == 2) {
+          sample[1] = sample[0];
+        }
+      }
+    }
+    row_pointers[y] = rows[y];
+  }
+  png_write_image(png_ptr, row_pointers);
+  png_write_end(png_ptr, NULL);
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+  fclose(file);
+}
+
+// every png variant textures come in reads as the same rgb image
+static void check_variants(void) {
+  const int variants[][3] = {
+      {PNG_COLOR_TYPE_GRAY, 8, false},
+      {PNG_COLOR_TYPE_GRAY, 16, false},
+      {PNG_COLOR_TYPE_GRAY_ALPHA, 8, false},
+      {PNG_COLOR_TYPE_RGB, 16, false},
+      {PNG_COLOR_TYPE_RGB_ALPHA, 8, false},
+      {PNG_COLOR_TYPE_RGB_ALPHA, 16, false},
+      {PNG_COLOR_TYPE_PALETTE, 8, false},
+      {PNG_COLOR_TYPE_PALETTE, 8, true},
+  };
+  for (size_t v = 0; v < sizeof variants / sizeof variants[0]; ++v) {
+    write_variant("image_test_variant.png", variants[v][0], variants[v][1],
+                  variants[v][2]);
+    RayImg *img = ray_read_img("image_test_variant.png");
+    assert(img != NULL && "png variant must be readable");
+    assert(img->width == VARIANT_WIDTH && img->height == VARIANT_HEIGHT &&
+           img->channels == 3 && "png variant must read as rgb");
+    for (int y = 0; y < VARIANT_HEIGHT; ++y) {
+      for (int x = 0; x < VARIANT_WIDTH; ++x) {
+        double expected = (double)(x + y * VARIANT_WIDTH) / UCHAR_MAX;
+        for (size_t c = 0; c < 3; ++c) {
+          assert(gsl_vector_get(img->pixels[y][x], c) == expected &&
+                 "png variant must decode to the same levels");
+        }
+      }
+    }
+    ray_free_img(img);
+  }
+}
+
 int main() {
+  check_variants();
+
   RayImg *img = ray_read_img("texture.png");
 
   bool success = ray_png_write("image_test.png", img);
-  ray_free_img(img);
   if (!success) {
+    ray_free_img(img);
     fprintf(stdout, "failed to write out image\n");
     return 1;
   }
 
+  const RAY_PNG_PRESET presets[] = {
+      RAY_PNG_PRESET_default,
+      RAY_PNG_PRESET_fast,
+      RAY_PNG_PRESET_small,
+  };
+  for (size_t p = 0; p < sizeof presets / sizeof presets[0]; ++p) {
+    RayPngOptions options = ray_png_options(presets[p]);
+    check_round_trip(img, &options);
+    // and split into bands, including more of them than there are rows
+    for (int threads = 2; threads <= 5; threads += 3) {
+      options.num_threads = threads;
+      for (int f = RAY_PNG_FILTER_adaptive; f <= RAY_PNG_FILTER_up; ++f) {
+        options.filter = f;
+        check_round_trip(img, &options);
+      }
+    }
+  }
+  RayPngOptions many_bands = {
+      .compression_level = 6,
+      .num_threads = img->height + 3,
+  };
+  check_round_trip(img, &many_bands);
+
+  ray_free_img(img);
+
   return 0;
 }
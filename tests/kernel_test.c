@@ -0,0 +1,123 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#include <assert.h>
+
+#include "ray/img_utils.h"
+#include "ray/prepare.h"
+#include "ray/render.h"
+#include "ray/scene_gen.h"
+
+static unsigned scene_features(const RayScene *scene) {
+  RayPreparedScene prepared;
+  bool success = ray_prepare_scene(scene, 0.0, &prepared);
+  assert(success && "scene must prepare");
+  unsigned features = prepared.features;
+  ray_free_prepared_scene(&prepared);
+  return features;
+}
+
+// the specialised kernel has to give exactly what the generic one does
+static void assert_same_as_generic(const RayScene *scene) {
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.num_threads = 1;
+  RayImg *specialised = ray_render_scene_with_settings(scene, &settings);
+  settings.generic_kernel = true;
+  RayImg *generic = ray_render_scene_with_settings(scene, &settings);
+  assert(specialised != NULL && generic != NULL && "both kernels must render");
+
+  for (int y = 0; y < scene->height; ++y) {
+    for (int x = 0; x < scene->width; ++x) {
+      for (size_t c = 0; c < 3; ++c) {
+        assert(gsl_vector_get(specialised->pixels[y][x], c) ==
+                   gsl_vector_get(generic->pixels[y][x], c) &&
+               "specialised kernel must match the generic one");
+      }
+    }
+  }
+  ray_free_img(specialised);
+  ray_free_img(generic);
+}
+
+int main() {
+  RaySceneGenSettings settings = ray_default_scene_gen_settings();
+  settings.width = 64;
+  settings.height = 48;
+  settings.num_spheres = 60;
+  settings.num_planes = 0;
+  settings.num_lights = 3;
+  settings.reflective_fraction = 0.3;
+  settings.refractive_fraction = 0.0;
+  settings.textured_fraction = 0.0;
+
+  // spheres lit by directional lights only, the leanest kernel there is
+  RayScene scene;
+  bool success = ray_generate_scene(&settings, &scene);
+  assert(success && "scene must generate");
+  for (int i = 0; i < scene.num_lights; ++i) {
+    RayLight *light = &scene.lights[i];
+    light->type = RAY_LIGHT_TYPE_directional;
+    gsl_vector_set(light->direction, 0, 0.3 * (i - 1));
+    gsl_vector_set(light->direction, 1, -1.0);
+    gsl_vector_set(light->direction, 2, -0.5);
+    light->intensity = 2.0;
+  }
+  assert(scene_features(&scene) == 0 && "scene must need no features");
+  assert_same_as_generic(&scene);
+
+  // an update only ever adds features
+  RayPreparedScene prepared;
+  success = ray_prepare_scene(&scene, 0.0, &prepared);
+  assert(success && "scene must prepare");
+  scene.objects[0].material.surface.type = RAY_SURFACE_TYPE_refractive;
+  scene.objects[0].material.surface.index = 1.5;
+  scene.objects[0].material.surface.transparency = 0.9;
+  const int changed = 0;
+  success = ray_update_prepared_scene(&prepared, &changed, 1, false, 0.0);
+  assert(success && "refractive object must update");
+  assert(prepared.features == RAY_SCENE_FEATURE_refraction &&
+         "update must add refraction");
+  scene.objects[0].material.surface.type = RAY_SURFACE_TYPE_diffuse;
+  success = ray_update_prepared_scene(&prepared, &changed, 1, false, 0.0);
+  assert(success && "diffuse object must update");
+  assert(prepared.features == RAY_SCENE_FEATURE_refraction &&
+         "update must not drop refraction");
+  ray_free_prepared_scene(&prepared);
+  ray_free_scene(&scene);
+
+  // planes and point lights, still no textures or refraction
+  settings.num_planes = 2;
+  success = ray_generate_scene(&settings, &scene);
+  assert(success && "scene with planes must generate");
+  assert(scene_features(&scene) ==
+             (RAY_SCENE_FEATURE_planes | RAY_SCENE_FEATURE_local_lights) &&
+         "scene must need planes and local lights");
+  assert_same_as_generic(&scene);
+  ray_free_scene(&scene);
+
+  // everything, which is the generic kernel either way
+  settings.refractive_fraction = 0.2;
+  settings.textured_fraction = 0.3;
+  settings.num_textures = 2;
+  settings.texture_size = 8;
+  success = ray_generate_scene(&settings, &scene);
+  assert(success && "scene with everything must generate");
+  assert(scene_features(&scene) == RAY_SCENE_FEATURE_all &&
+         "scene must need every feature");
+  assert_same_as_generic(&scene);
+  ray_free_scene(&scene);
+}
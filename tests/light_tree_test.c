@@ -0,0 +1,114 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "gsl/gsl_math.h"
+#include "ray/light_tree.h"
+#include "ray/vec_utils.h"
+
+#define NUM_LIGHTS 300
+#define NUM_POINTS 2000
+#define CUTOFF 0.01
+
+static double random_coord(void) { return (double)rand() / RAND_MAX * 100.0; }
+
+static bool reaches(const RayLight *light, const gsl_vector *point) {
+  if (light->type == RAY_LIGHT_TYPE_directional) {
+    return true;
+  }
+  double d2 = 0.0;
+  for (size_t a = 0; a < 3; ++a) {
+    double d = gsl_vector_get(light->position, a) - gsl_vector_get(point, a);
+    d2 += d * d;
+  }
+  double radius = ray_light_influence_radius(light, CUTOFF);
+  return d2 <= radius * radius;
+}
+
+int main() {
+  srand(7);
+  RayLight *lights = malloc(NUM_LIGHTS * (sizeof *lights));
+  for (int l = 0; l < NUM_LIGHTS; ++l) {
+    if (l % 50 == 0) {
+      lights[l] = (RayLight){
+          .type = RAY_LIGHT_TYPE_directional,
+          .direction = ray_create_vec3(0.0, -1.0, 0.0),
+          .color = ray_create_vec3(1.0, 1.0, 1.0),
+          .intensity = 1.0,
+      };
+    } else {
+      lights[l] = (RayLight){
+          .type = RAY_LIGHT_TYPE_point,
+          .position =
+              ray_create_vec3(random_coord(), random_coord(), random_coord()),
+          .color = ray_create_vec3(1.0, 0.5, 0.25),
+          .intensity = 100.0 + rand() % 2000,
+      };
+    }
+  }
+  RayScene scene = {
+      .num_lights = NUM_LIGHTS,
+      .lights = lights,
+  };
+
+  // at the radius a light is exactly at the cutoff
+  double radius = ray_light_influence_radius(&lights[1], CUTOFF);
+  assert(fabs(lights[1].intensity / (4.0 * M_PI * radius * radius) - CUTOFF) <
+             1e-9 &&
+         "influence radius must be where the light drops to the cutoff");
+
+  RayLightTree tree;
+  bool built = ray_build_light_tree(&scene, CUTOFF, &tree);
+  assert(built && "building the tree must succeed");
+  int found[NUM_LIGHTS];
+  gsl_vector *point = gsl_vector_alloc(3);
+  for (int p = 0; p < NUM_POINTS; ++p) {
+    for (size_t a = 0; a < 3; ++a) {
+      gsl_vector_set(point, a, random_coord());
+    }
+    int count = ray_light_tree_query(&tree, &scene, point, found);
+    bool seen[NUM_LIGHTS] = {false};
+    for (int i = 0; i < count; ++i) {
+      assert(!seen[found[i]] && "lights must only be returned once");
+      seen[found[i]] = true;
+    }
+    for (int l = 0; l < NUM_LIGHTS; ++l) {
+      assert(seen[l] == reaches(&lights[l], point) &&
+             "exactly the lights in range must be returned");
+    }
+  }
+  ray_free_light_tree(&tree);
+
+  // without a cutoff every light is returned, in scene order
+  built = ray_build_light_tree(&scene, 0.0, &tree);
+  assert(built && "building the tree must succeed");
+  int count = ray_light_tree_query(&tree, &scene, point, found);
+  assert(count == NUM_LIGHTS && "no cutoff must keep every light");
+  for (int l = 0; l < NUM_LIGHTS; ++l) {
+    assert(found[l] == l && "no cutoff must keep the scene order");
+  }
+  ray_free_light_tree(&tree);
+
+  gsl_vector_free(point);
+  ray_free_scene(&scene);
+
+  return 0;
+}
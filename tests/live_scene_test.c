@@ -0,0 +1,219 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for utimensat
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "ray/img_utils.h"
+#include "ray/loader.h"
+#include "ray/prepare.h"
+#include "ray/render.h"
+#include "ray/scene_watch.h"
+
+#define SCENE_PATH "live_scene_test.json"
+#define TEXTURE_PATH "live_scene_test.png"
+
+// a 2x2 texture all of one grey, with a modification time of seconds since
+// the epoch so rewriting it is always noticed
+static void write_texture(double grey, time_t seconds) {
+  RayImg *img = ray_create_packed_img(2, 2, 3);
+  assert(img != NULL);
+  for (int i = 0; i < 2 * 2 * 3; ++i) {
+    img->data[i] = grey;
+  }
+  bool success = ray_png_write(TEXTURE_PATH, img);
+  assert(success && "texture must be written");
+  ray_free_img(img);
+  const struct timespec times[2] = {{.tv_sec = seconds},
+                                    {.tv_sec = seconds}};
+  int result = utimensat(AT_FDCWD, TEXTURE_PATH, times, 0);
+  assert(result == 0 && "texture must be dated");
+}
+
+// three spheres (the middle one textured) and a light. radius and x of the
+// first sphere and the background's red are what edits change
+static void write_scene(double radius, double x, double red,
+                        bool extra_sphere) {
+  FILE *file = fopen(SCENE_PATH, "w");
+  assert(file != NULL && "scene file must open");
+  fprintf(file,
+          "{\"width\": 8, \"height\": 8, \"fov\": 90.0,\n"
+          " \"shadow-bias\": 1e-12, \"max-recursion-depth\": 2,\n"
+          " \"background\": {\"r\": %g, \"g\": 0.0, \"b\": 0.0},\n"
+          " \"objects\": [\n",
+          red);
+  const char *material = "\"material\": {\"coloration\": {\"color\": "
+                         "{\"r\": 1.0, \"g\": 1.0, \"b\": 1.0}}, "
+                         "\"albedo\": 0.18, \"surface\": \"diffuse\"}";
+  fprintf(file,
+          "  {\"sphere\": {\"center\": {\"x\": %g, \"y\": 0.0, \"z\": -5.0}, "
+          "\"radius\": %g, %s}},\n",
+          x, radius, material);
+  fprintf(file, "  {\"sphere\": {\"center\": {\"x\": 2.0, \"y\": 0.0, "
+                "\"z\": -5.0}, \"radius\": 1.0, \"material\": "
+                "{\"coloration\": {\"texture\": \"" TEXTURE_PATH "\"}, "
+                "\"albedo\": 0.18, \"surface\": \"diffuse\"}}},\n");
+  if (extra_sphere) {
+    fprintf(file,
+            "  {\"sphere\": {\"center\": {\"x\": 0.0, \"y\": 3.0, "
+            "\"z\": -5.0}, \"radius\": 1.0, %s}},\n",
+            material);
+  }
+  fprintf(file,
+          "  {\"sphere\": {\"center\": {\"x\": -2.0, \"y\": 0.0, "
+          "\"z\": -5.0}, \"radius\": 1.0, %s}}\n"
+          " ],\n"
+          " \"lights\": [{\"point\": {\"position\": {\"x\": 0.0, \"y\": 5.0, "
+          "\"z\": 0.0}, \"color\": {\"r\": 1.0, \"g\": 1.0, \"b\": 1.0}, "
+          "\"intensity\": 100.0}}]}\n",
+          material);
+  fclose(file);
+}
+
+// a renderer keeping the scene prepared across edits has to render exactly
+// what one preparing it from scratch does
+static void assert_renders_fresh(RayRenderer *renderer,
+                                 const RayScene *scene) {
+  RayImg *kept = ray_renderer_render(renderer, scene);
+  RayImg *fresh = ray_render_scene_with_settings(scene, NULL);
+  assert(kept != NULL && fresh != NULL);
+  for (int y = 0; y < scene->height; ++y) {
+    for (int x = 0; x < scene->width; ++x) {
+      for (size_t c = 0; c < 3; ++c) {
+        assert(gsl_vector_get(kept->pixels[y][x], c) ==
+                   gsl_vector_get(fresh->pixels[y][x], c) &&
+               "the kept prepared scene must be up to date");
+      }
+    }
+  }
+  ray_free_img(kept);
+  ray_free_img(fresh);
+}
+
+int main() {
+  write_texture(0.0, 1000);
+  write_scene(1.0, 0.0, 0.0, false);
+  RayLiveScene *live = ray_load_live_scene(SCENE_PATH);
+  assert(live != NULL && "live scene must load");
+  RayScene *scene = ray_live_scene(live);
+  assert(scene->num_objects == 3 && scene->num_lights == 1 &&
+         "live scene must have every object and light");
+  const RayImg *texture = scene->objects[1].material.coloration.texture;
+  const gsl_vector *third_center = scene->objects[2].center;
+  RayPreparedScene prepared;
+  bool success = ray_prepare_scene(scene, 0.0, &prepared);
+  assert(success && "preparing the live scene must succeed");
+
+  RayRenderer *renderer = ray_create_renderer(NULL);
+  assert(renderer != NULL && "renderer must be created");
+  assert_renders_fresh(renderer, scene);
+
+  RaySceneChanges changes;
+  RaySceneWatch *watch = ray_create_scene_watch(SCENE_PATH);
+  assert(watch != NULL && "watching the scene must succeed");
+  int noticed = ray_scene_watch_wait(watch, 0);
+  assert(noticed == 0 && "nothing must have changed yet");
+
+  // one object edited: only it is loaded again
+  write_scene(2.0, 0.0, 0.0, false);
+  noticed = ray_scene_watch_wait(watch, 5000);
+  assert(noticed == 1 && "writing the scene must be noticed");
+  success = ray_reload_live_scene(live, &changes);
+  assert(success && "reloading must succeed");
+  assert(ray_live_scene(live) == scene && "the scene must stay put");
+  assert(changes.num_changed_objects == 1 &&
+         changes.changed_objects[0] == 0 && !changes.moved &&
+         !changes.settings && changes.num_changed_lights == 0 &&
+         "only the edited object must have changed");
+  assert(scene->objects[0].radius == 2.0 && "the edit must be loaded");
+  assert(scene->objects[1].material.coloration.texture == texture &&
+         scene->objects[2].center == third_center &&
+         "unchanged objects and textures must be kept");
+  success = ray_update_prepared_scene(&prepared, changes.changed_objects,
+                                      changes.num_changed_objects,
+                                      changes.num_changed_lights > 0, 0.0);
+  assert(success && prepared.sphere_radius2[0] == 4.0 &&
+         "the prepared scene must be patched");
+  // the renderer starts keeping it from here
+  success = ray_renderer_apply_changes(renderer, scene, &changes);
+  assert(success && "applying changes must succeed");
+  assert_renders_fresh(renderer, scene);
+  ray_free_scene_changes(&changes);
+
+  // settings only
+  write_scene(2.0, 0.0, 0.5, false);
+  success = ray_reload_live_scene(live, &changes);
+  assert(success && changes.settings && changes.num_changed_objects == 0 &&
+         gsl_vector_get(scene->background, 0) == 0.5 &&
+         "a settings edit must only reload the settings");
+  success = ray_renderer_apply_changes(renderer, scene, &changes);
+  assert(success && "applying changes must succeed");
+  assert_renders_fresh(renderer, scene);
+  ray_free_scene_changes(&changes);
+
+  // an object added in the middle moves the ones after it
+  write_scene(2.0, 0.0, 0.5, true);
+  success = ray_reload_live_scene(live, &changes);
+  assert(success && changes.moved && changes.num_changed_objects == 1 &&
+         changes.changed_objects[0] == 2 && scene->num_objects == 4 &&
+         scene->objects[3].center == third_center &&
+         "inserting an object must be a move, reusing the rest");
+  success = ray_renderer_apply_changes(renderer, scene, &changes);
+  assert(success && "applying changes must succeed");
+  assert_renders_fresh(renderer, scene);
+  ray_free_scene_changes(&changes);
+
+  // an edit to the kept scene is patched in
+  write_scene(1.5, 0.5, 0.5, true);
+  success = ray_reload_live_scene(live, &changes);
+  assert(success && !changes.moved && changes.num_changed_objects == 1 &&
+         "an edit after a move must not be a move");
+  success = ray_renderer_apply_changes(renderer, scene, &changes);
+  assert(success && "applying changes must succeed");
+  assert_renders_fresh(renderer, scene);
+  ray_free_scene_changes(&changes);
+
+  // a half written file leaves the scene alone, textures included
+  write_texture(1.0, 2000);
+  FILE *file = fopen(SCENE_PATH, "w");
+  fprintf(file, "{\"width\": 8, \"objects\": [");
+  fclose(file);
+  success = ray_reload_live_scene(live, &changes);
+  assert(!success && scene->num_objects == 4 &&
+         gsl_vector_get(texture->pixels[0][0], 0) == 0.0 &&
+         "a broken file must leave the scene as it was");
+
+  // once it's fixed the new texture is picked up, in the same image
+  write_scene(2.0, 0.0, 0.5, true);
+  success = ray_reload_live_scene(live, &changes);
+  assert(success && changes.num_reloaded_textures == 1 &&
+         scene->objects[1].material.coloration.texture == texture &&
+         gsl_vector_get(texture->pixels[0][0], 0) == 1.0 &&
+         "a changed texture must be decoded again");
+  ray_free_scene_changes(&changes);
+
+  ray_free_prepared_scene(&prepared);
+  ray_free_renderer(renderer);
+  ray_free_scene_watch(watch);
+  ray_free_live_scene(live);
+  return 0;
+}
@@ -16,11 +16,124 @@
 //  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
 //  USA
 
+#include <assert.h>
+
 #include "ray/img_utils.h"
 #include "ray/render.h"
 #include "ray/loader.h"
 
+static void write_textured_scene(const char *path, const char *texture) {
+  FILE *file = fopen(path, "w");
+  assert(file != NULL && "scene file must open");
+  fprintf(file,
+          "{\"width\": 4, \"height\": 4, \"fov\": 90.0, "
+          "\"shadow-bias\": 1e-12, \"max-recursion-depth\": 2, "
+          "\"background\": {\"r\": 0.0, \"g\": 0.0, \"b\": 0.0}, "
+          "\"objects\": [");
+  for (int i = 0; i < 3; ++i) {
+    fprintf(file,
+            "%s{\"sphere\": {\"center\": {\"x\": %d.0, \"y\": 0.0, "
+            "\"z\": -5.0}, \"radius\": 1.0, \"material\": "
+            "{\"coloration\": {\"texture\": \"%s\"}, \"albedo\": 0.18, "
+            "\"surface\": \"diffuse\"}}}",
+            i > 0 ? ", " : "", i * 3, i == 1 ? texture : "texture.png");
+  }
+  fprintf(file, "], \"lights\": []}");
+  fclose(file);
+}
+
+// textures are decoded after the walk, once per distinct path
+static void check_textures(void) {
+  RayScene scene;
+  write_textured_scene("loader_test_textures.json", "texture.png");
+  bool success = ray_scene_from_file("loader_test_textures.json", &scene);
+  assert(success && "textured scene must load");
+  const RayImg *texture = scene.objects[0].material.coloration.texture;
+  assert(texture->width > 0 && "texture must be decoded");
+  for (int i = 1; i < scene.num_objects; ++i) {
+    assert(scene.objects[i].material.coloration.texture == texture &&
+           "repeated textures must be shared");
+  }
+  ray_free_scene(&scene);
+
+  write_textured_scene("loader_test_textures.json", "missing.png");
+  success = ray_scene_from_file("loader_test_textures.json", &scene);
+  assert(!success && "a missing texture must fail the load");
+}
+
+static void count_object(const RayObject *object, int index, void *data) {
+  int *count = data;
+  assert(index == *count && "objects must be handed over in order");
+  *count += 1;
+}
+
+// the streaming loader builds the same scene without a dom of the file
+static void check_streaming(void) {
+  RayScene loaded;
+  bool success = ray_scene_from_file("scene.json", &loaded);
+  assert(success && "scene.json must load");
+  int streamed_objects = 0;
+  RaySceneStreamHandlers handlers = {
+      .on_object = count_object,
+      .data = &streamed_objects,
+  };
+  RayScene streamed;
+  success =
+      ray_scene_stream_from_file("scene.json", NULL, &handlers, &streamed);
+  assert(success && "scene.json must stream");
+  assert(streamed_objects == loaded.num_objects &&
+         "every object must be handed to the handler");
+  assert(streamed.width == loaded.width && streamed.fov == loaded.fov &&
+         streamed.max_recursion_depth == loaded.max_recursion_depth &&
+         gsl_vector_equal(streamed.background, loaded.background) &&
+         "streamed settings must match");
+  assert(streamed.num_objects == loaded.num_objects &&
+         streamed.num_lights == loaded.num_lights &&
+         "streamed scene must have the same objects and lights");
+  for (int i = 0; i < loaded.num_objects; ++i) {
+    const RayObject *a = &streamed.objects[i];
+    const RayObject *b = &loaded.objects[i];
+    assert(a->type == b->type &&
+           a->material.coloration.type == b->material.coloration.type &&
+           a->material.albedo == b->material.albedo &&
+           "streamed objects must match");
+  }
+  for (int i = 0; i < loaded.num_lights; ++i) {
+    assert(streamed.lights[i].type == loaded.lights[i].type &&
+           streamed.lights[i].intensity == loaded.lights[i].intensity &&
+           "streamed lights must match");
+  }
+  ray_free_scene(&streamed);
+  ray_free_scene(&loaded);
+
+  // settings can come after the arrays, unknown members are skipped
+  FILE *file = fopen("loader_test_stream.json", "w");
+  assert(file != NULL && "scene file must open");
+  fprintf(file, "{\"objects\": [], \"lights\": [], \"notes\": "
+                "[\"a ] \\\" {\", {}], \"width\": 4, \"height\": 3, "
+                "\"fov\": 90, \"shadow-bias\": 1e-12, "
+                "\"max-recursion-depth\": 2, \"background\": "
+                "{\"r\": 0.5, \"g\": 0.0, \"b\": 0.0}}\n");
+  fclose(file);
+  success = ray_scene_stream_from_file("loader_test_stream.json", NULL, NULL,
+                                       &streamed);
+  assert(success && streamed.height == 3 && streamed.num_objects == 0 &&
+         "settings after the arrays must load");
+  ray_free_scene(&streamed);
+
+  // cut off part way through
+  file = fopen("loader_test_stream.json", "w");
+  fprintf(file, "{\"width\": 4, \"objects\": [{\"sphere\": {");
+  fclose(file);
+  success = ray_scene_stream_from_file("loader_test_stream.json", NULL, NULL,
+                                       &streamed);
+  assert(!success && "a truncated scene must fail to stream");
+}
+
 int main() {
+  check_textures();
+  check_streaming();
+
   RayScene scene;
   bool success = ray_scene_from_file("scene.json", &scene);
   if (!success) {
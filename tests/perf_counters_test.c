@@ -0,0 +1,128 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#include <assert.h>
+#include <stdio.h>
+
+#include "ray/img_utils.h"
+#include "ray/perf_counters.h"
+#include "ray/render.h"
+#include "ray/scene_gen.h"
+
+static RayImg *render(const RayScene *scene, bool batch_shadows,
+                      bool perf_counters, int perf_sample_every,
+                      RayRenderStats *stats) {
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.num_threads = 2;
+  settings.batch_shadows = batch_shadows;
+  settings.perf_counters = perf_counters;
+  settings.perf_sample_every = perf_sample_every;
+  RayRenderer *renderer = ray_create_renderer(&settings);
+  assert(renderer != NULL);
+  RayImg *img = ray_renderer_render(renderer, scene);
+  assert(img != NULL);
+  *stats = ray_renderer_stats(renderer);
+  ray_free_renderer(renderer);
+  return img;
+}
+
+static void check_stages(const RayRenderStats *stats, bool every_pixel) {
+  for (int c = 0; c < RAY_PERF_COUNTER_count; ++c) {
+    uint64_t total = 0;
+    for (int s = 0; s < RAY_RENDER_STAGE_count; ++s) {
+      total += stats->perf[s][c];
+    }
+    if (!(stats->perf_counters & (1u << c))) {
+      assert(total == 0);
+      continue;
+    }
+    assert(total > 0);
+    if (!every_pixel) {
+      // a sample this small might well miss a stage
+      continue;
+    }
+    // every stage has something to do in this scene
+    for (int s = 0; s < RAY_RENDER_STAGE_count; ++s) {
+      assert(stats->perf[s][c] > 0);
+    }
+  }
+}
+
+int main() {
+  // whatever's there outside the render, the counters go up
+  RayPerfCounters counters;
+  if (ray_open_perf_counters(&counters)) {
+    uint64_t before[RAY_PERF_COUNTER_count];
+    uint64_t after[RAY_PERF_COUNTER_count];
+    bool success = ray_read_perf_counters(&counters, before);
+    assert(success && "counters must read before");
+    volatile double sum = 0.0;
+    for (int i = 0; i < 1000000; ++i) {
+      sum += i;
+    }
+    success = ray_read_perf_counters(&counters, after);
+    assert(success && "counters must read after");
+    for (int c = 0; c < RAY_PERF_COUNTER_count; ++c) {
+      assert(after[c] >= before[c]);
+    }
+    if (counters.available & (1u << RAY_PERF_COUNTER_instructions)) {
+      assert(after[RAY_PERF_COUNTER_instructions] >
+             before[RAY_PERF_COUNTER_instructions] + 1000000);
+    }
+    ray_close_perf_counters(&counters);
+  } else {
+    printf("no perf counters available, only checking they stay zero\n");
+  }
+
+  RaySceneGenSettings gen = ray_default_scene_gen_settings();
+  gen.width = 48;
+  gen.height = 32;
+  gen.num_spheres = 30;
+  gen.reflective_fraction = 0.5;
+  RayScene scene;
+  bool success = ray_generate_scene(&gen, &scene);
+  assert(success && "scene must generate");
+
+  for (int batch = 0; batch < 2; ++batch) {
+    RayRenderStats plain_stats;
+    RayImg *plain = render(&scene, batch, false, 1, &plain_stats);
+    assert(plain_stats.perf_counters == 0);
+    check_stages(&plain_stats, true);
+    // every pixel split by stage, then the default sample
+    const int sample_every[] = {
+        1, ray_default_render_settings().perf_sample_every};
+    for (int i = 0; i < 2; ++i) {
+      RayRenderStats counted_stats;
+      RayImg *counted =
+          render(&scene, batch, true, sample_every[i], &counted_stats);
+      check_stages(&counted_stats, sample_every[i] <= 1);
+      assert(counted_stats.shadow_rays == plain_stats.shadow_rays);
+      for (int y = 0; y < scene.height; ++y) {
+        for (int x = 0; x < scene.width; ++x) {
+          for (size_t c = 0; c < 3; ++c) {
+            assert(gsl_vector_get(plain->pixels[y][x], c) ==
+                   gsl_vector_get(counted->pixels[y][x], c));
+          }
+        }
+      }
+      ray_free_img(counted);
+    }
+    ray_free_img(plain);
+  }
+
+  ray_free_scene(&scene);
+}
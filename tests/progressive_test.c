@@ -0,0 +1,79 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include <assert.h>
+
+#include "ray/img_utils.h"
+#include "ray/loader.h"
+#include "ray/render.h"
+
+typedef struct PassLog {
+  int num_passes;
+  int steps[8];
+} PassLog;
+
+static bool log_pass(const RayImg *img, int step, void *user_data) {
+  PassLog *log = user_data;
+  assert(log->num_passes < 8 && "too many passes reported");
+  log->steps[log->num_passes] = step;
+  log->num_passes += 1;
+  return true;
+}
+
+int main() {
+  RayScene scene;
+  bool success = ray_scene_from_file("scene.json", &scene);
+  if (!success) {
+    fprintf(stderr, "failed to load scene.json\n");
+    return 1;
+  }
+
+  PassLog log = {0};
+  RayProgressiveOptions options = {
+      .initial_step = 8,
+      .on_pass = log_pass,
+      .user_data = &log,
+  };
+  int completed_step;
+  RayImg *img = ray_render_scene_progressive(&scene, &options, &completed_step);
+  assert(img != NULL && "progressive render must produce an image");
+  assert(completed_step == 1 && "uncancelled render must finish");
+  assert(log.num_passes == 4 && "should refine 8, 4, 2 then 1");
+  for (int i = 0; i < log.num_passes; ++i) {
+    assert(log.steps[i] == 8 >> i && "passes must go coarse to fine");
+  }
+  ray_png_write("progressive_test.png", img);
+  ray_free_img(img);
+
+  // a token cancelled up front still has to hand back a writable image
+  RayCancelToken cancel;
+  ray_cancel_token_init(&cancel);
+  ray_cancel_token_cancel(&cancel);
+  log.num_passes = 0;
+  options.cancel = &cancel;
+  img = ray_render_scene_progressive(&scene, &options, &completed_step);
+  assert(img != NULL && "cancelled render must still produce an image");
+  assert(completed_step == 0 && "cancelled render can't finish a pass");
+  assert(log.num_passes == 0 && "cancelled render can't report passes");
+  success = ray_png_write("progressive_cancel_test.png", img);
+  ray_free_img(img);
+
+  ray_free_scene(&scene);
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for raise
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <signal.h>
+#include <string.h>
+
+#include "ray/render_farm.h"
+#include "ray/scene_gen.h"
+
+// whether part matches whole wherever part has a pixel, or only inside rect
+// if it's given
+static bool matches(const RayFramebuffer *part, const RayFramebuffer *whole,
+                    const RayTile *rect) {
+  RayTile all = {part->x, part->y, part->width, part->height};
+  rect = rect != NULL ? rect : &all;
+  for (int y = rect->y; y < rect->y + rect->height; ++y) {
+    for (int x = rect->x; x < rect->x + rect->width; ++x) {
+      if (memcmp(ray_framebuffer_pixel(part, x - part->x, y - part->y),
+                 ray_framebuffer_pixel(whole, x, y),
+                 RAY_FRAMEBUFFER_CHANNELS * sizeof(float)) != 0) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void kill_worker(int worker, void *data) {
+  const int *victim = data;
+  if (*victim < 0 || worker == *victim) {
+    raise(SIGKILL);
+  }
+}
+
+int main() {
+  RaySceneGenSettings gen = ray_default_scene_gen_settings();
+  gen.num_spheres = 100;
+  gen.width = 96;
+  gen.height = 72;
+  RayScene scene;
+  bool success = ray_generate_scene(&gen, &scene);
+  assert(success && "scene must generate");
+
+  RayRenderSettings settings = ray_default_render_settings();
+  settings.num_threads = 2;
+  RayRenderer *renderer = ray_create_renderer(&settings);
+  RayFramebuffer *whole = ray_renderer_render_hdr(renderer, &scene);
+  assert(whole != NULL);
+
+  // a region comes out the same as that part of the whole image, hanging
+  // off the edge it's clipped
+  RayFramebuffer *part = ray_renderer_render_region(
+      renderer, &scene, (RayTile){.x = 13, .y = 7, .width = 40, .height = 30});
+  assert(part != NULL && part->x == 13 && part->y == 7 &&
+         part->width == 40 && part->height == 30);
+  assert(matches(part, whole, NULL));
+  ray_free_framebuffer(part);
+  part = ray_renderer_render_region(
+      renderer, &scene, (RayTile){.x = 80, .y = -5, .width = 40, .height = 20});
+  assert(part != NULL && part->x == 80 && part->y == 0 &&
+         part->width == 16 && part->height == 15);
+  assert(matches(part, whole, NULL));
+  ray_free_framebuffer(part);
+
+  // so do scattered tiles, with nothing rendered in between
+  RayTile tiles[] = {{0, 0, 10, 10}, {50, 40, 20, 8}};
+  part = ray_renderer_render_tiles(renderer, &scene, tiles, 2);
+  assert(part != NULL && part->x == 0 && part->y == 0 &&
+         part->width == 70 && part->height == 48);
+  assert(matches(part, whole, &tiles[0]) && matches(part, whole, &tiles[1]));
+  assert(ray_framebuffer_pixel(part, 30, 20)[0] == 0.0f);
+  ray_free_framebuffer(part);
+  RayTile outside = {90, 0, 10, 10};
+  part = ray_renderer_render_tiles(renderer, &scene, &outside, 1);
+  assert(part == NULL && "tiles outside the image must not render");
+
+  // the farm puts together exactly the same image
+  RayFarmSettings farm = ray_default_farm_settings();
+  farm.num_workers = 3;
+  farm.batch_size = 2;
+  RayFarmStats stats;
+  RayFramebuffer *farmed = ray_farm_render_hdr(&scene, &farm, &stats);
+  assert(farmed != NULL && matches(farmed, whole, NULL));
+  assert(stats.num_workers == 3 && stats.failed_workers == 0);
+  ray_free_framebuffer(farmed);
+
+  // and still does when one of the workers dies
+  int victim = 1;
+  farm.on_worker_start = kill_worker;
+  farm.data = &victim;
+  farmed = ray_farm_render_hdr(&scene, &farm, &stats);
+  assert(farmed != NULL && matches(farmed, whole, NULL));
+  assert(stats.failed_workers == 1 && stats.requeued_batches > 0);
+  ray_free_framebuffer(farmed);
+
+  // but not when they all do
+  victim = -1;
+  farmed = ray_farm_render_hdr(&scene, &farm, &stats);
+  assert(farmed == NULL && stats.failed_workers == 3 &&
+         "a farm without workers must fail");
+
+  ray_free_framebuffer(whole);
+  ray_free_renderer(renderer);
+  ray_free_scene(&scene);
+}
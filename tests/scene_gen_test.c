@@ -0,0 +1,197 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "ray/loader.h"
+#include "ray/scene_gen.h"
+
+#define PATH "scene_gen_test.json"
+
+static bool vectors_equal(const gsl_vector *a, const gsl_vector *b) {
+  return gsl_vector_get(a, 0) == gsl_vector_get(b, 0) &&
+         gsl_vector_get(a, 1) == gsl_vector_get(b, 1) &&
+         gsl_vector_get(a, 2) == gsl_vector_get(b, 2);
+}
+
+static bool textures_equal(const RayImg *a, const RayImg *b) {
+  if (a->width != b->width || a->height != b->height) {
+    return false;
+  }
+  for (int y = 0; y < a->height; ++y) {
+    for (int x = 0; x < a->width; ++x) {
+      if (!vectors_equal(a->pixels[y][x], b->pixels[y][x])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static bool materials_equal(const RayMaterial *a, const RayMaterial *b) {
+  const RayColoration *ca = &a->coloration;
+  const RayColoration *cb = &b->coloration;
+  if (ca->type != cb->type || a->albedo != b->albedo ||
+      a->surface.type != b->surface.type) {
+    return false;
+  }
+  bool same_coloration = ca->type == RAY_COLORATION_TYPE_color
+                             ? vectors_equal(ca->color, cb->color)
+                             : textures_equal(ca->texture, cb->texture);
+  switch (a->surface.type) {
+  case RAY_SURFACE_TYPE_diffuse:
+    return same_coloration;
+  case RAY_SURFACE_TYPE_reflective:
+    return same_coloration &&
+           a->surface.reflectivity == b->surface.reflectivity;
+  case RAY_SURFACE_TYPE_refractive:
+    return same_coloration && a->surface.index == b->surface.index &&
+           a->surface.transparency == b->surface.transparency;
+  }
+  return false;
+}
+
+static bool scenes_equal(const RayScene *a, const RayScene *b) {
+  if (a->width != b->width || a->height != b->height ||
+      a->num_objects != b->num_objects || a->num_lights != b->num_lights) {
+    return false;
+  }
+  for (int i = 0; i < a->num_objects; ++i) {
+    const RayObject *oa = &a->objects[i];
+    const RayObject *ob = &b->objects[i];
+    bool same = oa->type == ob->type &&
+                (oa->type == RAY_OBJECT_TYPE_sphere
+                     ? vectors_equal(oa->center, ob->center) &&
+                           oa->radius == ob->radius
+                     : vectors_equal(oa->point, ob->point) &&
+                           vectors_equal(oa->normal, ob->normal)) &&
+                materials_equal(&oa->material, &ob->material);
+    if (!same) {
+      return false;
+    }
+  }
+  for (int i = 0; i < a->num_lights; ++i) {
+    const RayLight *la = &a->lights[i];
+    const RayLight *lb = &b->lights[i];
+    if (la->type != lb->type || !vectors_equal(la->position, lb->position) ||
+        !vectors_equal(la->color, lb->color) ||
+        la->intensity != lb->intensity) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// root mean square distance of the spheres from their average
+static double spread(const RayScene *scene) {
+  double mean[3] = {0.0, 0.0, 0.0};
+  int count = 0;
+  for (int i = 0; i < scene->num_objects; ++i) {
+    if (scene->objects[i].type == RAY_OBJECT_TYPE_sphere) {
+      for (size_t c = 0; c < 3; ++c) {
+        mean[c] += gsl_vector_get(scene->objects[i].center, c);
+      }
+      ++count;
+    }
+  }
+  for (size_t c = 0; c < 3; ++c) {
+    mean[c] /= count;
+  }
+  double sum = 0.0;
+  for (int i = 0; i < scene->num_objects; ++i) {
+    if (scene->objects[i].type == RAY_OBJECT_TYPE_sphere) {
+      for (size_t c = 0; c < 3; ++c) {
+        double d = gsl_vector_get(scene->objects[i].center, c) - mean[c];
+        sum += d * d;
+      }
+    }
+  }
+  return sqrt(sum / count);
+}
+
+int main() {
+  RaySceneGenSettings settings = ray_default_scene_gen_settings();
+  settings.num_spheres = 500;
+  settings.num_planes = 4;
+  settings.num_lights = 6;
+  settings.reflective_fraction = 0.3;
+  settings.refractive_fraction = 0.2;
+  settings.textured_fraction = 0.4;
+  settings.num_textures = 3;
+  settings.texture_size = 32;
+
+  RayScene scene;
+  RayScene again;
+  bool success = ray_generate_scene(&settings, &scene);
+  assert(success && "scene must generate");
+  success = ray_generate_scene(&settings, &again);
+  assert(success && "scene must generate again");
+  assert(scene.num_objects == 504 && scene.num_lights == 6);
+  assert(scenes_equal(&scene, &again));
+  ray_free_scene(&again);
+
+  // roughly the fractions asked for
+  int counts[3] = {0, 0, 0};
+  int textured = 0;
+  for (int i = 0; i < scene.num_objects; ++i) {
+    const RayMaterial *material = &scene.objects[i].material;
+    ++counts[material->surface.type];
+    textured += material->coloration.type == RAY_COLORATION_TYPE_texture;
+  }
+  assert(counts[RAY_SURFACE_TYPE_reflective] > 100 &&
+         counts[RAY_SURFACE_TYPE_reflective] < 200);
+  assert(counts[RAY_SURFACE_TYPE_refractive] > 60 &&
+         counts[RAY_SURFACE_TYPE_refractive] < 140);
+  assert(textured > 150 && textured < 250);
+
+  // written out and loaded back it's exactly the same scene
+  success = ray_write_generated_scene(&settings, PATH);
+  assert(success && "scene must write");
+  RayScene loaded;
+  success = ray_scene_from_file(PATH, &loaded);
+  assert(success && "written scene must load");
+  assert(scenes_equal(&scene, &loaded));
+  ray_free_scene(&loaded);
+
+  // adding lights leaves the objects where they were (the lights themselves
+  // get dimmer to make up for it)
+  settings.num_lights = 7;
+  success = ray_generate_scene(&settings, &again);
+  assert(success && "scene with another light must generate");
+  scene.num_lights = 0;
+  again.num_lights = 0;
+  assert(scenes_equal(&scene, &again));
+  ray_free_scene(&again);
+
+  // clustering pulls the spheres together
+  settings.clustering = 0.9;
+  settings.num_clusters = 1;
+  success = ray_generate_scene(&settings, &again);
+  assert(success && "clustered scene must generate");
+  assert(spread(&again) < 0.2 * spread(&scene));
+  ray_free_scene(&again);
+
+  ray_free_scene(&scene);
+  remove(PATH);
+  for (int t = 0; t < settings.num_textures; ++t) {
+    char texture[64];
+    snprintf(texture, sizeof texture, "scene_gen_test_texture%d.png", t);
+    remove(texture);
+  }
+}
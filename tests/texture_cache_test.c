@@ -0,0 +1,175 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+// for nanosleep
+#define _POSIX_C_SOURCE 200809L
+
+#include <assert.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "ray/img_utils.h"
+#include "ray/texture_cache.h"
+
+// 3x4 tiles at the top level, not a whole number of them either way
+#define WIDTH 150
+#define HEIGHT 200
+#define TILE_BYTES (RAY_TEXTURE_TILE_SIZE * RAY_TEXTURE_TILE_SIZE * 3)
+#define NUM_THREADS 4
+#define CACHE_DIR "texture_cache_test.d"
+
+static int texel_level(int x, int y, size_t c) {
+  return c == 0 ? x : c == 1 ? y : (x * 7 + y * 3) % 256;
+}
+
+// whether sampling the middle of texel (x, y) of the top level gives back
+// what was written there
+static bool sample_matches(RayCachedTexture *texture, int x, int y,
+                           gsl_vector *color) {
+  RayTexCoord coord = {
+      .x = (x + 0.5) / WIDTH,
+      .y = (y + 0.5) / HEIGHT,
+  };
+  ray_cached_texture_sample_into(texture, coord, 0.0, color);
+  for (size_t c = 0; c < 3; ++c) {
+    int level = (int)(gsl_vector_get(color, c) * UCHAR_MAX + 0.5);
+    if (level != texel_level(x, y, c)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void *sample_everywhere(void *voidTexture) {
+  RayCachedTexture *texture = voidTexture;
+  gsl_vector *color = gsl_vector_alloc(3);
+  bool all_match = true;
+  for (int pass = 0; pass < 3; ++pass) {
+    for (int y = 0; y < HEIGHT; y += 3) {
+      for (int x = 0; x < WIDTH; x += 5) {
+        all_match = sample_matches(texture, x, y, color) && all_match;
+      }
+    }
+  }
+  gsl_vector_free(color);
+  return all_match ? texture : NULL;
+}
+
+int main() {
+  RayImg *img = ray_create_packed_img(WIDTH, HEIGHT, 3);
+  for (int y = 0; y < HEIGHT; ++y) {
+    for (int x = 0; x < WIDTH; ++x) {
+      for (size_t c = 0; c < 3; ++c) {
+        gsl_vector_set(img->pixels[y][x], c,
+                       texel_level(x, y, c) / (double)UCHAR_MAX);
+      }
+    }
+  }
+  bool success = ray_png_write("texture_cache_test.png", img);
+  assert(success && "writing the texture must succeed");
+  ray_free_img(img);
+
+  // room for 4 tiles
+  mkdir(CACHE_DIR, 0777);
+  RayTextureCache *cache =
+      ray_create_texture_cache(CACHE_DIR, 4 * TILE_BYTES + 1024);
+  assert(cache != NULL && "cache creation must succeed");
+  RayCachedTexture *texture =
+      ray_texture_cache_open(cache, "texture_cache_test.png");
+  assert(texture != NULL && "opening the texture must succeed");
+  assert(texture->width == WIDTH && texture->height == HEIGHT &&
+         "cached texture must be the size of the png");
+  assert(texture->num_levels == 8 && "levels must go down to 1x1");
+  assert(ray_texture_cache_stats(cache).resident_bytes == 0 &&
+         "opening must not load any tiles");
+
+  // top level texels come back exactly, through as many evictions as it
+  // takes to go over all 12 tiles
+  gsl_vector *color = gsl_vector_alloc(3);
+  for (int y = 0; y < HEIGHT; ++y) {
+    for (int x = 0; x < WIDTH; ++x) {
+      assert(sample_matches(texture, x, y, color) &&
+             "cached texels must match the png");
+    }
+  }
+  RayTextureCacheStats stats = ray_texture_cache_stats(cache);
+  assert(stats.resident_bytes <= 4 * TILE_BYTES + 1024 &&
+         "resident tiles must stay within the budget");
+  assert(stats.misses >= 12 && stats.evictions >= 8 &&
+         "every tile must have been loaded, evicting the others");
+
+  // a footprint the size of the whole texture is the 1x1 level, the
+  // average of everything
+  ray_cached_texture_sample_into(texture, (RayTexCoord){0.3, 0.6}, 1.0,
+                                 color);
+  assert(gsl_vector_get(color, 0) > 0.2 && gsl_vector_get(color, 0) < 0.4 &&
+         "the smallest level must be the average red");
+  assert(gsl_vector_get(color, 1) > 0.3 && gsl_vector_get(color, 1) < 0.5 &&
+         "the smallest level must be the average green");
+
+  // threads sampling against each other over a budget smaller than what
+  // they touch still only ever see the right texels
+  pthread_t threads[NUM_THREADS];
+  for (int t = 0; t < NUM_THREADS; ++t) {
+    int created = pthread_create(&threads[t], NULL, sample_everywhere, texture);
+    assert(created == 0 && "thread creation must succeed");
+  }
+  for (int t = 0; t < NUM_THREADS; ++t) {
+    void *result = NULL;
+    pthread_join(threads[t], &result);
+    assert(result != NULL && "concurrent samples must match the png");
+  }
+  ray_free_cached_texture(texture);
+
+  // the cache file is reused until the png changes
+  char cache_path[PATH_MAX] = "";
+  DIR *dir = opendir(CACHE_DIR);
+  assert(dir != NULL && "the cache directory must exist");
+  for (struct dirent *entry = readdir(dir); entry != NULL;
+       entry = readdir(dir)) {
+    if (strstr(entry->d_name, ".raytex") != NULL) {
+      snprintf(cache_path, sizeof cache_path, CACHE_DIR "/%s",
+               entry->d_name);
+    }
+  }
+  closedir(dir);
+  struct stat before;
+  int result = stat(cache_path, &before);
+  assert(result == 0 && "the cache file must exist");
+  // mtimes may be coarse
+  nanosleep(&(struct timespec){.tv_nsec = 20000000}, NULL);
+  texture = ray_texture_cache_open(cache, "texture_cache_test.png");
+  assert(texture != NULL && "reopening the texture must succeed");
+  ray_free_cached_texture(texture);
+  struct stat after;
+  stat(cache_path, &after);
+  assert(before.st_mtim.tv_sec == after.st_mtim.tv_sec &&
+         before.st_mtim.tv_nsec == after.st_mtim.tv_nsec &&
+         "an up to date cache file must not be rewritten");
+
+  texture = ray_texture_cache_open(cache, "missing.png");
+  assert(texture == NULL && "missing textures must fail to open");
+
+  gsl_vector_free(color);
+  ray_free_texture_cache(cache);
+  return 0;
+}
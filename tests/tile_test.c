@@ -0,0 +1,83 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "ray/tile.h"
+
+#define WIDTH 53
+#define HEIGHT 37
+#define TILE_SIZE 8
+
+static void check_coverage(RAY_TILE_ORDER order) {
+  int num_tiles;
+  RayTile *tiles = ray_create_tiles(WIDTH, HEIGHT, TILE_SIZE, order, &num_tiles);
+  assert(tiles != NULL && "tiles must be created for valid orders");
+
+  int coverage[HEIGHT][WIDTH] = {{0}};
+  for (int t = 0; t < num_tiles; ++t) {
+    for (int y = tiles[t].y; y < tiles[t].y + tiles[t].height; ++y) {
+      for (int x = tiles[t].x; x < tiles[t].x + tiles[t].width; ++x) {
+        coverage[y][x] += 1;
+      }
+    }
+  }
+  for (int y = 0; y < HEIGHT; ++y) {
+    for (int x = 0; x < WIDTH; ++x) {
+      assert(coverage[y][x] == 1 && "every pixel must be in exactly one tile");
+    }
+  }
+  free(tiles);
+}
+
+int main() {
+  check_coverage(RAY_TILE_ORDER_scanline);
+  check_coverage(RAY_TILE_ORDER_raster);
+  check_coverage(RAY_TILE_ORDER_morton);
+  check_coverage(RAY_TILE_ORDER_hilbert);
+
+  for (uint32_t code = 0; code < 1024; ++code) {
+    uint32_t x;
+    uint32_t y;
+    ray_morton_decode(code, &x, &y);
+    assert(ray_morton_encode(x, y) == code && "morton codes must round trip");
+  }
+
+  // neighbouring steps along a hilbert curve are always adjacent cells
+  const uint32_t side = 16;
+  uint32_t cell_x[16 * 16];
+  uint32_t cell_y[16 * 16];
+  for (uint32_t y = 0; y < side; ++y) {
+    for (uint32_t x = 0; x < side; ++x) {
+      uint32_t d = ray_hilbert_index(side, x, y);
+      assert(d < side * side && "hilbert index out of range");
+      cell_x[d] = x;
+      cell_y[d] = y;
+    }
+  }
+  for (uint32_t d = 1; d < side * side; ++d) {
+    uint32_t dx = cell_x[d] > cell_x[d - 1] ? cell_x[d] - cell_x[d - 1]
+                                            : cell_x[d - 1] - cell_x[d];
+    uint32_t dy = cell_y[d] > cell_y[d - 1] ? cell_y[d] - cell_y[d - 1]
+                                            : cell_y[d - 1] - cell_y[d];
+    assert(dx + dy == 1 && "hilbert curve must be continuous");
+  }
+
+  return 0;
+}
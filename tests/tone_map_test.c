@@ -0,0 +1,115 @@
+//  a small and simple raytracer
+//  Copyright (C) 2021  Benjamin Hinchliff
+//
+//  This library is free software; you can redistribute it and/or
+//  modify it under the terms of the GNU Lesser General Public
+//  License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//  Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with this library; if not, write to the Free Software
+//  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+//  USA
+
+#include <assert.h>
+#include <math.h>
+
+#include "ray/loader.h"
+#include "ray/render.h"
+#include "ray/tone_map.h"
+
+static void check_curves(void) {
+  const float in[] = {-1.0f, 0.0f, 0.25f, 1.0f, 4.0f};
+  float out[5];
+
+  RayToneMapSettings settings = ray_default_tone_map();
+  ray_tone_map_floats(in, out, 5, &settings);
+  assert(out[0] == 0.0f && out[2] == 0.25f && out[4] == 1.0f &&
+         "clamp must only cut off outside [0, 1]");
+
+  settings.exposure = 1.0;
+  ray_tone_map_floats(in, out, 5, &settings);
+  assert(out[2] == 0.5f && "an exposure of 1 must double the input");
+
+  settings = (RayToneMapSettings){.op = RAY_TONE_MAP_reinhard};
+  ray_tone_map_floats(in, out, 5, &settings);
+  assert(out[3] == 0.5f && out[4] == 0.8f && "reinhard must be x / (1 + x)");
+
+  settings.op = RAY_TONE_MAP_aces;
+  ray_tone_map_floats(in, out, 5, &settings);
+  assert(out[1] == 0.0f && "aces must map black to black");
+  for (int i = 1; i < 5; ++i) {
+    assert(out[i] >= out[i - 1] && out[i] <= 1.0f &&
+           "aces must be increasing and stay within [0, 1]");
+  }
+
+  // the same buffer can be both input and output
+  float copy[5] = {-1.0f, 0.0f, 0.25f, 1.0f, 4.0f};
+  ray_tone_map_floats(copy, copy, 5, &settings);
+  for (int i = 0; i < 5; ++i) {
+    assert(copy[i] == out[i] && "mapping in place must match");
+  }
+}
+
+int main() {
+  check_curves();
+
+  RayScene scene;
+  bool success = ray_scene_from_file("scene.json", &scene);
+  if (!success) {
+    fprintf(stderr, "failed to load scene.json\n");
+    return 1;
+  }
+  scene.width = 160;
+  scene.height = 120;
+
+  RayRenderer *renderer = ray_create_renderer(NULL);
+  assert(renderer != NULL && "renderer creation must succeed");
+  RayFramebuffer *fb = ray_renderer_render_hdr(renderer, &scene);
+  assert(fb != NULL && "hdr render must produce a framebuffer");
+  RayImg *img = ray_renderer_render(renderer, &scene);
+  assert(img != NULL && "render must produce an image");
+
+  // nothing is clamped before tone mapping, and the default tone mapping is
+  // what plain renders return
+  bool over_one = false;
+  RayImg *mapped = ray_tone_map(fb, NULL);
+  for (int y = 0; y < scene.height; ++y) {
+    for (int x = 0; x < scene.width; ++x) {
+      const float *pixel = ray_framebuffer_pixel(fb, x, y);
+      for (size_t c = 0; c < 3; ++c) {
+        over_one = over_one || pixel[c] > 1.0f;
+        assert(gsl_vector_get(mapped->pixels[y][x], c) ==
+                   gsl_vector_get(img->pixels[y][x], c) &&
+               "default tone mapping must match a plain render");
+      }
+    }
+  }
+  assert(over_one && "the framebuffer must keep values over 1");
+
+  // re-exposing only needs the framebuffer
+  RayToneMapSettings darker = {.op = RAY_TONE_MAP_reinhard, .exposure = -2.0};
+  ray_tone_map_into(fb, &darker, mapped);
+  for (int y = 0; y < scene.height; ++y) {
+    for (int x = 0; x < scene.width; ++x) {
+      for (size_t c = 0; c < 3; ++c) {
+        assert(gsl_vector_get(mapped->pixels[y][x], c) <=
+                   gsl_vector_get(img->pixels[y][x], c) &&
+               "a lower exposure must not brighten anything");
+      }
+    }
+  }
+
+  ray_free_img(mapped);
+  ray_free_img(img);
+  ray_free_framebuffer(fb);
+  ray_free_renderer(renderer);
+  ray_free_scene(&scene);
+
+  return 0;
+}